@@ -0,0 +1,129 @@
+/**
+ * @file analog_sensors.h
+ * @brief DMA-driven acquisition of the analog pool sensors (pH, ORP, pressure)
+ *
+ * pH and ORP probe amplifiers and the filter pressure transducer are analog
+ * outputs; a single ADC read of them is noisy to a tenth of a pH unit. Here
+ * the ADC1 runs continuously in I2S DMA mode and scans every configured
+ * channel on its own (SAR pattern table): samples land in DMA buffers with
+ * no CPU involvement, each tagged with its channel number.
+ *
+ * serviceAnalogSensors() drains the completed buffers (never waits) and runs
+ * every sample through a per-channel fixed-point CIC decimator
+ * (cic_decimator.h: ANALOG_CIC_STAGES integrator/comb stages, decimation
+ * ANALOG_DECIMATION). The decimated outputs are averaged over
+ * ANALOG_UPDATE_INTERVAL and mapped to engineering units with a two-point
+ * calibration per sensor, stored in NVS (defaults in config.h).
+ *
+ * The pump current transformer and the mains voltage sensor are scanned in
+ * the same pattern, right after each other, but bypass the CIC: their raw
+ * samples are paired (current, voltage) and handed in blocks to the
+ * waveform callback (pump monitor) for per-cycle RMS / power processing.
+ *
+ * Acquisition throughput, filter CPU time and lost buffers are logged every
+ * ANALOG_REPORT_INTERVAL.
+ */
+
+#ifndef ANALOG_SENSORS_H
+#define ANALOG_SENSORS_H
+
+#include <Arduino.h>
+#include "cic_decimator.h"
+
+// ==================== Acquisition Settings ====================
+#define ANALOG_DMA_BUFFERS      8       // DMA buffers (ring)
+#define ANALOG_DMA_BUFFER_LEN   256     // Samples per DMA buffer
+#define ANALOG_UPDATE_INTERVAL  1000    // Averaging window of the published value (ms)
+#define ANALOG_REPORT_INTERVAL  3600000 // Acquisition statistics log (ms)
+
+/**
+ * Sensors in the order of the calibration and JSON tables
+ */
+enum AnalogSensor {
+  ANALOG_PH,
+  ANALOG_ORP,
+  ANALOG_PRESSURE,
+  ANALOG_SENSOR_COUNT
+};
+
+/**
+ * Receives the raw current / voltage sample pairs of one DMA buffer
+ * @param current ADC counts of the current transformer
+ * @param voltage ADC counts of the voltage sensor, nullptr if not installed
+ * @param count Number of samples (pairs)
+ */
+typedef void (*AnalogWaveformCallback)(const uint16_t* current, const uint16_t* voltage, size_t count);
+
+/**
+ * Install the I2S/ADC DMA driver, load the calibrations and start sampling
+ * Sensors whose pin is -1 in config.h are not scanned.
+ */
+void initAnalogSensors();
+
+/**
+ * Drain the DMA buffers and filter the samples (call every loop, never blocks)
+ * @return true in the iteration a new averaged value of every sensor is ready
+ */
+bool serviceAnalogSensors();
+
+/**
+ * Set the handler of the current / voltage waveform (runs in the loop task,
+ * inside serviceAnalogSensors())
+ */
+void setAnalogWaveformCallback(AnalogWaveformCallback callback);
+
+/**
+ * Nominal sample rate of each scanned channel (Hz, 0 if not running)
+ */
+uint32_t getAnalogChannelRate();
+
+/**
+ * Check if the current transformer / voltage sensor channels are scanned
+ */
+bool hasAnalogCurrent();
+bool hasAnalogVoltage();
+
+/**
+ * Calibrated value of a sensor (pH, mV, bar)
+ * @return NAN for a disabled sensor or before the first averaging window
+ */
+float getAnalogValue(AnalogSensor sensor);
+
+/**
+ * Check if a sensor is configured and scanned
+ */
+bool isAnalogSensorInstalled(AnalogSensor sensor);
+
+/**
+ * Name of a sensor as used in the JSON and calibration commands ("ph")
+ */
+const char* getAnalogName(AnalogSensor sensor);
+
+/**
+ * Take the current reading of a sensor as a calibration point
+ * The point closest in value is replaced (pH 7 then pH 4 buffers set both).
+ * @param name Sensor name, case-insensitive
+ * @param value Reference value of the buffer/standard, or "RESET" for the
+ *              config.h defaults
+ * @return false if the sensor is unknown / not read yet or the point is
+ *         too close to the other one
+ */
+bool calibrateAnalogSensor(const char* name, const char* value);
+
+/**
+ * Check if a sensor moved past its deadband since markAnalogSensorsPublished()
+ */
+bool analogSensorsMoved();
+
+/**
+ * Current values become the reference of analogSensorsMoved()
+ */
+void markAnalogSensorsPublished();
+
+/**
+ * Enabled sensors as one JSON object (unread sensors are null)
+ * @return {"ph":7.21,"orp":652,"pressure":1.18}
+ */
+String getAnalogSensorsJSON();
+
+#endif // ANALOG_SENSORS_H
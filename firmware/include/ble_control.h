@@ -0,0 +1,98 @@
+/**
+ * @file ble_control.h
+ * @brief Local pump/valve/timer control and telemetry GATT service
+ *
+ * Optional service (BLE_LOCAL_CONTROL in config.h) that stays available after
+ * provisioning, so the owner next to the pool can operate the equipment when
+ * the internet or the cloud broker is down.
+ *
+ * Each resource has one characteristic. Writes carry the same payloads as the
+ * MQTT command topics (pump ON/OFF/TOGGLE, valve 1/2/TOGGLE, timer JSON) and
+ * are handed to the same command handlers. The characteristic value is the
+ * current state and is notified whenever it changes, whatever the source of
+ * the change (MQTT, BLE or the timer).
+ *
+ * Reading and subscribing are open; writing needs a bonded link encrypted
+ * with keys authenticated by the passkey (BLE_CONTROL_PASSKEY). The stack
+ * answers a write on a weaker link with "insufficient authentication", which
+ * makes the phone pair: the user types the passkey once and the bond is
+ * stored on both sides.
+ *
+ * Writes arrive in the NimBLE host task. They are only queued there; the
+ * callback runs from serviceBLEControl() in the loop task, so the handlers
+ * never race the MQTT callback. Latency from write to handled command is
+ * measured for every command.
+ *
+ * Notifications go to every subscribed client at its own MTU. A value the
+ * stack could not queue for a client (congested link) is notified again
+ * from serviceBLEControl() with the then current value.
+ */
+
+#ifndef BLE_CONTROL_H
+#define BLE_CONTROL_H
+
+#include <Arduino.h>
+
+class NimBLEServer;
+
+#define BLE_CONTROL_QUEUE_LEN     4    // Commands waiting for the loop task
+#define BLE_CONTROL_PAYLOAD_MAX   64   // Longest accepted write (timer JSON)
+
+/**
+ * Controllable resources (one characteristic each)
+ */
+enum BLEControlChannel {
+  BLE_CONTROL_PUMP,
+  BLE_CONTROL_VALVE,
+  BLE_CONTROL_TIMER,
+  BLE_CONTROL_TEMPERATURE,   // Notify only
+  BLE_CONTROL_CHANNEL_COUNT
+};
+
+/**
+ * Command handler, called from serviceBLEControl() in the loop task
+ * @param channel Resource the command was written to
+ * @param payload Written value (NUL-terminated)
+ */
+typedef void (*BLEControlCallback)(BLEControlChannel channel, const char* payload);
+
+/**
+ * Latency statistics (write received in the host task -> handler returned)
+ */
+struct BLEControlStats {
+  uint32_t commands;
+  uint32_t dropped;   // Queue full
+  uint32_t rejected;  // Written on a link without an authenticated bond
+  uint32_t avgUs;
+  uint32_t maxUs;
+};
+
+/**
+ * Add the control service to the GATT server
+ * Called by the BLE stack setup before advertising starts
+ */
+void createBLEControlService(NimBLEServer* server);
+
+/**
+ * Register the command handler
+ */
+void setBLEControlCallback(BLEControlCallback callback);
+
+/**
+ * Run queued commands and repeat refused notifications
+ * (call every loop, returns immediately when idle)
+ */
+void serviceBLEControl();
+
+/**
+ * Update a resource value and notify subscribed clients
+ * No-op until the service exists
+ */
+void notifyBLEControl(BLEControlChannel channel, const char* value);
+
+/**
+ * Latency statistics since boot
+ */
+BLEControlStats getBLEControlStats();
+
+#endif // BLE_CONTROL_H
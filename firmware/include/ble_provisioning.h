@@ -9,7 +9,8 @@
  * Flow:
  * 1. ESP32 boots and starts BLE advertising (if no WiFi credentials)
  * 2. Dashboard uses Web Bluetooth API to scan and connect
- * 3. Dashboard writes WiFi SSID and password to BLE characteristics
+ * 3. Dashboard writes SSID, password and optional settings in one TLV write
+ *    (older dashboards: one write each to the SSID and password characteristics)
  * 4. ESP32 saves credentials to NVS and attempts WiFi connection
  * 5. BLE is disabled after successful WiFi connection (saves power)
  */
@@ -18,19 +19,65 @@
 #define BLE_PROVISIONING_H
 
 #include <Arduino.h>
+#include "wifi_scan.h"
+#include "network_settings.h"
+
+// ==================== Connections ====================
+// Concurrent centrals (e.g. two phones plus a laptop). Each connection has its
+// own MTU, subscriptions, status replies and networks stream. Must match
+// CONFIG_BT_NIMBLE_MAX_CONNECTIONS in platformio.ini; advertising stops
+// while every slot is taken.
+#define BLE_MAX_CLIENTS         3
+
+// ==================== Advertising Profiles ====================
+// Intervals in units of 0.625 ms. Fast advertising makes the device show up
+// in the browser picker almost immediately; slow advertising keeps it
+// connectable while leaving the shared 2.4 GHz radio to WiFi.
+#define BLE_ADV_FAST_WINDOW     30000  // Fast profile after boot / button (ms)
+#define BLE_ADV_FAST_MIN        0x20   // 20 ms
+#define BLE_ADV_FAST_MAX        0x30   // 30 ms
+#define BLE_ADV_SLOW_MIN        0x640  // 1000 ms
+#define BLE_ADV_SLOW_MAX        0x7A0  // 1220 ms
+
+/**
+ * Start the NimBLE stack, register all GATT services and advertise
+ * Does not enable provisioning; called by initBLEProvisioning() and at boot
+ * when the local control service (BLE_LOCAL_CONTROL) is enabled. Idempotent.
+ */
+void startBLEStack();
 
 /**
  * Initialize BLE provisioning service
  * Starts BLE advertising with device name "ESP32-Pool-XXXX" (XXXX = last 4 MAC digits)
+ * Cheap to call repeatedly: the GATT database and callbacks are built once,
+ * later calls only resume advertising (restart time and heap are logged)
  */
 void initBLEProvisioning();
 
 /**
- * Stop BLE provisioning and free resources
- * Call this after successful WiFi connection to save power
+ * Stop BLE provisioning
+ * Call this after successful WiFi connection. Advertising is paused and the
+ * client disconnected; the stack itself is not deinitialized, so a later
+ * initBLEProvisioning() does not rebuild anything. With BLE_LOCAL_CONTROL
+ * advertising keeps running for the control service.
  */
 void stopBLEProvisioning();
 
+/**
+ * Shut Bluetooth down for the rest of this boot and return the controller
+ * memory to the heap (esp_bt_controller_mem_release)
+ * Only without BLE_LOCAL_CONTROL, while provisioning is stopped and no client
+ * is connected. Afterwards initBLEProvisioning() is a no-op and provisioning
+ * relies on the captive portal; a reboot brings BLE back.
+ * @return Heap bytes gained (0 if nothing was released)
+ */
+uint32_t releaseBLEMemory();
+
+/**
+ * Check if Bluetooth was released for this boot
+ */
+bool isBLEReleased();
+
 /**
  * Check if BLE provisioning is active
  * @return true if BLE is running, false otherwise
@@ -38,35 +85,75 @@ void stopBLEProvisioning();
 bool isBLEProvisioningActive();
 
 /**
- * Check if new WiFi credentials were received via BLE
- * @return true if credentials are ready to be used
+ * Check if a dashboard is connected over BLE (provisioning or local control)
  */
-bool hasNewWiFiCredentials();
+bool isBLEClientConnected();
 
 /**
- * Get the WiFi SSID received via BLE
- * @param ssid Buffer to store SSID (minimum 33 bytes)
- * @return true if SSID is available, false otherwise
+ * Number of connected centrals (0 .. BLE_MAX_CLIENTS)
+ */
+uint8_t getBLEClientCount();
+
+/**
+ * Drive the advertising profile (call every loop)
+ * Switches from the fast to the slow profile when the fast window ends and
+ * resumes advertising after a disconnect, unless advertising is paused.
+ */
+void serviceBLEAdvertising();
+
+/**
+ * Advertise with the fast profile for BLE_ADV_FAST_WINDOW
+ * Called at boot, when provisioning starts and on a button press
+ */
+void boostBLEAdvertising();
+
+/**
+ * Pause advertising while the radio is needed by WiFi (association, TLS)
+ * Calls nest; every pause needs a matching resumeBLEAdvertising()
  */
-bool getBLEWiFiSSID(char* ssid);
+void pauseBLEAdvertising();
 
 /**
- * Get the WiFi password received via BLE
+ * Undo one pauseBLEAdvertising(); advertising restarts after the last one
+ */
+void resumeBLEAdvertising();
+
+/**
+ * Take the WiFi credentials received via BLE, if any
+ * Lock-free single-slot mailbox filled by the NimBLE host task; cheap enough
+ * to call on every loop. Taking the credentials empties the slot.
+ * A set comes either from one TLV write on the provisioning characteristic
+ * (SSID, password and optional settings) or from the legacy SSID + password
+ * writes (no settings).
+ * @param ssid Buffer to store SSID (minimum 33 bytes)
  * @param password Buffer to store password (minimum 64 bytes)
- * @return true if password is available, false otherwise
+ * @param settings Optional network settings sent with the credentials
+ * @param fields NETWORK_FIELD_* mask of the settings actually sent (0 = none)
+ * @return true if a complete set was taken
  */
-bool getBLEWiFiPassword(char* password);
+bool takeBLEWiFiCredentials(char* ssid, char* password, NetworkSettings* settings, uint8_t* fields);
 
 /**
- * Scan available WiFi networks and return JSON array
+ * Get the cached WiFi networks as JSON array, complete (see wifi_scan.h)
+ * Never blocks: a stale cache only requests a background scan
  * @return JSON string with network list: [{"ssid":"NETWORK1","rssi":-50,"open":false},...]
- * Call this in response to a scan request from the dashboard
  */
 String scanWiFiNetworks();
 
 /**
- * Clear the received credentials flag
- * Call this after successfully connecting to WiFi
+ * Stream scan results on the networks characteristic (call every loop)
+ * Entries are notified as each channel completes, strongest first: JSON
+ * arrays (one per line) cut into sequence-numbered chunks that fit the
+ * MTU of the requesting connection. The last chunk carries the final flag.
+ * Every client that wrote a request gets its own stream; a chunk refused by
+ * the stack (out of buffers, congested link) is retried on the next call
+ * while the other clients keep going.
+ * @param event Result of serviceWiFiScan() in this loop iteration
+ */
+void updateBLENetworks(WiFiScanEvent event);
+
+/**
+ * Drop credentials waiting in the mailbox (e.g. when provisioning stops)
  */
 void clearBLECredentials();
 
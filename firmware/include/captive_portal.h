@@ -0,0 +1,79 @@
+/**
+ * @file captive_portal.h
+ * @brief Non-blocking SoftAP captive portal for WiFi provisioning
+ *
+ * Fallback provisioning method for devices without Web Bluetooth (iOS).
+ * Unlike WiFiManager::autoConnect(), the portal never blocks: the DNS and
+ * HTTP servers are serviced from loop() with handleCaptivePortal(), so the
+ * pump timer and BLE provisioning keep running while the portal is open.
+ *
+ * The page is stored gzip-compressed in flash (data/portal/index.html.gz,
+ * embedded with board_build.embed_files) and served with Content-Encoding
+ * and Cache-Control headers. Every response is timed; see getPortalStats().
+ *
+ * To update the page, edit data/portal/index.html and regenerate:
+ *   gzip -9 -n -c data/portal/index.html > data/portal/index.html.gz
+ */
+
+#ifndef CAPTIVE_PORTAL_H
+#define CAPTIVE_PORTAL_H
+
+#include <Arduino.h>
+
+#define PORTAL_AP_SSID        "ESP32-Pool-Setup"
+#define PORTAL_CACHE_MAX_AGE  86400   // Page cache lifetime in the browser (s)
+
+/**
+ * Response time statistics of the portal HTTP server
+ */
+struct PortalStats {
+  uint32_t requests;
+  uint32_t avgUs;
+  uint32_t maxUs;
+};
+
+/**
+ * Start the SoftAP, DNS catch-all and HTTP server
+ * Keeps the station interface (WIFI_AP_STA) so reconnection can continue
+ */
+void startCaptivePortal();
+
+/**
+ * Stop the portal and return to station-only mode
+ */
+void stopCaptivePortal();
+
+/**
+ * Check if the portal is running
+ */
+bool isCaptivePortalActive();
+
+/**
+ * Service DNS and HTTP clients (call every loop, returns immediately)
+ */
+void handleCaptivePortal();
+
+/**
+ * Check if credentials were submitted through the portal
+ */
+bool hasPortalCredentials();
+
+/**
+ * Get the submitted credentials
+ * @param ssid Buffer for SSID (minimum 33 bytes)
+ * @param password Buffer for password (minimum 64 bytes)
+ * @return true if credentials are available
+ */
+bool getPortalCredentials(char* ssid, char* password);
+
+/**
+ * Clear the submitted credentials after handling them
+ */
+void clearPortalCredentials();
+
+/**
+ * Response time statistics since the portal was started
+ */
+PortalStats getPortalStats();
+
+#endif // CAPTIVE_PORTAL_H
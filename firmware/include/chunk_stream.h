@@ -0,0 +1,84 @@
+/**
+ * @file chunk_stream.h
+ * @brief Framing of a text stream into MTU-sized BLE notifications
+ *
+ * The networks list goes out as a text stream cut into chunks that fit the
+ * negotiated MTU, one per notification:
+ *   [flags][seq][payload]
+ * flags always has CHUNK_FLAG_FRAMED (never the first byte of plain JSON) and
+ * CHUNK_FLAG_FINAL on the last chunk of the list; seq counts chunks from 0
+ * (wrapping at 256) for each list so the client can detect a dropped
+ * notification.
+ *
+ * A chunk is only taken from the caller's text once the stack accepted it.
+ * A refusal (no mbuf, congested link) leaves the text in place and the same
+ * seq is cut again on the next call, so the sequence stays in order.
+ *
+ * Hardware-independent (no Arduino or NimBLE includes) so it is covered by
+ * the native tests (test/test_chunk_stream).
+ */
+
+#ifndef CHUNK_STREAM_H
+#define CHUNK_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ==================== Frame Layout ====================
+#define CHUNK_FLAG_FRAMED       0x80
+#define CHUNK_FLAG_FINAL        0x01
+#define CHUNK_HEADER_SIZE       2
+#define ATT_NOTIFY_OVERHEAD     3       // Opcode + attribute handle
+#define CHUNK_MTU_MIN           23      // BLE default ATT MTU
+#define CHUNK_MTU_MAX           527     // Largest ATT MTU (frame buffer size)
+#define CHUNK_BATCH_MIN         128     // Minimum text appended at once (one JSON entry always fits)
+
+/**
+ * Sequence and counters of one list transfer
+ */
+struct ChunkStream {
+  uint8_t seq;            // Next chunk's sequence number
+  uint32_t chunks;        // Chunks accepted
+  uint32_t bytes;         // Frame bytes accepted (headers included)
+  uint16_t stalls;        // Refusals by the stack
+};
+
+enum ChunkStatus {
+  CHUNK_IDLE,             // Nothing to send yet (list not complete)
+  CHUNK_SENT,
+  CHUNK_REFUSED,          // Stack had no room: call again later
+  CHUNK_FINAL             // Last chunk of the list sent
+};
+
+/**
+ * Queue one frame as a notification
+ * @return false if the stack has no room right now
+ */
+typedef bool (*ChunkSendFn)(void* context, const uint8_t* frame, size_t length);
+
+/**
+ * Start a new list (seq back to 0, counters cleared)
+ */
+void resetChunkStream(ChunkStream* stream);
+
+/**
+ * Payload bytes per chunk at an ATT MTU (clamped to CHUNK_MTU_MIN..MAX)
+ */
+size_t chunkPayloadMax(uint16_t mtu);
+
+/**
+ * Text to append to the stream at once at an ATT MTU: one chunk's worth,
+ * at least CHUNK_BATCH_MIN
+ */
+size_t chunkBatchMax(uint16_t mtu);
+
+/**
+ * Cut the next chunk from the front of text and send it
+ * @param listComplete No more text will be added: the chunk that empties
+ *                     text (or an empty one) carries CHUNK_FLAG_FINAL
+ * @param consumed Bytes of text the caller must drop (0 unless sent)
+ */
+ChunkStatus sendNextChunk(ChunkStream* stream, const char* text, size_t length, uint16_t mtu,
+                          bool listComplete, ChunkSendFn send, void* context, size_t* consumed);
+
+#endif // CHUNK_STREAM_H
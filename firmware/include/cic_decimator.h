@@ -0,0 +1,76 @@
+/**
+ * @file cic_decimator.h
+ * @brief Fixed-point CIC decimator of the analog sensor channels
+ *
+ * Hardware-independent kernel of analog_sensors.cpp (no Arduino includes):
+ * ANALOG_CIC_STAGES integrators at the input rate, as many combs at the
+ * decimated rate, registers wrapping modulo 2^32. The output is exact (the
+ * same as cascaded boxcar averages of ANALOG_DECIMATION samples, scaled by
+ * cicGain()) as long as it fits 32 bits, which the static_assert checks for
+ * 12-bit samples.
+ *
+ * cicDecimate() runs once per ADC sample (20000/s), so it stays inline here.
+ * Its cost on the host and its exactness are checked by
+ * test/test_cic_decimator; the device logs its own ns/sample hourly.
+ */
+
+#ifndef CIC_DECIMATOR_H
+#define CIC_DECIMATOR_H
+
+#include <stdint.h>
+
+#define ANALOG_CIC_STAGES       3       // CIC order
+#define ANALOG_DECIMATION       64      // CIC decimation (gain 64^3 = 2^18, fits 32 bits with 12-bit samples)
+
+/**
+ * CIC DC gain (decimation ^ stages)
+ */
+static constexpr float cicGain(int stages = ANALOG_CIC_STAGES) {
+  return stages == 0 ? 1.0f : ANALOG_DECIMATION * cicGain(stages - 1);
+}
+
+// The integrators wrap modulo 2^32; the output is exact as long as it fits
+static_assert(4095.0f * cicGain() < 4294967296.0f,
+              "ANALOG_CIC_STAGES / ANALOG_DECIMATION overflow 32-bit CIC registers");
+
+struct CicDecimator {
+  uint32_t integrator[ANALOG_CIC_STAGES];
+  uint32_t comb[ANALOG_CIC_STAGES];
+  uint16_t phase;           // Input samples since the last output
+  uint8_t settling;         // Outputs still to discard after a reset
+};
+
+/**
+ * Clear the registers (the first ANALOG_CIC_STAGES outputs are discarded)
+ */
+void resetCicDecimator(CicDecimator* cic);
+
+/**
+ * Feed one sample
+ * @param output Decimated output (counts * cicGain()) when it returns true
+ * @return true every ANALOG_DECIMATION samples, once settled
+ */
+static inline bool cicDecimate(CicDecimator* cic, uint32_t sample, uint32_t* output) {
+  uint32_t v = sample;
+  for (int i = 0; i < ANALOG_CIC_STAGES; i++) {
+    cic->integrator[i] += v;
+    v = cic->integrator[i];
+  }
+  if (++cic->phase < ANALOG_DECIMATION) return false;
+  cic->phase = 0;
+
+  for (int i = 0; i < ANALOG_CIC_STAGES; i++) {
+    uint32_t in = v;
+    v = in - cic->comb[i];
+    cic->comb[i] = in;
+  }
+  // The first outputs still see the empty comb delays
+  if (cic->settling) {
+    cic->settling--;
+    return false;
+  }
+  *output = v;
+  return true;
+}
+
+#endif // CIC_DECIMATOR_H
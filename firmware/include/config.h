@@ -15,6 +15,26 @@
 
 // --- Inputs: Sensors ---
 #define TEMP_SENSOR_PIN     21  // DS18B20 temperature probe (OneWire) - 4.7kΩ pull-up to 3.3V - GPIO 2-23 side (top corner)
+#define BOOT_BUTTON_PIN     0   // BOOT button on the devkit (active LOW) - short press = fast BLE advertising
+
+// --- Inputs: Analog Sensors (ADC1 only, -1 = not installed) ---
+// All off by default: a floating ADC pin reads noise as a pH/ORP/pressure value.
+// To install one, wire it to the suggested GPIO and replace -1 with that number.
+#define PH_SENSOR_PIN       -1  // pH probe amplifier output - GPIO 36 (ADC1_CH0, VP)
+#define ORP_SENSOR_PIN      -1  // ORP probe amplifier output - GPIO 39 (ADC1_CH3, VN)
+#define PRESSURE_SENSOR_PIN -1  // Filter pressure transducer (0.5-4.5 V through a divider) - GPIO 34 (ADC1_CH6)
+#define CT_SENSOR_PIN       -1  // Pump current transformer (SCT-013, burden + 1.65 V bias) - GPIO 35 (ADC1_CH7)
+#define VOLTAGE_SENSOR_PIN  -1  // Mains voltage sensor (ZMPT101B) - GPIO 32 (ADC1_CH4)
+
+// --- Inputs: Pulse Counter (-1 = not installed) ---
+#define FLOW_SENSOR_PIN     -1  // Hall-effect flow meter pulse output (open collector, internal pull-up) - GPIO 27 suggested - PCNT unit 0
+
+// --- RS-485 Bus: Variable-Speed Pump Drive (UART2) ---
+// Only opened when VSD_PUMP = 1 (see Variable-Speed Pump below); with VSD_PUMP = 0
+// these GPIOs stay free. -1 on TX or RX keeps the bus closed even with VSD_PUMP = 1.
+#define MODBUS_TX_PIN       17  // RS-485 transceiver DI (MAX3485, 3.3V) - UART2 TX
+#define MODBUS_RX_PIN       16  // RS-485 transceiver RO - UART2 RX
+#define MODBUS_DE_PIN       4   // RS-485 transceiver DE + /RE tied - UART2 RTS (half-duplex mode)
 
 // ==================== MQTT Topics ====================
 
@@ -43,5 +63,167 @@
 #define TOPIC_TIMER_STATE   "devices/" DEVICE_ID "/timer/state"
 
 // Temperature:
-// TOPIC_TEMP_STATE = ESP32 publica temperatura actual (°C) -> dashboard se suscribe
+// TOPIC_TEMP_STATE  = ESP32 publica temperatura del agua (°C) -> dashboard se suscribe
+// TOPIC_TEMP_PROBES = ESP32 publica todas las sondas (JSON: {"water":25.3,"air":31.0}) -> dashboard se suscribe
+// TOPIC_TEMP_LABEL  = dashboard publica nombre de una sonda ("<ROM o nombre>=<nuevo nombre>") -> ESP32 se suscribe
 #define TOPIC_TEMP_STATE    "devices/" DEVICE_ID "/temperature/state"
+#define TOPIC_TEMP_PROBES   "devices/" DEVICE_ID "/temperature/probes"
+#define TOPIC_TEMP_LABEL    "devices/" DEVICE_ID "/temperature/label"
+
+// TOPIC_PUMP_POWER = ESP32 publica corriente/potencia/energia y alarma de la bomba (JSON) -> dashboard se suscribe
+#define TOPIC_PUMP_POWER    "devices/" DEVICE_ID "/pump/power"
+
+// TOPIC_STATS_GET   = dashboard pide estadisticas ("ALL" o nombre del sensor) -> ESP32 se suscribe
+// TOPIC_STATS_STATE = ESP32 responde un JSON por sensor (ventanas 1m/15m/1h/24h) -> dashboard se suscribe
+#define TOPIC_STATS_GET     "devices/" DEVICE_ID "/stats/get"
+#define TOPIC_STATS_STATE   "devices/" DEVICE_ID "/stats/state"
+
+// TOPIC_SENSORS_STATE = ESP32 publica pH/ORP/presion (JSON: {"ph":7.21,"orp":652,"pressure":1.18}) -> dashboard se suscribe
+// TOPIC_SENSORS_CAL   = dashboard publica calibracion ("<sensor>=<valor del patron>" o "<sensor>=RESET") -> ESP32 se suscribe
+#define TOPIC_SENSORS_STATE "devices/" DEVICE_ID "/sensors/state"
+#define TOPIC_SENSORS_CAL   "devices/" DEVICE_ID "/sensors/calibrate"
+
+// TOPIC_FLOW_STATE = ESP32 publica caudal y volumen total filtrado (JSON: {"rate_lpm":152.3,"total_m3":1234.567}) -> dashboard se suscribe
+#define TOPIC_FLOW_STATE    "devices/" DEVICE_ID "/flow/state"
+
+// TOPIC_PUMP_SPEED_SET   = dashboard publica consigna de velocidad (rpm) -> ESP32 se suscribe
+// TOPIC_PUMP_SPEED_STATE = ESP32 publica estado del variador (JSON: consigna, rpm, potencia, fallo) -> dashboard se suscribe
+#define TOPIC_PUMP_SPEED_SET   "devices/" DEVICE_ID "/pump/speed/set"
+#define TOPIC_PUMP_SPEED_STATE "devices/" DEVICE_ID "/pump/speed/state"
+
+// Power Profile:
+// TOPIC_POWER_SET   = dashboard publica perfil (performance/balanced/eco) o BENCH -> ESP32 se suscribe
+// TOPIC_POWER_STATE = ESP32 publica perfil activo y resultados de latencia (JSON) -> dashboard se suscribe
+// TOPIC_POWER_PROBE = ESP32 publica y recibe sus propias sondas de latencia (loopback via broker)
+#define TOPIC_POWER_SET     "devices/" DEVICE_ID "/power/set"
+#define TOPIC_POWER_STATE   "devices/" DEVICE_ID "/power/state"
+#define TOPIC_POWER_PROBE   "devices/" DEVICE_ID "/power/probe"
+
+// ==================== Local BLE Control ====================
+
+// Servicio GATT persistente para controlar bomba, valvula y timer sin nube
+// (1 = activo; el stack BLE queda encendido despues del provisioning).
+// Solo un telefono vinculado con la clave BLE_CONTROL_PASSKEY (6 digitos,
+// definida en secrets.h) puede escribir comandos; leer el estado es libre.
+// Apagado por defecto: con el control local activo el Bluetooth nunca se
+// apaga, asi que no se libera su memoria (BLE_RELEASE_DELAY) y el perfil
+// "performance" se queda en modem sleep minimo
+#define BLE_LOCAL_CONTROL   0
+
+// Vinculacion BLE (Just Works) al conectar, solo sin control local: el
+// telefono guarda las claves y la tabla GATT, asi las reconexiones se saltan
+// el descubrimiento de servicios (1 = activo). Just Works no autentica y
+// cualquiera en alcance puede vincularse, por eso queda apagado. Con
+// BLE_LOCAL_CONTROL se ignora: el vinculo se crea con la clave
+// BLE_CONTROL_PASSKEY en la primera escritura de control
+#define BLE_BONDING         0
+
+// Solo con BLE_LOCAL_CONTROL en 0 (sin efecto con control local): tras este
+// tiempo con WiFi y MQTT estables se apaga el Bluetooth y se libera su
+// memoria hasta el proximo reinicio (el portal cautivo sigue disponible para
+// reconfigurar la red)
+#define BLE_RELEASE_DELAY   300000  // ms
+
+// ==================== Temperature Sampling ====================
+
+// Muestreo adaptativo: con el agua estable se lee poco y con poca resolucion
+// (menos tiempo de conversion); si la temperatura se mueve (calentador, agua
+// nueva, sol) se pasa a alta resolucion y lecturas frecuentes
+#define TEMP_STABLE_RESOLUTION  10      // bits: 0.25 °C, conversion ~188 ms
+#define TEMP_ACTIVE_RESOLUTION  12      // bits: 0.0625 °C, conversion ~750 ms
+#define TEMP_STABLE_INTERVAL    120000  // ms entre lecturas con el agua estable
+#define TEMP_ACTIVE_INTERVAL    10000   // ms entre lecturas mientras cambia
+#define TEMP_ACTIVE_DELTA       0.5     // °C de deriva (cualquier sonda) que activan el modo rapido
+#define TEMP_STABLE_WINDOW      600000  // ms de ventana para medir la velocidad de cambio (a 1 °C/h, casi 3 pasos de 12 bits)
+#define TEMP_STABLE_RATE        1.0     // °C/h: por debajo (en toda la ventana) vuelve al modo estable
+
+// Filtro de temperatura: mediana de las ultimas N lecturas (descarta picos de
+// un cable largo o ruidoso) y despues un filtro de Kalman escalar. Se publica
+// solo cuando el valor filtrado se mueve mas que la banda muerta o cuando
+// vence el intervalo maximo
+#define TEMP_MEDIAN_SIZE        3       // lecturas (1 = sin mediana, max 7)
+#define TEMP_KALMAN_Q           0.0004  // °C² por segundo: cuanto puede cambiar el agua de verdad
+#define TEMP_KALMAN_R           0.01    // °C²: ruido de la sonda (se suma el de la resolucion)
+#define TEMP_DEADBAND           0.1     // °C
+#define TEMP_MAX_REPORT_INTERVAL 600000 // ms sin publicar como maximo
+
+// ==================== Analog Sensors ====================
+
+// El ADC1 muestrea todos los sensores por DMA sin intervencion de la CPU; cada
+// canal pasa por un filtro CIC decimador y se promedia cada segundo
+#define ANALOG_SAMPLE_RATE      20000   // muestras/s del ADC, repartidas entre los canales (4 kHz c/u con 5)
+
+// Calibracion por defecto: dos puntos (cuentas del ADC = valor) por sensor.
+// Se recalibra con la sonda en el patron publicando "PH=7.00" en
+// sensors/calibrate (se guarda en NVS y se reemplaza el punto mas cercano)
+#define PH_CAL_RAW1             2048    // cuentas con tampon pH 7
+#define PH_CAL_VALUE1           7.0
+#define PH_CAL_RAW2             2720    // cuentas con tampon pH 4
+#define PH_CAL_VALUE2           4.0
+#define ORP_CAL_RAW1            2048    // cuentas a 0 mV
+#define ORP_CAL_VALUE1          0.0
+#define ORP_CAL_RAW2            3072    // cuentas a 1000 mV
+#define ORP_CAL_VALUE2          1000.0
+#define PRESSURE_CAL_RAW1       310     // cuentas a 0 bar
+#define PRESSURE_CAL_VALUE1     0.0
+#define PRESSURE_CAL_RAW2       3100    // cuentas a 2.5 bar
+#define PRESSURE_CAL_VALUE2     2.5
+
+// Publicacion por excepcion: banda muerta de cada sensor e intervalo maximo
+#define PH_DEADBAND             0.05    // pH
+#define ORP_DEADBAND            10      // mV
+#define PRESSURE_DEADBAND       0.05    // bar
+#define ANALOG_MAX_REPORT_INTERVAL 600000 // ms sin publicar como maximo
+
+// ==================== Pump Monitoring ====================
+
+// Corriente de la bomba (transformador de corriente) y, si hay sensor, tension
+// de red: RMS y factor de potencia por ciclo, energia acumulada y proteccion
+#define PUMP_CT_AMPS_PER_VOLT   30.0    // A por voltio en el ADC (SCT-013-030: 30 A / 1 V)
+#define MAINS_VOLTS_PER_VOLT    330.0   // V de red por voltio en el ADC (ajustar con un multimetro)
+#define MAINS_VOLTAGE           230     // V nominales (se usan sin sensor de tension)
+#define MAINS_FREQUENCY         50      // Hz
+#define PUMP_RATED_CURRENT      4.0     // A de placa de la bomba
+#define PUMP_RATED_POWER        750     // W electricos de placa
+#define PUMP_NOMINAL_PF         0.8     // factor de potencia supuesto sin sensor de tension
+#define PUMP_NO_CURRENT         0.2     // A: por debajo el motor no recibe corriente
+#define PUMP_NO_LOAD_FRACTION   0.6     // carga (potencia o corriente / placa) por debajo = marcha en seco
+#define PUMP_OVERLOAD_FACTOR    1.25    // x corriente de placa = sobrecarga
+#define PUMP_LOCKED_FACTOR      3.0     // x corriente de placa pasado el arranque = rotor bloqueado
+#define PUMP_PROTECTION         0       // 1 = apagar la bomba (y el temporizador) al confirmar un evento; activar solo con el TC instalado y probado
+
+// ==================== Flow Meter ====================
+
+// Caudalimetro de efecto Hall contado por hardware (PCNT): caudal y volumen
+// total (guardado en NVS). Factor K en pulsos por litro (hoja del fabricante:
+// F[Hz] = k * Q[L/min] -> pulsos por litro = k * 60; DN50 "F = 0.2 Q" -> 12)
+#define FLOW_PULSES_PER_LITER   12.0    // pulsos por litro del caudalimetro
+#define FLOW_DEADBAND           2.0     // L/min
+#define FLOW_MAX_REPORT_INTERVAL 600000 // ms sin publicar como maximo
+
+// ==================== Variable-Speed Pump ====================
+
+// Bomba de velocidad variable con variador Modbus RTU (RS-485). El rele sigue
+// cortando la bomba; la orden de marcha y la consigna van por el bus.
+// Mapa de registros generico: ajustar a la hoja del variador
+#define VSD_PUMP                0       // 1 = variador Modbus instalado
+#define MODBUS_BAUD             9600    // baudios del bus
+#define MODBUS_PARITY           'E'     // 'E' par (8E1, por defecto en Modbus), 'O' impar, 'N' sin paridad (8N2)
+#define MODBUS_RESPONSE_TIMEOUT 100     // ms de espera de la respuesta del esclavo
+#define VSD_SLAVE_ID            1       // direccion Modbus del variador
+#define VSD_REG_CONTROL         0x2000  // registro de marcha/paro (escritura)
+#define VSD_CMD_RUN             0x0001  // valor de marcha
+#define VSD_CMD_STOP            0x0000  // valor de paro
+#define VSD_REG_SPEED           0x2001  // registro de consigna (rpm)
+#define VSD_REG_READBACK        0x3000  // bloque de lectura: estado, rpm, W, corriente, fallo
+#define VSD_CURRENT_SCALE       0.1     // A por unidad del registro de corriente
+#define VSD_MIN_RPM             600     // consigna minima aceptada
+#define VSD_MAX_RPM             3450    // consigna maxima aceptada
+#define VSD_DEFAULT_RPM         2400    // consigna inicial (luego se guarda en NVS)
+#define VSD_SPEED_DEADBAND      50      // rpm
+#define VSD_MAX_REPORT_INTERVAL 600000  // ms sin publicar como maximo
+
+// Diagnostico: mide la latencia de interrupciones con un timer (1 ms) y la
+// registra cada hora separando la actividad del bus OneWire del resto
+// (comparar los entornos esp32dev y esp32dev-bitbang)
+#define IRQ_LATENCY_PROBE       0       // 1 = medir latencia de interrupciones
@@ -0,0 +1,35 @@
+/**
+ * @file flow_counter.h
+ * @brief Flow meter pulse arithmetic (total from the folded counter, rate)
+ *
+ * Hardware-independent half of flow_meter.cpp (no Arduino includes;
+ * test/test_flow_counter runs it on the host).
+ */
+
+#ifndef FLOW_COUNTER_H
+#define FLOW_COUNTER_H
+
+#include <stdint.h>
+
+#define FLOW_PCNT_LIMIT         30000   // Hardware counter range before it is folded into the total
+
+/**
+ * Pulses counted so far from the fold count and the hardware counter
+ * A fold whose interrupt is still pending (counter cleared, fold count not
+ * yet incremented) shows up as a total going backwards and is added here.
+ * @param folds FLOW_PCNT_LIMIT folds seen by the interrupt
+ * @param count Hardware counter (0 .. FLOW_PCNT_LIMIT - 1)
+ * @param previous Total returned by the previous call (0 at start)
+ */
+uint64_t flowPulseTotal(uint32_t folds, uint16_t count, uint64_t previous);
+
+/**
+ * Flow rate from a pulse count over a time span
+ * @param pulses Pulses counted
+ * @param elapsedUs Time span (us)
+ * @param pulsesPerLiter Meter K-factor
+ * @return L/min (0 if the span is empty)
+ */
+float flowRateOf(uint32_t pulses, uint64_t elapsedUs, float pulsesPerLiter);
+
+#endif // FLOW_COUNTER_H
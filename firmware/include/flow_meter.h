@@ -0,0 +1,65 @@
+/**
+ * @file flow_meter.h
+ * @brief Hall-effect flow meter on the ESP32 pulse counter (PCNT)
+ *
+ * A flow meter gives a pulse per few millilitres; counting them with GPIO
+ * interrupts costs one ISR per pulse, hundreds per second at full flow.
+ * The PCNT peripheral counts the rising edges in hardware (with its glitch
+ * filter), so a pulse costs no CPU. The 16-bit counter is cleared by the
+ * hardware at FLOW_PCNT_LIMIT and an interrupt then adds the limit to the
+ * software total: one interrupt every FLOW_PCNT_LIMIT pulses (arithmetic in
+ * flow_counter.h).
+ *
+ * serviceFlowMeter() samples the total every FLOW_RATE_INTERVAL and computes
+ * the rate over the last FLOW_RATE_WINDOW samples (longer window, finer
+ * quantization at low flow). The volume is integrated from the pulse count
+ * itself (no drift) and stored in NVS every FLOW_SAVE_INTERVAL while the
+ * water moves and when it stops, so it survives reboots and power cuts
+ * (losing at most one save interval).
+ */
+
+#ifndef FLOW_METER_H
+#define FLOW_METER_H
+
+#include <Arduino.h>
+#include "flow_counter.h"
+
+// ==================== Counter Settings ====================
+#define FLOW_GLITCH_FILTER      1000    // Pulses shorter than this are ignored (APB cycles, 12.5 us)
+#define FLOW_RATE_INTERVAL      1000    // Rate sample period (ms)
+#define FLOW_RATE_WINDOW        5       // Samples in the sliding rate window
+#define FLOW_SAVE_INTERVAL      600000  // Total volume NVS write while flowing (ms)
+
+/**
+ * Load the stored total and start counting (no-op without FLOW_SENSOR_PIN)
+ */
+void initFlowMeter();
+
+/**
+ * Sample the counter and update the rate (call every loop, never blocks)
+ * @return true in the iteration a new rate was computed
+ */
+bool serviceFlowMeter();
+
+/**
+ * Check if a flow meter is configured and counting
+ */
+bool isFlowMeterAvailable();
+
+/**
+ * Flow rate over the sliding window (L/min, NAN until the first window)
+ */
+float getFlowRate();
+
+/**
+ * Total volume since the counter was created (litres, persisted)
+ */
+double getFlowTotal();
+
+/**
+ * Flow state as JSON
+ * @return {"rate_lpm":152.3,"total_m3":1234.567}
+ */
+String getFlowJSON();
+
+#endif // FLOW_METER_H
@@ -0,0 +1,61 @@
+/**
+ * @file irq_latency.h
+ * @brief Interrupt latency probe (diagnostics)
+ *
+ * A hardware timer fires every IRQ_LATENCY_PERIOD us on the loop task's core.
+ * The timer reloads to 0 on the alarm, so its counter read first thing in the
+ * ISR is the time the interrupt waited: anything that keeps interrupts
+ * disabled (e.g. a bit-banged OneWire slot) shows up directly.
+ *
+ * Samples are split by tag so bus activity can be compared against the rest
+ * of the firmware. Enabled with IRQ_LATENCY_PROBE in config.h; every call is
+ * a no-op otherwise.
+ */
+
+#ifndef IRQ_LATENCY_H
+#define IRQ_LATENCY_H
+
+#include <Arduino.h>
+
+#define IRQ_LATENCY_TIMER       1     // Hardware timer number (0-3)
+#define IRQ_LATENCY_PERIOD      1000  // Alarm period (us)
+
+/**
+ * What the loop task is doing while samples are taken
+ */
+enum IRQLatencyTag {
+  IRQ_TAG_IDLE,      // Everything else
+  IRQ_TAG_ONEWIRE,   // OneWire bus transactions
+  IRQ_TAG_COUNT
+};
+
+/**
+ * Latency statistics of one tag
+ */
+struct IRQLatencyStats {
+  uint32_t samples;
+  uint32_t avgUs;
+  uint32_t maxUs;
+};
+
+/**
+ * Start the probe timer (call once from setup)
+ */
+void initIRQLatencyProbe();
+
+/**
+ * Tag the following samples (loop task)
+ */
+void setIRQLatencyTag(IRQLatencyTag tag);
+
+/**
+ * Statistics of a tag since the last reset
+ */
+IRQLatencyStats getIRQLatencyStats(IRQLatencyTag tag);
+
+/**
+ * Start a new measurement window for every tag
+ */
+void resetIRQLatencyStats();
+
+#endif // IRQ_LATENCY_H
@@ -0,0 +1,88 @@
+/**
+ * @file link_governor.h
+ * @brief Link-quality-aware telemetry governor for ESP32 Pool Controller
+ *
+ * On a weak WiFi link every telemetry publish competes with retransmissions,
+ * and MQTT commands (pump/valve/timer) arrive late. The governor watches:
+ * - RSSI (same "weak" threshold as publishWiFiState())
+ * - TCP retransmissions (lwIP stats, when compiled in)
+ * - MQTT publish failures reported by the publish functions, while the MQTT
+ *   session is up (a broker outage on a healthy link is not a link problem)
+ * and classifies the link as good, degraded or poor. Telemetry intervals are
+ * multiplied by getLinkIntervalScale() and, while degraded, telemetry topics
+ * are published together in one burst so the radio transmits less often.
+ * The link steps back up one level after LINK_RECOVER_WINDOWS good windows.
+ *
+ * The Arduino-ESP32 prebuilt lwIP is compiled without LWIP_STATS/TCP_STATS,
+ * so with the standard framework the retransmit input reads -1 and the link
+ * is judged on RSSI and publish failures only. A framework built with
+ * CONFIG_LWIP_STATS enabled brings the retransmit counter in.
+ */
+
+#ifndef LINK_GOVERNOR_H
+#define LINK_GOVERNOR_H
+
+#include <Arduino.h>
+
+// ==================== Governor Settings ====================
+#define LINK_EVAL_INTERVAL      10000  // Evaluation window (ms)
+#define LINK_RECOVER_WINDOWS    3      // Consecutive good windows before stepping up a level
+#define LINK_RSSI_DEGRADED      -70    // Below this: degraded (matches "weak" quality)
+#define LINK_RSSI_POOR          -80    // Below this: poor
+#define LINK_RETX_DEGRADED      4      // TCP retransmissions per window
+#define LINK_RETX_POOR          12
+#define LINK_PUBFAIL_DEGRADED   1      // Failed MQTT publishes per window
+#define LINK_PUBFAIL_POOR       3
+
+enum LinkLevel {
+  LINK_GOOD = 0,      // Normal intervals
+  LINK_DEGRADED = 1,  // Intervals x2, telemetry batched
+  LINK_POOR = 2       // Intervals x4, telemetry batched
+};
+
+/**
+ * Evaluate the link (call from loop, evaluates every LINK_EVAL_INTERVAL)
+ * @return true if the link level changed in this call
+ */
+bool updateLinkGovernor();
+
+/**
+ * Report the result of an MQTT publish
+ * @param ok Return value of mqtt.publish()
+ * @param sessionUp mqtt.connected() after the publish; failures while the
+ *                  session is down are not counted
+ */
+void noteLinkPublish(bool ok, bool sessionUp);
+
+/**
+ * Current link level
+ */
+LinkLevel getLinkLevel();
+
+/**
+ * Name of a link level ("good", "degraded", "poor")
+ */
+const char* linkLevelName(LinkLevel level);
+
+/**
+ * Multiplier for telemetry intervals at the current level (1, 2 or 4)
+ */
+uint32_t getLinkIntervalScale();
+
+/**
+ * Check if telemetry should be batched into a single burst
+ */
+bool isLinkBatching();
+
+/**
+ * TCP retransmissions counted in the last evaluation window
+ * @return -1 if lwIP statistics are not compiled in (prebuilt Arduino-ESP32)
+ */
+int getLinkRetransmits();
+
+/**
+ * Failed publishes counted in the last evaluation window
+ */
+int getLinkPublishFailures();
+
+#endif // LINK_GOVERNOR_H
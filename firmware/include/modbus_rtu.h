@@ -0,0 +1,147 @@
+/**
+ * @file modbus_rtu.h
+ * @brief Modbus RTU master: frames, CRC and the request pipeline
+ *
+ * Hardware-independent core (no Arduino or ESP-IDF includes) so it can be
+ * built and exercised on a PC against a simulated slave. The transport
+ * (modbus_uart.h on the ESP32) only has to write frames and hand back each
+ * received frame, already delimited by the 3.5-character bus silence.
+ *
+ * Requests are queued with their frame prebuilt (CRC included). RTU allows
+ * one transaction on the bus at a time; the pipeline sends the next frame in
+ * the same call that completes the previous one (response, timeout or
+ * broadcast turnaround), so back-to-back polls leave no gap beyond the
+ * mandatory silence, whatever the caller's loop is doing.
+ *
+ * All master functions must be called from one context (the bus task).
+ */
+
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ==================== Protocol Limits ====================
+#define MODBUS_MAX_FRAME        256     // RTU ADU limit (receive buffer)
+#define MODBUS_MAX_REGISTERS    16      // Registers per request (keeps queued requests small)
+#define MODBUS_QUEUE_LEN        8       // Requests waiting for the bus
+#define MODBUS_BROADCAST        0       // Slave address without response
+
+enum ModbusFunction {
+  MODBUS_READ_HOLDING   = 0x03,
+  MODBUS_READ_INPUT     = 0x04,
+  MODBUS_WRITE_SINGLE   = 0x06,
+  MODBUS_WRITE_MULTIPLE = 0x10
+};
+
+enum ModbusStatus {
+  MODBUS_OK,
+  MODBUS_TIMEOUT,
+  MODBUS_CRC_ERROR,
+  MODBUS_EXCEPTION,       // Slave answered with an exception code
+  MODBUS_BAD_RESPONSE     // Valid CRC but not the answer to the request
+};
+
+/**
+ * One transaction to send
+ */
+struct ModbusRequest {
+  uint8_t slave;
+  uint8_t function;       // ModbusFunction
+  uint16_t address;       // First register
+  uint16_t count;         // Registers (1 for MODBUS_WRITE_SINGLE)
+  uint16_t values[MODBUS_MAX_REGISTERS];  // Written values
+  uint32_t tag;           // Caller's identifier, copied to the result
+};
+
+/**
+ * Completed transaction
+ */
+struct ModbusResult {
+  uint32_t tag;
+  uint8_t slave;
+  uint8_t function;
+  uint16_t address;
+  uint16_t count;
+  ModbusStatus status;
+  uint8_t exception;      // Exception code (MODBUS_EXCEPTION)
+  uint16_t values[MODBUS_MAX_REGISTERS];  // Registers read
+  uint32_t latencyUs;     // First byte sent to frame received
+};
+
+/**
+ * Bus counters since begin
+ */
+struct ModbusStats {
+  uint32_t requests;      // Frames sent
+  uint32_t responses;     // MODBUS_OK
+  uint32_t timeouts;
+  uint32_t crcErrors;
+  uint32_t exceptions;
+  uint32_t badResponses;
+  uint32_t unexpected;    // Frames received with no request pending
+  uint32_t rejected;      // Submits refused (queue full or invalid)
+  uint64_t latencyTotalUs;
+  uint32_t latencyMaxUs;
+};
+
+typedef void (*ModbusSendFn)(const uint8_t* frame, size_t length);
+typedef void (*ModbusResultFn)(const ModbusResult& result);
+
+/**
+ * Modbus CRC-16 (poly 0xA001 reflected, init 0xFFFF), one table lookup per byte
+ * The frame carries it low byte first.
+ */
+uint16_t modbusCRC16(const uint8_t* data, size_t length);
+
+/**
+ * Encode a request frame (address, PDU, CRC)
+ * @return Frame length, 0 if the request is invalid
+ */
+size_t modbusBuildRequest(const ModbusRequest& request, uint8_t* frame);
+
+/**
+ * Decode the answer to a request into result (status, exception, values)
+ */
+ModbusStatus modbusParseResponse(const ModbusRequest& request, const uint8_t* frame, size_t length,
+                                 ModbusResult& result);
+
+/**
+ * Reset the pipeline
+ * @param send Writes one frame to the bus
+ * @param onResult Receives every completed transaction
+ * @param responseTimeoutUs Wait for an answer after a frame is sent
+ * @param turnaroundUs Silence after a broadcast before the next frame
+ */
+void modbusMasterBegin(ModbusSendFn send, ModbusResultFn onResult,
+                       uint32_t responseTimeoutUs, uint32_t turnaroundUs);
+
+/**
+ * Queue a request (sent at once if the bus is idle)
+ * @return false if the queue is full or the request invalid
+ */
+bool modbusMasterSubmit(const ModbusRequest& request, uint64_t nowUs);
+
+/**
+ * A frame was received (transport delimited it by bus silence)
+ */
+void modbusMasterOnFrame(const uint8_t* frame, size_t length, uint64_t nowUs);
+
+/**
+ * Expire the pending transaction if its time is up
+ * @return Microseconds until the next deadline (UINT32_MAX if the bus is idle)
+ */
+uint32_t modbusMasterTick(uint64_t nowUs);
+
+/**
+ * Requests queued or on the bus
+ */
+uint8_t modbusMasterPending();
+
+/**
+ * Bus counters since modbusMasterBegin()
+ */
+ModbusStats modbusMasterStats();
+
+#endif // MODBUS_RTU_H
@@ -0,0 +1,63 @@
+/**
+ * @file modbus_uart.h
+ * @brief RS-485 transport for the Modbus RTU master (ESP32 UART)
+ *
+ * The UART driver moves bytes between its FIFO and ring buffers in its own
+ * interrupt and reports them on an event queue. Frames are delimited by the
+ * UART's hardware RX timeout, set to the RTU inter-frame silence (3.5
+ * characters, 1.75 ms above 19200 baud): a frame arrives as one event with
+ * the timeout flag, without timing individual bytes in software. The
+ * transceiver's DE line is the UART RTS, switched by the hardware in
+ * RS-485 half-duplex mode.
+ *
+ * A bus task owns the master pipeline (modbus_rtu.h). It sleeps on a queue
+ * set (UART events + submitted requests) with the pipeline's next deadline
+ * as timeout, so the next frame goes out as soon as the previous answer is
+ * in, independently of loop(). Results come back through a queue drained by
+ * the caller.
+ */
+
+#ifndef MODBUS_UART_H
+#define MODBUS_UART_H
+
+#include <Arduino.h>
+#include "modbus_rtu.h"
+
+// ==================== Transport Settings ====================
+#define MODBUS_RX_BUFFER        512     // Driver ring buffer (bytes)
+#define MODBUS_EVENT_QUEUE_LEN  16      // UART driver events
+#define MODBUS_RESULT_QUEUE_LEN 8       // Completed transactions waiting for loop()
+#define MODBUS_TASK_STACK       3072
+#define MODBUS_TASK_PRIORITY    3       // Above loop(): the bus is served right away
+
+/**
+ * Install the UART driver and start the bus task (no-op without MODBUS_TX_PIN)
+ * @return true if the bus is running
+ */
+bool initModbusUart();
+
+/**
+ * Queue a request for the bus task (never blocks)
+ * @return false if the bus is not running or the queue is full
+ */
+bool modbusSubmit(const ModbusRequest& request);
+
+/**
+ * Take the next completed transaction (never blocks)
+ * @return false if none is waiting
+ */
+bool modbusReceive(ModbusResult& result);
+
+/**
+ * Bus counters (snapshot from the bus task)
+ * @param droppedResults Results lost because loop() did not drain the queue
+ */
+ModbusStats getModbusStats(uint32_t* droppedResults = nullptr);
+
+/**
+ * Highest response latency since the previous call (us), for per-window
+ * reports: ModbusStats::latencyMaxUs never resets
+ */
+uint32_t takeModbusLatencyPeak();
+
+#endif // MODBUS_UART_H
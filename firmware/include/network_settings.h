@@ -0,0 +1,69 @@
+/**
+ * @file network_settings.h
+ * @brief Optional network settings delivered with the WiFi credentials
+ *
+ * A TLV provisioning write (see ble_provisioning.h) may carry, next to the
+ * SSID and password, a static IPv4 configuration, an MQTT broker override and
+ * a device name (DHCP hostname). Settings are stored in the "wifi" NVS
+ * namespace, so clearing the WiFi credentials clears them as well.
+ *
+ * All-zero / empty fields mean "firmware default": DHCP, MQTT_HOST/MQTT_PORT
+ * from config.h and the default hostname.
+ *
+ * A write carries only the settings the user changed: the others keep their
+ * stored value (NETWORK_FIELD_* mask, mergeNetworkSettings()).
+ */
+
+#ifndef NETWORK_SETTINGS_H
+#define NETWORK_SETTINGS_H
+
+#include <stdint.h>
+
+struct NetworkSettings {
+  uint8_t ip[4];          // Static address (all zero = DHCP)
+  uint8_t gateway[4];
+  uint8_t subnet[4];
+  uint8_t dns[4];
+  char mqttHost[64];      // "" = MQTT_HOST
+  char mqttUser[64];      // Credentials for mqttHost ("" = anonymous); the
+  char mqttPass[64];      // built-in MQTT_USER/MQTT_PASS only go to MQTT_HOST
+  uint16_t mqttPort;      // 0 = MQTT_PORT
+  char deviceName[32];    // "" = default hostname
+};
+
+// Settings present in a provisioning write (bit mask)
+#define NETWORK_FIELD_STATIC_IP    0x01
+#define NETWORK_FIELD_MQTT_HOST    0x02   // Host with its user and password
+#define NETWORK_FIELD_MQTT_PORT    0x04
+#define NETWORK_FIELD_DEVICE_NAME  0x08
+
+/**
+ * Load the stored settings (defaults when nothing is stored)
+ */
+void loadNetworkSettings(NetworkSettings* settings);
+
+/**
+ * Store settings received from provisioning
+ */
+void saveNetworkSettings(const NetworkSettings& settings);
+
+/**
+ * Copy the received fields onto the stored settings
+ * @param stored Settings to update
+ * @param received Settings from a provisioning write
+ * @param fields NETWORK_FIELD_* mask of the fields that were sent
+ */
+void mergeNetworkSettings(NetworkSettings* stored, const NetworkSettings& received, uint8_t fields);
+
+/**
+ * Apply hostname and static IP (or DHCP) to the station interface
+ * Call before WiFi.begin()
+ */
+void applyNetworkSettings(const NetworkSettings& settings);
+
+/**
+ * Check if the settings ask for a static IP
+ */
+bool hasStaticIP(const NetworkSettings& settings);
+
+#endif // NETWORK_SETTINGS_H
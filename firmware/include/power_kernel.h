@@ -0,0 +1,109 @@
+/**
+ * @file power_kernel.h
+ * @brief Fixed-point per-cycle power kernel of the pump monitor
+ *
+ * Hardware-independent kernel of pump_monitor.cpp (no Arduino includes):
+ * every current / voltage sample pair is centred by a slow integer IIR
+ * (Q16 bias, samples in Q3) and i², v² and v·i are summed in 64-bit
+ * integers until the rising zero crossing of the reference (voltage, or
+ * current without a voltage sensor) closes the mains cycle. A cycle with no
+ * crossings (pump off, flat input) is closed anyway after maxSamples.
+ *
+ * kernelSample() runs once per sample pair, so it stays inline here. RMS and
+ * power factor accuracy, bias convergence and the closing rules are checked
+ * by test/test_power_kernel; the device measures its cost in CPU cycles.
+ */
+
+#ifndef POWER_KERNEL_H
+#define POWER_KERNEL_H
+
+#include <stdint.h>
+
+#define KERNEL_FRAC_BITS        3       // Centred samples in Q3: i² of a full-scale swing fits int32
+#define PUMP_OFFSET_SHIFT       12      // DC bias IIR: time constant 2^12 samples
+#define PUMP_ZC_HYSTERESIS      16      // Zero-crossing hysteresis (ADC counts)
+
+/**
+ * Per-cycle integer accumulator of one current / voltage channel pair
+ */
+struct PowerKernel {
+  int32_t offsetI;          // DC bias in counts, Q16
+  int32_t offsetV;
+  bool hasVoltage;
+  bool armed;               // Reference went below -hysteresis (zero-crossing detector)
+  uint16_t minSamples;      // Shortest accepted cycle (3/4 of nominal)
+  uint16_t maxSamples;      // Cycle closed anyway (no crossings: pump off)
+  uint16_t samples;
+  uint64_t sumI2;
+  uint64_t sumV2;
+  int64_t sumVI;
+};
+
+/**
+ * Sums of one finished mains cycle (or window of cycles)
+ */
+struct PowerSums {
+  uint32_t samples;
+  uint64_t sumI2;
+  uint64_t sumV2;
+  int64_t sumVI;
+};
+
+/**
+ * Prepare a kernel for a channel sample rate (bias at mid-scale)
+ */
+void kernelReset(PowerKernel& k, uint32_t rate, uint32_t mainsFrequency, bool hasVoltage);
+
+/**
+ * Add a cycle to a window
+ */
+void addSums(PowerSums& total, const PowerSums& cycle);
+
+/**
+ * RMS value in Q3 counts of a sum of squares
+ */
+float rmsOf(uint64_t sum, uint32_t samples);
+
+/**
+ * Feed one current / voltage sample pair
+ * @param cycle Receives the sums when a cycle closes
+ * @return true if a cycle closed with this sample
+ */
+static inline bool kernelSample(PowerKernel& k, uint16_t rawI, uint16_t rawV, PowerSums& cycle) {
+  // Slow bias tracking; the centred sample keeps KERNEL_FRAC_BITS of the bias
+  k.offsetI += (((int32_t)rawI << 16) - k.offsetI) >> PUMP_OFFSET_SHIFT;
+  int32_t i = ((int32_t)rawI << KERNEL_FRAC_BITS) - (k.offsetI >> (16 - KERNEL_FRAC_BITS));
+  int32_t v = 0;
+  if (k.hasVoltage) {
+    k.offsetV += (((int32_t)rawV << 16) - k.offsetV) >> PUMP_OFFSET_SHIFT;
+    v = ((int32_t)rawV << KERNEL_FRAC_BITS) - (k.offsetV >> (16 - KERNEL_FRAC_BITS));
+  }
+
+  k.sumI2 += (uint32_t)(i * i);
+  k.sumV2 += (uint32_t)(v * v);
+  k.sumVI += v * i;
+  k.samples++;
+
+  // Rising zero crossing of the reference closes the cycle
+  int32_t reference = k.hasVoltage ? v : i;
+  bool crossed = false;
+  if (reference < -(PUMP_ZC_HYSTERESIS << KERNEL_FRAC_BITS)) {
+    k.armed = true;
+  } else if (k.armed && reference >= 0) {
+    k.armed = false;
+    crossed = true;
+  }
+  if (!(crossed && k.samples >= k.minSamples) && k.samples < k.maxSamples) return false;
+
+  cycle.samples = k.samples;
+  cycle.sumI2 = k.sumI2;
+  cycle.sumV2 = k.sumV2;
+  cycle.sumVI = k.sumVI;
+  k.samples = 0;
+  k.sumI2 = 0;
+  k.sumV2 = 0;
+  k.sumVI = 0;
+  return true;
+}
+
+#endif // POWER_KERNEL_H
@@ -0,0 +1,135 @@
+/**
+ * @file power_profile.h
+ * @brief WiFi modem power-save profiles for ESP32 Pool Controller
+ *
+ * The radio power-save mode decides how often the station wakes up to
+ * receive buffered frames from the access point. Deeper sleep saves current
+ * but delays downlink MQTT commands (pump/valve/timer) until the next wake-up.
+ *
+ * Profiles:
+ * - performance: power save OFF (radio always on, lowest command latency).
+ *                While Bluetooth may run (not released), WiFi/BT coexistence
+ *                requires modem sleep, so it falls back to WIFI_PS_MIN_MODEM
+ * - balanced:    WIFI_PS_MIN_MODEM (wakes every DTIM, framework default)
+ * - eco:         WIFI_PS_MAX_MODEM with a longer listen interval
+ *
+ * The selected profile is persisted in NVS and can be switched at runtime
+ * over MQTT (TOPIC_POWER_SET). A loopback latency benchmark measures the
+ * command latency of the active profile through the broker.
+ */
+
+#ifndef POWER_PROFILE_H
+#define POWER_PROFILE_H
+
+#include <Arduino.h>
+
+// ==================== Profile Settings ====================
+#define POWER_ECO_LISTEN_INTERVAL   10    // Beacon intervals between wake-ups in eco (~1 s at 102.4 ms beacons)
+#define POWER_BENCH_SAMPLES         10    // Loopback probes per benchmark run
+#define POWER_BENCH_SPACING         1500  // Delay between probes (ms) - lets the radio fall back asleep
+#define POWER_BENCH_TIMEOUT         5000  // Probe is counted as lost after this time (ms)
+
+enum PowerProfile {
+  POWER_PROFILE_PERFORMANCE = 0,
+  POWER_PROFILE_BALANCED    = 1,
+  POWER_PROFILE_ECO         = 2,
+  POWER_PROFILE_COUNT
+};
+
+/**
+ * Latency statistics of one benchmark run (loopback publish -> receive)
+ */
+struct PowerBenchResult {
+  uint8_t samples;     // Probes answered
+  uint8_t lost;        // Probes that timed out
+  uint32_t minMs;
+  uint32_t avgMs;
+  uint32_t maxMs;
+};
+
+/**
+ * Load the saved profile from NVS (default: balanced)
+ * Call once at boot, before connecting to WiFi
+ */
+void initPowerProfile();
+
+/**
+ * Apply a power-save profile to the WiFi driver
+ * The power-save mode changes immediately. The eco listen interval is part of
+ * the station config, so a live association is renewed to pick it up.
+ * @param profile Profile to apply
+ * @param persist true to save the profile to NVS
+ * @return true if the WiFi driver accepted the settings
+ */
+bool applyPowerProfile(PowerProfile profile, bool persist = true);
+
+/**
+ * Re-apply the active profile after a new WiFi association
+ * WiFi.begin() rewrites the station config, so call this once connected
+ */
+void onPowerProfileAssociated();
+
+/**
+ * Get the active profile
+ */
+PowerProfile getPowerProfile();
+
+/**
+ * Power-save mode actually applied for the active profile
+ * @return "none", "min_modem" or "max_modem"
+ */
+const char* getEffectivePowerSave();
+
+/**
+ * Profile name as used on MQTT ("performance", "balanced", "eco")
+ */
+const char* powerProfileName(PowerProfile profile);
+
+/**
+ * Parse a profile name (case-insensitive)
+ * @param name Profile name
+ * @param profile Output profile
+ * @return true if the name is valid
+ */
+bool parsePowerProfile(const String& name, PowerProfile* profile);
+
+// ==================== Latency Benchmark ====================
+
+/**
+ * Start a benchmark run for the active profile
+ * Probes are sent by the caller when servicePowerBench() says so
+ */
+void startPowerBench();
+
+enum PowerBenchEvent {
+  POWER_BENCH_IDLE,        // Nothing to do
+  POWER_BENCH_SEND_PROBE,  // Publish a probe with the returned sequence number
+  POWER_BENCH_FINISHED     // Run complete, results are ready to publish
+};
+
+/**
+ * Check if a benchmark run is in progress
+ */
+bool isPowerBenchRunning();
+
+/**
+ * Drive the benchmark (call from loop)
+ * Expires probes that exceeded POWER_BENCH_TIMEOUT
+ * @param seq Output sequence number for POWER_BENCH_SEND_PROBE
+ * @return Action the caller must take
+ */
+PowerBenchEvent servicePowerBench(uint16_t* seq);
+
+/**
+ * Record the loopback of a probe
+ * @param seq Sequence number found in the received payload
+ */
+void onPowerBenchEcho(uint16_t seq);
+
+/**
+ * Get the last benchmark result of a profile
+ * @return nullptr if the profile was never benchmarked in this boot
+ */
+const PowerBenchResult* getPowerBenchResult(PowerProfile profile);
+
+#endif // POWER_PROFILE_H
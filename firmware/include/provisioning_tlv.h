@@ -0,0 +1,57 @@
+/**
+ * @file provisioning_tlv.h
+ * @brief Parser of the single-write provisioning record (TLV)
+ *
+ * One write on the provisioning characteristic carries a sequence of
+ * [type][length][value] records: SSID, password and the optional network
+ * settings. Unknown types are skipped so newer dashboards keep working with
+ * older firmware.
+ *
+ * The write comes over an unauthenticated link, so a broker override must
+ * carry its own credentials (TLV_MQTT_USER, TLV_MQTT_PASS): the built-in
+ * MQTT_USER/MQTT_PASS are never sent to a host set this way.
+ *
+ * Hardware-independent (no Arduino includes) so it is covered by the native
+ * tests (test/test_provisioning_tlv).
+ */
+
+#ifndef PROVISIONING_TLV_H
+#define PROVISIONING_TLV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "network_settings.h"
+
+// ==================== Record Types ====================
+#define TLV_SSID            0x01  // 1-32 bytes
+#define TLV_PASSWORD        0x02  // 0-63 bytes (empty = open network)
+#define TLV_STATIC_IP       0x03  // 16 bytes: ip, gateway, subnet, dns
+#define TLV_MQTT_HOST       0x04  // 1-63 bytes
+#define TLV_MQTT_PORT       0x05  // 2 bytes, big endian
+#define TLV_DEVICE_NAME     0x06  // 1-31 bytes [A-Za-z0-9-]
+#define TLV_MQTT_USER       0x07  // 0-63 bytes, required with TLV_MQTT_HOST (empty = anonymous)
+#define TLV_MQTT_PASS       0x08  // 0-63 bytes, only with TLV_MQTT_HOST
+
+/**
+ * Credentials and settings of one provisioning write
+ */
+struct ProvisioningData {
+  char ssid[33];
+  char password[64];
+  NetworkSettings settings;   // Fields not flagged in settingsFields are zero
+  uint8_t settingsFields;     // NETWORK_FIELD_* records present (0 for legacy writes)
+};
+
+/**
+ * Parse a provisioning write
+ * @param data Characteristic value
+ * @param size Value length
+ * @param out Cleared, then filled with the records found
+ * @return nullptr if valid, otherwise the status to report
+ *         ("invalid_tlv", "invalid_ssid", "invalid_password", "invalid_ip",
+ *          "invalid_mqtt_host", "invalid_mqtt_port", "invalid_mqtt_credentials",
+ *          "invalid_name")
+ */
+const char* parseProvisioningTLV(const uint8_t* data, size_t size, ProvisioningData* out);
+
+#endif // PROVISIONING_TLV_H
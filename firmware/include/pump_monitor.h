@@ -0,0 +1,126 @@
+/**
+ * @file pump_monitor.h
+ * @brief Pump current monitoring, protection and energy accounting
+ *
+ * The pump relay switches 220 V blindly: nothing confirms the motor draws
+ * current, and a pump that lost its prime runs dry until the seal burns.
+ * A current transformer on the pump line (and optionally a mains voltage
+ * sensor) is sampled by the analog acquisition (DMA). Every sample pair goes
+ * through a fixed-point kernel:
+ * - DC bias removal (slow integer IIR per channel, Q16)
+ * - sums of i², v² and v·i in 64-bit integers over one mains cycle, closed
+ *   on the rising zero crossing of the voltage (current if no voltage
+ *   sensor) with hysteresis
+ *
+ * Cycles are combined into PUMP_WINDOW_CYCLES windows, where RMS current,
+ * RMS voltage, real power and power factor are computed (one square root
+ * per window). Windows feed the event detector and the energy counter.
+ *
+ * Events (confirmed after staying for their persistence time):
+ * - no current:   relay on but no current (relay, wiring, thermal cutout);
+ *                 only once the CT is confirmed present, see below
+ * - no load:      running well below rated load (dry run / lost prime)
+ * - overload:     above PUMP_OVERLOAD_FACTOR x rated current
+ * - locked rotor: starting current that does not decay after the start grace
+ *
+ * A missing or unplugged CT also reads no current, so the CT is confirmed
+ * first: during PUMP_CT_DETECT_TIME after boot its input must sit at the
+ * bias (PUMP_CT_BIAS_MIN..MAX counts) with some ADC noise (a pin held at a
+ * rail or by a wire reads flat), or a window must have measured current.
+ * Until then a window without current reports nothing (neither no current
+ * nor no load).
+ *
+ * The kernel (power_kernel.h, bias and crossing settings there) is checked
+ * at boot against synthetic waveforms of known RMS and power factor, and on
+ * the host by test/test_power_kernel; its cost is measured in CPU cycles per
+ * sample and logged with the hourly statistics.
+ */
+
+#ifndef PUMP_MONITOR_H
+#define PUMP_MONITOR_H
+
+#include <Arduino.h>
+
+// ==================== Kernel Settings ====================
+#define PUMP_WINDOW_CYCLES      25      // Mains cycles per measurement window (0.5 s at 50 Hz)
+#define PUMP_REPORT_INTERVAL    3600000 // Kernel statistics log (ms)
+#define PUMP_ENERGY_SAVE_INTERVAL 3600000 // Energy counter NVS write while running (ms)
+
+// ==================== CT Presence ====================
+#define PUMP_CT_DETECT_TIME     5000    // Boot check of the CT input (ms)
+#define PUMP_CT_BIAS_MIN        1240    // ADC counts (1.0 V): lowest accepted bias of the 1.65 V divider
+#define PUMP_CT_BIAS_MAX        2855    // ADC counts (2.3 V)
+#define PUMP_CT_MIN_NOISE       2       // ADC counts peak to peak
+
+// ==================== Event Persistence ====================
+#define PUMP_START_GRACE        2000    // Inrush ignored after the relay closes (ms)
+#define PUMP_NO_CURRENT_TIME    3000    // ms
+#define PUMP_NO_LOAD_TIME       15000   // ms (priming draws little for a few seconds)
+#define PUMP_OVERLOAD_TIME      10000   // ms
+#define PUMP_LOCKED_TIME        500     // ms after the start grace
+
+enum PumpEvent {
+  PUMP_EVENT_NONE,
+  PUMP_EVENT_NO_CURRENT,
+  PUMP_EVENT_NO_LOAD,
+  PUMP_EVENT_OVERLOAD,
+  PUMP_EVENT_LOCKED_ROTOR
+};
+
+/**
+ * Electrical state of the pump (last window)
+ */
+struct PumpPower {
+  float current;        // A RMS
+  float voltage;        // V RMS (nominal MAINS_VOLTAGE without voltage sensor)
+  float power;          // W (estimated with PUMP_NOMINAL_PF without voltage sensor)
+  float powerFactor;    // NAN without voltage sensor
+  double energyWh;      // Total since the counter was created (NVS)
+  uint32_t runSeconds;  // Total pump running time (NVS)
+};
+
+/**
+ * Load the energy counter, self-test the kernel and attach it to the
+ * analog acquisition (call after initAnalogSensors())
+ */
+void initPumpMonitor();
+
+/**
+ * Tell the monitor the relay state (starts the inrush grace, clears the
+ * latched alarm on a new start, saves the energy counter on stop)
+ */
+void setPumpMonitorRunning(bool running);
+
+/**
+ * Evaluate the completed windows (call every loop)
+ * @return The event confirmed in this call (once per run), else PUMP_EVENT_NONE
+ */
+PumpEvent servicePumpMonitor();
+
+/**
+ * Check if a current transformer is installed and sampled
+ */
+bool isPumpMonitorAvailable();
+
+/**
+ * Electrical state of the last window
+ */
+PumpPower getPumpPower();
+
+/**
+ * Latched alarm of the current run (PUMP_EVENT_NONE if none)
+ */
+PumpEvent getPumpAlarm();
+
+/**
+ * Event name for logs and JSON ("none", "no_current", "no_load"...)
+ */
+const char* getPumpEventName(PumpEvent event);
+
+/**
+ * Pump electrical state as JSON
+ * @return {"current":3.82,"voltage":229,"power":812,"pf":0.92,"energy_wh":15234,"run_hours":412.5,"alarm":"none"}
+ */
+String getPumpPowerJSON();
+
+#endif // PUMP_MONITOR_H
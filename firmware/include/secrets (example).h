@@ -9,3 +9,7 @@
 
 #define MQTT_USER "ESP32-01"
 #define MQTT_PASS "1234"
+
+// Pairing passkey for the BLE local control: pick your own 6 digits
+// (no leading zero, C would read the number as octal)
+#define BLE_CONTROL_PASSKEY 583920
@@ -0,0 +1,61 @@
+/**
+ * @file sensor_stats.h
+ * @brief Windowed streaming statistics per sensor, in constant memory
+ *
+ * Each registered sensor keeps count, mean, standard deviation, min and max
+ * over STATS_WINDOW_COUNT sliding windows (1 min, 15 min, 1 h, 24 h), so the
+ * dashboard can ask "min/max/average today" without storing every sample in
+ * the cloud.
+ *
+ * The windows are rings of Welford buckets merged at query time, weighted by
+ * the time each reading stood, in memory fixed at compile time; see
+ * stats_series.h. This module keeps the sensor table, the last-change time
+ * and the JSON.
+ */
+
+#ifndef SENSOR_STATS_H
+#define SENSOR_STATS_H
+
+#include <Arduino.h>
+#include "stats_series.h"
+
+#define STATS_MAX_SENSORS       12      // Registered sensors
+
+/**
+ * Add a sensor
+ * @param name Name in the JSON and queries; the pointer is kept, so it must
+ *             stay valid (a label renamed in place is picked up)
+ * @param deadband Change that counts for the last-change time
+ * @return Sensor id, or -1 if the table is full
+ */
+int8_t registerStatsSensor(const char* name, float deadband);
+
+/**
+ * Add a reading (NAN readings are ignored)
+ */
+void addStatsSample(int8_t sensor, float value);
+
+/**
+ * Statistics of a window (count 0 and NAN values if empty)
+ */
+SensorStats getSensorStats(int8_t sensor, StatsWindow window);
+
+/**
+ * Number of registered sensors
+ */
+uint8_t getStatsSensorCount();
+
+/**
+ * Find a sensor by name (case-insensitive)
+ * @return -1 if unknown
+ */
+int8_t findStatsSensor(const char* name);
+
+/**
+ * Every window of a sensor as JSON
+ * @return {"sensor":"water","last_change_s":420,"1m":{"n":6,"mean":25.31,
+ *         "std":0.02,"min":25.28,"max":25.34},"15m":{...},"1h":{...},"24h":{...}}
+ */
+String getSensorStatsJSON(int8_t sensor);
+
+#endif // SENSOR_STATS_H
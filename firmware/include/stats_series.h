@@ -0,0 +1,112 @@
+/**
+ * @file stats_series.h
+ * @brief Sliding-window statistics of one sensor (bucket rings)
+ *
+ * Hardware-independent core of sensor_stats (no Arduino includes, time
+ * passed in; test/test_stats_series runs it on the host).
+ *
+ * A window is a ring of STATS_BUCKETS buckets of window/STATS_BUCKETS each.
+ * Buckets are weighted Welford accumulators; a query merges the buckets
+ * still inside the window (Chan's parallel combination), so windows slide
+ * with the granularity of one bucket.
+ *
+ * Time weighting: a reading stands until the next one, and is added to the
+ * bucket of its own timestamp with that hold time as its weight (ms, capped
+ * at one bucket: a longer gap means the sensor was missing). The latest
+ * reading, still standing, joins each query with the time it has stood so
+ * far. The adaptive temperature schedule (fast while the water moves)
+ * therefore does not bias the mean toward the active periods.
+ *
+ * Buckets hold deviations from the first reading (shifted data), so
+ * single-precision floats keep their resolution on large levels.
+ */
+
+#ifndef STATS_SERIES_H
+#define STATS_SERIES_H
+
+#include <stdint.h>
+
+// ==================== Window Settings ====================
+#define STATS_BUCKETS           12      // Buckets per window (slide granularity = window / buckets)
+
+enum StatsWindow {
+  STATS_WINDOW_1MIN,
+  STATS_WINDOW_15MIN,
+  STATS_WINDOW_1H,
+  STATS_WINDOW_24H,
+  STATS_WINDOW_COUNT
+};
+
+/**
+ * Statistics of one window
+ */
+struct SensorStats {
+  uint32_t count;       // Samples in the window
+  float mean;           // Time-weighted
+  float stddev;
+  float min;
+  float max;
+};
+
+/**
+ * Weighted Welford accumulator of one bucket
+ */
+struct StatsBucket {
+  uint32_t slot;        // Bucket number since boot (uptime / span); marks stale buckets
+  uint32_t count;
+  float weight;         // Sum of sample weights (s)
+  float mean;
+  float m2;             // Sum of weighted squared deviations
+  float min;
+  float max;
+};
+
+/**
+ * Every window of one sensor
+ */
+struct StatsSeries {
+  float offset;             // First reading; buckets hold value - offset
+  float pending;            // Latest reading, not in a bucket until the next one
+  uint64_t pendingAt;       // Its time (ms)
+  bool hasSample;
+  StatsBucket buckets[STATS_WINDOW_COUNT][STATS_BUCKETS];
+};
+
+/**
+ * Window length (s)
+ */
+uint32_t statsWindowSeconds(StatsWindow window);
+
+/**
+ * Empty a bucket for a new slot
+ */
+void statsBucketReset(StatsBucket* bucket, uint32_t slot);
+
+/**
+ * Welford update with a weighted sample (West's algorithm)
+ * @param weight Seconds the value stood for (> 0)
+ */
+void statsBucketAdd(StatsBucket* bucket, float value, float weight);
+
+/**
+ * Combine a bucket into a running total (Chan et al.)
+ */
+void statsBucketMerge(StatsBucket* total, const StatsBucket& bucket);
+
+/**
+ * Forget every sample
+ */
+void resetStatsSeries(StatsSeries* series);
+
+/**
+ * Add a reading
+ * @param nowMs Time of the reading (ms since boot, never wraps)
+ */
+void addStatsSeriesSample(StatsSeries* series, float value, uint64_t nowMs);
+
+/**
+ * Statistics of a window at a time (count 0 and NAN values if empty)
+ */
+SensorStats queryStatsSeries(const StatsSeries& series, StatsWindow window, uint64_t nowMs);
+
+#endif // STATS_SERIES_H
@@ -0,0 +1,135 @@
+/**
+ * @file temperature.h
+ * @brief Non-blocking multi-probe DS18B20 temperature bus
+ *
+ * A DS18B20 conversion takes up to 750 ms at 12-bit resolution. The blocking
+ * DallasTemperature call waits that long on every reading, stalling loop()
+ * (BLE, portal, MQTT keep-alive). Here a sampling cycle is split into phases:
+ * - start:   one skip-ROM CONVERT T broadcast starts every probe at once
+ *            (setWaitForConversion(false), ~2 ms of bus traffic) and a
+ *            deadline is taken from the resolution
+ * - collect: once the deadline passes, one probe per serviceTemperature()
+ *            call is read by its ROM address (no bus search)
+ *
+ * Between phases serviceTemperature() returns immediately, so the loop never
+ * waits on the OneWire bus, and the bus time of one loop iteration does not
+ * grow with the number of probes.
+ *
+ * Every probe reading goes through a filter chain before it is exposed:
+ * median of the last TEMP_MEDIAN_SIZE readings (a single spike never gets
+ * through), then a scalar Kalman filter whose process noise grows with the
+ * time since the last reading and whose measurement noise includes the
+ * quantization of the current resolution (temperature_filter.h, tested on
+ * the host). A probe that does not answer resets its filter and reads NAN
+ * until it answers again.
+ *
+ * Sampling adapts to the water (rules in config.h): while every probe is
+ * stable, cycles run every TEMP_STABLE_INTERVAL at TEMP_STABLE_RESOLUTION;
+ * once a probe drifts TEMP_ACTIVE_DELTA from its reference, cycles run every
+ * TEMP_ACTIVE_INTERVAL at TEMP_ACTIVE_RESOLUTION until the change rate over
+ * a TEMP_STABLE_WINDOW falls below TEMP_STABLE_RATE. Conversion time and the
+ * estimated tracking error are reported every TEMP_REPORT_INTERVAL against
+ * the old fixed schedule (12 bits every minute).
+ *
+ * Probes (water, air, solar collector, heater return...) are discovered once
+ * at boot. Their ROM addresses and user labels are kept in NVS, so a probe
+ * keeps its label across reboots and while it is unplugged. A new probe gets
+ * the next free slot; the first one is labelled "water" (primary probe).
+ */
+
+#ifndef TEMPERATURE_H
+#define TEMPERATURE_H
+
+#include <Arduino.h>
+
+// ==================== Probe Settings ====================
+#define TEMP_MAX_PROBES         4      // Probes kept (NVS slots)
+#define TEMP_LABEL_MAX          16     // Label length incl. terminator ([a-z0-9_-])
+#define TEMP_PRIMARY_LABEL      "water" // Probe published on TOPIC_TEMP_STATE
+
+// ==================== Conversion Settings ====================
+#define TEMP_CONVERSION_MARGIN  10     // Extra wait after the datasheet conversion time (ms)
+#define TEMP_REPORT_INTERVAL    3600000 // Sampler statistics log (ms)
+#define TEMP_BASELINE_INTERVAL  60000  // Fixed schedule the statistics compare against (ms, 12 bits)
+
+enum TemperatureEvent {
+  TEMP_EVENT_IDLE,     // Nothing happened (or the cycle is still running)
+  TEMP_EVENT_READY     // A cycle finished; every probe holds its new reading
+};
+
+/**
+ * Load the stored probes, discover the bus and start the first conversion
+ */
+void initTemperature();
+
+/**
+ * Ask for a sampling cycle now, outside the adaptive schedule
+ * The conversion starts on the next serviceTemperature(); ignored while a
+ * cycle is already running (its result answers this request too).
+ */
+void requestTemperature();
+
+/**
+ * Drive the sampling schedule and cycle (call every loop, never blocks on
+ * the conversion)
+ * @return TEMP_EVENT_READY in the iteration the last probe was read
+ */
+TemperatureEvent serviceTemperature();
+
+/**
+ * Filtered reading of the primary probe in Celsius degrees
+ * The primary probe is the one labelled TEMP_PRIMARY_LABEL, else the first.
+ * @return NAN before the first reading or if the probe did not answer
+ */
+float getTemperature();
+
+/**
+ * Check if a cycle is requested or running
+ */
+bool isTemperatureConverting();
+
+/**
+ * Check if the sampler is in the fast, high resolution mode
+ */
+bool isTemperatureActive();
+
+// ==================== Probes ====================
+
+/**
+ * Number of known probes (discovered now or stored from an earlier boot)
+ */
+uint8_t getTemperatureProbeCount();
+
+/**
+ * Filtered reading of a probe
+ * @param index 0 .. getTemperatureProbeCount()-1
+ * @return NAN if unknown or the probe did not answer
+ */
+float getProbeTemperature(uint8_t index);
+
+/**
+ * Last raw reading of a probe, before the filters
+ * @return NAN if unknown or the probe did not answer
+ */
+float getProbeRawTemperature(uint8_t index);
+
+/**
+ * Label of a probe ("" if the index is out of range)
+ */
+const char* getProbeLabel(uint8_t index);
+
+/**
+ * Rename a probe and store the label in NVS
+ * @param probe Current label or ROM address (16 hex digits), case-insensitive
+ * @param label New label, 1-15 characters [a-z0-9_-] (stored lower case)
+ * @return false if the probe is unknown or the label invalid / already used
+ */
+bool setProbeLabel(const char* probe, const char* label);
+
+/**
+ * All probes as one JSON object keyed by label (unanswered probes are null)
+ * @return {"water":25.3,"air":31.0,"solar":null}
+ */
+String getTemperatureJSON();
+
+#endif // TEMPERATURE_H
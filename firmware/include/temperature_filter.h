@@ -0,0 +1,50 @@
+/**
+ * @file temperature_filter.h
+ * @brief Per-probe temperature filter chain: median -> scalar Kalman
+ *
+ * Hardware-independent half of the probe filtering in temperature.cpp (no
+ * Arduino includes; test/test_temperature_filter runs it on the host).
+ *
+ * The median of the last TEMP_MEDIAN_SIZE readings keeps a single spike out;
+ * the Kalman filter then smooths the median with a process noise that grows
+ * with the time since the last reading (TEMP_KALMAN_Q) and a measurement
+ * noise of TEMP_KALMAN_R plus the quantization of the reading's resolution.
+ * A missing reading (NAN) resets the chain: the next reading starts it again.
+ */
+
+#ifndef TEMPERATURE_FILTER_H
+#define TEMPERATURE_FILTER_H
+
+#include <stdint.h>
+#include "config.h"
+
+struct TemperatureFilter {
+  float window[TEMP_MEDIAN_SIZE];   // Last raw readings (ring)
+  uint8_t windowCount;
+  uint8_t windowNext;
+  float estimate;           // Filtered value; NAN until the first reading
+  float variance;           // Kalman estimate variance (°C²)
+  uint32_t updatedAt;       // Time of the last update (ms)
+};
+
+/**
+ * Forget the history (probe missing, first reading)
+ */
+void resetTemperatureFilter(TemperatureFilter* filter);
+
+/**
+ * Median of the raw window (mean of the middle pair while it fills up with
+ * an even count); NAN when empty
+ */
+float temperatureMedian(const TemperatureFilter& filter);
+
+/**
+ * Run one raw reading through the chain
+ * @param raw Reading (°C), NAN when the probe did not answer
+ * @param bits Resolution of the reading
+ * @param nowMs Time of the reading (ms, wraps like millis())
+ * @return Filtered value, NAN after a missing reading
+ */
+float updateTemperatureFilter(TemperatureFilter* filter, float raw, uint8_t bits, uint32_t nowMs);
+
+#endif // TEMPERATURE_FILTER_H
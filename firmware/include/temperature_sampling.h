@@ -0,0 +1,63 @@
+/**
+ * @file temperature_sampling.h
+ * @brief Adaptive DS18B20 sampling rules (resolution and interval)
+ *
+ * Hardware-independent half of the sampler in temperature.cpp: the mode
+ * decision after each cycle and the datasheet figures it is accounted with.
+ * No Arduino includes, so the rules can be replayed against water
+ * temperature traces on the host (test/test_temperature_sampling), where the
+ * bus-time saving and the tracking error are measured against the fixed
+ * schedule (12 bits every TEMP_BASELINE_INTERVAL).
+ *
+ * Rules (config.h): stable -> active as soon as any probe drifted
+ * TEMP_ACTIVE_DELTA from its reference; active -> stable once, over a whole
+ * TEMP_STABLE_WINDOW, every probe changed slower than TEMP_STABLE_RATE,
+ * otherwise the window restarts from new references.
+ */
+
+#ifndef TEMPERATURE_SAMPLING_H
+#define TEMPERATURE_SAMPLING_H
+
+#include <stdint.h>
+
+enum TempSamplingAction {
+  TEMP_SAMPLING_KEEP,       // Stay in the current mode
+  TEMP_SAMPLING_ACTIVATE,   // Water moving: switch to the active mode
+  TEMP_SAMPLING_STABILIZE,  // Slow over a whole window: back to the stable mode
+  TEMP_SAMPLING_RESTART     // Window over, still moving: new references, stay active
+};
+
+/**
+ * Decide the sampling mode after a completed cycle
+ * @param active Current mode
+ * @param maxDrift Largest |reading - reference| over the probes (°C)
+ * @param elapsedMs Time since the references were taken
+ */
+TempSamplingAction evaluateSampling(bool active, float maxDrift, uint32_t elapsedMs);
+
+/**
+ * Change rate of a drift over a time (°C/h, 0 when no time passed)
+ */
+float samplingRate(float maxDrift, uint32_t elapsedMs);
+
+/**
+ * Sampling interval of a mode (ms)
+ */
+uint32_t samplingInterval(bool active);
+
+/**
+ * Resolution of a mode (bits)
+ */
+uint8_t samplingResolution(bool active);
+
+/**
+ * Datasheet conversion time for a resolution (ms): 94 at 9 bits ... 750 at 12 bits
+ */
+uint32_t conversionTimeMs(uint8_t bits);
+
+/**
+ * Reading step of a resolution (°C): 0.5 at 9 bits ... 0.0625 at 12 bits
+ */
+float resolutionStep(uint8_t bits);
+
+#endif // TEMPERATURE_SAMPLING_H
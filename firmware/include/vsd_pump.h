@@ -0,0 +1,90 @@
+/**
+ * @file vsd_pump.h
+ * @brief Variable-speed pump drive over Modbus RTU
+ *
+ * The relay only switches the pump on and off; a variable-speed pump saves
+ * most of its energy running slower for longer. The drive is a Modbus slave
+ * (register map in config.h, VSD_REG_*): the run command follows the pump
+ * state, the speed setpoint (rpm) comes from MQTT and is kept in NVS, and a
+ * readback block (status, speed, power, current, fault code) is polled every
+ * VSD_POLL_INTERVAL.
+ *
+ * Writes that fail (timeout, exception) stay pending and are sent again with
+ * the next poll. Pending writes and the poll are submitted together and go
+ * out back to back on the bus.
+ */
+
+#ifndef VSD_PUMP_H
+#define VSD_PUMP_H
+
+#include <Arduino.h>
+
+// ==================== Drive Settings ====================
+#define VSD_POLL_INTERVAL       1000    // Readback poll period (ms)
+#define VSD_OFFLINE_POLLS       3       // Failed polls before the drive is reported offline
+#define VSD_REPORT_INTERVAL     3600000 // Bus statistics log (ms)
+
+/**
+ * Drive readback (last successful poll)
+ */
+struct VsdPumpState {
+  bool online;          // Answered one of the last VSD_OFFLINE_POLLS polls
+  bool running;         // Drive reports the motor running
+  uint16_t setpoint;    // Requested speed (rpm)
+  uint16_t speed;       // Actual speed (rpm)
+  uint16_t power;       // W
+  float current;        // A
+  uint16_t fault;       // Drive fault code (0 = none)
+};
+
+/**
+ * Load the setpoint and start the bus (no-op unless VSD_PUMP is enabled)
+ */
+void initVsdPump();
+
+/**
+ * Drain bus results, resend pending writes and poll (call every loop)
+ * @return true when a poll completed (readback updated or drive lost)
+ */
+bool serviceVsdPump();
+
+/**
+ * Check if a drive is configured and its bus running
+ */
+bool isVsdPumpAvailable();
+
+/**
+ * Command the drive to run or stop (follows the pump relay)
+ */
+void setVsdRunning(bool running);
+
+/**
+ * Set the speed setpoint (stored in NVS, sent to the drive)
+ * @param rpm Between VSD_MIN_RPM and VSD_MAX_RPM
+ * @return false if out of range or no drive configured
+ */
+bool setVsdSpeed(uint16_t rpm);
+
+/**
+ * Drive state of the last poll
+ */
+VsdPumpState getVsdPumpState();
+
+/**
+ * True if the state moved enough to be reported (speed beyond
+ * VSD_SPEED_DEADBAND, online/running/fault/setpoint changed)
+ */
+bool vsdPumpMoved();
+
+/**
+ * Remember the state just reported
+ */
+void markVsdPumpPublished();
+
+/**
+ * Drive state as JSON
+ * @return {"online":true,"running":true,"setpoint_rpm":2400,"speed_rpm":2398,"power":410,"current":2.1,"fault":0}
+ */
+String getVsdPumpJSON();
+
+#endif // VSD_PUMP_H
@@ -0,0 +1,120 @@
+/**
+ * @file wifi_scan.h
+ * @brief Asynchronous WiFi scanner with a TTL-bound result cache
+ *
+ * Shared by BLE provisioning and the captive portal. Scans run with
+ * WiFi.scanNetworks(true) and are collected from loop() by serviceWiFiScan(),
+ * so a scan never blocks the firmware. Results are copied into a static
+ * table; requests within WIFI_SCAN_TTL are answered from the table without
+ * touching the radio.
+ *
+ * A scan pass visits one channel at a time, busiest channels (1, 6, 11)
+ * first, and merges each channel into a second table as soon as it
+ * completes; the cache keeps the previous pass until the new one is swapped
+ * in at the end, so readers never see a half-built list. Entries of the
+ * running pass that are new or got stronger are flagged as pending for every
+ * consumer, so a consumer (e.g. BLE notifications) can stream incremental
+ * results long before the full pass ends.
+ *
+ * requestWiFiScan() only sets a flag and may be called from the NimBLE host
+ * task. Everything else must be called from the loop task.
+ */
+
+#ifndef WIFI_SCAN_H
+#define WIFI_SCAN_H
+
+#include <Arduino.h>
+
+#define WIFI_SCAN_TTL           30000  // Cached results are fresh for 30 s
+#define WIFI_SCAN_MAX_NETWORKS  24     // Static table size (strongest networks kept)
+#define WIFI_SCAN_CHANNEL_TIME  120    // Active dwell time per channel (ms)
+#define WIFI_SCAN_CONSUMERS     8      // Independent incremental readers (bit per consumer)
+
+enum WiFiScanEvent {
+  WIFI_SCAN_IDLE,      // Nothing happened
+  WIFI_SCAN_PROGRESS,  // A channel completed; pending entries may be available
+  WIFI_SCAN_DONE       // The full pass completed
+};
+
+/**
+ * One cached scan result
+ */
+struct ScanNetwork {
+  char ssid[33];
+  int8_t rssi;
+  uint8_t channel;
+  bool open;
+  uint8_t pendingMask;  // Consumers that have not received this entry yet
+};
+
+/**
+ * Ask for fresh results
+ * Starts a background scan on the next serviceWiFiScan() unless the cache is
+ * still fresh or a scan is already running. Safe to call from any task.
+ */
+void requestWiFiScan();
+
+/**
+ * Drive the scanner (call every loop)
+ * @return Progress of the running pass
+ */
+WiFiScanEvent serviceWiFiScan();
+
+/**
+ * Check if a scan is pending or running
+ */
+bool isWiFiScanRunning();
+
+/**
+ * Check if the table holds results (fresh or stale)
+ */
+bool hasWiFiScanResults();
+
+/**
+ * Check if the cached results are younger than WIFI_SCAN_TTL
+ */
+bool isWiFiScanFresh();
+
+/**
+ * Number of networks of the last completed pass (sorted strongest first)
+ */
+uint8_t getWiFiScanCount();
+
+/**
+ * Get a cached network
+ * @param index 0 .. getWiFiScanCount()-1
+ */
+const ScanNetwork* getWiFiScanNetwork(uint8_t index);
+
+/**
+ * Build the JSON array of the last completed pass
+ * @param maxLength Stop adding entries beyond this size (0 = no limit)
+ * @return [{"ssid":"NETWORK1","rssi":-50,"open":false},...]
+ */
+String getWiFiScanJSON(size_t maxLength = 0);
+
+// ==================== Incremental Results ====================
+
+// While a pass runs these work on the pass being built, otherwise on the cache
+
+/**
+ * Flag the whole table as pending for a consumer (e.g. answering from cache)
+ * @param consumer 0 .. WIFI_SCAN_CONSUMERS-1
+ */
+void markWiFiScanPending(uint8_t consumer);
+
+/**
+ * Check if a consumer has entries it has not received yet
+ */
+bool hasWiFiScanPending(uint8_t consumer);
+
+/**
+ * Take pending entries as a JSON array, strongest first
+ * Entries that do not fit stay pending for the next call
+ * @param consumer 0 .. WIFI_SCAN_CONSUMERS-1
+ * @param maxLength Maximum JSON size (at least one entry must fit)
+ * @return JSON array of the entries taken ("[]" if none)
+ */
+String takeWiFiScanPendingJSON(uint8_t consumer, size_t maxLength);
+
+#endif // WIFI_SCAN_H
@@ -0,0 +1,289 @@
+/**
+ * @file OneWire.cpp
+ * @brief OneWire bus master on the ESP32 RMT peripheral implementation
+ */
+
+#include "OneWire.h"
+#include <driver/gpio.h>
+#include <soc/gpio_periph.h>
+#include <soc/gpio_struct.h>
+
+// ==================== Slot Timing ====================
+// RMT ticks of 1 us (80 MHz APB / 80). Standard speed timings with margin.
+#define OW_CLK_DIV          80
+#define OW_RESET_LOW        480  // Reset pulse
+#define OW_RESET_WAIT       70   // Release before sampling presence
+#define OW_SLOT             70   // Write/read slot incl. recovery
+#define OW_ONE_LOW          5    // Write 1 / read slot: short low, then released
+#define OW_ZERO_LOW         65   // Write 0: low for almost the whole slot
+#define OW_SAMPLE           13   // Low longer than this = the device pulled a 0
+#define OW_RX_IDLE_SLOT     (OW_SLOT + 10)       // No edge for this long ends a byte
+#define OW_RX_IDLE_RESET    (OW_RESET_LOW + 60)  // ... and a reset / presence sequence
+#define OW_RX_FILTER        30   // Glitch filter in APB cycles (0.375 us)
+#define OW_RX_BUFFER        512  // Ring buffer bytes (4 per captured pulse)
+#define OW_RX_TIMEOUT_MS    20
+
+// ==================== Driver Setup ====================
+
+void OneWire::begin(uint8_t pin) {
+  this->pin = pin;
+  reset_search();
+}
+
+/**
+ * Install TX and RX channels on the same open-drain pin
+ * @return false if the RMT driver could not be installed
+ */
+bool OneWire::ensureDriver() {
+  if (driverReady) return true;
+  if (pin == 0xFF) return false;
+
+  rmt_config_t tx = {};
+  tx.rmt_mode = RMT_MODE_TX;
+  tx.channel = ONEWIRE_RMT_TX_CHANNEL;
+  tx.gpio_num = (gpio_num_t)pin;
+  tx.mem_block_num = 1;
+  tx.clk_div = OW_CLK_DIV;
+  tx.tx_config.idle_level = RMT_IDLE_LEVEL_HIGH;  // Released (pulled up)
+  tx.tx_config.idle_output_en = true;
+
+  rmt_config_t rx = {};
+  rx.rmt_mode = RMT_MODE_RX;
+  rx.channel = ONEWIRE_RMT_RX_CHANNEL;
+  rx.gpio_num = (gpio_num_t)pin;
+  rx.mem_block_num = 1;
+  rx.clk_div = OW_CLK_DIV;
+  rx.rx_config.filter_en = true;
+  rx.rx_config.filter_ticks_thresh = OW_RX_FILTER;
+  rx.rx_config.idle_threshold = OW_RX_IDLE_SLOT;
+
+  if (rmt_config(&rx) != ESP_OK || rmt_driver_install(rx.channel, OW_RX_BUFFER, 0) != ESP_OK) {
+    Serial.println("[ONEWIRE] RMT RX channel install failed");
+    return false;
+  }
+  if (rmt_config(&tx) != ESP_OK || rmt_driver_install(tx.channel, 0, 0) != ESP_OK) {
+    rmt_driver_uninstall(rx.channel);
+    Serial.println("[ONEWIRE] RMT TX channel install failed");
+    return false;
+  }
+  rmt_get_ringbuf_handle(rx.channel, &rxBuffer);
+
+  // rmt_config() left the pad as a push-pull output (TX routed last);
+  // re-enable the input path to the RX channel and switch to open drain
+  PIN_INPUT_ENABLE(GPIO_PIN_MUX_REG[pin]);
+  GPIO.pin[pin].pad_driver = 1;
+
+  driverReady = true;
+  return true;
+}
+
+// ==================== Slots ====================
+
+uint8_t OneWire::transact(uint8_t bits, uint8_t count) {
+  if (!ensureDriver()) return 0xFF;
+
+  rmt_item32_t items[8];
+  for (uint8_t i = 0; i < count; i++) {
+    bool one = bits & (1 << i);
+    items[i].level0 = 0;
+    items[i].duration0 = one ? OW_ONE_LOW : OW_ZERO_LOW;
+    items[i].level1 = 1;
+    items[i].duration1 = OW_SLOT - items[i].duration0;
+  }
+
+  rmt_rx_start(ONEWIRE_RMT_RX_CHANNEL, true);
+  rmt_write_items(ONEWIRE_RMT_TX_CHANNEL, items, count, true /*wait_tx_done*/);
+
+  // Every slot starts with a falling edge, so captured pulse i is slot i
+  uint8_t result = 0;
+  size_t size = 0;
+  rmt_item32_t* rxItems = (rmt_item32_t*)xRingbufferReceive(rxBuffer, &size,
+                                                            pdMS_TO_TICKS(OW_RX_TIMEOUT_MS));
+  if (rxItems) {
+    size_t received = size / sizeof(rmt_item32_t);
+    for (uint8_t i = 0; i < count && i < received; i++) {
+      if (rxItems[i].level0 == 0 && rxItems[i].duration0 <= OW_SAMPLE) result |= 1 << i;
+    }
+    vRingbufferReturnItem(rxBuffer, rxItems);
+  }
+  rmt_rx_stop(ONEWIRE_RMT_RX_CHANNEL);
+  return result;
+}
+
+uint8_t OneWire::reset() {
+  if (!ensureDriver()) return 0;
+
+  rmt_item32_t item;
+  item.level0 = 0;
+  item.duration0 = OW_RESET_LOW;
+  item.level1 = 1;
+  item.duration1 = OW_RESET_WAIT;
+
+  rmt_set_rx_idle_thresh(ONEWIRE_RMT_RX_CHANNEL, OW_RX_IDLE_RESET);
+  rmt_rx_start(ONEWIRE_RMT_RX_CHANNEL, true);
+  rmt_write_items(ONEWIRE_RMT_TX_CHANNEL, &item, 1, true);
+
+  // Captured: our reset low, then (if a device is there) its presence low
+  uint8_t presence = 0;
+  size_t size = 0;
+  rmt_item32_t* rxItems = (rmt_item32_t*)xRingbufferReceive(rxBuffer, &size,
+                                                            pdMS_TO_TICKS(OW_RX_TIMEOUT_MS));
+  if (rxItems) {
+    size_t received = size / sizeof(rmt_item32_t);
+    if (received >= 2 && rxItems[0].duration0 >= OW_RESET_LOW - 20 &&
+        rxItems[1].level0 == 0 && rxItems[1].duration0 > 0) {
+      presence = 1;
+    }
+    vRingbufferReturnItem(rxBuffer, rxItems);
+  }
+  rmt_rx_stop(ONEWIRE_RMT_RX_CHANNEL);
+  rmt_set_rx_idle_thresh(ONEWIRE_RMT_RX_CHANNEL, OW_RX_IDLE_SLOT);
+  return presence;
+}
+
+void OneWire::write_bit(uint8_t v) {
+  transact(v & 1, 1);
+}
+
+uint8_t OneWire::read_bit() {
+  return transact(1, 1) & 1;
+}
+
+void OneWire::write(uint8_t v, uint8_t power) {
+  transact(v, 8);
+}
+
+void OneWire::write_bytes(const uint8_t* buf, uint16_t count, bool power) {
+  for (uint16_t i = 0; i < count; i++) write(buf[i]);
+}
+
+uint8_t OneWire::read() {
+  return transact(0xFF, 8);
+}
+
+void OneWire::read_bytes(uint8_t* buf, uint16_t count) {
+  for (uint16_t i = 0; i < count; i++) buf[i] = read();
+}
+
+void OneWire::select(const uint8_t rom[8]) {
+  write(0x55);  // MATCH ROM
+  for (uint8_t i = 0; i < 8; i++) write(rom[i]);
+}
+
+void OneWire::skip() {
+  write(0xCC);  // SKIP ROM
+}
+
+// ==================== Search ====================
+// ROM search as described in Maxim application note 187
+
+void OneWire::reset_search() {
+  LastDiscrepancy = 0;
+  LastDeviceFlag = false;
+  LastFamilyDiscrepancy = 0;
+  memset(ROM_NO, 0, sizeof(ROM_NO));
+}
+
+void OneWire::target_search(uint8_t family_code) {
+  ROM_NO[0] = family_code;
+  memset(ROM_NO + 1, 0, 7);
+  LastDiscrepancy = 64;
+  LastFamilyDiscrepancy = 0;
+  LastDeviceFlag = false;
+}
+
+bool OneWire::search(uint8_t* newAddr, bool search_mode) {
+  if (LastDeviceFlag) {
+    reset_search();
+    return false;
+  }
+  if (!reset()) {
+    reset_search();
+    return false;
+  }
+
+  write(search_mode ? 0xF0 : 0xEC);  // SEARCH ROM / ALARM SEARCH
+
+  uint8_t lastZero = 0;
+  for (uint8_t bitNumber = 1; bitNumber <= 64; bitNumber++) {
+    uint8_t byteIndex = (bitNumber - 1) / 8;
+    uint8_t mask = 1 << ((bitNumber - 1) % 8);
+
+    uint8_t idBit = read_bit();
+    uint8_t complement = read_bit();
+    if (idBit && complement) {
+      // No device answered
+      reset_search();
+      return false;
+    }
+
+    uint8_t direction;
+    if (idBit != complement) {
+      direction = idBit;  // All remaining devices agree
+    } else {
+      // Discrepancy: take the branch decided by the previous pass
+      if (bitNumber < LastDiscrepancy) {
+        direction = (ROM_NO[byteIndex] & mask) ? 1 : 0;
+      } else {
+        direction = bitNumber == LastDiscrepancy;
+      }
+      if (direction == 0) {
+        lastZero = bitNumber;
+        if (lastZero < 9) LastFamilyDiscrepancy = lastZero;
+      }
+    }
+
+    if (direction) {
+      ROM_NO[byteIndex] |= mask;
+    } else {
+      ROM_NO[byteIndex] &= ~mask;
+    }
+    write_bit(direction);
+  }
+
+  LastDiscrepancy = lastZero;
+  if (LastDiscrepancy == 0) LastDeviceFlag = true;
+
+  if (ROM_NO[0] == 0) {
+    reset_search();
+    return false;
+  }
+  memcpy(newAddr, ROM_NO, 8);
+  return true;
+}
+
+// ==================== CRC ====================
+
+uint8_t OneWire::crc8(const uint8_t* addr, uint8_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    uint8_t inbyte = *addr++;
+    for (uint8_t i = 8; i; i--) {
+      uint8_t mix = (crc ^ inbyte) & 0x01;
+      crc >>= 1;
+      if (mix) crc ^= 0x8C;
+      inbyte >>= 1;
+    }
+  }
+  return crc;
+}
+
+bool OneWire::check_crc16(const uint8_t* input, uint16_t len, const uint8_t* inverted_crc, uint16_t crc) {
+  crc = ~crc16(input, len, crc);
+  return (crc & 0xFF) == inverted_crc[0] && (crc >> 8) == inverted_crc[1];
+}
+
+uint16_t OneWire::crc16(const uint8_t* input, uint16_t len, uint16_t crc) {
+  static const uint8_t oddparity[16] = {0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0};
+  for (uint16_t i = 0; i < len; i++) {
+    uint16_t cdata = input[i];
+    cdata = (cdata ^ crc) & 0xFF;
+    crc >>= 8;
+    if (oddparity[cdata & 0x0F] ^ oddparity[cdata >> 4]) crc ^= 0xC001;
+    cdata <<= 6;
+    crc ^= cdata;
+    cdata <<= 1;
+    crc ^= cdata;
+  }
+  return crc;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file OneWire.h
+ * @brief OneWire bus master on the ESP32 RMT peripheral
+ *
+ * Drop-in replacement for the bit-banged OneWire library (same class name and
+ * API), so DallasTemperature runs on top of it unchanged. The bit-banged
+ * library disables interrupts for every reset, bit and byte slot, which
+ * delays WiFi/BLE interrupts by tens of microseconds many times per reading.
+ * Here one RMT channel generates the slots and a second one samples the line
+ * on the same pin (open drain), so the timing lives in hardware and the CPU
+ * only waits on a semaphore / ring buffer with interrupts enabled.
+ *
+ * Whole bytes go out and come back as one RMT transaction (8 slots), so the
+ * bus time of a scratchpad read is the same as with the bit-banged driver.
+ *
+ * Selected by the esp32dev environment (lib_ignore = OneWire); the
+ * esp32dev-bitbang environment builds the original library instead.
+ *
+ * Limitations: no strong pull-up (parasite power is not supported, probes
+ * need VDD), and a single bus per firmware (fixed RMT channels).
+ */
+
+#ifndef ONEWIRE_RMT_H
+#define ONEWIRE_RMT_H
+
+#include <Arduino.h>
+#include <driver/rmt.h>
+#include <freertos/ringbuf.h>
+
+#define ONEWIRE_RMT_TX_CHANNEL  RMT_CHANNEL_0
+#define ONEWIRE_RMT_RX_CHANNEL  RMT_CHANNEL_1
+
+// Same feature switches as the bit-banged library (DallasTemperature checks them)
+#define ONEWIRE_SEARCH 1
+#define ONEWIRE_CRC 1
+#define ONEWIRE_CRC16 1
+
+class OneWire {
+public:
+  OneWire() {}
+  explicit OneWire(uint8_t pin) { begin(pin); }
+
+  /**
+   * Select the bus pin; the RMT channels are set up on the first transaction
+   * (global objects are constructed before the drivers can be installed)
+   */
+  void begin(uint8_t pin);
+
+  /**
+   * Reset pulse
+   * @return 1 if a device answered with a presence pulse, 0 otherwise
+   */
+  uint8_t reset();
+
+  void select(const uint8_t rom[8]);
+  void skip();
+
+  /**
+   * Write a byte (power is accepted for API compatibility and ignored)
+   */
+  void write(uint8_t v, uint8_t power = 0);
+  void write_bytes(const uint8_t* buf, uint16_t count, bool power = 0);
+  uint8_t read();
+  void read_bytes(uint8_t* buf, uint16_t count);
+  void write_bit(uint8_t v);
+  uint8_t read_bit();
+
+  /**
+   * No-op: the line is never actively driven high
+   */
+  void depower() {}
+
+  // ==================== Search ====================
+  void reset_search();
+  void target_search(uint8_t family_code);
+  bool search(uint8_t* newAddr, bool search_mode = true);
+
+  // ==================== CRC ====================
+  static uint8_t crc8(const uint8_t* addr, uint8_t len);
+  static bool check_crc16(const uint8_t* input, uint16_t len, const uint8_t* inverted_crc, uint16_t crc = 0);
+  static uint16_t crc16(const uint8_t* input, uint16_t len, uint16_t crc = 0);
+
+private:
+  bool ensureDriver();
+  /**
+   * Send count slots and sample the line while they run
+   * @param bits LSB first; a 1 is also a read slot
+   * @return Sampled bits (LSB first)
+   */
+  uint8_t transact(uint8_t bits, uint8_t count);
+
+  uint8_t pin = 0xFF;
+  bool driverReady = false;
+  RingbufHandle_t rxBuffer = nullptr;
+
+  // Search state
+  uint8_t ROM_NO[8];
+  uint8_t LastDiscrepancy = 0;
+  uint8_t LastFamilyDiscrepancy = 0;
+  bool LastDeviceFlag = false;
+};
+
+#endif // ONEWIRE_RMT_H
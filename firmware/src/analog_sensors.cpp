@@ -0,0 +1,500 @@
+/**
+ * @file analog_sensors.cpp
+ * @brief DMA-driven acquisition of the analog pool sensors implementation
+ */
+
+#include "analog_sensors.h"
+#include "config.h"
+#include <Preferences.h>
+#include <driver/i2s.h>
+#include <driver/adc.h>
+#include <soc/syscon_struct.h>
+
+#define NVS_NAMESPACE       "analog"
+#define ANALOG_I2S_PORT     I2S_NUM_0   // Only I2S0 can sample the built-in ADC
+#define ANALOG_CAL_MIN_SPAN 20          // Minimum ADC counts between calibration points
+
+/**
+ * Fixed settings of one sensor
+ */
+struct AnalogSensorConfig {
+  const char* name;
+  int8_t pin;               // -1 = not installed
+  uint8_t decimals;         // JSON precision
+  float deadband;           // Report-by-exception threshold
+  float raw[2];             // Default calibration: ADC counts ...
+  float value[2];           // ... and the values they read as
+};
+
+static const AnalogSensorConfig sensorConfig[ANALOG_SENSOR_COUNT] = {
+  {"ph", PH_SENSOR_PIN, 2, PH_DEADBAND,
+   {PH_CAL_RAW1, PH_CAL_RAW2}, {PH_CAL_VALUE1, PH_CAL_VALUE2}},
+  {"orp", ORP_SENSOR_PIN, 0, ORP_DEADBAND,
+   {ORP_CAL_RAW1, ORP_CAL_RAW2}, {ORP_CAL_VALUE1, ORP_CAL_VALUE2}},
+  {"pressure", PRESSURE_SENSOR_PIN, 2, PRESSURE_DEADBAND,
+   {PRESSURE_CAL_RAW1, PRESSURE_CAL_RAW2}, {PRESSURE_CAL_VALUE1, PRESSURE_CAL_VALUE2}},
+};
+
+/**
+ * Acquisition and filter state of one sensor
+ */
+struct AnalogSensorState {
+  int8_t adcChannel;        // ADC1 channel, -1 = disabled
+  float calRaw[2];          // Active calibration (NVS or defaults)
+  float calValue[2];
+
+  CicDecimator cic;
+
+  // Averaging window of the decimated outputs
+  uint64_t windowSum;
+  uint32_t windowCount;
+
+  float counts;             // Last window mean in ADC counts
+  float value;              // Calibrated; NAN until the first window
+  float published;          // Value of the last report
+};
+
+// Channel roles beyond the CIC-filtered sensors
+#define ROLE_CURRENT  ANALOG_SENSOR_COUNT
+#define ROLE_VOLTAGE  (ANALOG_SENSOR_COUNT + 1)
+
+// ==================== State Variables ====================
+static AnalogSensorState sensors[ANALOG_SENSOR_COUNT];
+static int8_t channelRole[16];            // Channel tag of a sample -> sensor / role (-1 = none)
+static uint16_t dmaBuffer[ANALOG_DMA_BUFFER_LEN];
+static bool running = false;
+static uint32_t windowStart = 0;
+static uint8_t scanCount = 0;             // Channels in the scan pattern
+
+// Current / voltage waveform (pairs of consecutive scan entries)
+static AnalogWaveformCallback waveformCallback = nullptr;
+static bool currentScanned = false;
+static bool voltageScanned = false;
+static int16_t pendingCurrent = -1;       // Half of a pair waiting for the other
+static int16_t pendingVoltage = -1;
+static uint16_t waveCurrent[ANALOG_DMA_BUFFER_LEN];
+static uint16_t waveVoltage[ANALOG_DMA_BUFFER_LEN];
+static size_t waveCount = 0;
+
+// Acquisition statistics (ANALOG_REPORT_INTERVAL)
+static uint32_t reportStart = 0;
+static uint32_t statSamples = 0;
+static uint32_t statFilterUs = 0;        // CPU time of demux + CIC
+static uint32_t statRingFull = 0;        // Drains that found every DMA buffer full
+
+// ==================== Helpers ====================
+
+/**
+ * Find a sensor by name (case-insensitive)
+ * @return ANALOG_SENSOR_COUNT if unknown
+ */
+static AnalogSensor findSensor(const char* name) {
+  for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+    if (strcasecmp(sensorConfig[i].name, name) == 0) return (AnalogSensor)i;
+  }
+  return ANALOG_SENSOR_COUNT;
+}
+
+/**
+ * Map ADC counts to the sensor's unit through its two calibration points
+ */
+static float toValue(const AnalogSensorState& state, float counts) {
+  float slope = (state.calValue[1] - state.calValue[0]) / (state.calRaw[1] - state.calRaw[0]);
+  return state.calValue[0] + (counts - state.calRaw[0]) * slope;
+}
+
+/**
+ * Load the calibration points from NVS (defaults for missing keys)
+ */
+static void loadCalibrations() {
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, true);
+  for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+    for (int p = 0; p < 2; p++) {
+      char key[16];
+      snprintf(key, sizeof(key), "%s_r%d", sensorConfig[i].name, p);
+      sensors[i].calRaw[p] = prefs.getFloat(key, sensorConfig[i].raw[p]);
+      snprintf(key, sizeof(key), "%s_v%d", sensorConfig[i].name, p);
+      sensors[i].calValue[p] = prefs.getFloat(key, sensorConfig[i].value[p]);
+    }
+  }
+  prefs.end();
+}
+
+/**
+ * Store the calibration of a sensor in NVS
+ * @param defaults true to remove the stored points instead
+ */
+static void saveCalibration(AnalogSensor sensor, bool defaults) {
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, false);
+  for (int p = 0; p < 2; p++) {
+    char rawKey[16];
+    char valueKey[16];
+    snprintf(rawKey, sizeof(rawKey), "%s_r%d", sensorConfig[sensor].name, p);
+    snprintf(valueKey, sizeof(valueKey), "%s_v%d", sensorConfig[sensor].name, p);
+    if (defaults) {
+      prefs.remove(rawKey);
+      prefs.remove(valueKey);
+    } else {
+      prefs.putFloat(rawKey, sensors[sensor].calRaw[p]);
+      prefs.putFloat(valueKey, sensors[sensor].calValue[p]);
+    }
+  }
+  prefs.end();
+}
+
+/**
+ * Load the SAR ADC1 scan pattern: one entry per channel, 12 bits, 11 dB
+ * Entry layout (8 bits): channel[7:4] width[3:2] attenuation[1:0]; four
+ * entries per register, first one in the most significant byte.
+ * i2s_adc_enable() programs a single-channel pattern, so this runs after it.
+ */
+static void setScanPattern(const uint8_t* channels, uint8_t count) {
+  uint32_t table[4] = {0, 0, 0, 0};
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t entry = (channels[i] << 4) | (ADC_WIDTH_BIT_12 << 2) | ADC_ATTEN_DB_11;
+    table[i / 4] |= (uint32_t)entry << (24 - 8 * (i % 4));
+  }
+  for (int i = 0; i < 4; i++) {
+    SYSCON.saradc_sar1_patt_tab[i] = table[i];
+  }
+  SYSCON.saradc_ctrl.sar1_patt_len = count - 1;
+  SYSCON.saradc_ctrl.sar1_patt_p_clear = 1;
+  SYSCON.saradc_ctrl.sar1_patt_p_clear = 0;
+}
+
+// ==================== Filter ====================
+
+/**
+ * Feed one ADC sample to a sensor's CIC decimator (cic_decimator.h); the
+ * decimated output (counts * cicGain()) is added to the averaging window.
+ */
+static inline void filterSample(AnalogSensorState& state, uint32_t sample) {
+  uint32_t output;
+  if (!cicDecimate(&state.cic, sample, &output)) return;
+  state.windowSum += output;
+  state.windowCount++;
+}
+
+/**
+ * Pair a current or voltage sample with the other half of its scan
+ * The DMA swaps 16-bit samples in pairs, so either half may come first.
+ */
+static inline void pairSample(int8_t role, uint16_t sample) {
+  if (role == ROLE_CURRENT) {
+    pendingCurrent = sample;
+  } else {
+    pendingVoltage = sample;
+  }
+  if (pendingCurrent < 0 || (voltageScanned && pendingVoltage < 0)) return;
+
+  waveCurrent[waveCount] = pendingCurrent;
+  waveVoltage[waveCount] = voltageScanned ? pendingVoltage : 0;
+  waveCount++;
+  pendingCurrent = -1;
+  pendingVoltage = -1;
+}
+
+/**
+ * Forget the filter history of a sensor
+ */
+static void resetFilter(AnalogSensorState& state) {
+  resetCicDecimator(&state.cic);
+  state.windowSum = 0;
+  state.windowCount = 0;
+  state.counts = NAN;
+  state.value = NAN;
+  state.published = NAN;
+}
+
+/**
+ * Log acquisition throughput and filter cost once per ANALOG_REPORT_INTERVAL
+ */
+static void logReport(uint32_t now) {
+  uint32_t window = now - reportStart;
+  if (window < ANALOG_REPORT_INTERVAL) return;
+
+  Serial.print("[ANALOG] Acquisition: ");
+  Serial.print((uint32_t)((uint64_t)statSamples * 1000 / window));
+  Serial.print(" samples/s (configured ");
+  Serial.print(ANALOG_SAMPLE_RATE);
+  Serial.print("), filter ");
+  Serial.print(statSamples ? (uint32_t)((uint64_t)statFilterUs * 1000 / statSamples) : 0);
+  Serial.print(" ns/sample (");
+  Serial.print(statFilterUs / (float)window / 10, 2);  // us / (ms * 1000) * 100
+  Serial.print("% CPU), DMA ring full ");
+  Serial.print(statRingFull);
+  Serial.println(" times");
+
+  reportStart = now;
+  statSamples = 0;
+  statFilterUs = 0;
+  statRingFull = 0;
+}
+
+// ==================== Public Functions ====================
+
+/**
+ * Resolve a pin to its ADC1 channel
+ * @return -1 if the pin is not installed or not on ADC1
+ */
+static int8_t adcChannelOf(int8_t pin, const char* name) {
+  if (pin < 0) return -1;
+  // ADC2 is unusable while WiFi is on; ADC1 channels are 0-7
+  int8_t channel = digitalPinToAnalogChannel(pin);
+  if (channel < 0 || channel > 7) {
+    Serial.print("[ANALOG] GPIO ");
+    Serial.print(pin);
+    Serial.print(" is not an ADC1 pin - ");
+    Serial.print(name);
+    Serial.println(" disabled");
+    return -1;
+  }
+  adc1_config_channel_atten((adc1_channel_t)channel, ADC_ATTEN_DB_11);
+  return channel;
+}
+
+void initAnalogSensors() {
+  for (int i = 0; i < 16; i++) channelRole[i] = -1;
+  loadCalibrations();
+
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  uint8_t channels[ANALOG_SENSOR_COUNT + 2];
+  uint8_t channelCount = 0;
+  for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+    resetFilter(sensors[i]);
+    sensors[i].adcChannel = -1;
+    int8_t channel = adcChannelOf(sensorConfig[i].pin, sensorConfig[i].name);
+    if (channel < 0) continue;
+    sensors[i].adcChannel = channel;
+    channelRole[channel] = i;
+    channels[channelCount++] = channel;
+  }
+
+  // Current then voltage: consecutive entries keep the pair skew at one
+  // sample period. Voltage alone is useless (no current to relate it to).
+  int8_t currentChannel = adcChannelOf(CT_SENSOR_PIN, "pump current");
+  if (currentChannel >= 0) {
+    currentScanned = true;
+    channelRole[currentChannel] = ROLE_CURRENT;
+    channels[channelCount++] = currentChannel;
+
+    int8_t voltageChannel = adcChannelOf(VOLTAGE_SENSOR_PIN, "mains voltage");
+    if (voltageChannel >= 0) {
+      voltageScanned = true;
+      channelRole[voltageChannel] = ROLE_VOLTAGE;
+      channels[channelCount++] = voltageChannel;
+    }
+  }
+
+  if (channelCount == 0) {
+    Serial.println("[ANALOG] No analog sensors configured");
+    return;
+  }
+
+  i2s_config_t config = {};
+  config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+  config.sample_rate = ANALOG_SAMPLE_RATE;
+  config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+  config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+  config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+  config.intr_alloc_flags = 0;
+  config.dma_buf_count = ANALOG_DMA_BUFFERS;
+  config.dma_buf_len = ANALOG_DMA_BUFFER_LEN;
+  config.use_apll = false;
+
+  if (i2s_driver_install(ANALOG_I2S_PORT, &config, 0, NULL) != ESP_OK) {
+    Serial.println("[ANALOG] I2S driver install failed");
+    return;
+  }
+  i2s_set_adc_mode(ADC_UNIT_1, (adc1_channel_t)channels[0]);
+  i2s_adc_enable(ANALOG_I2S_PORT);
+  setScanPattern(channels, channelCount);
+
+  scanCount = channelCount;
+  running = true;
+  windowStart = millis();
+  reportStart = millis();
+
+  Serial.print("[ANALOG] ✓ DMA acquisition: ");
+  for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+    if (sensors[i].adcChannel < 0) continue;
+    Serial.print(sensorConfig[i].name);
+    Serial.print("=ADC1_CH");
+    Serial.print(sensors[i].adcChannel);
+    Serial.print(" ");
+  }
+  if (currentScanned) Serial.print(voltageScanned ? "current+voltage " : "current ");
+  Serial.print("(");
+  Serial.print(ANALOG_SAMPLE_RATE / channelCount);
+  Serial.print(" Hz per sensor, CIC ");
+  Serial.print(ANALOG_CIC_STAGES);
+  Serial.print("x");
+  Serial.print(ANALOG_DECIMATION);
+  Serial.println(")");
+}
+
+bool serviceAnalogSensors() {
+  if (!running) return false;
+
+  // Only completed DMA buffers are taken; bounded by the ring size
+  uint8_t drained = 0;
+  while (drained < ANALOG_DMA_BUFFERS) {
+    size_t bytes = 0;
+    if (i2s_read(ANALOG_I2S_PORT, dmaBuffer, sizeof(dmaBuffer), &bytes, 0) != ESP_OK || bytes == 0) break;
+
+    uint32_t startUs = micros();
+    size_t count = bytes / sizeof(uint16_t);
+    for (size_t i = 0; i < count; i++) {
+      // Sample word: channel[15:12] value[11:0]
+      int8_t role = channelRole[dmaBuffer[i] >> 12];
+      if (role < 0) continue;
+      if (role < ANALOG_SENSOR_COUNT) {
+        filterSample(sensors[role], dmaBuffer[i] & 0x0FFF);
+      } else {
+        pairSample(role, dmaBuffer[i] & 0x0FFF);
+      }
+    }
+    statFilterUs += micros() - startUs;
+
+    if (waveCount > 0) {
+      if (waveformCallback) waveformCallback(waveCurrent, voltageScanned ? waveVoltage : nullptr, waveCount);
+      waveCount = 0;
+    }
+    statSamples += count;
+    drained++;
+    if (bytes < sizeof(dmaBuffer)) break;
+  }
+  // A whole ring in one call means the loop fell behind (buffers may be lost)
+  if (drained == ANALOG_DMA_BUFFERS) statRingFull++;
+
+  uint32_t now = millis();
+  if (now - windowStart < ANALOG_UPDATE_INTERVAL) return false;
+  windowStart = now;
+
+  for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+    AnalogSensorState& state = sensors[i];
+    if (state.adcChannel < 0) continue;
+    if (state.windowCount == 0) {
+      // No decimated output in a whole window: acquisition stalled
+      state.counts = NAN;
+      state.value = NAN;
+      continue;
+    }
+    state.counts = (float)state.windowSum / state.windowCount / cicGain();
+    state.value = toValue(state, state.counts);
+    state.windowSum = 0;
+    state.windowCount = 0;
+  }
+
+  logReport(now);
+  return true;
+}
+
+void setAnalogWaveformCallback(AnalogWaveformCallback callback) {
+  waveformCallback = callback;
+}
+
+uint32_t getAnalogChannelRate() {
+  return running ? ANALOG_SAMPLE_RATE / scanCount : 0;
+}
+
+bool hasAnalogCurrent() {
+  return running && currentScanned;
+}
+
+bool hasAnalogVoltage() {
+  return running && voltageScanned;
+}
+
+float getAnalogValue(AnalogSensor sensor) {
+  if (sensor >= ANALOG_SENSOR_COUNT) return NAN;
+  return sensors[sensor].value;
+}
+
+bool isAnalogSensorInstalled(AnalogSensor sensor) {
+  return running && sensor < ANALOG_SENSOR_COUNT && sensors[sensor].adcChannel >= 0;
+}
+
+const char* getAnalogName(AnalogSensor sensor) {
+  if (sensor >= ANALOG_SENSOR_COUNT) return "";
+  return sensorConfig[sensor].name;
+}
+
+bool calibrateAnalogSensor(const char* name, const char* value) {
+  AnalogSensor sensor = findSensor(name);
+  if (sensor >= ANALOG_SENSOR_COUNT || sensors[sensor].adcChannel < 0) return false;
+  AnalogSensorState& state = sensors[sensor];
+
+  if (strcasecmp(value, "RESET") == 0) {
+    for (int p = 0; p < 2; p++) {
+      state.calRaw[p] = sensorConfig[sensor].raw[p];
+      state.calValue[p] = sensorConfig[sensor].value[p];
+    }
+    saveCalibration(sensor, true);
+  } else {
+    char* end;
+    float reference = strtof(value, &end);
+    if (end == value || *end != '\0' || isnan(state.counts)) return false;
+
+    // Replace the point closest in value; the other one must stay distinct
+    uint8_t point = fabsf(reference - state.calValue[0]) <= fabsf(reference - state.calValue[1]) ? 0 : 1;
+    uint8_t other = 1 - point;
+    if (fabsf(state.counts - state.calRaw[other]) < ANALOG_CAL_MIN_SPAN ||
+        reference == state.calValue[other]) {
+      return false;
+    }
+    state.calRaw[point] = state.counts;
+    state.calValue[point] = reference;
+    saveCalibration(sensor, false);
+  }
+  if (!isnan(state.counts)) state.value = toValue(state, state.counts);
+
+  Serial.print("[ANALOG] ");
+  Serial.print(sensorConfig[sensor].name);
+  Serial.print(" calibration: ");
+  for (int p = 0; p < 2; p++) {
+    Serial.print(state.calRaw[p], 1);
+    Serial.print(" counts = ");
+    Serial.print(state.calValue[p], sensorConfig[sensor].decimals);
+    Serial.print(p == 0 ? ", " : "\n");
+  }
+  return true;
+}
+
+bool analogSensorsMoved() {
+  for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+    const AnalogSensorState& state = sensors[i];
+    if (state.adcChannel < 0) continue;
+    if (isnan(state.value) != isnan(state.published)) return true;
+    if (fabsf(state.value - state.published) >= sensorConfig[i].deadband) return true;
+  }
+  return false;
+}
+
+void markAnalogSensorsPublished() {
+  for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+    sensors[i].published = sensors[i].value;
+  }
+}
+
+String getAnalogSensorsJSON() {
+  String json = "{";
+  bool first = true;
+  for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+    if (sensors[i].adcChannel < 0) continue;
+    if (!first) json += ",";
+    first = false;
+    json += "\"";
+    json += sensorConfig[i].name;
+    json += "\":";
+    if (isnan(sensors[i].value)) {
+      json += "null";
+    } else {
+      json += String(sensors[i].value, (unsigned int)sensorConfig[i].decimals);
+    }
+  }
+  json += "}";
+  return json;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file ble_control.cpp
+ * @brief Local control and telemetry GATT service implementation
+ */
+
+#include "ble_control.h"
+#include <NimBLEDevice.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <atomic>
+
+// ==================== BLE UUIDs ====================
+// Keep in sync with js/ble-provisioning.js
+#define CONTROL_SERVICE_UUID  "6e0f0001-8d2f-4a8e-9b3c-5f1c2a7d9e10"
+#define PUMP_CHAR_UUID        "6e0f0002-8d2f-4a8e-9b3c-5f1c2a7d9e10"  // ON/OFF/TOGGLE
+#define VALVE_CHAR_UUID       "6e0f0003-8d2f-4a8e-9b3c-5f1c2a7d9e10"  // 1/2/TOGGLE
+#define TIMER_CHAR_UUID       "6e0f0004-8d2f-4a8e-9b3c-5f1c2a7d9e10"  // {"mode":1,"duration":3600}
+#define TEMP_CHAR_UUID        "6e0f0005-8d2f-4a8e-9b3c-5f1c2a7d9e10"  // "25.3"
+#define STATS_CHAR_UUID       "6e0f0006-8d2f-4a8e-9b3c-5f1c2a7d9e10"  // Latency statistics JSON
+
+/**
+ * One write waiting for the loop task
+ */
+struct BLEControlCommand {
+  uint8_t channel;
+  char payload[BLE_CONTROL_PAYLOAD_MAX + 1];
+  uint32_t receivedUs;   // micros() when the write reached the host task
+};
+
+// ==================== Global Objects ====================
+static NimBLECharacteristic* characteristics[BLE_CONTROL_CHANNEL_COUNT] = {nullptr};
+static NimBLECharacteristic* pStatsCharacteristic = nullptr;
+static QueueHandle_t commandQueue = nullptr;
+static BLEControlCallback controlCallback = nullptr;
+
+// Channels whose last notification was refused by at least one client
+// (out of buffers on a congested link); set by the host task, re-sent by
+// serviceBLEControl(). Only the latest value matters, so repeats coalesce.
+static std::atomic<uint8_t> renotifyMask(0);
+
+// ==================== State Variables ====================
+static uint32_t statCommands = 0;
+static uint32_t statDropped = 0;
+static uint32_t statRejected = 0;
+static uint64_t statTotalUs = 0;
+static uint32_t statMaxUs = 0;
+
+// ==================== Helpers ====================
+
+/**
+ * Map a characteristic back to its channel
+ * @return BLE_CONTROL_CHANNEL_COUNT if unknown
+ */
+static BLEControlChannel channelOf(NimBLECharacteristic* characteristic) {
+  for (int i = 0; i < BLE_CONTROL_CHANNEL_COUNT; i++) {
+    if (characteristics[i] == characteristic) return (BLEControlChannel)i;
+  }
+  return BLE_CONTROL_CHANNEL_COUNT;
+}
+
+/**
+ * Latency statistics as JSON for the stats characteristic
+ */
+static String statsJSON() {
+  BLEControlStats stats = getBLEControlStats();
+  String json = "{";
+  json += "\"commands\":" + String(stats.commands) + ",";
+  json += "\"dropped\":" + String(stats.dropped) + ",";
+  json += "\"rejected\":" + String(stats.rejected) + ",";
+  json += "\"avg_us\":" + String(stats.avgUs) + ",";
+  json += "\"max_us\":" + String(stats.maxUs);
+  json += "}";
+  return json;
+}
+
+// ==================== BLE Callbacks ====================
+
+/**
+ * Queues writes for the loop task; never runs a handler in the host task
+ */
+class ControlCallbacks : public NimBLECharacteristicCallbacks {
+  void onStatus(NimBLECharacteristic* pCharacteristic, Status status, int code) {
+    // notify() fans out to every subscribed client at its own MTU; a client
+    // whose link is congested fails with a GATT error and gets the value again
+    if (status != ERROR_GATT) return;
+    BLEControlChannel channel = channelOf(pCharacteristic);
+    if (channel < BLE_CONTROL_CHANNEL_COUNT) {
+      renotifyMask.fetch_or(1 << channel, std::memory_order_relaxed);
+    }
+  }
+
+  void onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) {
+    // The stack already refuses writes on links without authenticated
+    // encryption; a command also needs a stored bond (paired with the passkey)
+    if (!desc->sec_state.encrypted || !desc->sec_state.authenticated || !desc->sec_state.bonded) {
+      statRejected++;
+      Serial.println("[BLE-CTRL] Write on an unbonded link rejected");
+      return;
+    }
+
+    BLEControlCommand cmd;
+    cmd.receivedUs = micros();
+    cmd.channel = channelOf(pCharacteristic);
+    if (cmd.channel >= BLE_CONTROL_CHANNEL_COUNT || !commandQueue) return;
+
+    std::string value = pCharacteristic->getValue();
+    size_t length = value.length() < BLE_CONTROL_PAYLOAD_MAX ? value.length() : BLE_CONTROL_PAYLOAD_MAX;
+    memcpy(cmd.payload, value.data(), length);
+    cmd.payload[length] = '\0';
+
+    if (xQueueSend(commandQueue, &cmd, 0) != pdTRUE) {
+      statDropped++;
+      Serial.println("[BLE-CTRL] Command queue full - write dropped");
+    }
+  }
+};
+
+// ==================== Public Functions ====================
+
+void createBLEControlService(NimBLEServer* server) {
+  if (!commandQueue) {
+    commandQueue = xQueueCreate(BLE_CONTROL_QUEUE_LEN, sizeof(BLEControlCommand));
+  }
+
+  static ControlCallbacks callbacks;
+  NimBLEService* pService = server->createService(CONTROL_SERVICE_UUID);
+
+  const char* uuids[BLE_CONTROL_CHANNEL_COUNT] = {
+    PUMP_CHAR_UUID, VALVE_CHAR_UUID, TIMER_CHAR_UUID, TEMP_CHAR_UUID
+  };
+  for (int i = 0; i < BLE_CONTROL_CHANNEL_COUNT; i++) {
+    uint32_t properties = NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY;
+    if (i != BLE_CONTROL_TEMPERATURE) {
+      // Write without response saves a round trip on the command path;
+      // writes need a link encrypted with passkey-authenticated keys
+      properties |= NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR |
+                    NIMBLE_PROPERTY::WRITE_ENC | NIMBLE_PROPERTY::WRITE_AUTHEN;
+    }
+    characteristics[i] = pService->createCharacteristic(uuids[i], properties);
+    characteristics[i]->setCallbacks(&callbacks);
+    characteristics[i]->setValue("");
+  }
+
+  pStatsCharacteristic = pService->createCharacteristic(STATS_CHAR_UUID, NIMBLE_PROPERTY::READ);
+  pStatsCharacteristic->setValue(statsJSON().c_str());
+
+  pService->start();
+
+  Serial.print("[BLE-CTRL] ✓ Local control service: ");
+  Serial.println(CONTROL_SERVICE_UUID);
+}
+
+void setBLEControlCallback(BLEControlCallback callback) {
+  controlCallback = callback;
+}
+
+void serviceBLEControl() {
+  if (!commandQueue) return;
+
+  uint8_t renotify = renotifyMask.exchange(0, std::memory_order_relaxed);
+  for (int i = 0; i < BLE_CONTROL_CHANNEL_COUNT; i++) {
+    if (renotify & (1 << i)) characteristics[i]->notify();
+  }
+
+  BLEControlCommand cmd;
+  while (xQueueReceive(commandQueue, &cmd, 0) == pdTRUE) {
+    if (controlCallback) {
+      controlCallback((BLEControlChannel)cmd.channel, cmd.payload);
+    }
+
+    uint32_t us = micros() - cmd.receivedUs;
+    statCommands++;
+    statTotalUs += us;
+    if (us > statMaxUs) statMaxUs = us;
+
+    Serial.print("[BLE-CTRL] Command handled in ");
+    Serial.print(us);
+    Serial.println(" us");
+
+    if (pStatsCharacteristic) {
+      pStatsCharacteristic->setValue(statsJSON().c_str());
+    }
+  }
+}
+
+void notifyBLEControl(BLEControlChannel channel, const char* value) {
+  if (channel >= BLE_CONTROL_CHANNEL_COUNT) return;
+  NimBLECharacteristic* characteristic = characteristics[channel];
+  if (!characteristic) return;
+
+  characteristic->setValue(value);
+  characteristic->notify();
+}
+
+BLEControlStats getBLEControlStats() {
+  BLEControlStats stats;
+  stats.commands = statCommands;
+  stats.dropped = statDropped;
+  stats.rejected = statRejected;
+  stats.avgUs = statCommands ? (uint32_t)(statTotalUs / statCommands) : 0;
+  stats.maxUs = statMaxUs;
+  return stats;
+}
@@ -4,9 +4,22 @@
  */
 
 #include "ble_provisioning.h"
+#include "ble_control.h"
+#include "chunk_stream.h"
+#include "config.h"
+#include "provisioning_tlv.h"
+#include "secrets.h"  // BLE_CONTROL_PASSKEY
+#include "wifi_scan.h"
 #include <NimBLEDevice.h>
 #include <Preferences.h>
 #include <WiFi.h>
+#include <esp_bt.h>
+#include <nimble/nimble/host/services/gatt/include/services/gatt/ble_svc_gatt.h>
+#include <atomic>
+
+#if BLE_LOCAL_CONTROL && !defined(BLE_CONTROL_PASSKEY)
+#error "BLE_LOCAL_CONTROL needs BLE_CONTROL_PASSKEY (6 digits) in secrets.h"
+#endif
 
 // ==================== BLE UUIDs ====================
 // Custom UUIDs for Pool Controller WiFi Provisioning Service
@@ -17,6 +30,28 @@
 #define NETWORKS_CHAR_UUID  "fa87c0d0-afac-11de-8a39-0800200c9a66"  // WiFi networks scan result
 // Remote commands (e.g., clear WiFi). Keep in sync with dashboard JS.
 #define COMMAND_CHAR_UUID   "8b9d68c4-57b8-4b02-bf19-6fd94b62f709"
+// Single-write provisioning (TLV: SSID, password and optional settings)
+#define PROVISION_CHAR_UUID "4fafc202-1fb5-459e-8fcc-c5c9c331914b"
+
+// ==================== GATT Layout ====================
+// The device name stays the same across firmware versions, so clients keep
+// their cached GATT table. Bump the revision on any change to the services
+// or characteristics (order included): bonded clients then get a Service
+// Changed indication once and rediscover.
+#define GATT_LAYOUT_REVISION  3
+#define GATT_LAYOUT_VERSION   ((GATT_LAYOUT_REVISION << 1) | BLE_LOCAL_CONTROL)
+
+// ==================== Networks Streaming ====================
+// The list is sent as a text stream of JSON arrays, one per line, strongest
+// networks first, cut into MTU-sized chunks (framing in chunk_stream.h).
+#define NETWORKS_SCAN_CONSUMER    0    // First consumer bit in the wifi_scan pending masks (+ slot)
+#define NETWORKS_READ_MAX         512  // Full list kept for reads (attribute max length)
+#define NETWORKS_MAX_BURST        8    // Chunks queued per loop() before yielding (all clients)
+#define BLE_DEFAULT_MTU           23
+
+#if BLE_ATT_MTU_MAX > CHUNK_MTU_MAX
+#error "CHUNK_MTU_MAX must cover BLE_ATT_MTU_MAX"
+#endif
 
 // ==================== Global BLE Objects ====================
 static NimBLEServer* pServer = nullptr;
@@ -25,14 +60,165 @@ static NimBLECharacteristic* pPasswordCharacteristic = nullptr;
 static NimBLECharacteristic* pStatusCharacteristic = nullptr;
 static NimBLECharacteristic* pNetworksCharacteristic = nullptr;
 static NimBLECharacteristic* pCommandCharacteristic = nullptr;
+static NimBLECharacteristic* pProvisionCharacteristic = nullptr;
 
 // ==================== State Variables ====================
-static bool bleActive = false;
-static bool newCredentialsReceived = false;
-static String receivedSSID = "";
-static String receivedPassword = "";
-static bool deviceConnected = false;
-static bool clearWiFiRequested = false;
+static bool bleStackActive = false;   // NimBLE initialized, GATT services registered
+static bool bleReleased = false;      // Controller memory returned to the heap (no BLE until reboot)
+static std::atomic<bool> bleActive(false);  // Provisioning enabled (read by the host task)
+static uint16_t provisioningCycles = 0;
+static uint32_t firstCycleHeap = 0;   // Free heap at the first provisioning start
+
+// ==================== Client Slots ====================
+// One slot per connected central (at most BLE_MAX_CLIENTS). The host task
+// claims a slot in onConnect and frees it in onDisconnect; every connection
+// gets its own MTU, subscriptions, credential staging and networks stream,
+// so phones connected at the same time never share state.
+// Atomics cross tasks; "host" fields belong to the NimBLE host task, "loop"
+// fields to the loop task.
+struct ClientSlot {
+  std::atomic<bool> inUse;
+  std::atomic<uint16_t> generation;        // Bumped on every connection in this slot
+  std::atomic<uint16_t> handle;
+  std::atomic<uint16_t> mtu;
+  std::atomic<uint32_t> connectedAt;
+  std::atomic<bool> awaitingFirstOperation;
+  std::atomic<uint32_t> usableAt;          // millis() of the first ATT operation (0 = logged)
+  std::atomic<bool> usableBonded;          // Link was encrypted with bonded keys by then
+  std::atomic<bool> statusSubscribed;
+  std::atomic<bool> networksSubscribed;
+  std::atomic<uint32_t> networksRequestedAt; // millis() of a list request (0 = none), consumed in loop
+
+  // host: legacy two-write credentials
+  char stagedSSID[33];
+  char stagedPassword[64];
+
+  // loop: connection as last seen, networks stream of this client
+  bool active;
+  uint16_t seenGeneration;
+  bool streaming;                          // List requested and not finished
+  bool finalPending;                       // Final chunk still owed
+  uint32_t requestTime;
+  String streamBuffer;                     // JSON lines not yet sent (a refused chunk stays here)
+  ChunkStream chunks;                      // Sequence and counters of the list transfer
+  uint32_t transferStart;                  // millis() of the first chunk
+};
+static ClientSlot clients[BLE_MAX_CLIENTS];
+static std::atomic<uint8_t> clientCount(0);
+
+#if NETWORKS_SCAN_CONSUMER + BLE_MAX_CLIENTS > WIFI_SCAN_CONSUMERS
+#error "Not enough wifi_scan consumers for BLE_MAX_CLIENTS"
+#endif
+
+// ==================== Advertising Profile ====================
+// Owned by the loop task; the host task never starts or stops advertising
+enum AdvertisingProfile { ADV_OFF, ADV_FAST, ADV_SLOW };
+static AdvertisingProfile advProfile = ADV_OFF;  // Profile on air
+static bool fastAdvertising = false;             // Inside the fast window
+static uint32_t fastAdvertisingStart = 0;
+static uint8_t advertisingPauses = 0;            // Nested pauseBLEAdvertising() calls
+static uint32_t advertisingSince = 0;            // millis() advertising went on air
+
+// ==================== Credential Mailbox ====================
+// Single-slot handoff from the NimBLE host task (producer) to the loop task
+// (consumer). The producer only fills the slot while it is empty and
+// publishes it with a release store; the consumer reads it after an acquire
+// load and hands it back by clearing the flag. No locks, no heap.
+static ProvisioningData credentialSlot;
+static std::atomic<bool> credentialsReady(false);
+static std::atomic<bool> clearWiFiRequested(false);
+
+// Staging buffer for TLV writes, touched by the host task only
+static ProvisioningData stagedTLV;
+
+// ==================== Helpers ====================
+
+/**
+ * Copy a characteristic value into a fixed buffer
+ * @return false if it does not fit (value rejected)
+ */
+static bool copyValue(const std::string& value, char* buffer, size_t size) {
+  if (value.length() >= size) return false;
+  memcpy(buffer, value.data(), value.length());
+  buffer[value.length()] = '\0';
+  return true;
+}
+
+/**
+ * Slot of a connection (host task)
+ * @return nullptr if the handle is not connected
+ */
+static ClientSlot* findClient(uint16_t handle) {
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    if (clients[i].inUse.load(std::memory_order_relaxed) &&
+        clients[i].handle.load(std::memory_order_relaxed) == handle) {
+      return &clients[i];
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Queue one notification for a single connection
+ * Uses the host API directly so an out-of-buffer condition (congested
+ * link) is reported instead of silently dropping the value.
+ * @return false if the stack has no room right now (retry later)
+ */
+static bool sendNotification(uint16_t handle, NimBLECharacteristic* characteristic,
+                             const uint8_t* data, size_t length) {
+  struct os_mbuf* om = ble_hs_mbuf_from_flat(data, length);
+  if (om == nullptr) return false;
+  // The mbuf is consumed even on failure
+  return ble_gattc_notify_custom(handle, characteristic->getHandle(), om) == 0;
+}
+
+/**
+ * Answer the client that wrote: update the status value and notify only
+ * that connection, so other phones never see someone else's replies
+ */
+static void replyStatus(ClientSlot* client, const char* status) {
+  if (!pStatusCharacteristic) return;
+  pStatusCharacteristic->setValue(status);
+  if (client && client->statusSubscribed.load(std::memory_order_relaxed)) {
+    sendNotification(client->handle.load(std::memory_order_relaxed), pStatusCharacteristic,
+                     (const uint8_t*)status, strlen(status));
+  }
+}
+
+/**
+ * Hand a complete set to the loop task (host task)
+ * @return false if the previous set has not been taken yet
+ */
+static bool publishCredentials(const ProvisioningData& staged, ClientSlot* client) {
+  if (credentialsReady.load(std::memory_order_acquire)) {
+    // Previous set not taken yet; the slot is owned by the loop task
+    Serial.println("[BLE] Credentials busy - previous set still pending");
+    replyStatus(client, "busy");
+    return false;
+  }
+  memcpy(&credentialSlot, &staged, sizeof(ProvisioningData));
+  credentialsReady.store(true, std::memory_order_release);
+  Serial.println("[BLE] ✓ WiFi credentials complete");
+  replyStatus(client, "credentials_ready");
+  return true;
+}
+
+/**
+ * First read/write/subscribe on a connection: the client finished its
+ * service discovery (or used its cache) and the link is usable (host task)
+ */
+static void noteFirstOperation(ClientSlot* client, ble_gap_conn_desc* desc) {
+  if (!client || !client->awaitingFirstOperation.exchange(false, std::memory_order_relaxed)) return;
+  client->usableBonded.store(desc->sec_state.bonded, std::memory_order_relaxed);
+  client->usableAt.store(millis() | 1, std::memory_order_release);
+}
+
+/**
+ * Advertising runs while provisioning, and always with local control
+ */
+static bool isAdvertisingWanted() {
+  return bleActive || BLE_LOCAL_CONTROL;
+}
 
 // ==================== BLE Callbacks ====================
 
@@ -40,24 +226,74 @@ static bool clearWiFiRequested = false;
  * Server callback - handles client connect/disconnect events
  */
 class ServerCallbacks : public NimBLEServerCallbacks {
-  void onConnect(NimBLEServer* pServer) {
-    deviceConnected = true;
-    Serial.println("[BLE] Client connected");
-    
-    // Update status characteristic
-    if (pStatusCharacteristic) {
-      pStatusCharacteristic->setValue("connected");
-      pStatusCharacteristic->notify();
+  void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {
+    ClientSlot* client = nullptr;
+    for (int i = 0; i < BLE_MAX_CLIENTS && !client; i++) {
+      if (!clients[i].inUse.load(std::memory_order_relaxed)) client = &clients[i];
     }
+    if (!client) {
+      // Cannot happen with CONFIG_BT_NIMBLE_MAX_CONNECTIONS == BLE_MAX_CLIENTS
+      pServer->disconnect(desc->conn_handle);
+      return;
+    }
+    
+    client->handle.store(desc->conn_handle, std::memory_order_relaxed);
+    client->mtu.store(BLE_DEFAULT_MTU, std::memory_order_relaxed);
+    client->connectedAt.store(millis(), std::memory_order_relaxed);
+    client->awaitingFirstOperation.store(true, std::memory_order_relaxed);
+    client->usableAt.store(0, std::memory_order_relaxed);
+    client->statusSubscribed.store(false, std::memory_order_relaxed);
+    client->networksSubscribed.store(false, std::memory_order_relaxed);
+    client->networksRequestedAt.store(0, std::memory_order_relaxed);
+    client->stagedSSID[0] = '\0';
+    client->stagedPassword[0] = '\0';
+    client->generation.fetch_add(1, std::memory_order_relaxed);
+    client->inUse.store(true, std::memory_order_release);
+    uint8_t count = clientCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    
+    Serial.print("[BLE] Client connected (");
+    Serial.print(count);
+    Serial.print("/");
+    Serial.print(BLE_MAX_CLIENTS);
+    Serial.println(")");
+    
+#if BLE_BONDING && !BLE_LOCAL_CONTROL
+    // Encrypt the link: a bonded phone restores its keys (and keeps its GATT
+    // cache), a new one pairs with Just Works. With local control, pairing
+    // waits for the first control write so provisioning never asks for the passkey
+    NimBLEDevice::startSecurity(desc->conn_handle);
+#endif
+    
+    // Only this connection hears about its own connect
+    replyStatus(client, "connected");
   }
 
-  void onDisconnect(NimBLEServer* pServer) {
-    deviceConnected = false;
-    Serial.println("[BLE] Client disconnected");
+  void onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {
+    // Stream state belongs to the loop task; serviceBLEAdvertising() resets it
+    ClientSlot* client = findClient(desc->conn_handle);
+    if (!client) return;
+    client->inUse.store(false, std::memory_order_release);
+    uint8_t count = clientCount.fetch_sub(1, std::memory_order_relaxed) - 1;
     
-    // Restart advertising so others can connect
-    NimBLEDevice::startAdvertising();
-    Serial.println("[BLE] Advertising restarted");
+    Serial.print("[BLE] Client disconnected (");
+    Serial.print(count);
+    Serial.print("/");
+    Serial.print(BLE_MAX_CLIENTS);
+    Serial.println(")");
+    // serviceBLEAdvertising() restarts advertising with the current profile
+  }
+
+  void onAuthenticationComplete(ble_gap_conn_desc* desc) {
+    Serial.print("[BLE] Link ");
+    Serial.print(desc->sec_state.encrypted ? "encrypted" : "not encrypted");
+    Serial.println(desc->sec_state.bonded ? " (bonded)" : "");
+  }
+
+  void onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc) {
+    ClientSlot* client = findClient(desc->conn_handle);
+    if (client) client->mtu.store(MTU, std::memory_order_relaxed);
+    Serial.print("[BLE] MTU: ");
+    Serial.println(MTU);
   }
 };
 
@@ -65,95 +301,298 @@ class ServerCallbacks : public NimBLEServerCallbacks {
  * Characteristic callbacks - handles write events for WiFi credentials
  */
 class CharacteristicCallbacks : public NimBLECharacteristicCallbacks {
-  void onWrite(NimBLECharacteristic* pCharacteristic) {
+  void onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) {
+    ClientSlot* client = findClient(desc->conn_handle);
+    if (!client) return;
+    noteFirstOperation(client, desc);
+    
     std::string uuid = pCharacteristic->getUUID().toString();
     std::string value = pCharacteristic->getValue();
     
+    if ((uuid == SSID_CHAR_UUID || uuid == PASSWORD_CHAR_UUID || uuid == PROVISION_CHAR_UUID) && !bleActive) {
+      // Stack kept for local control: credentials only accepted while provisioning
+      Serial.println("[BLE] Credentials ignored - provisioning not active");
+      return;
+    }
+    
     if (uuid == SSID_CHAR_UUID) {
-      receivedSSID = String(value.c_str());
+      if (!copyValue(value, client->stagedSSID, sizeof(client->stagedSSID))) {
+        Serial.println("[BLE] SSID rejected (longer than 32 bytes)");
+        replyStatus(client, "invalid_ssid");
+        return;
+      }
       Serial.print("[BLE] SSID received: ");
-      Serial.println(receivedSSID);
+      Serial.println(client->stagedSSID);
       
       // Update status
-      if (pStatusCharacteristic) {
-        pStatusCharacteristic->setValue("ssid_received");
-        pStatusCharacteristic->notify();
-      }
+      replyStatus(client, "ssid_received");
     } 
     else if (uuid == PASSWORD_CHAR_UUID) {
-      receivedPassword = String(value.c_str());
+      if (!copyValue(value, client->stagedPassword, sizeof(client->stagedPassword))) {
+        Serial.println("[BLE] Password rejected (longer than 63 bytes)");
+        replyStatus(client, "invalid_password");
+        return;
+      }
       Serial.print("[BLE] Password received (");
-      Serial.print(receivedPassword.length());
+      Serial.print(strlen(client->stagedPassword));
       Serial.println(" chars)");
       
       // Update status
-      if (pStatusCharacteristic) {
-        pStatusCharacteristic->setValue("password_received");
-        pStatusCharacteristic->notify();
-      }
+      replyStatus(client, "password_received");
       
-      // Both credentials received
-      if (receivedSSID.length() > 0 && receivedPassword.length() > 0) {
-        newCredentialsReceived = true;
-        Serial.println("[BLE] ✓ WiFi credentials complete");
-        
-        if (pStatusCharacteristic) {
-          pStatusCharacteristic->setValue("credentials_ready");
-          pStatusCharacteristic->notify();
-        }
+      // Both credentials received from this client: publish them to the loop task
+      if (client->stagedSSID[0] != '\0' && client->stagedPassword[0] != '\0') {
+        memset(&stagedTLV, 0, sizeof(stagedTLV));
+        memcpy(stagedTLV.ssid, client->stagedSSID, sizeof(client->stagedSSID));
+        memcpy(stagedTLV.password, client->stagedPassword, sizeof(client->stagedPassword));
+        if (!publishCredentials(stagedTLV, client)) return;
+        client->stagedSSID[0] = '\0';
+        client->stagedPassword[0] = '\0';
       }
     }
+    else if (uuid == PROVISION_CHAR_UUID) {
+      // Everything in one write, acknowledged by a single status notify
+      const char* error = parseProvisioningTLV((const uint8_t*)value.data(), value.length(), &stagedTLV);
+      if (error) {
+        Serial.print("[BLE] Provisioning write rejected: ");
+        Serial.println(error);
+        replyStatus(client, error);
+        return;
+      }
+      Serial.print("[BLE] Provisioning received for: ");
+      Serial.println(stagedTLV.ssid);
+      publishCredentials(stagedTLV, client);
+    }
     else if (uuid == NETWORKS_CHAR_UUID) {
-      // Trigger WiFi scan when client writes to networks characteristic
-      Serial.println("[BLE] Networks scan triggered via write");
-      String json = scanWiFiNetworks();
-      
-      // Update the characteristic with scan results
-      pCharacteristic->setValue((uint8_t*)json.c_str(), json.length());
-      Serial.print("[BLE] Networks characteristic updated, length: ");
-      Serial.println(json.length());
+      // Scan request from dashboard. Never scan here: this runs in the NimBLE
+      // host task and a blocking scan would stall BLE for 2-4 s.
+      Serial.println("[BLE] Networks scan requested via write");
       
-      // Notify client that new data is available
-      pCharacteristic->notify();
+      // updateBLENetworks() streams the cached table (if any) followed by
+      // every channel of a background refresh when the cache is stale
+      if (!isWiFiScanFresh()) {
+        requestWiFiScan();
+      }
+      client->networksRequestedAt.store(millis() | 1, std::memory_order_release);
     }
     else if (uuid == COMMAND_CHAR_UUID) {
+      // Stack kept for local control: outside provisioning, erasing the
+      // credentials needs the passkey bond that local control writes need
+      if (!bleActive && !(desc->sec_state.encrypted && desc->sec_state.authenticated &&
+                          desc->sec_state.bonded)) {
+        Serial.println("[BLE] Command ignored - provisioning not active and link not bonded");
+        return;
+      }
       // Handle simple command verbs from dashboard
       if (value == "clear_wifi") {
-        clearWiFiRequested = true;
+        clearWiFiRequested.store(true, std::memory_order_release);
         Serial.println("[BLE] Clear WiFi command received via BLE");
 
-        if (pStatusCharacteristic) {
-          pStatusCharacteristic->setValue("clear_wifi_requested");
-          pStatusCharacteristic->notify();
-        }
+        replyStatus(client, "clear_wifi_requested");
       }
     }
   }
   
-  void onRead(NimBLECharacteristic* pCharacteristic) {
-    std::string uuid = pCharacteristic->getUUID().toString();
+  void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) {
+    ClientSlot* client = findClient(desc->conn_handle);
+    if (!client) return;
+    noteFirstOperation(client, desc);
+    
+    // Fan-out goes only to connections that asked for it
+    bool notify = (subValue & 0x0001) != 0;
+    if (pCharacteristic == pStatusCharacteristic) {
+      client->statusSubscribed.store(notify, std::memory_order_relaxed);
+    } else if (pCharacteristic == pNetworksCharacteristic) {
+      client->networksSubscribed.store(notify, std::memory_order_release);
+    }
+  }
+
+  void onRead(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) {
+    noteFirstOperation(findClient(desc->conn_handle), desc);
     
     // Log when networks characteristic is read
-    if (uuid == NETWORKS_CHAR_UUID) {
+    if (pCharacteristic == pNetworksCharacteristic) {
       Serial.println("[BLE] Networks characteristic read");
     }
   }
 };
 
-// Forward declaration for scanWiFiNetworks
-String scanWiFiNetworks();
+/**
+ * Forget a client's networks stream (loop task)
+ */
+static void resetNetworksStream(ClientSlot& client) {
+  client.streaming = false;
+  client.finalPending = false;
+  client.streamBuffer = "";
+  resetChunkStream(&client.chunks);
+}
+
+/**
+ * Follow connects and disconnects of the host task (loop task)
+ * A slot whose generation changed between two calls was reused by a new
+ * connection; its previous stream is dropped either way.
+ */
+static void syncClients() {
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    ClientSlot& client = clients[i];
+    bool inUse = client.inUse.load(std::memory_order_acquire);
+    uint16_t generation = client.generation.load(std::memory_order_relaxed);
+    
+    if (client.active && (!inUse || generation != client.seenGeneration)) {
+      // Client gone (or replaced between two loops): drop the rest of its stream
+      resetNetworksStream(client);
+      client.active = false;
+    }
+    if (inUse && !client.active) {
+      client.active = true;
+      client.seenGeneration = generation;
+      // Discovery latency: advertising on air -> client connected
+      if (advProfile != ADV_OFF) {
+        Serial.print("[BLE] Slot ");
+        Serial.print(i);
+        Serial.print(" discovered after ");
+        Serial.print(client.connectedAt.load(std::memory_order_relaxed) - advertisingSince);
+        Serial.print(" ms of ");
+        Serial.print(advProfile == ADV_FAST ? "fast" : "slow");
+        Serial.println(" advertising");
+      }
+    }
+  }
+}
+
+// Allocated once for the lifetime of the firmware; the stack only keeps pointers
+static ServerCallbacks serverCallbacks;
+static CharacteristicCallbacks characteristicCallbacks;
+
+// ==================== Advertising Profile ====================
+
+/**
+ * Put the wanted advertising profile on air (loop task only)
+ * Off while paused, while every client slot is taken or when nothing needs
+ * advertising; otherwise fast inside the fast window and slow after it.
+ * The intervals only take effect on a restart, so a profile change stops
+ * and restarts advertising.
+ */
+static void applyAdvertising() {
+  if (!bleStackActive) return;
+  
+  bool full = clientCount.load(std::memory_order_acquire) >= BLE_MAX_CLIENTS;
+  AdvertisingProfile wanted = ADV_OFF;
+  if (isAdvertisingWanted() && advertisingPauses == 0 && !full) {
+    wanted = fastAdvertising ? ADV_FAST : ADV_SLOW;
+  }
+  
+  NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+  bool onAir = pAdvertising->isAdvertising();
+  if (wanted == advProfile && onAir == (wanted != ADV_OFF)) return;
+  
+  if (onAir) NimBLEDevice::stopAdvertising();
+  
+  if (wanted == ADV_OFF) {
+    if (advProfile != ADV_OFF) {
+      Serial.print("[BLE] Advertising off (");
+      Serial.print(advertisingPauses > 0 ? "paused for WiFi" : full ? "all client slots busy" : "not needed");
+      Serial.println(")");
+    }
+    advProfile = ADV_OFF;
+    return;
+  }
+  
+  bool fast = wanted == ADV_FAST;
+  pAdvertising->setMinInterval(fast ? BLE_ADV_FAST_MIN : BLE_ADV_SLOW_MIN);
+  pAdvertising->setMaxInterval(fast ? BLE_ADV_FAST_MAX : BLE_ADV_SLOW_MAX);
+  NimBLEDevice::startAdvertising();
+  if (!onAir) advertisingSince = millis();
+  advProfile = wanted;
+  
+  Serial.print("[BLE] Advertising ");
+  Serial.print(fast ? "fast (" : "slow (");
+  Serial.print((fast ? BLE_ADV_FAST_MIN : BLE_ADV_SLOW_MIN) * 5 / 8);
+  Serial.print("-");
+  Serial.print((fast ? BLE_ADV_FAST_MAX : BLE_ADV_SLOW_MAX) * 5 / 8);
+  Serial.println(" ms)");
+}
+
+void serviceBLEAdvertising() {
+  if (!bleStackActive) return;
+  
+  if (fastAdvertising && millis() - fastAdvertisingStart >= BLE_ADV_FAST_WINDOW) {
+    fastAdvertising = false;
+  }
+  
+  syncClients();
+  
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    ClientSlot& client = clients[i];
+    // Connect-to-usable latency: short for repeat clients that skip discovery
+    uint32_t usable = client.usableAt.exchange(0, std::memory_order_acquire);
+    if (usable) {
+      bool bonded = client.usableBonded.load(std::memory_order_relaxed);
+      Serial.print("[BLE] Slot ");
+      Serial.print(i);
+      Serial.print(" usable ");
+      Serial.print(usable - client.connectedAt.load(std::memory_order_relaxed));
+      Serial.print(" ms after connect (");
+      Serial.print(bonded ? "repeat, bonded link" : "new or unbonded link");
+      Serial.println(")");
+    }
+  }
+  
+  applyAdvertising();
+}
+
+void boostBLEAdvertising() {
+  fastAdvertising = true;
+  fastAdvertisingStart = millis();
+  applyAdvertising();
+}
+
+void pauseBLEAdvertising() {
+  advertisingPauses++;
+  applyAdvertising();
+}
+
+void resumeBLEAdvertising() {
+  if (advertisingPauses > 0) advertisingPauses--;
+  applyAdvertising();
+}
+
+// ==================== GATT Layout ====================
+
+/**
+ * Announce a changed GATT layout to bonded clients (once per change)
+ * The indication is queued by the host for bonded peers that subscribed to
+ * Service Changed and delivered when they reconnect.
+ */
+static void checkGATTLayout() {
+  Preferences prefs;
+  prefs.begin("ble", false);
+  uint32_t stored = prefs.getUInt("layout", 0);
+  if (stored != GATT_LAYOUT_VERSION) {
+    ble_svc_gatt_changed(0x0001, 0xFFFF);
+    prefs.putUInt("layout", GATT_LAYOUT_VERSION);
+    Serial.print("[BLE] GATT layout ");
+    Serial.print(stored);
+    Serial.print(" -> ");
+    Serial.print(GATT_LAYOUT_VERSION);
+    Serial.println(": Service Changed queued for bonded clients");
+  }
+  prefs.end();
+}
 
 // ==================== Public Functions ====================
 
-void initBLEProvisioning() {
-  Serial.println("[BLE] Initializing BLE provisioning...");
+void startBLEStack() {
+  if (bleStackActive || bleReleased) return;
+
+  Serial.println("[BLE] Starting BLE stack...");
   
   // Generate device name with MAC address suffix
   uint8_t mac[6];
   esp_read_mac(mac, ESP_MAC_WIFI_STA);
   char deviceName[32];
-  // Add version suffix to break cached GATT on clients
-  snprintf(deviceName, sizeof(deviceName), "Controlador Smart Pool-%02X%02X-v2", mac[4], mac[5]);
+  // Stable name: layout changes are announced with Service Changed instead
+  snprintf(deviceName, sizeof(deviceName), "Controlador Smart Pool-%02X%02X", mac[4], mac[5]);
   
   Serial.print("[BLE] Device name: ");
   Serial.println(deviceName);
@@ -161,9 +600,22 @@ void initBLEProvisioning() {
   // Initialize NimBLE
   NimBLEDevice::init(deviceName);
   
+#if BLE_LOCAL_CONTROL
+  // Control writes need an authenticated bond: the device "displays" a fixed
+  // passkey, which the user types on the phone when pairing
+  NimBLEDevice::setSecurityAuth(true /*bonding*/, true /*mitm*/, true /*secure connections*/);
+  NimBLEDevice::setSecurityIOCap(BLE_HS_IO_DISPLAY_ONLY);
+  NimBLEDevice::setSecurityPasskey(BLE_CONTROL_PASSKEY);
+#elif BLE_BONDING
+  // Just Works bonding (no display/keyboard); no characteristic requires it
+  NimBLEDevice::setSecurityAuth(true /*bonding*/, false /*mitm*/, true /*secure connections*/);
+  NimBLEDevice::setSecurityIOCap(BLE_HS_IO_NO_INPUT_OUTPUT);
+#endif
+  
   // Create BLE Server
   pServer = NimBLEDevice::createServer();
-  pServer->setCallbacks(new ServerCallbacks());
+  pServer->setCallbacks(&serverCallbacks, false /*deleteCallbacks*/);
+  pServer->advertiseOnDisconnect(false);  // Restarted by serviceBLEAdvertising()
   
   // Create BLE Service
   NimBLEService* pService = pServer->createService(SERVICE_UUID);
@@ -173,7 +625,7 @@ void initBLEProvisioning() {
     SSID_CHAR_UUID,
     NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE
   );
-  pSSIDCharacteristic->setCallbacks(new CharacteristicCallbacks());
+  pSSIDCharacteristic->setCallbacks(&characteristicCallbacks);
   pSSIDCharacteristic->setValue(""); // Initial empty value
   
   // Create Password Characteristic (Write only for security)
@@ -181,7 +633,7 @@ void initBLEProvisioning() {
     PASSWORD_CHAR_UUID,
     NIMBLE_PROPERTY::WRITE
   );
-  pPasswordCharacteristic->setCallbacks(new CharacteristicCallbacks());
+  pPasswordCharacteristic->setCallbacks(&characteristicCallbacks);
   pPasswordCharacteristic->setValue("");
   
   // Create Status Characteristic (Read/Notify)
@@ -189,6 +641,7 @@ void initBLEProvisioning() {
     STATUS_CHAR_UUID,
     NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY
   );
+  pStatusCharacteristic->setCallbacks(&characteristicCallbacks);
   pStatusCharacteristic->setValue("waiting");
   
   // Create Networks Characteristic (Read/Write - write triggers scan, read returns JSON)
@@ -196,7 +649,7 @@ void initBLEProvisioning() {
     NETWORKS_CHAR_UUID,
     NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY
   );
-  pNetworksCharacteristic->setCallbacks(new CharacteristicCallbacks());
+  pNetworksCharacteristic->setCallbacks(&characteristicCallbacks);
   pNetworksCharacteristic->setValue("[]"); // Initial empty list
 
   // Create Command Characteristic (Write to request actions like clearing WiFi)
@@ -204,26 +657,79 @@ void initBLEProvisioning() {
     COMMAND_CHAR_UUID,
     NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY
   );
-  pCommandCharacteristic->setCallbacks(new CharacteristicCallbacks());
+  pCommandCharacteristic->setCallbacks(&characteristicCallbacks);
   pCommandCharacteristic->setValue("");
   Serial.print("[BLE] Command characteristic UUID: ");
   Serial.println(COMMAND_CHAR_UUID);
   
+  // Create Provisioning Characteristic (single TLV write replaces SSID + password)
+  pProvisionCharacteristic = pService->createCharacteristic(
+    PROVISION_CHAR_UUID,
+    NIMBLE_PROPERTY::WRITE
+  );
+  pProvisionCharacteristic->setCallbacks(&characteristicCallbacks);
+  
   // Start the service
   pService->start();
+
+#if BLE_LOCAL_CONTROL
+  // Local control service lives next to provisioning on the same server
+  createBLEControlService(pServer);
+#endif
+  
+  // Register the GATT database now (handles fixed) instead of on first advertising
+  pServer->start();
+  checkGATTLayout();
   
-  // Start advertising
+  // Advertising data; the interval is set by the advertising profile
   NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
   pAdvertising->addServiceUUID(SERVICE_UUID);
   pAdvertising->setScanResponse(true);
   pAdvertising->setMinPreferred(0x06);  // Apple connection parameter
   pAdvertising->setMaxPreferred(0x12);
   
-  NimBLEDevice::startAdvertising();
+  bleStackActive = true;
+  Serial.println("[BLE] ✓ BLE stack started");
+  
+  // Boot: fast advertising so the dashboard finds the device right away
+  boostBLEAdvertising();
+}
+
+void initBLEProvisioning() {
+  if (bleActive) return;
+  if (bleReleased) {
+    Serial.println("[BLE] Bluetooth released for this boot - captive portal only");
+    return;
+  }
+  
+  Serial.println("[BLE] Initializing BLE provisioning...");
+  uint32_t startUs = micros();
+  
+  // First call builds the GATT database; later calls only resume advertising
+  startBLEStack();
   
   bleActive = true;
   
-  Serial.println("[BLE] ✓ Provisioning service started");
+  if (pStatusCharacteristic) {
+    pStatusCharacteristic->setValue("waiting");
+  }
+  // The user is about to look for the device: fast profile again
+  boostBLEAdvertising();
+  
+  uint32_t elapsedUs = micros() - startUs;
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (provisioningCycles == 0) firstCycleHeap = freeHeap;
+  provisioningCycles++;
+  
+  Serial.print("[BLE] ✓ Provisioning service started in ");
+  Serial.print(elapsedUs);
+  Serial.print(" us (cycle ");
+  Serial.print(provisioningCycles);
+  Serial.print(", free heap ");
+  Serial.print(freeHeap);
+  Serial.print(", delta since first cycle ");
+  Serial.print((int32_t)(freeHeap - firstCycleHeap));
+  Serial.println(")");
   Serial.println("[BLE] Waiting for dashboard connection...");
   Serial.print("[BLE] Service UUID: ");
   Serial.println(SERVICE_UUID);
@@ -234,123 +740,257 @@ void stopBLEProvisioning() {
   
   Serial.println("[BLE] Stopping provisioning service...");
   
-  NimBLEDevice::stopAdvertising();
-  
-  // deinit() automatically disconnects all clients
-  NimBLEDevice::deinit(true);
-  
   bleActive = false;
-  deviceConnected = false;
-  pServer = nullptr;
+  clearBLECredentials();
+
+#if BLE_LOCAL_CONTROL
+  // Stack stays up for local control; provisioning writes are ignored from now on
+  Serial.println("[BLE] Stack kept for local control");
+#else
+  // Pause instead of deinit: the GATT database and callbacks are kept so the
+  // next initBLEProvisioning() only has to resume advertising
+  if (pServer) {
+    for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+      if (clients[i].inUse.load(std::memory_order_acquire)) {
+        pServer->disconnect(clients[i].handle.load(std::memory_order_relaxed));
+      }
+    }
+  }
+#endif
+  applyAdvertising();
+  
+  Serial.print("[BLE] ✓ Provisioning stopped (free heap ");
+  Serial.print(ESP.getFreeHeap());
+  Serial.println(")");
+}
+
+uint32_t releaseBLEMemory() {
+#if BLE_LOCAL_CONTROL
+  return 0; // The stack serves local control for the whole boot
+#else
+  if (bleReleased || bleActive || clientCount.load(std::memory_order_acquire) > 0) return 0;
+  
+  uint32_t heapBefore = ESP.getFreeHeap();
+  uint32_t blockBefore = ESP.getMaxAllocHeap();
+  
+  if (bleStackActive) {
+    // Host and controller down; clearAll frees the GATT database
+    NimBLEDevice::deinit(true);
+    pServer = nullptr;
+    pSSIDCharacteristic = nullptr;
+    pPasswordCharacteristic = nullptr;
+    pStatusCharacteristic = nullptr;
+    pNetworksCharacteristic = nullptr;
+    pCommandCharacteristic = nullptr;
+    pProvisionCharacteristic = nullptr;
+    bleStackActive = false;
+    advProfile = ADV_OFF;
+  }
+  uint32_t heapDeinit = ESP.getFreeHeap();
   
-  Serial.println("[BLE] ✓ Provisioning stopped");
+  // Controller .bss/.data (BLE and Classic) back to the heap; irreversible
+  esp_err_t err = esp_bt_controller_mem_release(ESP_BT_MODE_BTDM);
+  if (err != ESP_OK) {
+    Serial.print("[BLE] Controller memory release failed: ");
+    Serial.println(esp_err_to_name(err));
+  }
+  bleReleased = true;
+  
+  uint32_t heapAfter = ESP.getFreeHeap();
+  Serial.print("[BLE] ✓ Bluetooth released - free heap ");
+  Serial.print(heapBefore);
+  Serial.print(" -> ");
+  Serial.print(heapDeinit);
+  Serial.print(" (deinit) -> ");
+  Serial.print(heapAfter);
+  Serial.print(" (controller), largest block ");
+  Serial.print(blockBefore);
+  Serial.print(" -> ");
+  Serial.println(ESP.getMaxAllocHeap());
+  return heapAfter > heapBefore ? heapAfter - heapBefore : 0;
+#endif
+}
+
+bool isBLEReleased() {
+  return bleReleased;
 }
 
 bool isBLEProvisioningActive() {
   return bleActive;
 }
 
-bool hasNewWiFiCredentials() {
-  return newCredentialsReceived;
+bool isBLEClientConnected() {
+  return clientCount.load(std::memory_order_acquire) > 0;
 }
 
-bool getBLEWiFiSSID(char* ssid) {
-  if (receivedSSID.length() == 0) return false;
-  
-  strncpy(ssid, receivedSSID.c_str(), 32);
-  ssid[32] = '\0';
-  return true;
+uint8_t getBLEClientCount() {
+  return clientCount.load(std::memory_order_acquire);
 }
 
-bool getBLEWiFiPassword(char* password) {
-  if (receivedPassword.length() == 0) return false;
+bool takeBLEWiFiCredentials(char* ssid, char* password, NetworkSettings* settings, uint8_t* fields) {
+  if (!credentialsReady.load(std::memory_order_acquire)) return false;
   
-  strncpy(password, receivedPassword.c_str(), 63);
-  password[63] = '\0';
+  memcpy(ssid, credentialSlot.ssid, sizeof(credentialSlot.ssid));
+  memcpy(password, credentialSlot.password, sizeof(credentialSlot.password));
+  memcpy(settings, &credentialSlot.settings, sizeof(NetworkSettings));
+  *fields = credentialSlot.settingsFields;
+  
+  // Hand the slot back to the host task
+  credentialsReady.store(false, std::memory_order_release);
   return true;
 }
 
 void clearBLECredentials() {
-  newCredentialsReceived = false;
-  receivedSSID = "";
-  receivedPassword = "";
+  credentialsReady.store(false, std::memory_order_release);
 }
 
 /**
- * Scan available WiFi networks and return JSON array
+ * Cached WiFi networks as JSON array (complete list, no size limit)
+ * Requests a background scan when the cache is stale
  * @return JSON string with network list: [{"ssid":"NETWORK1","rssi":-50,"open":false},...]
  */
 String scanWiFiNetworks() {
-  Serial.println("[BLE] Scanning WiFi networks...");
-  
-  // Ensure WiFi is in station mode for scanning (required for BLE coexistence)
-  WiFi.mode(WIFI_STA);
-  delay(100); // Give WiFi radio time to initialize
-  
-  // Perform WiFi scan
-  int numNetworks = WiFi.scanNetworks();
-  
-  if (numNetworks == 0 || numNetworks == -1) {
-    Serial.println("[BLE] No networks found or scan failed");
-    return "[]";
+  if (!isWiFiScanFresh()) {
+    requestWiFiScan();
   }
   
-  Serial.print("[BLE] Found ");
-  Serial.print(numNetworks);
-  Serial.println(" networks");
-  
-  // Build JSON array
-  String json = "[";
-  int networkCount = 0;
-  
-  for (int i = 0; i < numNetworks; i++) {
-    String ssid = WiFi.SSID(i);
-    int rssi = WiFi.RSSI(i);
-    uint8_t encryption = WiFi.encryptionType(i);
-    bool open = (encryption == WIFI_AUTH_OPEN);
-    
-    // Skip empty SSIDs
-    if (ssid.length() == 0) continue;
-    
-    // Build network entry
-    String entry = "{\"ssid\":\"";
-    entry += ssid;
-    entry += "\",\"rssi\":";
-    entry += String(rssi);
-    entry += ",\"open\":";
-    entry += (open ? "true" : "false");
-    entry += "}";
-    
-    // Check if adding this entry would exceed safe BLE MTU (~400 bytes for reliable transmission)
-    int projectedSize = json.length() + entry.length() + (networkCount > 0 ? 1 : 0) + 1; // +1 for comma, +1 for ]
-    if (projectedSize > 400) {
-      Serial.println("[BLE] Network list too large, stopping here");
-      break;
-    }
-    
-    if (networkCount > 0) json += ",";
-    json += entry;
-    networkCount++;
-  }
-  
-  json += "]";
-  
-  // Clean up
-  WiFi.scanDelete();
+  String json = getWiFiScanJSON();
   
   Serial.print("[BLE] JSON size: ");
   Serial.print(json.length());
   Serial.println(" bytes");
-  Serial.print("[BLE] JSON: ");
-  Serial.println(json);
   
   return json;
 }
 
+/**
+ * Queue one chunk as a notification on a client's connection
+ * @return false if the stack has no room right now (retry later)
+ */
+static bool notifyNetworksChunk(void* context, const uint8_t* frame, size_t length) {
+  ClientSlot* client = (ClientSlot*)context;
+  return sendNotification(client->handle.load(std::memory_order_relaxed), pNetworksCharacteristic,
+                          frame, length);
+}
+
+/**
+ * Log the throughput of a completed list transfer
+ */
+static void logNetworksTransfer(ClientSlot& client) {
+  uint32_t elapsed = millis() - client.transferStart;
+  Serial.print("[BLE] Slot ");
+  Serial.print(&client - clients);
+  Serial.print(" networks list complete: ");
+  Serial.print(getWiFiScanCount());
+  Serial.print(" networks, ");
+  Serial.print(client.chunks.chunks);
+  Serial.print(" chunks, ");
+  Serial.print(client.chunks.bytes);
+  Serial.print(" bytes in ");
+  Serial.print(elapsed);
+  Serial.print(" ms (");
+  Serial.print(elapsed ? client.chunks.bytes * 1000UL / elapsed : client.chunks.bytes);
+  Serial.print(" B/s, MTU ");
+  Serial.print(client.mtu.load(std::memory_order_relaxed));
+  Serial.print(", stalls ");
+  Serial.print(client.chunks.stalls);
+  Serial.println(")");
+}
+
+/**
+ * Move one client's stream forward by at most budget chunks (loop task)
+ * Chunks are cut to this client's MTU. A refusal from the stack means this
+ * link is congested: the chunk stays in the buffer for the next loop and the
+ * other clients keep streaming.
+ * @return Chunks sent
+ */
+static uint8_t streamNetworks(ClientSlot& client, uint8_t consumer, uint8_t budget) {
+  uint16_t mtu = client.mtu.load(std::memory_order_relaxed);
+  size_t payloadMax = chunkPayloadMax(mtu);
+
+  uint8_t sent = 0;
+  while (sent < budget) {
+    if (client.streamBuffer.length() < payloadMax && hasWiFiScanPending(consumer)) {
+      client.streamBuffer += takeWiFiScanPendingJSON(consumer, chunkBatchMax(mtu));
+      client.streamBuffer += '\n';
+    }
+
+    bool listComplete = client.finalPending && !isWiFiScanRunning() &&
+                        !hasWiFiScanPending(consumer);
+    size_t consumed = 0;
+    ChunkStatus status = sendNextChunk(&client.chunks, client.streamBuffer.c_str(),
+                                       client.streamBuffer.length(), mtu, listComplete,
+                                       notifyNetworksChunk, &client, &consumed);
+    if (status == CHUNK_IDLE || status == CHUNK_REFUSED) break;
+    client.streamBuffer.remove(0, consumed);
+    sent++;
+
+    if (client.chunks.chunks == 1) {
+      client.transferStart = millis();
+      if (consumed > 0) {
+        Serial.print("[BLE] Slot ");
+        Serial.print(&client - clients);
+        Serial.print(" first networks notified ");
+        Serial.print(millis() - client.requestTime);
+        Serial.println(" ms after request");
+      }
+    }
+    if (status == CHUNK_FINAL) {
+      client.streaming = false;
+      client.finalPending = false;
+      logNetworksTransfer(client);
+      break;
+    }
+  }
+  return sent;
+}
+
+void updateBLENetworks(WiFiScanEvent event) {
+  if (!bleActive || !pNetworksCharacteristic) return;
+
+  if (event == WIFI_SCAN_DONE) {
+    // Reads (and old dashboards) get the list once the pass completes
+    String json = getWiFiScanJSON(NETWORKS_READ_MAX);
+    pNetworksCharacteristic->setValue((uint8_t*)json.c_str(), json.length());
+    for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+      if (clients[i].streaming) clients[i].finalPending = true;
+    }
+  }
+
+  syncClients();
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    ClientSlot& client = clients[i];
+    if (!client.active) continue;
+    uint32_t requestedAt = client.networksRequestedAt.exchange(0, std::memory_order_acquire);
+    if (!requestedAt) continue;
+
+    // New list for this client: restart its stream from the whole table
+    resetNetworksStream(client);
+    markWiFiScanPending(NETWORKS_SCAN_CONSUMER + i);
+    client.streaming = true;
+    client.requestTime = requestedAt;
+    // Answered from cache: the final chunk follows the cached entries
+    if (!isWiFiScanRunning()) client.finalPending = true;
+  }
+
+  // Share the burst budget round-robin so one congested or slow link does
+  // not hold back the others
+  static uint8_t nextClient = 0;
+  uint8_t budget = NETWORKS_MAX_BURST;
+  for (int n = 0; n < BLE_MAX_CLIENTS && budget > 0; n++) {
+    uint8_t i = (nextClient + n) % BLE_MAX_CLIENTS;
+    ClientSlot& client = clients[i];
+    if (!client.active || !client.streaming) continue;
+    if (!client.networksSubscribed.load(std::memory_order_acquire)) continue;
+    budget -= streamNetworks(client, NETWORKS_SCAN_CONSUMER + i, budget);
+  }
+  nextClient = (nextClient + 1) % BLE_MAX_CLIENTS;
+}
+
 bool isClearWiFiRequested() {
-  return clearWiFiRequested;
+  return clearWiFiRequested.load(std::memory_order_acquire);
 }
 
 void resetClearWiFiRequest() {
-  clearWiFiRequested = false;
+  clearWiFiRequested.store(false, std::memory_order_release);
 }
@@ -0,0 +1,214 @@
+/**
+ * @file captive_portal.cpp
+ * @brief Non-blocking SoftAP captive portal implementation
+ */
+
+#include "captive_portal.h"
+#include "wifi_scan.h"
+#include <WiFi.h>
+#include <WebServer.h>
+#include <DNSServer.h>
+
+// ==================== Embedded Page ====================
+// Generated by board_build.embed_files = data/portal/index.html.gz
+extern const uint8_t portal_page_start[] asm("_binary_data_portal_index_html_gz_start");
+extern const uint8_t portal_page_end[]   asm("_binary_data_portal_index_html_gz_end");
+
+#define DNS_PORT 53
+
+// ==================== Global Objects ====================
+static WebServer server(80);
+static DNSServer dnsServer;
+
+// ==================== State Variables ====================
+static bool portalActive = false;
+static bool credentialsReceived = false;
+static char portalSSID[33] = "";
+static char portalPassword[64] = "";
+
+static uint32_t statRequests = 0;
+static uint64_t statTotalUs = 0;
+static uint32_t statMaxUs = 0;
+
+// ==================== Response Timing ====================
+
+/**
+ * Measures one handler from entry until the response has been written
+ */
+struct ResponseTimer {
+  uint32_t start;
+  ResponseTimer() : start(micros()) {}
+  ~ResponseTimer() {
+    uint32_t us = micros() - start;
+    statRequests++;
+    statTotalUs += us;
+    if (us > statMaxUs) statMaxUs = us;
+
+    Serial.print("[PORTAL] ");
+    Serial.print(server.uri());
+    Serial.print(" served in ");
+    Serial.print(us);
+    Serial.println(" us");
+  }
+};
+
+// ==================== HTTP Handlers ====================
+
+/**
+ * Serves the gzip-compressed setup page straight from flash
+ */
+static void handleRoot() {
+  ResponseTimer timer;
+  server.sendHeader("Content-Encoding", "gzip");
+  server.sendHeader("Cache-Control", "public, max-age=" + String(PORTAL_CACHE_MAX_AGE));
+  server.send_P(200, "text/html", (const char*)portal_page_start,
+                portal_page_end - portal_page_start);
+}
+
+/**
+ * Returns cached scan results, requesting a background scan when stale
+ * Format: {"scanning":false,"networks":[{"ssid":"X","rssi":-50,"open":false},...]}
+ */
+static void handleScan() {
+  ResponseTimer timer;
+  server.sendHeader("Cache-Control", "no-store");
+
+  if (!isWiFiScanFresh()) {
+    requestWiFiScan();
+    server.send(200, "application/json", "{\"scanning\":true}");
+    return;
+  }
+
+  server.send(200, "application/json",
+              "{\"scanning\":false,\"networks\":" + getWiFiScanJSON() + "}");
+}
+
+/**
+ * Receives the form POST with ssid and password
+ */
+static void handleSave() {
+  ResponseTimer timer;
+  String ssid = server.arg("ssid");
+  String password = server.arg("password");
+
+  if (ssid.length() == 0 || ssid.length() > 32 || password.length() > 63) {
+    server.send(400, "text/plain", "Datos invalidos");
+    return;
+  }
+
+  strncpy(portalSSID, ssid.c_str(), 32);
+  portalSSID[32] = '\0';
+  strncpy(portalPassword, password.c_str(), 63);
+  portalPassword[63] = '\0';
+  credentialsReceived = true;
+
+  Serial.print("[PORTAL] ✓ Credentials received for: ");
+  Serial.println(portalSSID);
+
+  server.send(200, "text/html",
+              "<meta name=viewport content='width=device-width'>"
+              "<p style='font-family:sans-serif'>Conectando a la red WiFi...</p>");
+}
+
+/**
+ * Any other URL (OS connectivity checks included) redirects to the portal,
+ * which makes phones open the captive portal sheet automatically
+ */
+static void handleRedirect() {
+  ResponseTimer timer;
+  server.sendHeader("Location", "http://" + WiFi.softAPIP().toString() + "/");
+  server.send(302, "text/plain", "");
+}
+
+// ==================== Public Functions ====================
+
+void startCaptivePortal() {
+  if (portalActive) return;
+
+  Serial.println("[PORTAL] Starting captive portal...");
+
+  // AP+STA keeps the station free to reconnect to a known network
+  WiFi.mode(WIFI_AP_STA);
+  WiFi.softAP(PORTAL_AP_SSID);
+  IPAddress apIP = WiFi.softAPIP();
+
+  dnsServer.start(DNS_PORT, "*", apIP);
+
+  // Routes are registered once; WebServer keeps them across stop()/begin()
+  static bool routesRegistered = false;
+  if (!routesRegistered) {
+    server.on("/", HTTP_GET, handleRoot);
+    server.on("/index.html", HTTP_GET, handleRoot);
+    server.on("/scan", HTTP_GET, handleScan);
+    server.on("/save", HTTP_POST, handleSave);
+    server.onNotFound(handleRedirect);
+    routesRegistered = true;
+  }
+  server.begin();
+
+  statRequests = 0;
+  statTotalUs = 0;
+  statMaxUs = 0;
+  portalActive = true;
+
+  Serial.print("[PORTAL] ✓ Connect to \"");
+  Serial.print(PORTAL_AP_SSID);
+  Serial.print("\" and open http://");
+  Serial.println(apIP);
+}
+
+void stopCaptivePortal() {
+  if (!portalActive) return;
+
+  PortalStats stats = getPortalStats();
+  Serial.print("[PORTAL] Stopping - requests=");
+  Serial.print(stats.requests);
+  Serial.print(" avg=");
+  Serial.print(stats.avgUs);
+  Serial.print("us max=");
+  Serial.print(stats.maxUs);
+  Serial.println("us");
+
+  server.stop();
+  dnsServer.stop();
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_STA);
+
+  portalActive = false;
+}
+
+bool isCaptivePortalActive() {
+  return portalActive;
+}
+
+void handleCaptivePortal() {
+  if (!portalActive) return;
+  dnsServer.processNextRequest();
+  server.handleClient();
+}
+
+bool hasPortalCredentials() {
+  return credentialsReceived;
+}
+
+bool getPortalCredentials(char* ssid, char* password) {
+  if (!credentialsReceived) return false;
+
+  strncpy(ssid, portalSSID, 33);
+  strncpy(password, portalPassword, 64);
+  return true;
+}
+
+void clearPortalCredentials() {
+  credentialsReceived = false;
+  portalSSID[0] = '\0';
+  portalPassword[0] = '\0';
+}
+
+PortalStats getPortalStats() {
+  PortalStats stats;
+  stats.requests = statRequests;
+  stats.avgUs = statRequests ? (uint32_t)(statTotalUs / statRequests) : 0;
+  stats.maxUs = statMaxUs;
+  return stats;
+}
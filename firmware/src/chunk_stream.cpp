@@ -0,0 +1,51 @@
+/**
+ * @file chunk_stream.cpp
+ * @brief Framing of a text stream into MTU-sized BLE notifications implementation
+ */
+
+#include "chunk_stream.h"
+#include <string.h>
+
+void resetChunkStream(ChunkStream* stream) {
+  stream->seq = 0;
+  stream->chunks = 0;
+  stream->bytes = 0;
+  stream->stalls = 0;
+}
+
+size_t chunkPayloadMax(uint16_t mtu) {
+  if (mtu < CHUNK_MTU_MIN) mtu = CHUNK_MTU_MIN;
+  if (mtu > CHUNK_MTU_MAX) mtu = CHUNK_MTU_MAX;
+  return mtu - ATT_NOTIFY_OVERHEAD - CHUNK_HEADER_SIZE;
+}
+
+size_t chunkBatchMax(uint16_t mtu) {
+  // One byte left for the newline that ends each JSON array
+  size_t batch = chunkPayloadMax(mtu) - 1;
+  return batch > CHUNK_BATCH_MIN ? batch : CHUNK_BATCH_MIN;
+}
+
+ChunkStatus sendNextChunk(ChunkStream* stream, const char* text, size_t length, uint16_t mtu,
+                          bool listComplete, ChunkSendFn send, void* context, size_t* consumed) {
+  *consumed = 0;
+  if (length == 0 && !listComplete) return CHUNK_IDLE;
+
+  size_t payload = chunkPayloadMax(mtu);
+  if (payload > length) payload = length;
+  bool final = listComplete && payload == length;
+
+  uint8_t frame[CHUNK_MTU_MAX];
+  frame[0] = CHUNK_FLAG_FRAMED | (final ? CHUNK_FLAG_FINAL : 0);
+  frame[1] = stream->seq;
+  memcpy(frame + CHUNK_HEADER_SIZE, text, payload);
+
+  if (!send(context, frame, CHUNK_HEADER_SIZE + payload)) {
+    stream->stalls++;
+    return CHUNK_REFUSED;
+  }
+  stream->seq++;
+  stream->chunks++;
+  stream->bytes += CHUNK_HEADER_SIZE + payload;
+  *consumed = payload;
+  return final ? CHUNK_FINAL : CHUNK_SENT;
+}
@@ -0,0 +1,14 @@
+/**
+ * @file cic_decimator.cpp
+ * @brief Fixed-point CIC decimator implementation
+ */
+
+#include "cic_decimator.h"
+#include <string.h>
+
+void resetCicDecimator(CicDecimator* cic) {
+  memset(cic->integrator, 0, sizeof(cic->integrator));
+  memset(cic->comb, 0, sizeof(cic->comb));
+  cic->phase = 0;
+  cic->settling = ANALOG_CIC_STAGES;
+}
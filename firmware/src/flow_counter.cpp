@@ -0,0 +1,18 @@
+/**
+ * @file flow_counter.cpp
+ * @brief Flow meter pulse arithmetic implementation
+ */
+
+#include "flow_counter.h"
+
+uint64_t flowPulseTotal(uint32_t folds, uint16_t count, uint64_t previous) {
+  uint64_t pulses = (uint64_t)folds * FLOW_PCNT_LIMIT + count;
+  if (pulses < previous) pulses += FLOW_PCNT_LIMIT;
+  return pulses;
+}
+
+float flowRateOf(uint32_t pulses, uint64_t elapsedUs, float pulsesPerLiter) {
+  if (elapsedUs == 0 || pulsesPerLiter <= 0) return 0;
+  // pulses / K = litres; * 60e6 / us = per minute
+  return (float)((double)pulses * 60000000.0 / ((double)elapsedUs * pulsesPerLiter));
+}
@@ -0,0 +1,171 @@
+/**
+ * @file flow_meter.cpp
+ * @brief Hall-effect flow meter on the ESP32 pulse counter implementation
+ */
+
+#include "flow_meter.h"
+#include "config.h"
+#include <Preferences.h>
+#include <driver/pcnt.h>
+#include <esp_timer.h>
+
+#define NVS_NAMESPACE   "flow"
+#define FLOW_PCNT_UNIT  PCNT_UNIT_0
+
+// ==================== State Variables ====================
+static bool available = false;
+static volatile uint32_t counterWraps = 0;    // FLOW_PCNT_LIMIT folds, written by the ISR
+static uint64_t storedPulses = 0;             // Total of previous boots (NVS)
+static uint64_t lastPulses = 0;               // Last total read (monotonic guard)
+
+// Sliding rate window: total pulses and time of the last samples (ring)
+static uint64_t windowPulses[FLOW_RATE_WINDOW + 1];
+static uint64_t windowUs[FLOW_RATE_WINDOW + 1];
+static uint8_t windowNext = 0;
+static uint8_t windowCount = 0;
+static uint32_t lastSampleAt = 0;
+
+static float flowRate = NAN;
+static uint64_t savedPulses = 0;              // Total at the last NVS write
+static uint32_t lastSaveAt = 0;
+
+// ==================== Counter ====================
+
+/**
+ * High limit reached: the hardware cleared the counter, fold it into the total
+ */
+static void IRAM_ATTR onCounterLimit(void* arg) {
+  counterWraps++;
+}
+
+/**
+ * Pulses counted in this boot
+ * The wrap count is read around the counter so a fold in between is seen;
+ * a fold whose interrupt is still pending is handled by flowPulseTotal().
+ */
+static uint64_t countedPulses() {
+  uint32_t wraps;
+  int16_t count;
+  do {
+    wraps = counterWraps;
+    pcnt_get_counter_value(FLOW_PCNT_UNIT, &count);
+  } while (wraps != counterWraps);
+
+  lastPulses = flowPulseTotal(wraps, (uint16_t)count, lastPulses);
+  return lastPulses;
+}
+
+/**
+ * Store the lifetime pulse total in NVS
+ */
+static void saveTotal(uint64_t total) {
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putULong64("pulses", total);
+  prefs.end();
+  savedPulses = total;
+  lastSaveAt = millis();
+}
+
+// ==================== Public Functions ====================
+
+void initFlowMeter() {
+  if (FLOW_SENSOR_PIN < 0) {
+    Serial.println("[FLOW] No flow meter configured");
+    return;
+  }
+
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, true);
+  storedPulses = prefs.getULong64("pulses", 0);
+  prefs.end();
+  savedPulses = storedPulses;
+
+  // Rising edges only; the control input is not used
+  pcnt_config_t config = {};
+  config.pulse_gpio_num = FLOW_SENSOR_PIN;
+  config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+  config.lctrl_mode = PCNT_MODE_KEEP;
+  config.hctrl_mode = PCNT_MODE_KEEP;
+  config.pos_mode = PCNT_COUNT_INC;
+  config.neg_mode = PCNT_COUNT_DIS;
+  config.counter_h_lim = FLOW_PCNT_LIMIT;
+  config.counter_l_lim = 0;
+  config.unit = FLOW_PCNT_UNIT;
+  config.channel = PCNT_CHANNEL_0;
+
+  if (pcnt_unit_config(&config) != ESP_OK) {
+    Serial.println("[FLOW] PCNT unit config failed");
+    return;
+  }
+  // Open-collector hall sensors need a pull-up
+  pinMode(FLOW_SENSOR_PIN, INPUT_PULLUP);
+
+  pcnt_set_filter_value(FLOW_PCNT_UNIT, FLOW_GLITCH_FILTER);
+  pcnt_filter_enable(FLOW_PCNT_UNIT);
+  pcnt_event_enable(FLOW_PCNT_UNIT, PCNT_EVT_H_LIM);
+  pcnt_counter_pause(FLOW_PCNT_UNIT);
+  pcnt_counter_clear(FLOW_PCNT_UNIT);
+  pcnt_isr_service_install(0);
+  pcnt_isr_handler_add(FLOW_PCNT_UNIT, onCounterLimit, nullptr);
+  pcnt_counter_resume(FLOW_PCNT_UNIT);
+
+  available = true;
+  lastSampleAt = millis();
+  lastSaveAt = millis();
+
+  Serial.print("[FLOW] ✓ Flow meter on GPIO ");
+  Serial.print(FLOW_SENSOR_PIN);
+  Serial.print(" (PCNT), total ");
+  Serial.print(getFlowTotal() / 1000, 3);
+  Serial.println(" m3");
+}
+
+bool serviceFlowMeter() {
+  if (!available || millis() - lastSampleAt < FLOW_RATE_INTERVAL) return false;
+  lastSampleAt = millis();
+
+  uint64_t pulses = countedPulses();
+  uint64_t nowUs = esp_timer_get_time();
+
+  // Ring of FLOW_RATE_WINDOW + 1 samples: the rate spans the oldest to the newest
+  windowPulses[windowNext] = pulses;
+  windowUs[windowNext] = nowUs;
+  windowNext = (windowNext + 1) % (FLOW_RATE_WINDOW + 1);
+  if (windowCount < FLOW_RATE_WINDOW + 1) windowCount++;
+  if (windowCount < 2) return false;
+
+  uint8_t oldest = windowCount < FLOW_RATE_WINDOW + 1 ? 0 : windowNext;
+  float previousRate = flowRate;
+  flowRate = flowRateOf((uint32_t)(pulses - windowPulses[oldest]), nowUs - windowUs[oldest],
+                        FLOW_PULSES_PER_LITER);
+
+  // Persist while the water moves, and once when it stops
+  uint64_t total = storedPulses + pulses;
+  bool stopped = flowRate == 0 && previousRate > 0;
+  if (total != savedPulses && (stopped || millis() - lastSaveAt >= FLOW_SAVE_INTERVAL)) {
+    saveTotal(total);
+  }
+  return true;
+}
+
+bool isFlowMeterAvailable() {
+  return available;
+}
+
+float getFlowRate() {
+  return flowRate;
+}
+
+double getFlowTotal() {
+  if (!available) return storedPulses / (double)FLOW_PULSES_PER_LITER;
+  return (storedPulses + lastPulses) / (double)FLOW_PULSES_PER_LITER;
+}
+
+String getFlowJSON() {
+  String json = "{";
+  json += "\"rate_lpm\":" + (isnan(flowRate) ? String("null") : String(flowRate, 1)) + ",";
+  json += "\"total_m3\":" + String(getFlowTotal() / 1000, 3);
+  json += "}";
+  return json;
+}
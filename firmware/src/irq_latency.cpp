@@ -0,0 +1,72 @@
+/**
+ * @file irq_latency.cpp
+ * @brief Interrupt latency probe implementation
+ */
+
+#include "irq_latency.h"
+#include "config.h"
+
+#if IRQ_LATENCY_PROBE
+
+// ==================== State Variables ====================
+// Written by the ISR, read by the loop task (32-bit accesses are atomic)
+static hw_timer_t* probeTimer = nullptr;
+static volatile uint8_t currentTag = IRQ_TAG_IDLE;
+static volatile uint32_t sampleCount[IRQ_TAG_COUNT];
+static volatile uint32_t sampleTotalUs[IRQ_TAG_COUNT];
+static volatile uint32_t sampleMaxUs[IRQ_TAG_COUNT];
+
+// ==================== Timer ISR ====================
+
+/**
+ * Counter restarted at 0 on the alarm: its value now is the latency
+ */
+static void IRAM_ATTR onProbeTimer() {
+  uint32_t us = (uint32_t)timerRead(probeTimer);
+  uint8_t tag = currentTag;
+  sampleCount[tag]++;
+  sampleTotalUs[tag] += us;
+  if (us > sampleMaxUs[tag]) sampleMaxUs[tag] = us;
+}
+
+// ==================== Public Functions ====================
+
+void initIRQLatencyProbe() {
+  if (probeTimer) return;
+  // 80 MHz APB / 80 = 1 us per tick; allocated on the calling (loop) core
+  probeTimer = timerBegin(IRQ_LATENCY_TIMER, 80, true);
+  timerAttachInterrupt(probeTimer, onProbeTimer, true);
+  timerAlarmWrite(probeTimer, IRQ_LATENCY_PERIOD, true /*autoreload*/);
+  timerAlarmEnable(probeTimer);
+  Serial.println("[IRQ] Latency probe running");
+}
+
+void setIRQLatencyTag(IRQLatencyTag tag) {
+  currentTag = tag;
+}
+
+IRQLatencyStats getIRQLatencyStats(IRQLatencyTag tag) {
+  IRQLatencyStats stats = {0, 0, 0};
+  if (tag >= IRQ_TAG_COUNT) return stats;
+  stats.samples = sampleCount[tag];
+  stats.avgUs = stats.samples ? sampleTotalUs[tag] / stats.samples : 0;
+  stats.maxUs = sampleMaxUs[tag];
+  return stats;
+}
+
+void resetIRQLatencyStats() {
+  for (int i = 0; i < IRQ_TAG_COUNT; i++) {
+    sampleCount[i] = 0;
+    sampleTotalUs[i] = 0;
+    sampleMaxUs[i] = 0;
+  }
+}
+
+#else
+
+void initIRQLatencyProbe() {}
+void setIRQLatencyTag(IRQLatencyTag tag) {}
+IRQLatencyStats getIRQLatencyStats(IRQLatencyTag tag) { return {0, 0, 0}; }
+void resetIRQLatencyStats() {}
+
+#endif // IRQ_LATENCY_PROBE
@@ -0,0 +1,133 @@
+/**
+ * @file link_governor.cpp
+ * @brief Link-quality-aware telemetry governor implementation
+ */
+
+#include "link_governor.h"
+#include <WiFi.h>
+#include "lwip/stats.h"
+
+// ==================== State Variables ====================
+static LinkLevel linkLevel = LINK_GOOD;
+static uint32_t lastEval = 0;
+static uint8_t goodWindows = 0;         // Consecutive windows better than the current level
+static uint16_t publishFailures = 0;    // Failures in the running window
+static int lastWindowRetx = -1;
+static int lastWindowFailures = 0;
+
+#if LWIP_STATS && TCP_STATS
+static uint32_t lastRexmitCount = 0;
+#endif
+
+// ==================== Helpers ====================
+
+/**
+ * TCP retransmissions since the previous call
+ * @return -1 if lwIP statistics are not available
+ */
+static int sampleRetransmits() {
+#if LWIP_STATS && TCP_STATS
+  uint32_t count = lwip_stats.tcp.rexmit;
+  int delta = (int)(count - lastRexmitCount);
+  lastRexmitCount = count;
+  return delta;
+#else
+  return -1;
+#endif
+}
+
+/**
+ * Classify one evaluation window
+ */
+static LinkLevel classifyWindow(int rssi, int retx, int failures) {
+  if (rssi < LINK_RSSI_POOR || retx >= LINK_RETX_POOR || failures >= LINK_PUBFAIL_POOR) {
+    return LINK_POOR;
+  }
+  if (rssi < LINK_RSSI_DEGRADED || retx >= LINK_RETX_DEGRADED || failures >= LINK_PUBFAIL_DEGRADED) {
+    return LINK_DEGRADED;
+  }
+  return LINK_GOOD;
+}
+
+// ==================== Public Functions ====================
+
+bool updateLinkGovernor() {
+  uint32_t now = millis();
+  if (now - lastEval < LINK_EVAL_INTERVAL) return false;
+  lastEval = now;
+
+  if (WiFi.status() != WL_CONNECTED) {
+    publishFailures = 0;
+    return false;
+  }
+
+  int rssi = WiFi.RSSI();
+  lastWindowRetx = sampleRetransmits();
+  lastWindowFailures = publishFailures;
+  publishFailures = 0;
+
+  LinkLevel measured = classifyWindow(rssi, lastWindowRetx, lastWindowFailures);
+  LinkLevel previous = linkLevel;
+
+  if (measured > linkLevel) {
+    // Degrade immediately so the command path is protected right away
+    linkLevel = measured;
+    goodWindows = 0;
+  } else if (measured < linkLevel) {
+    // Recover one level at a time with hysteresis
+    if (++goodWindows >= LINK_RECOVER_WINDOWS) {
+      linkLevel = (LinkLevel)(linkLevel - 1);
+      goodWindows = 0;
+    }
+  } else {
+    goodWindows = 0;
+  }
+
+  if (linkLevel == previous) return false;
+
+  Serial.print("[LINK] ");
+  Serial.print(linkLevelName(previous));
+  Serial.print(" -> ");
+  Serial.print(linkLevelName(linkLevel));
+  Serial.print(" (rssi=");
+  Serial.print(rssi);
+  Serial.print(" retx=");
+  Serial.print(lastWindowRetx);
+  Serial.print(" pubfail=");
+  Serial.print(lastWindowFailures);
+  Serial.println(")");
+  return true;
+}
+
+void noteLinkPublish(bool ok, bool sessionUp) {
+  if (!ok && sessionUp && publishFailures < UINT16_MAX) publishFailures++;
+}
+
+LinkLevel getLinkLevel() {
+  return linkLevel;
+}
+
+const char* linkLevelName(LinkLevel level) {
+  switch (level) {
+    case LINK_GOOD:     return "good";
+    case LINK_DEGRADED: return "degraded";
+    case LINK_POOR:     return "poor";
+  }
+  return "unknown";
+}
+
+uint32_t getLinkIntervalScale() {
+  return 1UL << linkLevel;
+}
+
+bool isLinkBatching() {
+  return linkLevel != LINK_GOOD;
+}
+
+int getLinkRetransmits() {
+  return lastWindowRetx;
+}
+
+int getLinkPublishFailures() {
+  return lastWindowFailures;
+}
@@ -2,18 +2,29 @@
 
 #include <WiFi.h>              // ESP32 WiFi
 #include <WiFiClientSecure.h>  // TLS Client (HTTPS/MQTTS)
-#include <WiFiManager.h>       // WiFiManager for captive portal provisioning (fallback)
 #include <PubSubClient.h>      // MQTT client (uses a Client underneath)
 #include <time.h>              // For NTP (system time)
-#include <OneWire.h>           // OneWire protocol for DS18B20
-#include <DallasTemperature.h> // DS18B20 temperature sensor library
 #include <Preferences.h>       // NVS storage for WiFi credentials
+#include <esp_coexist.h>       // WiFi/BLE radio coexistence preference
 
 // =================== Project Includes ====================
 #include "config.h"    // host/ports/topics/device_id (NO secrets)
 #include "secrets.h"   // wifi and mqtt user/pass (SECRET)
 #include "ca_cert.h"   // Root CA certificate (public)
 #include "ble_provisioning.h"  // BLE provisioning for WiFi credentials
+#include "ble_control.h"       // Local control/telemetry GATT service
+#include "power_profile.h"     // WiFi modem power-save profiles
+#include "link_governor.h"     // Link-quality-aware telemetry throttling
+#include "captive_portal.h"    // Non-blocking SoftAP portal (provisioning fallback)
+#include "wifi_scan.h"         // Asynchronous WiFi scan cache (BLE + portal)
+#include "network_settings.h"  // Static IP / broker / hostname from provisioning
+#include "temperature.h"       // Non-blocking DS18B20 conversions
+#include "irq_latency.h"       // Interrupt latency probe (diagnostics)
+#include "analog_sensors.h"    // pH / ORP / pressure DMA acquisition
+#include "pump_monitor.h"      // Pump current, protection and energy
+#include "sensor_stats.h"      // Windowed min/max/mean per sensor
+#include "flow_meter.h"        // PCNT flow meter (rate and total volume)
+#include "vsd_pump.h"          // Variable-speed pump drive (Modbus RTU)
 
 // ==================== Timing Constants ====================
 #define VALVE_SWITCH_DELAY      500       // Delay for valve switching (ms)
@@ -24,16 +35,62 @@
 #define NTP_SYNC_TIMEOUT        15000     // Timeout for NTP synchronization (ms)
 #define WIFI_STATE_INTERVAL     30000     // Interval to publish WiFi state (ms)
 #define TIMER_PUBLISH_INTERVAL  10000     // Interval to publish timer state (ms)
-#define TEMP_PUBLISH_INTERVAL   60000     // Interval to publish temperature (ms) - 1 minute
-#define BLE_CHECK_INTERVAL      1000      // Check for BLE credentials every 1 second
+#define TEMP_PUBLISH_INTERVAL   60000     // Telemetry batch clock on a degraded link (ms) - 1 minute
+#define PUMP_POWER_INTERVAL     30000     // Interval to publish pump power while it runs (ms)
+#define MQTT_RECONNECT_INTERVAL 5000      // Minimum time between MQTT reconnect attempts (ms)
+#define BUTTON_DEBOUNCE         50        // BOOT button debounce time (ms)
+
+// ==================== Buffer Sizes ====================
+#define MQTT_BUFFER_SIZE        512       // MQTT packet buffer (PubSubClient default is 256)
+#define MQTT_BUFFER_SIZE_LARGE  2048      // Once the Bluetooth memory is released
 #define MIN_VALID_EPOCH         1700000000L // Minimum valid epoch for NTP (Nov 2023)
 
 // ==================== Hardware State ====================
 static bool pumpState = false;     // Logical pump state (ON/OFF)
 static int valveMode = 1;          // Valve mode: 1 or 2
-static float currentTemperature = 0.0; // Current temperature in °C
+static float currentTemperature = NAN; // Current temperature in °C (NAN until the first reading)
+static float publishedTemperature = NAN; // Value of the last temperature report
+static uint32_t lastTempPublish = 0;     // millis() of the last temperature report
+static uint32_t lastSensorsPublish = 0;  // millis() of the last analog sensors report
+static uint32_t lastPumpPowerPublish = 0; // millis() of the last pump power report
+static float publishedFlow = NAN;         // Flow rate of the last flow report
+static uint32_t lastFlowPublish = 0;      // millis() of the last flow report
+static uint32_t lastPumpSpeedPublish = 0; // millis() of the last drive report
+
+// ==================== Sensor Statistics ====================
+static int8_t statsProbe[TEMP_MAX_PROBES];        // Stats id of each temperature probe
+static int8_t statsAnalog[ANALOG_SENSOR_COUNT];   // Stats id of each analog sensor
+static int8_t statsPumpCurrent = -1;
+static int8_t statsPumpPower = -1;
+static int8_t statsFlow = -1;
+static int8_t statsPumpSpeed = -1;
 static bool wifiProvisioned = false;   // Flag to track if provisioning completed
 
+// ==================== WiFi Recovery State ====================
+static bool cloudReady = false;        // NTP synced once and MQTT client configured
+static bool wifiWasConnected = false;  // Link state seen by the previous loop()
+static uint32_t wifiLostAt = 0;        // millis() when the link dropped (0 = boot)
+static uint32_t lastRecoveryMs = 0;    // Duration of the last outage
+static bool reconnectPending = false;  // WiFi.begin() issued, waiting for association
+static uint32_t reconnectStartedAt = 0;
+static uint32_t lastReconnectAttempt = 0;
+static int reconnectAttempts = 0;
+static NetworkSettings networkSettings;  // Stored optional settings (MQTT host must outlive setServer)
+static bool cloudStarting = false;     // initCloud() called, waiting for NTP before MQTT
+static uint32_t timeSyncStartedAt = 0;
+
+// ==================== Provisioning State ====================
+// Credentials from BLE or the portal, tried without blocking loop()
+static bool provisionPending = false;      // Credentials waiting to be tried
+static bool provisionAssociating = false;  // WiFi.begin() issued for them
+static uint8_t provisionAttempt = 0;
+static uint32_t provisionStartedAt = 0;    // millis() the credentials arrived
+static uint32_t provisionAttemptAt = 0;    // millis() of the last attempt (start or timeout)
+static char provisionSSID[33];
+static char provisionPassword[64];
+static bool provisionHasSettings = false;
+static NetworkSettings provisionSettings;
+
 // ==================== Timer State ====================
 static bool timerActive = false;   // Timer is running
 static int timerMode = 1;          // Timer mode (1=Cascada, 2=Eyectores)
@@ -41,10 +98,11 @@ static uint32_t timerDuration = 0; // Total timer duration in seconds
 static uint32_t timerRemaining = 0; // Remaining time in seconds
 static uint32_t timerLastUpdate = 0; // Last millis() for countdown
 
-// ==================== Temperature Sensor ====================
-// Setup OneWire on GPIO 21
-OneWire oneWire(TEMP_SENSOR_PIN);
-DallasTemperature tempSensor(&oneWire);
+// ==================== Loop Timing ====================
+// Duration of loop() iterations since the last WiFi state publish
+static uint32_t loopCount = 0;
+static uint64_t loopTotalUs = 0;
+static uint32_t loopMaxUs = 0;
 
 // ==================== MQTT/TLS ====================
 // TLS Client (used to connect to a server with certificate)
@@ -72,27 +130,46 @@ String payloadToString(const byte* payload, unsigned int length) {
   return s;
 }
 
-// ==================== Temperature Sensor ====================
+/**
+ * Pauses BLE advertising for the lifetime of the object (blocking WiFi work)
+ */
+struct AdvertisingPause {
+  AdvertisingPause() { pauseBLEAdvertising(); }
+  ~AdvertisingPause() { resumeBLEAdvertising(); }
+};
 
 /**
- * Reads temperature from DS18B20 sensor
- * @return Temperature in Celsius degrees, or NAN if error
+ * BOOT button: a press brings back fast BLE advertising so a phone next to
+ * the device finds it right away (call every loop)
  */
-float readTemperature() {
-  tempSensor.requestTemperatures();
-  float temp = tempSensor.getTempCByIndex(0);
-  
-  Serial.print("[SENSOR] Temperature: ");
-  if (temp == DEVICE_DISCONNECTED_C) {
-    Serial.println("ERROR - sensor desconectado");
-    return NAN;
+void serviceBootButton() {
+  static bool pressed = false;
+  static uint32_t lastChange = 0;
+  bool down = digitalRead(BOOT_BUTTON_PIN) == LOW;
+  if (down == pressed || millis() - lastChange < BUTTON_DEBOUNCE) return;
+  
+  pressed = down;
+  lastChange = millis();
+  if (pressed) {
+    Serial.println("[BUTTON] Pressed - fast BLE advertising");
+    boostBLEAdvertising();
   }
-  Serial.print(temp);
-  Serial.println(" °C");
-  
-  return temp;
 }
 
+/**
+ * Measures one loop() iteration, whatever return path it takes
+ */
+struct LoopTimer {
+  uint32_t start;
+  LoopTimer() : start(micros()) {}
+  ~LoopTimer() {
+    uint32_t us = micros() - start;
+    loopCount++;
+    loopTotalUs += us;
+    if (us > loopMaxUs) loopMaxUs = us;
+  }
+};
+
 // ==================== MQTT State Publishing ====================
 
 /**
@@ -101,7 +178,9 @@ float readTemperature() {
  */
 void publishPumpState() {
   const char* msg = pumpState ? "ON" : "OFF";
+  notifyBLEControl(BLE_CONTROL_PUMP, msg);
   bool ok = mqtt.publish(TOPIC_PUMP_STATE, msg, true /*retain*/);
+  noteLinkPublish(ok, mqtt.connected());
   
   Serial.print("[MQTT] publish ");
   Serial.print(TOPIC_PUMP_STATE);
@@ -110,6 +189,45 @@ void publishPumpState() {
   Serial.println(ok ? " OK" : " FAIL");
 }
 
+/**
+ * Publishes pump electrical state, energy counter and alarm (JSON)
+ * Only with a current transformer installed
+ */
+void publishPumpPower() {
+  lastPumpPowerPublish = millis();
+  if (!isPumpMonitorAvailable() || !mqtt.connected()) return;
+  
+  String json = getPumpPowerJSON();
+  bool ok = mqtt.publish(TOPIC_PUMP_POWER, json.c_str(), true /*retain*/);
+  noteLinkPublish(ok, mqtt.connected());
+  
+  Serial.print("[MQTT] publish ");
+  Serial.print(TOPIC_PUMP_POWER);
+  Serial.print(" = ");
+  Serial.print(json);
+  Serial.println(ok ? " OK" : " FAIL");
+}
+
+/**
+ * Publishes the variable-speed drive state (JSON)
+ * Only with a Modbus drive configured
+ */
+void publishPumpSpeed() {
+  markVsdPumpPublished();
+  lastPumpSpeedPublish = millis();
+  if (!isVsdPumpAvailable() || !mqtt.connected()) return;
+  
+  String json = getVsdPumpJSON();
+  bool ok = mqtt.publish(TOPIC_PUMP_SPEED_STATE, json.c_str(), true /*retain*/);
+  noteLinkPublish(ok, mqtt.connected());
+  
+  Serial.print("[MQTT] publish ");
+  Serial.print(TOPIC_PUMP_SPEED_STATE);
+  Serial.print(" = ");
+  Serial.print(json);
+  Serial.println(ok ? " OK" : " FAIL");
+}
+
 /**
  * Publishes current valve state to MQTT topic
  * Sends "1" or "2" depending on active mode
@@ -119,8 +237,11 @@ void publishValveState() {
   msg[0] = '0' + valveMode;  // Convert 1 or 2 to "1" or "2"
   msg[1] = '\0';
   
+  notifyBLEControl(BLE_CONTROL_VALVE, msg);
   bool ok = mqtt.publish(TOPIC_VALVE_STATE, msg, true /*retain*/);
   
+  noteLinkPublish(ok, mqtt.connected());
+  
   Serial.print("[MQTT] publish ");
   Serial.print(TOPIC_VALVE_STATE);
   Serial.print(" = ");
@@ -130,7 +251,9 @@ void publishValveState() {
 
 /**
  * Publishes complete WiFi state in JSON format
- * Includes: status, SSID, IP, RSSI (signal), quality
+ * Includes: status, SSID, IP, RSSI (signal), quality, link governor level
+ * (good/degraded/poor), TCP retransmits and failed publishes of the last window,
+ * and the duration of the last WiFi outage (recovery_ms, 0 if none yet)
  * Quality is determined based on RSSI:
  * - excellent: >= -50 dBm
  * - good: >= -60 dBm
@@ -158,11 +281,26 @@ void publishWiFiState() {
   json += "\"ssid\":\"" + WiFi.SSID() + "\",";
   json += "\"ip\":\"" + WiFi.localIP().toString() + "\",";
   json += "\"rssi\":" + String(rssi) + ",";
-  json += "\"quality\":\"" + quality + "\"";
+  json += "\"quality\":\"" + quality + "\",";
+  json += "\"link\":\"" + String(linkLevelName(getLinkLevel())) + "\",";
+  json += "\"retx\":" + String(getLinkRetransmits()) + ",";
+  json += "\"pub_fail\":" + String(getLinkPublishFailures()) + ",";
+  json += "\"recovery_ms\":" + String(lastRecoveryMs) + ",";
+  json += "\"heap\":" + String(ESP.getFreeHeap()) + ",";
+  json += "\"bt_released\":" + String(isBLEReleased() ? "true" : "false") + ",";
+  json += "\"loop_avg_us\":" + String(loopCount ? (uint32_t)(loopTotalUs / loopCount) : 0) + ",";
+  json += "\"loop_max_us\":" + String(loopMaxUs);
   json += "}";
   
+  // Loop timing is reported per publish window
+  loopCount = 0;
+  loopTotalUs = 0;
+  loopMaxUs = 0;
+  
   bool ok = mqtt.publish(TOPIC_WIFI_STATE, json.c_str(), true /*retain*/);
   
+  noteLinkPublish(ok, mqtt.connected());
+  
   Serial.print("[MQTT] publish ");
   Serial.print(TOPIC_WIFI_STATE);
   Serial.print(" = ");
@@ -171,19 +309,30 @@ void publishWiFiState() {
 }
 
 /**
- * Publishes timer state in JSON format
+ * Timer state in JSON format
  * Includes: active (bool), remaining (seconds), mode (1 or 2), duration (total seconds)
  */
-void publishTimerState() {
+String timerStateJSON() {
   String json = "{";
   json += "\"active\":" + String(timerActive ? "true" : "false") + ",";
   json += "\"remaining\":" + String(timerRemaining) + ",";
   json += "\"mode\":" + String(timerMode) + ",";
   json += "\"duration\":" + String(timerDuration);
   json += "}";
+  return json;
+}
+
+/**
+ * Publishes timer state in JSON format (see timerStateJSON())
+ */
+void publishTimerState() {
+  String json = timerStateJSON();
   
+  notifyBLEControl(BLE_CONTROL_TIMER, json.c_str());
   bool ok = mqtt.publish(TOPIC_TIMER_STATE, json.c_str(), true /*retain*/);
   
+  noteLinkPublish(ok, mqtt.connected());
+  
   Serial.print("[MQTT] publish ");
   Serial.print(TOPIC_TIMER_STATE);
   Serial.print(" = ");
@@ -192,10 +341,14 @@ void publishTimerState() {
 }
 
 /**
- * Publishes current temperature to MQTT topic
- * Format: decimal number with 1 decimal place (e.g., "25.3")
+ * Publishes current (filtered) temperature to MQTT topics
+ * TOPIC_TEMP_STATE: primary (water) probe, 1 decimal place (e.g., "25.3")
+ * TOPIC_TEMP_PROBES: every probe in one batched JSON payload
  */
 void publishTemperature() {
+  publishedTemperature = currentTemperature;
+  lastTempPublish = millis();
+  
   if (isnan(currentTemperature)) {
     Serial.println("[MQTT] Skip temperature publish - invalid reading");
     return;
@@ -204,13 +357,171 @@ void publishTemperature() {
   char tempStr[8];
   dtostrf(currentTemperature, 4, 1, tempStr); // Format: "XX.X"
   
+  notifyBLEControl(BLE_CONTROL_TEMPERATURE, tempStr);
+  if (!mqtt.connected()) return;
+  
   bool ok = mqtt.publish(TOPIC_TEMP_STATE, tempStr, true);
   
+  noteLinkPublish(ok, mqtt.connected());
+  
   Serial.print("[MQTT] publish ");
   Serial.print(TOPIC_TEMP_STATE);
   Serial.print(" = ");
   Serial.print(tempStr);
   Serial.println(ok ? " OK" : " FAIL");
+  
+  // All probes in one message (one radio burst however many probes)
+  if (getTemperatureProbeCount() > 1) {
+    String json = getTemperatureJSON();
+    ok = mqtt.publish(TOPIC_TEMP_PROBES, json.c_str(), true);
+    noteLinkPublish(ok, mqtt.connected());
+    
+    Serial.print("[MQTT] publish ");
+    Serial.print(TOPIC_TEMP_PROBES);
+    Serial.print(" = ");
+    Serial.print(json);
+    Serial.println(ok ? " OK" : " FAIL");
+  }
+}
+
+/**
+ * Publishes the calibrated analog sensors (pH, ORP, pressure) to MQTT
+ * TOPIC_SENSORS_STATE: one JSON payload, e.g. {"ph":7.21,"orp":652,"pressure":1.18}
+ */
+void publishAnalogSensors() {
+  markAnalogSensorsPublished();
+  lastSensorsPublish = millis();
+  
+  String json = getAnalogSensorsJSON();
+  if (json == "{}" || !mqtt.connected()) return;  // No sensor installed
+  
+  bool ok = mqtt.publish(TOPIC_SENSORS_STATE, json.c_str(), true);
+  
+  noteLinkPublish(ok, mqtt.connected());
+  
+  Serial.print("[MQTT] publish ");
+  Serial.print(TOPIC_SENSORS_STATE);
+  Serial.print(" = ");
+  Serial.print(json);
+  Serial.println(ok ? " OK" : " FAIL");
+}
+
+/**
+ * Publishes the flow rate and total filtered volume to MQTT
+ * TOPIC_FLOW_STATE: JSON, e.g. {"rate_lpm":152.3,"total_m3":1234.567}
+ */
+void publishFlow() {
+  publishedFlow = getFlowRate();
+  lastFlowPublish = millis();
+  
+  if (!isFlowMeterAvailable() || !mqtt.connected()) return;
+  
+  String json = getFlowJSON();
+  bool ok = mqtt.publish(TOPIC_FLOW_STATE, json.c_str(), true);
+  
+  noteLinkPublish(ok, mqtt.connected());
+  
+  Serial.print("[MQTT] publish ");
+  Serial.print(TOPIC_FLOW_STATE);
+  Serial.print(" = ");
+  Serial.print(json);
+  Serial.println(ok ? " OK" : " FAIL");
+}
+
+/**
+ * Publishes windowed statistics on request (one message per sensor keeps
+ * each payload within the MQTT buffer)
+ * @param sensor Sensor name, or "ALL"/"" for every sensor
+ */
+void publishSensorStats(const String& sensor) {
+  bool all = sensor.length() == 0 || sensor == "ALL";
+  int8_t only = all ? -1 : findStatsSensor(sensor.c_str());
+  if (!all && only < 0) {
+    Serial.print("[MQTT] Unknown stats sensor: ");
+    Serial.println(sensor);
+    return;
+  }
+  if (!mqtt.connected()) return;
+  
+  for (uint8_t i = 0; i < getStatsSensorCount(); i++) {
+    if (!all && i != only) continue;
+    String json = getSensorStatsJSON(i);
+    bool ok = mqtt.publish(TOPIC_STATS_STATE, json.c_str());
+    noteLinkPublish(ok, mqtt.connected());
+    
+    Serial.print("[MQTT] publish ");
+    Serial.print(TOPIC_STATS_STATE);
+    Serial.print(" = ");
+    Serial.print(json);
+    Serial.println(ok ? " OK" : " FAIL");
+  }
+}
+
+/**
+ * Registers every installed sensor for windowed statistics
+ * Probe labels are shared by pointer, so a renamed probe keeps its history.
+ */
+void initSensorStats() {
+  for (uint8_t i = 0; i < TEMP_MAX_PROBES; i++) {
+    statsProbe[i] = i < getTemperatureProbeCount() ? registerStatsSensor(getProbeLabel(i), TEMP_DEADBAND) : -1;
+  }
+  const float analogDeadband[ANALOG_SENSOR_COUNT] = {PH_DEADBAND, ORP_DEADBAND, PRESSURE_DEADBAND};
+  for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+    AnalogSensor sensor = (AnalogSensor)i;
+    statsAnalog[i] = isAnalogSensorInstalled(sensor) ? registerStatsSensor(getAnalogName(sensor), analogDeadband[i]) : -1;
+  }
+  if (isPumpMonitorAvailable()) {
+    statsPumpCurrent = registerStatsSensor("pump_current", 0.1);
+    statsPumpPower = registerStatsSensor("pump_power", 20);
+  }
+  if (isFlowMeterAvailable()) {
+    statsFlow = registerStatsSensor("flow", FLOW_DEADBAND);
+  }
+  if (isVsdPumpAvailable()) {
+    statsPumpSpeed = registerStatsSensor("pump_speed", VSD_SPEED_DEADBAND);
+  }
+  
+  Serial.print("[STATS] Windowed statistics for ");
+  Serial.print(getStatsSensorCount());
+  Serial.println(" sensors");
+}
+
+/**
+ * Publishes active power profile and benchmark results in JSON format
+ * Includes: profile, and per-profile loopback latency (min/avg/max ms, lost probes)
+ * when a benchmark was run in this boot
+ */
+void publishPowerState() {
+  String json = "{";
+  json += "\"profile\":\"" + String(powerProfileName(getPowerProfile())) + "\"";
+  json += ",\"power_save\":\"" + String(getEffectivePowerSave()) + "\"";
+  json += ",\"bench_running\":" + String(isPowerBenchRunning() ? "true" : "false");
+  json += ",\"bench\":{";
+  bool first = true;
+  for (int i = 0; i < POWER_PROFILE_COUNT; i++) {
+    const PowerBenchResult* r = getPowerBenchResult((PowerProfile)i);
+    if (!r) continue;
+    if (!first) json += ",";
+    first = false;
+    json += "\"" + String(powerProfileName((PowerProfile)i)) + "\":{";
+    json += "\"samples\":" + String(r->samples) + ",";
+    json += "\"lost\":" + String(r->lost) + ",";
+    json += "\"min_ms\":" + String(r->minMs) + ",";
+    json += "\"avg_ms\":" + String(r->avgMs) + ",";
+    json += "\"max_ms\":" + String(r->maxMs);
+    json += "}";
+  }
+  json += "}}";
+
+  bool ok = mqtt.publish(TOPIC_POWER_STATE, json.c_str(), true /*retain*/);
+
+  noteLinkPublish(ok, mqtt.connected());
+
+  Serial.print("[MQTT] publish ");
+  Serial.print(TOPIC_POWER_STATE);
+  Serial.print(" = ");
+  Serial.print(json);
+  Serial.println(ok ? " OK" : " FAIL");
 }
 
 // ==================== Relay Control ====================
@@ -225,6 +536,8 @@ void setPumpRelay(bool targetState) {
   
   digitalWrite(PUMP_RELAY_PIN, targetState ? HIGH : LOW);
   pumpState = targetState;
+  setPumpMonitorRunning(targetState);
+  setVsdRunning(targetState);
 }
 
 /**
@@ -370,8 +683,10 @@ void updateTimer() {
       timerRemaining--;
       
       // Publish state every 10 seconds or when little time remains
+      // (stretched by the link governor on a poor link)
       static uint32_t lastPublish = 0;
-      if (timerRemaining % 10 == 0 || timerRemaining <= 10 || (now - lastPublish) > TIMER_PUBLISH_INTERVAL) {
+      uint32_t scale = getLinkIntervalScale();
+      if (timerRemaining % (10 * scale) == 0 || timerRemaining <= 10 || (now - lastPublish) > TIMER_PUBLISH_INTERVAL * scale) {
         lastPublish = now;
         publishTimerState();
       }
@@ -392,28 +707,25 @@ void updateTimer() {
   }
 }
 
-// ==================== MQTT Message Handler ====================
+// ==================== Command Handlers ====================
 
 /**
- * Callback invoked when MQTT message arrives
- * Handles 3 types of commands:
+ * Runs a command addressed to a command topic
+ * Shared by MQTT (onMqttMessage) and local BLE control (onBLEControl).
+ * Handles these commands:
  * 1. Pump (TOPIC_PUMP_SET): ON/OFF/TOGGLE
  * 2. Valves (TOPIC_VALVE_SET): 1/2/TOGGLE
  * 3. Timer (TOPIC_TIMER_SET): JSON with {mode, duration}
- * @param topic Topic of received message
- * @param payload Message content (bytes)
- * @param length Payload length
+ * 4. WiFi clear (TOPIC_WIFI_CLEAR)
+ * 5. Power profile (TOPIC_POWER_SET): PERFORMANCE/BALANCED/ECO/BENCH
+ * 6. Temperature probe label (TOPIC_TEMP_LABEL): <ROM or label>=<new label>
+ * 7. Analog sensor calibration (TOPIC_SENSORS_CAL): <sensor>=<reference value>/RESET
+ * 8. Statistics request (TOPIC_STATS_GET): ALL or a sensor name
+ * 9. Pump speed (TOPIC_PUMP_SPEED_SET): setpoint in rpm
+ * @param t Command topic
+ * @param msg Command payload, upper case
  */
-void onMqttMessage(char* topic, byte* payload, unsigned int length) {
-  String t = String(topic);
-  String msg = payloadToString(payload, length);
-  msg.toUpperCase();
-
-  Serial.print("[MQTT] RX ");
-  Serial.print(t);
-  Serial.print(" : ");
-  Serial.println(msg);
-
+void handleCommand(const String& t, const String& msg) {
   // ===== Pump Control =====
   if (t == TOPIC_PUMP_SET) {
     if (msg == "ON" || msg == "1") {
@@ -506,6 +818,122 @@ void onMqttMessage(char* topic, byte* payload, unsigned int length) {
     ESP.restart();
     return;
   }
+
+  // ===== Power Profile =====
+  if (t == TOPIC_POWER_SET) {
+    PowerProfile profile;
+    if (msg == "BENCH") {
+      // Measure command latency of the active profile (loopback through broker)
+      startPowerBench();
+    } else if (parsePowerProfile(msg, &profile)) {
+      applyPowerProfile(profile);
+    } else {
+      Serial.println("[MQTT] Unknown power command. Use: PERFORMANCE/BALANCED/ECO/BENCH");
+      return;
+    }
+    publishPowerState();
+    return;
+  }
+
+  // ===== Temperature Probe Label =====
+  if (t == TOPIC_TEMP_LABEL) {
+    int separator = msg.indexOf('=');
+    if (separator <= 0 ||
+        !setProbeLabel(msg.substring(0, separator).c_str(), msg.substring(separator + 1).c_str())) {
+      Serial.println("[MQTT] Invalid probe label. Use: <ROM or label>=<new label> ([a-z0-9_-], max 15)");
+      return;
+    }
+    publishTemperature();
+    return;
+  }
+
+  // ===== Analog Sensor Calibration =====
+  if (t == TOPIC_SENSORS_CAL) {
+    int separator = msg.indexOf('=');
+    if (separator <= 0 ||
+        !calibrateAnalogSensor(msg.substring(0, separator).c_str(), msg.substring(separator + 1).c_str())) {
+      Serial.println("[MQTT] Invalid calibration. Use: <PH/ORP/PRESSURE>=<reference value> or <sensor>=RESET");
+      return;
+    }
+    publishAnalogSensors();
+    return;
+  }
+
+  // ===== Statistics Request =====
+  if (t == TOPIC_STATS_GET) {
+    publishSensorStats(msg);
+    return;
+  }
+
+  // ===== Variable-Speed Pump Setpoint =====
+  if (t == TOPIC_PUMP_SPEED_SET) {
+    long rpm = msg.toInt();
+    if (rpm <= 0 || rpm > UINT16_MAX || !setVsdSpeed((uint16_t)rpm)) {
+      Serial.print("[MQTT] Invalid pump speed. Use: rpm between ");
+      Serial.print(VSD_MIN_RPM);
+      Serial.print(" and ");
+      Serial.print(VSD_MAX_RPM);
+      Serial.println(isVsdPumpAvailable() ? "" : " (no drive configured)");
+      return;
+    }
+    publishPumpSpeed();
+    return;
+  }
+
+  // ===== Power Benchmark Probe (our own loopback) =====
+  if (t == TOPIC_POWER_PROBE) {
+    onPowerBenchEcho((uint16_t)msg.toInt());
+    return;
+  }
+}
+
+// ==================== MQTT Message Handler ====================
+
+/**
+ * Callback invoked when MQTT message arrives
+ * @param topic Topic of received message
+ * @param payload Message content (bytes)
+ * @param length Payload length
+ */
+void onMqttMessage(char* topic, byte* payload, unsigned int length) {
+  String t = String(topic);
+  String msg = payloadToString(payload, length);
+  msg.toUpperCase();
+
+  Serial.print("[MQTT] RX ");
+  Serial.print(t);
+  Serial.print(" : ");
+  Serial.println(msg);
+
+  handleCommand(t, msg);
+}
+
+// ==================== Local BLE Control Handler ====================
+
+/**
+ * Callback invoked (from loop) for a write on the local control service
+ * Maps the characteristic to its MQTT command topic so both paths share
+ * handleCommand()
+ * @param channel Resource written
+ * @param payload Written value
+ */
+void onBLEControl(BLEControlChannel channel, const char* payload) {
+  String msg = String(payload);
+  msg.toUpperCase();
+
+  Serial.print("[BLE-CTRL] RX ");
+  Serial.print(channel);
+  Serial.print(" : ");
+  Serial.println(msg);
+
+  switch (channel) {
+    case BLE_CONTROL_PUMP:  handleCommand(TOPIC_PUMP_SET, msg); break;
+    case BLE_CONTROL_VALVE: handleCommand(TOPIC_VALVE_SET, msg); break;
+    case BLE_CONTROL_TIMER: handleCommand(TOPIC_TIMER_SET, msg); break;
+    default:
+      Serial.println("[BLE-CTRL] Resource is read-only");
+      break;
+  }
 }
 
 
@@ -582,6 +1010,9 @@ bool connectWiFi(const char* ssid, const char* password, int retryAttempts = WIF
   Serial.print("[WiFi] Connecting to: ");
   Serial.println(ssid);
   
+  // Association gets the radio to itself
+  AdvertisingPause advertisingPause;
+  
   for (int attempt = 1; attempt <= retryAttempts; attempt++) {
     if (attempt > 1) {
       Serial.print("[WiFi] Retry attempt ");
@@ -602,7 +1033,9 @@ bool connectWiFi(const char* ssid, const char* password, int retryAttempts = WIF
     Serial.println();
     
     if (WiFi.status() == WL_CONNECTED) {
-      Serial.println("[WiFi] ✓ CONNECTED");
+      Serial.print("[WiFi] ✓ CONNECTED in ");
+      Serial.print(millis() - startTime);
+      Serial.println(" ms (BLE advertising paused)");
       Serial.print("[WiFi] SSID: ");
       Serial.println(WiFi.SSID());
       Serial.print("[WiFi] IP: ");
@@ -611,6 +1044,7 @@ bool connectWiFi(const char* ssid, const char* password, int retryAttempts = WIF
       Serial.print(WiFi.RSSI());
       Serial.println(" dBm");
       wifiProvisioned = true;
+      onPowerProfileAssociated();
       return true;
     }
     
@@ -628,39 +1062,27 @@ bool connectWiFi(const char* ssid, const char* password, int retryAttempts = WIF
 }
 
 /**
- * Callback for when WiFiManager connects successfully
+ * Start all provisioning channels
+ * BLE (Web Bluetooth dashboard) and the SoftAP captive portal (any browser,
+ * e.g. iOS) run side by side; both are serviced from loop() without blocking
  */
-void onWiFiConnect() {
-  Serial.println("[WiFi] ✓ CONNECTED via WiFiManager");
-  Serial.print("[WiFi] SSID: ");
-  Serial.println(WiFi.SSID());
-  Serial.print("[WiFi] IP: ");
-  Serial.println(WiFi.localIP());
-  Serial.print("[WiFi] RSSI: ");
-  Serial.print(WiFi.RSSI());
-  Serial.println(" dBm");
-  wifiProvisioned = true;
-}
-
-/**
- * Callback for when WiFiManager enters AP mode (provisioning)
- */
-void onWiFiAPStart(WiFiManager* wm) {
-  Serial.println("[WiFi] AP mode started - Captive Portal active");
-  Serial.print("[WiFi] Connect to: ");
-  Serial.println(wm->getConfigPortalSSID());
-  Serial.println("[WiFi] Open your browser at: http://192.168.4.1");
+void startProvisioning() {
+  initBLEProvisioning();
+  startCaptivePortal();
+  
+  // Pre-warm the scan cache so the first "scan" tap is answered instantly
+  requestWiFiScan();
 }
 
 /**
- * Initialize WiFi with BLE Provisioning (primary) + WiFiManager fallback
+ * Initialize WiFi with BLE Provisioning + captive portal fallback
  * 
  * Provisioning flow:
  * 1. Try to load WiFi credentials from NVS
  * 2. If credentials exist, connect to WiFi with multiple retry attempts
- * 3. If connection fails after retries, start BLE provisioning (keeps credentials for auto-retry)
- * 4. If no credentials, start BLE provisioning
- * 5. Wait for credentials from Web Bluetooth dashboard
+ * 3. If connection fails after retries, start provisioning (keeps credentials for auto-retry)
+ * 4. If no credentials, start provisioning
+ * 5. Wait for credentials from Web Bluetooth dashboard or captive portal
  * 
  * @return true if connected to WiFi, false if provisioning is in progress
  */
@@ -689,85 +1111,46 @@ bool initWiFiProvisioning() {
     Serial.println("[WiFi] Keeping credentials for auto-retry. Use BLE/MQTT to update if needed.");
   }
   
-  // Step 3: No credentials or connection failed - start BLE provisioning
-  Serial.println("[WiFi] Starting BLE provisioning (credentials preserved for retry)...");
-  initBLEProvisioning();
+  // Step 3: No credentials or connection failed - start BLE + portal provisioning
+  Serial.println("[WiFi] Starting provisioning (credentials preserved for retry)...");
+  startProvisioning();
   
-  // BLE provisioning is non-blocking - credentials will be received in loop()
+  // Provisioning is non-blocking - credentials will be received in loop()
   return false;
 }
 
-/**
- * Fallback: Use WiFiManager captive portal if BLE provisioning fails
- * This provides backwards compatibility and alternative provisioning method
- * @return true if connected to WiFi, false if failed
- */
-bool initWiFiManagerFallback() {
-  Serial.println("[WiFi] Starting WiFiManager fallback...");
-  
-  // Create WiFiManager instance
-  WiFiManager wm;
-  
-  // Configure callbacks
-  wm.setAPCallback(onWiFiAPStart);
-  
-  // Configure portal (3 minute timeout, auto-reset on failure)
-  wm.setConfigPortalTimeout(180);  // 3 minutes
-  
-  // Enable specific features for better captive portal
-  wm.setWebServerCallback([]() {
-    Serial.println("[WiFi] Web server started at 192.168.4.1");
-  });
-  
-  // Auto-connect with saved credentials
-  // If no credentials, opens captive portal
-  bool connected = wm.autoConnect("ESP32-Pool-Setup", "");
-  
-  if (!connected) {
-    Serial.println("[WiFi] TIMEOUT: No credentials entered in portal");
-    // ESP32 will restart automatically after timeout
-    return false;
-  }
-  
-  // Save credentials to NVS for next boot
-  saveWiFiCredentials(WiFi.SSID().c_str(), WiFi.psk().c_str());
-  
-  // Callback manual para cuando se conecta
-  onWiFiConnect();
-  
-  return true;
-}
-
 // ==================== NTP Time Synchronization ====================
 
 /**
- * Synchronizes ESP32 clock with NTP servers
+ * Starts synchronizing the ESP32 clock with NTP servers
  * IMPORTANT: TLS validates certificate dates. If ESP32 has incorrect time,
  * handshake may fail. That's why we synchronize NTP BEFORE connecting to MQTT TLS.
- * @return true if synchronized successfully, false if timeout
+ * Returns right away; timeSyncFinished() is polled from loop().
  */
-bool syncTimeNTP() {
+void startTimeSync() {
   Serial.println("[NTP] Synchronizing time...");
   configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+  timeSyncStartedAt = millis();
+}
 
+/**
+ * Check the synchronization started by startTimeSync()
+ * @return true once the time is "reasonable" (after Nov 2023) or NTP_SYNC_TIMEOUT passed
+ */
+bool timeSyncFinished() {
   time_t now = time(nullptr);
-  const uint32_t start = millis();
-
-  // Wait until time is "reasonable" (after Nov 2023)
-  while (now < MIN_VALID_EPOCH && (millis() - start) < NTP_SYNC_TIMEOUT) {
-    Serial.print(".");
-    delay(500);
-    now = time(nullptr);
-  }
-  Serial.println();
+  if (now < MIN_VALID_EPOCH && millis() - timeSyncStartedAt < NTP_SYNC_TIMEOUT) return false;
 
   if (now < MIN_VALID_EPOCH) {
     Serial.println("[NTP] WARN: not synchronized (timeout). TLS may fail.");
-    return false;
+    return true;
   }
 
   Serial.print("[NTP] ✓ OK epoch: ");
-  Serial.println((long)now);
+  Serial.print((long)now);
+  Serial.print(" (");
+  Serial.print(millis() - timeSyncStartedAt);
+  Serial.println(" ms)");
   return true;
 }
 
@@ -780,11 +1163,16 @@ bool syncTimeNTP() {
  * - Loads root CA certificate for TLS validation
  */
 void setupMqtt() {
-  // Broker MQTT TLS endpoint (8883)
-  mqtt.setServer(MQTT_HOST, MQTT_PORT);
+  // Broker MQTT TLS endpoint (8883), unless provisioning set another one
+  const char* host = networkSettings.mqttHost[0] ? networkSettings.mqttHost : MQTT_HOST;
+  uint16_t port = networkSettings.mqttPort ? networkSettings.mqttPort : MQTT_PORT;
+  mqtt.setServer(host, port);
 
   // Callback for incoming messages
   mqtt.setCallback(onMqttMessage);
+  
+  // Room for the JSON telemetry; grows once Bluetooth memory is released
+  mqtt.setBufferSize(isBLEReleased() ? MQTT_BUFFER_SIZE_LARGE : MQTT_BUFFER_SIZE);
 
   // Load root CA so ESP32 can validate broker certificate
   tlsClient.setCACert(LETS_ENCRYPT_ISRG_ROOT_X1);
@@ -800,9 +1188,9 @@ void setupMqtt() {
  */
 bool connectMqtt() {
   Serial.print("[MQTT] Connecting to ");
-  Serial.print(MQTT_HOST);
+  Serial.print(networkSettings.mqttHost[0] ? networkSettings.mqttHost : MQTT_HOST);
   Serial.print(":");
-  Serial.println(MQTT_PORT);
+  Serial.println(networkSettings.mqttPort ? networkSettings.mqttPort : MQTT_PORT);
 
   // ClientID: should be stable and unique.
   // DEVICE_ID comes from config.h
@@ -815,9 +1203,26 @@ bool connectMqtt() {
   uint8_t lwt_qos = 0;
   boolean lwt_retain = true;
 
-  // MQTT_USER / MQTT_PASS vienen de secrets.h
+  // MQTT_USER / MQTT_PASS vienen de secrets.h y solo se envian a MQTT_HOST:
+  // un broker fijado por provisioning (BLE sin autenticar) usa las
+  // credenciales que llegaron con el (vacias = anonimo)
+  const char* user = MQTT_USER;
+  const char* pass = MQTT_PASS;
+  if (networkSettings.mqttHost[0]) {
+    user = networkSettings.mqttUser[0] ? networkSettings.mqttUser : nullptr;
+    pass = networkSettings.mqttUser[0] ? networkSettings.mqttPass : nullptr;
+  }
   // connect(clientId, user, pass, willTopic, willQoS, willRetain, willMessage)
-  bool ok = mqtt.connect(clientId, MQTT_USER, MQTT_PASS, lwt_topic, lwt_qos, lwt_retain, lwt_message);
+  // The TLS handshake is the longest burst of WiFi traffic: no advertising
+  uint32_t connectStart = millis();
+  bool ok;
+  {
+    AdvertisingPause advertisingPause;
+    ok = mqtt.connect(clientId, user, pass, lwt_topic, lwt_qos, lwt_retain, lwt_message);
+  }
+  Serial.print("[MQTT] TLS + CONNECT took ");
+  Serial.print(millis() - connectStart);
+  Serial.println(" ms");
 
   if (!ok) {
     Serial.print("[MQTT] ERROR connect rc=");
@@ -846,19 +1251,389 @@ bool connectMqtt() {
   Serial.print("[MQTT] Subscribed: ");
   Serial.println(TOPIC_WIFI_CLEAR);
 
+  mqtt.subscribe(TOPIC_POWER_SET);
+  Serial.print("[MQTT] Subscribed: ");
+  Serial.println(TOPIC_POWER_SET);
+
+  mqtt.subscribe(TOPIC_TEMP_LABEL);
+  Serial.print("[MQTT] Subscribed: ");
+  Serial.println(TOPIC_TEMP_LABEL);
+
+  mqtt.subscribe(TOPIC_SENSORS_CAL);
+  Serial.print("[MQTT] Subscribed: ");
+  Serial.println(TOPIC_SENSORS_CAL);
+
+  mqtt.subscribe(TOPIC_STATS_GET);
+  Serial.print("[MQTT] Subscribed: ");
+  Serial.println(TOPIC_STATS_GET);
+
+  mqtt.subscribe(TOPIC_PUMP_SPEED_SET);
+  Serial.print("[MQTT] Subscribed: ");
+  Serial.println(TOPIC_PUMP_SPEED_SET);
+
+  mqtt.subscribe(TOPIC_POWER_PROBE);
+  Serial.print("[MQTT] Subscribed: ");
+  Serial.println(TOPIC_POWER_PROBE);
+
   // Publish initial state
   publishPumpState();
   publishValveState();
   publishWiFiState();
   publishTimerState();
+  publishPowerState();
+  publishPumpPower();
+  publishPumpSpeed();
   
-  // Read and publish initial temperature
-  currentTemperature = readTemperature();
+  // Last reading now (skipped if none yet); a fresh one is published by
+  // loop() when its conversion completes
   publishTemperature();
+  requestTemperature();
+  publishAnalogSensors();
+  publishFlow();
+  
+  return true;
+}
+
+// ==================== Background WiFi Recovery ====================
+
+/**
+ * One-time cloud setup after the first association
+ * Starts NTP (needed by TLS); serviceCloudStart() configures and connects
+ * MQTT once the clock is set, so loop() never sits in the NTP wait.
+ */
+void initCloud() {
+  if (cloudReady || cloudStarting) return;
+  cloudStarting = true;
+  startTimeSync();
+}
+
+/**
+ * Finish the cloud setup started by initCloud() (call every loop with WiFi up)
+ */
+void serviceCloudStart() {
+  if (!cloudStarting || !timeSyncFinished()) return;
+  cloudStarting = false;
+  setupMqtt();
+  cloudReady = true;
+  connectMqtt();
+}
+
+/**
+ * Radio coexistence policy
+ * The radio is time-shared between WiFi and BLE: favour WiFi while an
+ * association is in progress, BLE while a dashboard is connected over BLE
+ * (provisioning or local control), and balance otherwise. Advertising is
+ * paused for the whole background association attempt.
+ */
+void updateCoexPreference() {
+  bool associating = reconnectPending || provisionAssociating;
+  static bool advertisingPaused = false;
+  if (associating != advertisingPaused) {
+    advertisingPaused = associating;
+    if (advertisingPaused) pauseBLEAdvertising();
+    else resumeBLEAdvertising();
+  }
+  
+  static esp_coex_prefer_t current = ESP_COEX_PREFER_BALANCE;
+  esp_coex_prefer_t wanted = ESP_COEX_PREFER_BALANCE;
+  if (associating) wanted = ESP_COEX_PREFER_WIFI;
+  else if (isBLEClientConnected()) wanted = ESP_COEX_PREFER_BT;
+  
+  if (wanted == current) return;
+  current = wanted;
+  esp_coex_preference_set(wanted);
+}
+
+/**
+ * Link came back (background reconnection or the router returned)
+ * Closes provisioning and restores the cloud connection
+ */
+void onWiFiRecovered() {
+  if (reconnectPending) {
+    Serial.print("[WiFi] Associated in ");
+    Serial.print(millis() - reconnectStartedAt);
+    Serial.println(" ms (BLE advertising paused)");
+  }
+  reconnectPending = false;
+  lastRecoveryMs = millis() - wifiLostAt;
+  
+  Serial.print("[WiFi] ✓ Recovered after ");
+  Serial.print(lastRecoveryMs);
+  Serial.print(" ms (");
+  Serial.print(reconnectAttempts);
+  Serial.print(" attempts), IP ");
+  Serial.println(WiFi.localIP());
+  reconnectAttempts = 0;
+  wifiProvisioned = true;
+  onPowerProfileAssociated();
+  
+  // Stored network is back: provisioning is no longer needed
+  if (isBLEProvisioningActive() || isCaptivePortalActive()) {
+    Serial.println("[WiFi] Closing provisioning");
+    stopBLEProvisioning();
+    stopCaptivePortal();
+  }
+  
+  if (!cloudReady) {
+    initCloud();  // First association: MQTT follows once NTP answers
+    return;
+  }
+  
+  uint32_t mqttStart = millis();
+  if (!mqtt.connected()) {
+    connectMqtt();
+  }
+  Serial.print("[MQTT] Cloud restored ");
+  Serial.print(millis() - wifiLostAt);
+  Serial.print(" ms after the outage began (MQTT ");
+  Serial.print(millis() - mqttStart);
+  Serial.println(" ms)");
+}
+
+/**
+ * Background reconnection to the stored network (call every loop)
+ * Never blocks: WiFi.begin() is issued and the result collected on later
+ * iterations, so the timer, local control and provisioning keep running.
+ * Attempts wait while a WiFi scan is using the radio.
+ */
+void serviceWiFiRecovery() {
+  if (WiFi.status() == WL_CONNECTED) {
+    if (!wifiWasConnected) {
+      wifiWasConnected = true;
+      onWiFiRecovered();
+    }
+    return;
+  }
+  
+  if (wifiWasConnected) {
+    wifiWasConnected = false;
+    wifiLostAt = millis();
+    Serial.println("[WiFi] Connection lost, recovering in background...");
+  }
+  
+  if (reconnectPending) {
+    if (isWiFiScanRunning()) {
+      // A provisioning scan was requested: give it the radio, retry later
+      WiFi.disconnect();
+      reconnectPending = false;
+      lastReconnectAttempt = millis();
+      Serial.println("[WiFi] Reconnect attempt yields to WiFi scan");
+      return;
+    }
+    if (millis() - reconnectStartedAt < WIFI_CONNECT_TIMEOUT) return;
+    reconnectPending = false;
+    Serial.println("[WiFi] Reconnect attempt timed out");
+  }
+  
+  if (millis() - lastReconnectAttempt < WIFI_RECONNECT_INTERVAL) return;
+  if (isWiFiScanRunning()) return; // Scan and association share the radio
+  lastReconnectAttempt = millis();
+  
+  char ssid[33];
+  char password[64];
+  if (!loadWiFiCredentials(ssid, password)) {
+    // No credentials - provisioning is the only way forward
+    if (!isBLEProvisioningActive() && !isCaptivePortalActive()) {
+      Serial.println("[WiFi] No credentials - starting provisioning...");
+      startProvisioning();
+    }
+    return;
+  }
+  
+  reconnectAttempts++;
+  Serial.print("[WiFi] Reconnect attempt ");
+  Serial.print(reconnectAttempts);
+  Serial.print(" to ");
+  Serial.println(ssid);
+  
+  // Keep AP+STA while the captive portal is open
+  if ((WiFi.getMode() & WIFI_MODE_STA) == 0) {
+    WiFi.mode(WIFI_STA);
+  }
+  WiFi.begin(ssid, password);
+  reconnectPending = true;
+  reconnectStartedAt = millis();
+}
+
+// ==================== Provisioned Credentials ====================
+
+/**
+ * Try credentials received from a provisioning channel (BLE or portal)
+ * Returns right away: serviceProvisioning() associates in the background.
+ * BLE provisioning and the portal are closed to free the radio and memory
+ * (~30-50KB RAM); the dashboard can use MQTT to clear credentials remotely.
+ * @param ssid WiFi SSID
+ * @param password WiFi password
+ * @param settings Optional settings sent with the credentials (nullptr = keep stored)
+ */
+void provisionWiFi(const char* ssid, const char* password, const NetworkSettings* settings) {
+  stopBLEProvisioning();
+  stopCaptivePortal();
+  
+  // A background attempt on the stored network gives way to the new one
+  if (reconnectPending) {
+    WiFi.disconnect();
+    reconnectPending = false;
+  }
+  
+  strncpy(provisionSSID, ssid, sizeof(provisionSSID) - 1);
+  provisionSSID[sizeof(provisionSSID) - 1] = '\0';
+  strncpy(provisionPassword, password, sizeof(provisionPassword) - 1);
+  provisionPassword[sizeof(provisionPassword) - 1] = '\0';
+  provisionHasSettings = settings != nullptr;
+  if (settings) {
+    provisionSettings = *settings;
+    applyNetworkSettings(provisionSettings);
+  }
+  
+  provisionPending = true;
+  provisionAssociating = false;
+  provisionAttempt = 0;
+  provisionStartedAt = millis();
+}
+
+/**
+ * Provisioned network joined: store it and bring the cloud up
+ */
+void onProvisionAssociated() {
+  provisionPending = false;
+  provisionAssociating = false;
+  
+  Serial.print("[WiFi] ✓ CONNECTED in ");
+  Serial.print(millis() - provisionAttemptAt);
+  Serial.println(" ms (BLE advertising paused)");
+  Serial.print("[WiFi] SSID: ");
+  Serial.println(WiFi.SSID());
+  Serial.print("[WiFi] IP: ");
+  Serial.println(WiFi.localIP());
+  Serial.print("[WiFi] RSSI: ");
+  Serial.print(WiFi.RSSI());
+  Serial.println(" dBm");
+  
+  // Save to NVS for future boots
+  saveWiFiCredentials(provisionSSID, provisionPassword);
+  if (provisionHasSettings) {
+    saveNetworkSettings(provisionSettings);
+    networkSettings = provisionSettings;
+  }
+  wifiProvisioned = true;
+  wifiWasConnected = true;
+  reconnectAttempts = 0;
+  onPowerProfileAssociated();
+  
+  // Complete system initialization
+  Serial.println("[System] Completing initialization...");
+  if (!cloudReady) {
+    initCloud();
+  } else {
+    setupMqtt();  // Broker may have changed
+    connectMqtt();
+  }
+  
+  Serial.print("[System] Provisioned in ");
+  Serial.print(millis() - provisionStartedAt);
+  Serial.println(" ms (credentials received -> associated)");
+  
+  Serial.println("========================================");
+  Serial.println("   Sistema listo (via provisioning)");
+  Serial.println("========================================");
+}
+
+/**
+ * Association with provisioned credentials (call every loop)
+ * Same pattern as serviceWiFiRecovery(): WiFi.begin() is issued and the
+ * result collected on later iterations, up to WIFI_RETRY_ATTEMPTS attempts
+ * WIFI_RETRY_DELAY apart. If every attempt fails, the stored settings are
+ * restored and provisioning restarts so the user can retry.
+ * @return true while the credentials are being tried (no background recovery)
+ */
+bool serviceProvisioning() {
+  if (!provisionPending) return false;
+  
+  if (provisionAssociating) {
+    if (WiFi.status() == WL_CONNECTED) {
+      onProvisionAssociated();
+      return false;
+    }
+    if (millis() - provisionAttemptAt < WIFI_CONNECT_TIMEOUT) return true;
+    
+    provisionAssociating = false;
+    provisionAttemptAt = millis();
+    if (provisionAttempt < WIFI_RETRY_ATTEMPTS) {
+      Serial.print("[WiFi] Connection failed, retrying in ");
+      Serial.print(WIFI_RETRY_DELAY / 1000);
+      Serial.println(" seconds...");
+      return true;
+    }
+    
+    Serial.print("[WiFi] ✗ Connection FAILED after ");
+    Serial.print(provisionAttempt);
+    Serial.println(" attempts");
+    Serial.println("[WiFi] Provisioned credentials failed - restarting provisioning for retry...");
+    provisionPending = false;
+    WiFi.disconnect();
+    if (provisionHasSettings) applyNetworkSettings(networkSettings);
+    lastReconnectAttempt = millis();  // Stored network retried after the usual interval
+    startProvisioning();
+    return false;
+  }
+  
+  if (provisionAttempt > 0 && millis() - provisionAttemptAt < WIFI_RETRY_DELAY) return true;
+  if (isWiFiScanRunning()) return true;  // Scan and association share the radio
   
+  provisionAttempt++;
+  Serial.print("[WiFi] Connecting to: ");
+  Serial.print(provisionSSID);
+  Serial.print(" (attempt ");
+  Serial.print(provisionAttempt);
+  Serial.print("/");
+  Serial.print(WIFI_RETRY_ATTEMPTS);
+  Serial.println(")");
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(provisionSSID, provisionPassword);
+  provisionAssociating = true;
+  provisionAttemptAt = millis();
   return true;
 }
 
+// ==================== Bluetooth Memory ====================
+
+/**
+ * Release Bluetooth once it cannot be needed again in this boot (call every loop)
+ * Without local control, BLE only serves provisioning. After BLE_RELEASE_DELAY
+ * on the stored network with the cloud connected, the controller memory goes
+ * back to the heap and the headroom is given to the MQTT buffer and TLS.
+ * Later provisioning in this boot uses the captive portal.
+ */
+void serviceBluetoothRelease(bool wifiUp) {
+#if !BLE_LOCAL_CONTROL
+  static uint32_t stableSince = 0;
+  if (isBLEReleased()) return;
+  
+  if (!wifiUp || !mqtt.connected() || isBLEProvisioningActive()) {
+    stableSince = 0;
+    return;
+  }
+  if (stableSince == 0) stableSince = millis();
+  if (millis() - stableSince < BLE_RELEASE_DELAY) return;
+  
+  // Retried next loop if a client is still disconnecting
+  if (releaseBLEMemory() == 0 && !isBLEReleased()) return;
+  
+  mqtt.setBufferSize(MQTT_BUFFER_SIZE_LARGE);
+  Serial.print("[MQTT] Buffer raised to ");
+  Serial.print(MQTT_BUFFER_SIZE_LARGE);
+  Serial.println(" bytes");
+  publishWiFiState();
+  
+  // Without Bluetooth the performance profile can turn modem sleep off
+  if (getPowerProfile() == POWER_PROFILE_PERFORMANCE) {
+    applyPowerProfile(POWER_PROFILE_PERFORMANCE, false);
+    publishPowerState();
+  }
+#endif
+}
+
 // ==================== Arduino Setup & Loop ====================
 
 /**
@@ -884,34 +1659,55 @@ void setup() {
   // Configure output pins (relays)
   pinMode(PUMP_RELAY_PIN, OUTPUT);
   pinMode(VALVE_RELAY_PIN, OUTPUT);
+  pinMode(BOOT_BUTTON_PIN, INPUT_PULLUP);
   
   // Initial state: all relays off
   digitalWrite(PUMP_RELAY_PIN, LOW);
   digitalWrite(VALVE_RELAY_PIN, LOW);
 
-  // Initialize DS18B20 temperature sensor
-  Serial.println("[SENSOR] Initializing DS18B20...");
-  tempSensor.begin();
-  int deviceCount = tempSensor.getDeviceCount();
-  Serial.print("[SENSOR] DS18B20 devices found: ");
-  Serial.println(deviceCount);
+  // Latency probe first so the bus discovery is measured too (if enabled)
+  initIRQLatencyProbe();
+
+  // Initialize DS18B20 temperature sensor (first conversion starts in loop)
+  initTemperature();
+
+  // Analog sensors sample on their own (DMA); loop() drains and filters
+  initAnalogSensors();
+  initPumpMonitor();
+  // Flow pulses are counted by the PCNT peripheral; loop() samples the total
+  initFlowMeter();
+  // Drive bus served by its own task; loop() takes the results
+  initVsdPump();
+  initSensorStats();
 
   // Initial state
   pumpState = false;
   valveMode = 1;
-  currentTemperature = 0.0;
 
-  // 1) Initialize WiFi with provisioning (BLE primary, WiFiManager fallback)
+  // Load WiFi power-save profile before the first association
+  initPowerProfile();
+  
+  // Hostname and static IP must be set before the first WiFi.begin()
+  loadNetworkSettings(&networkSettings);
+  applyNetworkSettings(networkSettings);
+
+#if BLE_LOCAL_CONTROL
+  // Local control works from boot, with or without WiFi/cloud
+  setBLEControlCallback(onBLEControl);
+  startBLEStack();
+  notifyBLEControl(BLE_CONTROL_PUMP, pumpState ? "ON" : "OFF");
+  notifyBLEControl(BLE_CONTROL_VALVE, valveMode == 2 ? "2" : "1");
+  notifyBLEControl(BLE_CONTROL_TIMER, timerStateJSON().c_str());
+#endif
+
+  // 1) Initialize WiFi with provisioning (BLE primary, captive portal fallback)
   bool wifiConnected = initWiFiProvisioning();
   
   if (wifiConnected) {
     // WiFi connected immediately (had saved credentials)
-    // 2) Synchronize time for TLS
-    syncTimeNTP();
-
-    // 3) Configure and connect MQTT
-    setupMqtt();
-    connectMqtt();
+    // 2) Synchronize time for TLS, 3) configure and connect MQTT
+    wifiWasConnected = true;
+    initCloud();
     
     Serial.println("========================================");
     Serial.println("   System ready");
@@ -926,141 +1722,213 @@ void setup() {
 }
 
 /**
- * Main loop (executed continuously)
+ * Main loop (executed continuously, never blocks on provisioning or WiFi)
  * Responsibilities:
- * 1. Update timer countdown
- * 2. Publish WiFi state periodically
- * 3. Read and publish temperature periodically
- * 4. Detect and recover WiFi connection loss
+ * 1. Local BLE control, provisioning channels and WiFi scans
+ * 2. Recover WiFi in the background (stored network), also while provisioning
+ * 3. Update timer countdown
+ * 4. Read temperature (non-blocking conversion) and analog sensors (DMA), publish telemetry
  * 5. Detect and recover MQTT connection loss
  * 6. Process incoming MQTT messages (mqtt.loop)
  */
 void loop() {
-  // ===== BLE Provisioning Check =====
-  // If BLE is active, check for new credentials from dashboard
-  static uint32_t lastBLECheck = 0;
-  if (isBLEProvisioningActive()) {
-    // Give BLE stack time to process events (writes, notifications, etc.)
-    delay(10);
-    
-    if (millis() - lastBLECheck > BLE_CHECK_INTERVAL) {
-      lastBLECheck = millis();
-      
-      if (hasNewWiFiCredentials()) {
-        char ssid[33];
-        char password[64];
-        
-        if (getBLEWiFiSSID(ssid) && getBLEWiFiPassword(password)) {
-          Serial.println("[BLE] ✓ Credentials received from dashboard");
-          
-          // Stop BLE to free resources (~30-50KB RAM, CPU cycles)
-          // Dashboard can use MQTT to clear credentials remotely
-          stopBLEProvisioning();
-          
-          // Try to connect with BLE credentials
-          if (connectWiFi(ssid, password)) {
-            // Save to NVS for future boots
-            saveWiFiCredentials(ssid, password);
-            clearBLECredentials();
-            
-            // Complete system initialization
-            Serial.println("[System] Completing initialization...");
-            syncTimeNTP();
-            setupMqtt();
-            connectMqtt();
-            
-            Serial.println("========================================");
-            Serial.println("   Sistema listo (via BLE)");
-            Serial.println("========================================");
-          } else {
-            // Connection failed - restart BLE for retry
-            Serial.println("[WiFi] BLE credentials failed - restarting BLE for retry...");
-            clearBLECredentials();
-            initBLEProvisioning();
-          }
-        }
-      }
-    }
-    
-    // If BLE is running, skip normal operations (WiFi reconnection, MQTT, etc.)
-    return;
+  LoopTimer loopTimer;
+  
+  // ===== Local BLE Control =====
+  // Runs before any early return so it keeps working without WiFi/cloud
+  serviceBLEControl();
+  serviceBootButton();
+  
+  // ===== Provisioning Check (BLE + captive portal) =====
+  // Portal DNS/HTTP are serviced every iteration; returns immediately when closed
+  handleCaptivePortal();
+  
+  // ===== WiFi Recovery =====
+  // Stored networks are retried in the background, also while provisioning,
+  // so a router outage after a power failure recovers on its own. Newly
+  // provisioned credentials take the radio while they are being tried.
+  if (!serviceProvisioning()) {
+    serviceWiFiRecovery();
   }
+  updateCoexPreference();
+  serviceBLEAdvertising();
+  bool wifiUp = WiFi.status() == WL_CONNECTED;
   
-  // ===== Normal Operations (only when WiFi connected) =====
-  // Check WiFi status periodically, not every loop (prevents spam)
-  static uint32_t lastWiFiCheck = 0;
-  static int reconnectAttempts = 0;
-  if (WiFi.status() != WL_CONNECTED && millis() - lastWiFiCheck > WIFI_RECONNECT_INTERVAL) {
-    lastWiFiCheck = millis();
-    reconnectAttempts++;
-    
-    // WiFi disconnected - try to reconnect
-    Serial.print("[WiFi] Connection lost (attempt ");
-    Serial.print(reconnectAttempts);
-    Serial.println("), attempting recovery...");
-    
-    char ssid[33];
-    char password[64];
-    if (loadWiFiCredentials(ssid, password)) {
-      // Try single connection attempt (we'll retry on next interval)
-      if (connectWiFi(ssid, password, 1)) {
-        reconnectAttempts = 0;  // Reset counter on success
-        // Reconnect MQTT after WiFi recovery
-        if (!mqtt.connected()) {
-          Serial.println("[System] WiFi recovered, reconnecting MQTT...");
-          connectMqtt();
-        }
-      }
+  // Collect background WiFi scans requested by BLE or the portal and
+  // stream each completed channel to the BLE client
+  updateBLENetworks(serviceWiFiScan());
+  
+  // Credentials are handed over lock-free, so they are checked every loop
+  char ssid[33];
+  char password[64];
+  NetworkSettings receivedSettings;
+  uint8_t receivedFields;
+  if (takeBLEWiFiCredentials(ssid, password, &receivedSettings, &receivedFields)) {
+    Serial.println("[BLE] ✓ Credentials received from dashboard");
+    if (receivedFields) {
+      // Only the settings that were sent replace the stored ones
+      NetworkSettings merged = networkSettings;
+      mergeNetworkSettings(&merged, receivedSettings, receivedFields);
+      provisionWiFi(ssid, password, &merged);
     } else {
-      // No credentials - restart BLE provisioning (only if not already active)
-      if (!isBLEProvisioningActive()) {
-        Serial.println("[WiFi] No credentials - starting BLE provisioning...");
-        initBLEProvisioning();
-        reconnectAttempts = 0;
-      }
+      provisionWiFi(ssid, password, nullptr);  // Legacy writes or credentials only
     }
-    return;
+  } else if (hasPortalCredentials() && getPortalCredentials(ssid, password)) {
+    Serial.println("[PORTAL] ✓ Credentials received from captive portal");
+    clearPortalCredentials();
+    provisionWiFi(ssid, password, nullptr);
   }
   
-  // Reset reconnect counter when WiFi is connected
-  if (WiFi.status() == WL_CONNECTED && reconnectAttempts > 0) {
-    reconnectAttempts = 0;
-  }
-  
-  // If WiFi not connected and BLE not active, just wait
-  if (WiFi.status() != WL_CONNECTED) {
-    delay(100);
-    return;
+  // "clear_wifi" written to the BLE command characteristic
+  if (isClearWiFiRequested()) {
+    resetClearWiFiRequest();
+    handleCommand(TOPIC_WIFI_CLEAR, "");
   }
   
+  // ===== Control (always runs, with or without WiFi) =====
   // Update timer if active
   updateTimer();
   
-  // Publish WiFi state periodically
+  // Idle pacing while offline (no network traffic to service)
+  if (!wifiUp) {
+    delay(10);
+  }
+  
+  // Evaluate link quality; report level changes right away
+  if (updateLinkGovernor() && mqtt.connected()) {
+    publishWiFiState();
+  }
+  
+  // Bluetooth memory back to the heap once BLE cannot be needed this boot
+  serviceBluetoothRelease(wifiUp);
+  
+  // Telemetry intervals are stretched on a poor link. While degraded, WiFi
+  // state and temperature share one clock so they go out in a single burst.
+  uint32_t telemetryScale = getLinkIntervalScale();
   static uint32_t lastWiFiUpdate = 0;
-  if (millis() - lastWiFiUpdate > WIFI_STATE_INTERVAL) {
+  static uint32_t lastTempUpdate = 0;
+  bool tempDue = millis() - lastTempUpdate > TEMP_PUBLISH_INTERVAL * telemetryScale;
+  bool wifiDue = isLinkBatching() ? tempDue
+                                  : millis() - lastWiFiUpdate > WIFI_STATE_INTERVAL * telemetryScale;
+  
+  // Publish WiFi state periodically
+  if (wifiDue) {
     lastWiFiUpdate = millis();
     if (mqtt.connected()) {
       publishWiFiState();
     }
   }
   
-  // Read and publish temperature periodically (every 1 minute)
-  static uint32_t lastTempUpdate = 0;
-  if (millis() - lastTempUpdate > TEMP_PUBLISH_INTERVAL) {
+  // The sampler reads and filters the probes on its own adaptive schedule
+  // (conversions run in the probes, collected without waiting here).
+  // Report by exception: the filtered value is published when it leaves the
+  // deadband around the last report, or when TEMP_MAX_REPORT_INTERVAL passes.
+  // While the link batches telemetry, reports wait for the batch clock.
+  if (tempDue) {
     lastTempUpdate = millis();
-    currentTemperature = readTemperature();
-    if (mqtt.connected()) {
-      publishTemperature();
+  }
+  if (serviceTemperature() == TEMP_EVENT_READY) {
+    currentTemperature = getTemperature();
+    for (uint8_t i = 0; i < getTemperatureProbeCount(); i++) {
+      addStatsSample(statsProbe[i], getProbeTemperature(i));
     }
   }
+  bool tempMoved = isnan(currentTemperature) != isnan(publishedTemperature) ||
+                   fabsf(currentTemperature - publishedTemperature) >= TEMP_DEADBAND;
+  bool tempExpired = millis() - lastTempPublish > TEMP_MAX_REPORT_INTERVAL * telemetryScale;
+  if ((tempMoved || tempExpired) && (!isLinkBatching() || tempDue)) {
+    publishTemperature();  // Also notifies local BLE clients while offline
+  }
   
-  // If MQTT drops, reconnect
-  if (!mqtt.connected()) {
+  // Analog sensors: same report-by-exception rules, per-sensor deadbands
+  if (serviceAnalogSensors()) {
+    for (int i = 0; i < ANALOG_SENSOR_COUNT; i++) {
+      addStatsSample(statsAnalog[i], getAnalogValue((AnalogSensor)i));
+    }
+    // Pump windows are 0.5 s; one statistics sample per second is enough
+    if (isPumpMonitorAvailable()) {
+      PumpPower pump = getPumpPower();
+      addStatsSample(statsPumpCurrent, pump.current);
+      addStatsSample(statsPumpPower, pump.power);
+    }
+  }
+  bool sensorsExpired = millis() - lastSensorsPublish > ANALOG_MAX_REPORT_INTERVAL * telemetryScale;
+  if ((analogSensorsMoved() || sensorsExpired) && (!isLinkBatching() || tempDue)) {
+    publishAnalogSensors();
+  }
+  
+  // Flow: rate sampled every second from the hardware count, same rules
+  if (serviceFlowMeter()) {
+    addStatsSample(statsFlow, getFlowRate());
+  }
+  float flowRate = getFlowRate();
+  bool flowMoved = isnan(flowRate) != isnan(publishedFlow) ||
+                   fabsf(flowRate - publishedFlow) >= FLOW_DEADBAND;
+  bool flowExpired = millis() - lastFlowPublish > FLOW_MAX_REPORT_INTERVAL * telemetryScale;
+  if (isFlowMeterAvailable() && (flowMoved || flowExpired) && (!isLinkBatching() || tempDue)) {
+    publishFlow();
+  }
+  
+  // Pump protection: a confirmed fault stops the pump (and its timer)
+  PumpEvent pumpEvent = servicePumpMonitor();
+  if (pumpEvent != PUMP_EVENT_NONE) {
+#if PUMP_PROTECTION
+    if (pumpState) {
+      Serial.print("[CONTROL] Pump stopped by protection: ");
+      Serial.println(getPumpEventName(pumpEvent));
+      if (timerActive) {
+        stopTimer();
+      } else {
+        setPumpState(false);
+      }
+    }
+#endif
+    publishPumpPower();
+  }
+  
+  // Pump power while it runs, and once more after it stops (final energy)
+  static bool pumpPowerActive = false;
+  if (pumpState) pumpPowerActive = true;
+  if (pumpPowerActive && millis() - lastPumpPowerPublish > PUMP_POWER_INTERVAL * telemetryScale &&
+      (!isLinkBatching() || tempDue)) {
+    publishPumpPower();
+    pumpPowerActive = pumpState;
+  }
+  
+  // Variable-speed drive: readback polled every second, reported by exception
+  if (serviceVsdPump()) {
+    VsdPumpState drive = getVsdPumpState();
+    if (drive.online) addStatsSample(statsPumpSpeed, drive.speed);
+  }
+  bool driveExpired = millis() - lastPumpSpeedPublish > VSD_MAX_REPORT_INTERVAL * telemetryScale;
+  if (isVsdPumpAvailable() && (vsdPumpMoved() || driveExpired) && (!isLinkBatching() || tempDue)) {
+    publishPumpSpeed();
+  }
+  
+  // MQTT setup once the clock is set (first association)
+  if (wifiUp) {
+    serviceCloudStart();
+  }
+  
+  if (!wifiUp || !cloudReady) return;
+  
+  // If MQTT drops, reconnect (rate-limited: a TLS attempt blocks the loop)
+  static uint32_t lastMqttAttempt = 0;
+  if (!mqtt.connected() && millis() - lastMqttAttempt > MQTT_RECONNECT_INTERVAL) {
+    lastMqttAttempt = millis();
     Serial.println("[MQTT] Connection lost, reconnecting...");
     connectMqtt();
   }
 
+  // Power profile latency benchmark (loopback probes through the broker)
+  uint16_t probeSeq;
+  PowerBenchEvent benchEvent = servicePowerBench(&probeSeq);
+  if (benchEvent == POWER_BENCH_SEND_PROBE) {
+    mqtt.publish(TOPIC_POWER_PROBE, String(probeSeq).c_str());
+  } else if (benchEvent == POWER_BENCH_FINISHED) {
+    publishPowerState();
+  }
+
   // Keep connection alive and process incoming messages
   mqtt.loop();
 }
@@ -0,0 +1,301 @@
+/**
+ * @file modbus_rtu.cpp
+ * @brief Modbus RTU master: frames, CRC and the request pipeline implementation
+ */
+
+#include "modbus_rtu.h"
+#include <string.h>
+
+// Longest request frame: write multiple (address, function, start, count,
+// byte count, registers, CRC)
+#define MODBUS_MAX_REQUEST_FRAME (9 + 2 * MODBUS_MAX_REGISTERS)
+
+/**
+ * Queued request with its encoded frame
+ */
+struct ModbusSlot {
+  ModbusRequest request;
+  uint8_t frame[MODBUS_MAX_REQUEST_FRAME];
+  uint8_t length;
+};
+
+enum ModbusBusState {
+  BUS_IDLE,
+  BUS_WAIT_RESPONSE,
+  BUS_TURNAROUND          // After a broadcast: no answer, wait before the next frame
+};
+
+// CRC-16/MODBUS of every byte value (reflected 0xA001), kept in flash
+static const uint16_t crcTable[256] = {
+  0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+  0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+  0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+  0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+  0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+  0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+  0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+  0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+  0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+  0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+  0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+  0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+  0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+  0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+  0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+  0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+  0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+  0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+  0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+  0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+  0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+  0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+  0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+  0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+  0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+  0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+  0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+  0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+  0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+  0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+  0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+  0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+// ==================== State Variables ====================
+static ModbusSendFn sendFrame = nullptr;
+static ModbusResultFn resultHandler = nullptr;
+static uint32_t responseTimeout = 0;
+static uint32_t turnaround = 0;
+
+static ModbusSlot queue[MODBUS_QUEUE_LEN];
+static uint8_t queueHead = 0;
+static uint8_t queueCount = 0;
+
+static ModbusBusState busState = BUS_IDLE;
+static uint64_t sentAt = 0;
+static uint64_t deadline = 0;
+static ModbusStats stats;
+
+// ==================== Frame Helpers ====================
+
+static void putWord(uint8_t* p, uint16_t value) {
+  p[0] = value >> 8;
+  p[1] = value & 0xFF;
+}
+
+static uint16_t getWord(const uint8_t* p) {
+  return ((uint16_t)p[0] << 8) | p[1];
+}
+
+uint16_t modbusCRC16(const uint8_t* data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  while (length--) {
+    crc = (crc >> 8) ^ crcTable[(crc ^ *data++) & 0xFF];
+  }
+  return crc;
+}
+
+size_t modbusBuildRequest(const ModbusRequest& request, uint8_t* frame) {
+  if (request.count == 0 || request.count > MODBUS_MAX_REGISTERS) return 0;
+
+  size_t length = 0;
+  frame[length++] = request.slave;
+  frame[length++] = request.function;
+  putWord(&frame[length], request.address);
+  length += 2;
+
+  switch (request.function) {
+    case MODBUS_READ_HOLDING:
+    case MODBUS_READ_INPUT:
+      if (request.slave == MODBUS_BROADCAST) return 0;  // Nobody would answer
+      putWord(&frame[length], request.count);
+      length += 2;
+      break;
+    case MODBUS_WRITE_SINGLE:
+      if (request.count != 1) return 0;
+      putWord(&frame[length], request.values[0]);
+      length += 2;
+      break;
+    case MODBUS_WRITE_MULTIPLE:
+      putWord(&frame[length], request.count);
+      length += 2;
+      frame[length++] = request.count * 2;
+      for (uint16_t i = 0; i < request.count; i++) {
+        putWord(&frame[length], request.values[i]);
+        length += 2;
+      }
+      break;
+    default:
+      return 0;
+  }
+
+  uint16_t crc = modbusCRC16(frame, length);
+  frame[length++] = crc & 0xFF;
+  frame[length++] = crc >> 8;
+  return length;
+}
+
+ModbusStatus modbusParseResponse(const ModbusRequest& request, const uint8_t* frame, size_t length,
+                                 ModbusResult& result) {
+  result.tag = request.tag;
+  result.slave = request.slave;
+  result.function = request.function;
+  result.address = request.address;
+  result.count = request.count;
+  result.exception = 0;
+
+  if (length < 5) return result.status = MODBUS_BAD_RESPONSE;
+  uint16_t crc = frame[length - 2] | ((uint16_t)frame[length - 1] << 8);
+  if (modbusCRC16(frame, length - 2) != crc) return result.status = MODBUS_CRC_ERROR;
+  if (frame[0] != request.slave) return result.status = MODBUS_BAD_RESPONSE;
+
+  if (frame[1] == (request.function | 0x80)) {
+    result.exception = frame[2];
+    return result.status = MODBUS_EXCEPTION;
+  }
+  if (frame[1] != request.function) return result.status = MODBUS_BAD_RESPONSE;
+
+  switch (request.function) {
+    case MODBUS_READ_HOLDING:
+    case MODBUS_READ_INPUT:
+      if (frame[2] != request.count * 2 || length != 5 + (size_t)request.count * 2) {
+        return result.status = MODBUS_BAD_RESPONSE;
+      }
+      for (uint16_t i = 0; i < request.count; i++) {
+        result.values[i] = getWord(&frame[3 + 2 * i]);
+      }
+      break;
+    case MODBUS_WRITE_SINGLE:
+      // Echo of the request
+      if (length != 8 || getWord(&frame[2]) != request.address || getWord(&frame[4]) != request.values[0]) {
+        return result.status = MODBUS_BAD_RESPONSE;
+      }
+      result.values[0] = request.values[0];
+      break;
+    case MODBUS_WRITE_MULTIPLE:
+      if (length != 8 || getWord(&frame[2]) != request.address || getWord(&frame[4]) != request.count) {
+        return result.status = MODBUS_BAD_RESPONSE;
+      }
+      break;
+  }
+  return result.status = MODBUS_OK;
+}
+
+// ==================== Pipeline ====================
+
+/**
+ * Put the next queued frame on the bus (or go idle)
+ */
+static void sendNext(uint64_t nowUs) {
+  if (queueCount == 0) {
+    busState = BUS_IDLE;
+    return;
+  }
+  const ModbusSlot& slot = queue[queueHead];
+  sendFrame(slot.frame, slot.length);
+  stats.requests++;
+  sentAt = nowUs;
+  if (slot.request.slave == MODBUS_BROADCAST) {
+    busState = BUS_TURNAROUND;
+    deadline = nowUs + turnaround;
+  } else {
+    busState = BUS_WAIT_RESPONSE;
+    deadline = nowUs + responseTimeout;
+  }
+}
+
+/**
+ * Report the transaction at the head, drop it and start the next one
+ */
+static void completeHead(ModbusResult& result, uint64_t nowUs) {
+  result.latencyUs = (uint32_t)(nowUs - sentAt);
+  switch (result.status) {
+    case MODBUS_OK:
+      stats.responses++;
+      stats.latencyTotalUs += result.latencyUs;
+      if (result.latencyUs > stats.latencyMaxUs) stats.latencyMaxUs = result.latencyUs;
+      break;
+    case MODBUS_TIMEOUT:      stats.timeouts++; break;
+    case MODBUS_CRC_ERROR:    stats.crcErrors++; break;
+    case MODBUS_EXCEPTION:    stats.exceptions++; break;
+    case MODBUS_BAD_RESPONSE: stats.badResponses++; break;
+  }
+
+  queueHead = (queueHead + 1) % MODBUS_QUEUE_LEN;
+  queueCount--;
+  // Next frame first: the caller's handler must not delay the bus
+  sendNext(nowUs);
+  if (resultHandler) resultHandler(result);
+}
+
+void modbusMasterBegin(ModbusSendFn send, ModbusResultFn onResult,
+                       uint32_t responseTimeoutUs, uint32_t turnaroundUs) {
+  sendFrame = send;
+  resultHandler = onResult;
+  responseTimeout = responseTimeoutUs;
+  turnaround = turnaroundUs;
+  queueHead = 0;
+  queueCount = 0;
+  busState = BUS_IDLE;
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool modbusMasterSubmit(const ModbusRequest& request, uint64_t nowUs) {
+  if (!sendFrame || queueCount >= MODBUS_QUEUE_LEN) {
+    stats.rejected++;
+    return false;
+  }
+  ModbusSlot& slot = queue[(queueHead + queueCount) % MODBUS_QUEUE_LEN];
+  size_t length = modbusBuildRequest(request, slot.frame);
+  if (length == 0) {
+    stats.rejected++;
+    return false;
+  }
+  slot.request = request;
+  slot.length = length;
+  queueCount++;
+
+  if (busState == BUS_IDLE) sendNext(nowUs);
+  return true;
+}
+
+void modbusMasterOnFrame(const uint8_t* frame, size_t length, uint64_t nowUs) {
+  if (busState != BUS_WAIT_RESPONSE) {
+    stats.unexpected++;   // Late answer to a timed-out request, or line noise
+    return;
+  }
+  ModbusResult result;
+  modbusParseResponse(queue[queueHead].request, frame, length, result);
+  completeHead(result, nowUs);
+}
+
+uint32_t modbusMasterTick(uint64_t nowUs) {
+  if (busState == BUS_IDLE) return UINT32_MAX;
+  if (nowUs < deadline) return (uint32_t)(deadline - nowUs);
+
+  const ModbusRequest& request = queue[queueHead].request;
+  ModbusResult result;
+  result.tag = request.tag;
+  result.slave = request.slave;
+  result.function = request.function;
+  result.address = request.address;
+  result.count = request.count;
+  result.exception = 0;
+  if (busState == BUS_TURNAROUND) {
+    // Broadcast writes are never answered: done once the slaves had time
+    result.status = MODBUS_OK;
+    memcpy(result.values, request.values, sizeof(result.values));
+  } else {
+    result.status = MODBUS_TIMEOUT;
+  }
+  completeHead(result, nowUs);
+  return busState == BUS_IDLE ? UINT32_MAX : (uint32_t)(deadline - nowUs);
+}
+
+uint8_t modbusMasterPending() {
+  return queueCount;
+}
+
+ModbusStats modbusMasterStats() {
+  return stats;
+}
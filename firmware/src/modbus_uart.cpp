@@ -0,0 +1,188 @@
+/**
+ * @file modbus_uart.cpp
+ * @brief RS-485 transport for the Modbus RTU master implementation
+ */
+
+#include "modbus_uart.h"
+#include "config.h"
+#include <driver/uart.h>
+#include <esp_timer.h>
+
+#define MODBUS_UART_PORT        UART_NUM_2
+#define MODBUS_CHAR_BITS        11      // Start + 8 data + parity/second stop + stop
+#define MODBUS_SILENCE_CHARS    4       // 3.5 characters, in whole UART symbols
+#define MODBUS_SILENCE_FAST_US  1750    // Fixed silence above 19200 baud (spec)
+
+// ==================== State Variables ====================
+static bool running = false;
+static QueueHandle_t uartEvents = nullptr;
+static QueueHandle_t requestQueue = nullptr;
+static QueueHandle_t resultQueue = nullptr;
+static QueueSetHandle_t busEvents = nullptr;
+
+// Counters copied out of the bus task after every event
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static ModbusStats statsSnapshot = {};
+static uint32_t latencyPeak = 0;        // Highest latency since the last takeModbusLatencyPeak()
+static volatile uint32_t droppedResults = 0;
+
+// ==================== Bus Task ====================
+
+static void sendFrame(const uint8_t* frame, size_t length) {
+  // Frames fit the 128-byte TX FIFO: returns without waiting for the wire
+  uart_write_bytes(MODBUS_UART_PORT, (const char*)frame, length);
+}
+
+static void queueResult(const ModbusResult& result) {
+  if (result.status == MODBUS_OK) {
+    portENTER_CRITICAL(&statsMux);
+    if (result.latencyUs > latencyPeak) latencyPeak = result.latencyUs;
+    portEXIT_CRITICAL(&statsMux);
+  }
+  if (xQueueSend(resultQueue, &result, 0) != pdTRUE) droppedResults++;
+}
+
+/**
+ * Inter-frame silence in UART symbols for the RX timeout
+ */
+static uint8_t silenceSymbols() {
+  if (MODBUS_BAUD <= 19200) return MODBUS_SILENCE_CHARS;
+  uint32_t charUs = 1000000UL * MODBUS_CHAR_BITS / MODBUS_BAUD;
+  return (MODBUS_SILENCE_FAST_US + charUs - 1) / charUs;
+}
+
+static void busTask(void* arg) {
+  static uint8_t frame[MODBUS_MAX_FRAME];
+  size_t length = 0;
+  uint32_t waitUs = UINT32_MAX;
+
+  for (;;) {
+    TickType_t wait = waitUs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(waitUs / 1000) + 1;
+    QueueSetMemberHandle_t member = xQueueSelectFromSet(busEvents, wait);
+
+    if (member == uartEvents) {
+      uart_event_t event;
+      xQueueReceive(uartEvents, &event, 0);
+      switch (event.type) {
+        case UART_DATA: {
+          // Bytes beyond the RTU limit are dropped; the CRC rejects the frame
+          size_t room = MODBUS_MAX_FRAME - length;
+          int read = uart_read_bytes(MODBUS_UART_PORT, frame + length,
+                                     event.size < room ? event.size : room, 0);
+          if (read > 0) length += read;
+          if (event.size > room) uart_flush_input(MODBUS_UART_PORT);
+          if (event.timeout_flag) {
+            // Bus silent for 3.5 characters: the frame is complete
+            modbusMasterOnFrame(frame, length, esp_timer_get_time());
+            length = 0;
+          }
+          break;
+        }
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+          uart_flush_input(MODBUS_UART_PORT);
+          length = 0;
+          break;
+        default:
+          // Parity and framing errors: the damaged frame fails its CRC
+          break;
+      }
+    } else if (member == requestQueue) {
+      ModbusRequest request;
+      xQueueReceive(requestQueue, &request, 0);
+      modbusMasterSubmit(request, esp_timer_get_time());
+    }
+
+    waitUs = modbusMasterTick(esp_timer_get_time());
+
+    ModbusStats stats = modbusMasterStats();
+    portENTER_CRITICAL(&statsMux);
+    statsSnapshot = stats;
+    portEXIT_CRITICAL(&statsMux);
+  }
+}
+
+// ==================== Public Functions ====================
+
+bool initModbusUart() {
+  if (MODBUS_TX_PIN < 0 || MODBUS_RX_PIN < 0) {
+    Serial.println("[MODBUS] No RS-485 transceiver configured");
+    return false;
+  }
+
+  // RTU: 8 data bits; without parity, two stop bits keep the character at 11 bits
+  uart_config_t config = {};
+  config.baud_rate = MODBUS_BAUD;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = MODBUS_PARITY == 'E' ? UART_PARITY_EVEN
+                : MODBUS_PARITY == 'O' ? UART_PARITY_ODD : UART_PARITY_DISABLE;
+  config.stop_bits = config.parity == UART_PARITY_DISABLE ? UART_STOP_BITS_2 : UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_APB;
+
+  if (uart_driver_install(MODBUS_UART_PORT, MODBUS_RX_BUFFER, 0, MODBUS_EVENT_QUEUE_LEN,
+                          &uartEvents, 0) != ESP_OK) {
+    Serial.println("[MODBUS] UART driver install failed");
+    return false;
+  }
+  uart_param_config(MODBUS_UART_PORT, &config);
+  uart_set_pin(MODBUS_UART_PORT, MODBUS_TX_PIN, MODBUS_RX_PIN, MODBUS_DE_PIN, UART_PIN_NO_CHANGE);
+  uart_set_mode(MODBUS_UART_PORT, UART_MODE_RS485_HALF_DUPLEX);
+  uart_set_rx_timeout(MODBUS_UART_PORT, silenceSymbols());
+
+  requestQueue = xQueueCreate(MODBUS_QUEUE_LEN, sizeof(ModbusRequest));
+  resultQueue = xQueueCreate(MODBUS_RESULT_QUEUE_LEN, sizeof(ModbusResult));
+  busEvents = xQueueCreateSet(MODBUS_EVENT_QUEUE_LEN + MODBUS_QUEUE_LEN);
+  xQueueAddToSet(uartEvents, busEvents);
+  xQueueAddToSet(requestQueue, busEvents);
+
+  // Broadcast turnaround: the slaves need a few characters to process
+  uint32_t charUs = 1000000UL * MODBUS_CHAR_BITS / MODBUS_BAUD;
+  modbusMasterBegin(sendFrame, queueResult, MODBUS_RESPONSE_TIMEOUT * 1000UL, 10 * charUs + 1000);
+
+  xTaskCreatePinnedToCore(busTask, "modbus", MODBUS_TASK_STACK, nullptr, MODBUS_TASK_PRIORITY,
+                          nullptr, ARDUINO_RUNNING_CORE);
+  running = true;
+
+  Serial.print("[MODBUS] ✓ RTU master on UART2 (TX ");
+  Serial.print(MODBUS_TX_PIN);
+  Serial.print(", RX ");
+  Serial.print(MODBUS_RX_PIN);
+  Serial.print(", DE ");
+  Serial.print(MODBUS_DE_PIN);
+  Serial.print(") ");
+  Serial.print(MODBUS_BAUD);
+  Serial.print(" 8");
+  Serial.print((char)MODBUS_PARITY);
+  Serial.print(config.parity == UART_PARITY_DISABLE ? "2" : "1");
+  Serial.print(", frame silence ");
+  Serial.print(silenceSymbols());
+  Serial.println(" symbols");
+  return true;
+}
+
+bool modbusSubmit(const ModbusRequest& request) {
+  if (!running) return false;
+  return xQueueSend(requestQueue, &request, 0) == pdTRUE;
+}
+
+bool modbusReceive(ModbusResult& result) {
+  if (!running) return false;
+  return xQueueReceive(resultQueue, &result, 0) == pdTRUE;
+}
+
+ModbusStats getModbusStats(uint32_t* dropped) {
+  portENTER_CRITICAL(&statsMux);
+  ModbusStats stats = statsSnapshot;
+  portEXIT_CRITICAL(&statsMux);
+  if (dropped) *dropped = droppedResults;
+  return stats;
+}
+
+uint32_t takeModbusLatencyPeak() {
+  portENTER_CRITICAL(&statsMux);
+  uint32_t peak = latencyPeak;
+  latencyPeak = 0;
+  portEXIT_CRITICAL(&statsMux);
+  return peak;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file network_settings.cpp
+ * @brief Optional network settings (static IP, broker, device name) implementation
+ */
+
+#include "network_settings.h"
+#include <Preferences.h>
+#include <WiFi.h>
+
+#define NVS_NAMESPACE "wifi"  // Shared with the credentials: cleared together
+
+static bool staticApplied = false;  // Station currently configured with a static IP
+
+// ==================== Helpers ====================
+
+static IPAddress toIPAddress(const uint8_t* bytes) {
+  return IPAddress(bytes[0], bytes[1], bytes[2], bytes[3]);
+}
+
+// ==================== Public Functions ====================
+
+void loadNetworkSettings(NetworkSettings* settings) {
+  memset(settings, 0, sizeof(NetworkSettings));
+
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, true);
+  prefs.getBytes("ip", settings->ip, sizeof(settings->ip));
+  prefs.getBytes("gateway", settings->gateway, sizeof(settings->gateway));
+  prefs.getBytes("subnet", settings->subnet, sizeof(settings->subnet));
+  prefs.getBytes("dns", settings->dns, sizeof(settings->dns));
+  String host = prefs.getString("mqtt_host", "");
+  String user = prefs.getString("mqtt_user", "");
+  String pass = prefs.getString("mqtt_pass", "");
+  settings->mqttPort = prefs.getUShort("mqtt_port", 0);
+  String name = prefs.getString("name", "");
+  prefs.end();
+
+  strncpy(settings->mqttHost, host.c_str(), sizeof(settings->mqttHost) - 1);
+  strncpy(settings->mqttUser, user.c_str(), sizeof(settings->mqttUser) - 1);
+  strncpy(settings->mqttPass, pass.c_str(), sizeof(settings->mqttPass) - 1);
+  strncpy(settings->deviceName, name.c_str(), sizeof(settings->deviceName) - 1);
+}
+
+void saveNetworkSettings(const NetworkSettings& settings) {
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putBytes("ip", settings.ip, sizeof(settings.ip));
+  prefs.putBytes("gateway", settings.gateway, sizeof(settings.gateway));
+  prefs.putBytes("subnet", settings.subnet, sizeof(settings.subnet));
+  prefs.putBytes("dns", settings.dns, sizeof(settings.dns));
+  prefs.putString("mqtt_host", settings.mqttHost);
+  prefs.putString("mqtt_user", settings.mqttUser);
+  prefs.putString("mqtt_pass", settings.mqttPass);
+  prefs.putUShort("mqtt_port", settings.mqttPort);
+  prefs.putString("name", settings.deviceName);
+  prefs.end();
+
+  Serial.println("[NVS] ✓ Saved network settings");
+}
+
+void mergeNetworkSettings(NetworkSettings* stored, const NetworkSettings& received, uint8_t fields) {
+  if (fields & NETWORK_FIELD_STATIC_IP) {
+    memcpy(stored->ip, received.ip, sizeof(stored->ip));
+    memcpy(stored->gateway, received.gateway, sizeof(stored->gateway));
+    memcpy(stored->subnet, received.subnet, sizeof(stored->subnet));
+    memcpy(stored->dns, received.dns, sizeof(stored->dns));
+  }
+  if (fields & NETWORK_FIELD_MQTT_HOST) {
+    memcpy(stored->mqttHost, received.mqttHost, sizeof(stored->mqttHost));
+    memcpy(stored->mqttUser, received.mqttUser, sizeof(stored->mqttUser));
+    memcpy(stored->mqttPass, received.mqttPass, sizeof(stored->mqttPass));
+  }
+  if (fields & NETWORK_FIELD_MQTT_PORT) {
+    stored->mqttPort = received.mqttPort;
+  }
+  if (fields & NETWORK_FIELD_DEVICE_NAME) {
+    memcpy(stored->deviceName, received.deviceName, sizeof(stored->deviceName));
+  }
+}
+
+void applyNetworkSettings(const NetworkSettings& settings) {
+  if (settings.deviceName[0] != '\0') {
+    WiFi.setHostname(settings.deviceName);
+    Serial.print("[WiFi] Hostname: ");
+    Serial.println(settings.deviceName);
+  }
+
+  if (hasStaticIP(settings)) {
+    WiFi.config(toIPAddress(settings.ip), toIPAddress(settings.gateway),
+                toIPAddress(settings.subnet), toIPAddress(settings.dns));
+    staticApplied = true;
+    Serial.print("[WiFi] Static IP: ");
+    Serial.println(toIPAddress(settings.ip).toString());
+  } else if (staticApplied) {
+    // All-zero addresses switch the station back to DHCP
+    WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
+    staticApplied = false;
+  }
+}
+
+bool hasStaticIP(const NetworkSettings& settings) {
+  return settings.ip[0] | settings.ip[1] | settings.ip[2] | settings.ip[3];
+}
@@ -0,0 +1,29 @@
+/**
+ * @file power_kernel.cpp
+ * @brief Fixed-point per-cycle power kernel implementation
+ */
+
+#include "power_kernel.h"
+#include <math.h>
+#include <string.h>
+
+void kernelReset(PowerKernel& k, uint32_t rate, uint32_t mainsFrequency, bool hasVoltage) {
+  memset(&k, 0, sizeof(k));
+  k.offsetI = 2048 << 16;  // Mid-scale bias: converges from the right place
+  k.offsetV = 2048 << 16;
+  k.hasVoltage = hasVoltage;
+  uint32_t nominal = rate / mainsFrequency;
+  k.minSamples = nominal * 3 / 4;
+  k.maxSamples = nominal * 2;
+}
+
+void addSums(PowerSums& total, const PowerSums& cycle) {
+  total.samples += cycle.samples;
+  total.sumI2 += cycle.sumI2;
+  total.sumV2 += cycle.sumV2;
+  total.sumVI += cycle.sumVI;
+}
+
+float rmsOf(uint64_t sum, uint32_t samples) {
+  return samples ? sqrtf((float)sum / samples) : 0;
+}
@@ -0,0 +1,232 @@
+/**
+ * @file power_profile.cpp
+ * @brief WiFi modem power-save profiles implementation
+ */
+
+#include "power_profile.h"
+#include "ble_provisioning.h"
+#include <WiFi.h>
+#include <Preferences.h>
+#include <esp_wifi.h>
+
+// ==================== State Variables ====================
+static PowerProfile activeProfile = POWER_PROFILE_BALANCED;
+static wifi_ps_type_t effectiveMode = WIFI_PS_MIN_MODEM;
+
+// Benchmark run state
+static bool benchRunning = false;
+static PowerProfile benchProfile = POWER_PROFILE_BALANCED;
+static uint16_t benchSeq = 0;          // Sequence number of the outstanding probe
+static bool probeOutstanding = false;
+static uint32_t probeSentAt = 0;       // millis() when the outstanding probe was sent
+static uint32_t lastProbeDone = 0;     // millis() when the previous probe finished
+static uint8_t probesDone = 0;
+static uint32_t benchSumMs = 0;
+static PowerBenchResult benchResults[POWER_PROFILE_COUNT];
+static bool benchValid[POWER_PROFILE_COUNT] = {false, false, false};
+
+static const char* const PROFILE_NAMES[POWER_PROFILE_COUNT] = {
+  "performance", "balanced", "eco"
+};
+
+// ==================== Helpers ====================
+
+/**
+ * Modem sleep mode for a profile
+ * IDF refuses WIFI_PS_NONE while the Bluetooth controller coexists with
+ * WiFi, so performance keeps minimum modem sleep until Bluetooth is released.
+ */
+static wifi_ps_type_t psModeFor(PowerProfile profile) {
+  if (profile == POWER_PROFILE_PERFORMANCE) return isBLEReleased() ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM;
+  if (profile == POWER_PROFILE_ECO) return WIFI_PS_MAX_MODEM;
+  return WIFI_PS_MIN_MODEM;
+}
+
+/**
+ * Listen interval for a profile (0 = driver default of 3 beacons)
+ */
+static uint16_t listenIntervalFor(PowerProfile profile) {
+  return profile == POWER_PROFILE_ECO ? POWER_ECO_LISTEN_INTERVAL : 0;
+}
+
+/**
+ * Write the listen interval into the station config
+ * @return true if the stored config changed
+ */
+static bool setListenInterval(uint16_t interval) {
+  wifi_config_t conf;
+  if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK) return false;
+  if (conf.sta.listen_interval == interval) return false;
+
+  conf.sta.listen_interval = interval;
+  return esp_wifi_set_config(WIFI_IF_STA, &conf) == ESP_OK;
+}
+
+// ==================== Public Functions ====================
+
+void initPowerProfile() {
+  Preferences prefs;
+  prefs.begin("power", true); // read-only
+  uint8_t saved = prefs.getUChar("profile", POWER_PROFILE_BALANCED);
+  prefs.end();
+
+  if (saved >= POWER_PROFILE_COUNT) saved = POWER_PROFILE_BALANCED;
+  activeProfile = (PowerProfile)saved;
+
+  Serial.print("[POWER] Profile: ");
+  Serial.println(powerProfileName(activeProfile));
+
+  // Preset the mode so the first association already uses it
+  effectiveMode = psModeFor(activeProfile);
+  WiFi.setSleep(effectiveMode);
+}
+
+bool applyPowerProfile(PowerProfile profile, bool persist) {
+  if (profile >= POWER_PROFILE_COUNT) return false;
+
+  // WiFi.setSleep() remembers the mode so a later WiFi.mode()/begin() keeps it
+  wifi_ps_type_t mode = psModeFor(profile);
+  bool ok = WiFi.setSleep(mode);
+  effectiveMode = mode;
+  if (profile == POWER_PROFILE_PERFORMANCE && mode != WIFI_PS_NONE) {
+    Serial.println("[POWER] Bluetooth active - performance keeps minimum modem sleep");
+  }
+
+  // Listen interval is only negotiated on association: renew a live link
+  if (setListenInterval(listenIntervalFor(profile)) && WiFi.status() == WL_CONNECTED) {
+    Serial.println("[POWER] Listen interval changed - renewing association");
+    esp_wifi_disconnect();
+    esp_wifi_connect();
+  }
+
+  activeProfile = profile;
+
+  if (persist) {
+    Preferences prefs;
+    prefs.begin("power", false); // read-write
+    prefs.putUChar("profile", (uint8_t)profile);
+    prefs.end();
+  }
+
+  Serial.print("[POWER] Applied profile: ");
+  Serial.print(powerProfileName(profile));
+  Serial.println(ok ? " OK" : " FAIL");
+  return ok;
+}
+
+void onPowerProfileAssociated() {
+  applyPowerProfile(activeProfile, false);
+}
+
+PowerProfile getPowerProfile() {
+  return activeProfile;
+}
+
+const char* getEffectivePowerSave() {
+  if (effectiveMode == WIFI_PS_NONE) return "none";
+  if (effectiveMode == WIFI_PS_MAX_MODEM) return "max_modem";
+  return "min_modem";
+}
+
+const char* powerProfileName(PowerProfile profile) {
+  if (profile >= POWER_PROFILE_COUNT) return "unknown";
+  return PROFILE_NAMES[profile];
+}
+
+bool parsePowerProfile(const String& name, PowerProfile* profile) {
+  for (int i = 0; i < POWER_PROFILE_COUNT; i++) {
+    if (name.equalsIgnoreCase(PROFILE_NAMES[i])) {
+      *profile = (PowerProfile)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ==================== Latency Benchmark ====================
+
+void startPowerBench() {
+  benchRunning = true;
+  benchProfile = activeProfile;
+  probeOutstanding = false;
+  probesDone = 0;
+  benchSumMs = 0;
+  lastProbeDone = millis();
+
+  PowerBenchResult& r = benchResults[benchProfile];
+  r.samples = 0;
+  r.lost = 0;
+  r.minMs = UINT32_MAX;
+  r.avgMs = 0;
+  r.maxMs = 0;
+
+  Serial.print("[POWER] Latency benchmark started for profile: ");
+  Serial.println(powerProfileName(benchProfile));
+}
+
+bool isPowerBenchRunning() {
+  return benchRunning;
+}
+
+PowerBenchEvent servicePowerBench(uint16_t* seq) {
+  if (!benchRunning) return POWER_BENCH_IDLE;
+
+  uint32_t now = millis();
+  PowerBenchResult& r = benchResults[benchProfile];
+
+  if (probeOutstanding) {
+    if (now - probeSentAt < POWER_BENCH_TIMEOUT) return POWER_BENCH_IDLE;
+    // Probe lost (broker drop or radio asleep for too long)
+    probeOutstanding = false;
+    r.lost++;
+    probesDone++;
+    lastProbeDone = now;
+  }
+
+  if (probesDone >= POWER_BENCH_SAMPLES) {
+    benchRunning = false;
+    if (r.samples == 0) r.minMs = 0;
+    r.avgMs = r.samples ? benchSumMs / r.samples : 0;
+    benchValid[benchProfile] = true;
+
+    Serial.print("[POWER] Benchmark done: min=");
+    Serial.print(r.minMs);
+    Serial.print("ms avg=");
+    Serial.print(r.avgMs);
+    Serial.print("ms max=");
+    Serial.print(r.maxMs);
+    Serial.print("ms lost=");
+    Serial.println(r.lost);
+    return POWER_BENCH_FINISHED;
+  }
+
+  if (now - lastProbeDone < POWER_BENCH_SPACING) return POWER_BENCH_IDLE;
+
+  benchSeq++;
+  *seq = benchSeq;
+  probeOutstanding = true;
+  probeSentAt = now;
+  return POWER_BENCH_SEND_PROBE;
+}
+
+void onPowerBenchEcho(uint16_t seq) {
+  if (!benchRunning || !probeOutstanding || seq != benchSeq) return;
+
+  uint32_t now = millis();
+  uint32_t rtt = now - probeSentAt;
+  PowerBenchResult& r = benchResults[benchProfile];
+
+  probeOutstanding = false;
+  probesDone++;
+  lastProbeDone = now;
+
+  r.samples++;
+  benchSumMs += rtt;
+  if (rtt < r.minMs) r.minMs = rtt;
+  if (rtt > r.maxMs) r.maxMs = rtt;
+}
+
+const PowerBenchResult* getPowerBenchResult(PowerProfile profile) {
+  if (profile >= POWER_PROFILE_COUNT || !benchValid[profile]) return nullptr;
+  return &benchResults[profile];
+}
@@ -0,0 +1,79 @@
+/**
+ * @file provisioning_tlv.cpp
+ * @brief Parser of the single-write provisioning record implementation
+ */
+
+#include "provisioning_tlv.h"
+#include <ctype.h>
+#include <string.h>
+
+const char* parseProvisioningTLV(const uint8_t* data, size_t size, ProvisioningData* out) {
+  memset(out, 0, sizeof(ProvisioningData));
+  bool hasUser = false;
+  bool hasPass = false;
+
+  for (size_t i = 0; i < size; ) {
+    if (i + 2 > size) return "invalid_tlv";
+    uint8_t type = data[i];
+    uint8_t length = data[i + 1];
+    const uint8_t* field = data + i + 2;
+    if (i + 2 + length > size) return "invalid_tlv";
+    i += 2 + length;
+
+    switch (type) {
+      case TLV_SSID:
+        if (length == 0 || length > 32) return "invalid_ssid";
+        memcpy(out->ssid, field, length);
+        break;
+      case TLV_PASSWORD:
+        if (length > 63) return "invalid_password";
+        memcpy(out->password, field, length);
+        break;
+      case TLV_STATIC_IP:
+        if (length != 16) return "invalid_ip";
+        memcpy(out->settings.ip, field, 4);
+        memcpy(out->settings.gateway, field + 4, 4);
+        memcpy(out->settings.subnet, field + 8, 4);
+        memcpy(out->settings.dns, field + 12, 4);
+        out->settingsFields |= NETWORK_FIELD_STATIC_IP;
+        break;
+      case TLV_MQTT_HOST:
+        if (length == 0 || length > 63) return "invalid_mqtt_host";
+        memcpy(out->settings.mqttHost, field, length);
+        out->settingsFields |= NETWORK_FIELD_MQTT_HOST;
+        break;
+      case TLV_MQTT_PORT:
+        if (length != 2) return "invalid_mqtt_port";
+        out->settings.mqttPort = (field[0] << 8) | field[1];
+        out->settingsFields |= NETWORK_FIELD_MQTT_PORT;
+        break;
+      case TLV_MQTT_USER:
+        if (length > 63) return "invalid_mqtt_credentials";
+        memcpy(out->settings.mqttUser, field, length);
+        hasUser = true;
+        break;
+      case TLV_MQTT_PASS:
+        if (length > 63) return "invalid_mqtt_credentials";
+        memcpy(out->settings.mqttPass, field, length);
+        hasPass = true;
+        break;
+      case TLV_DEVICE_NAME:
+        if (length == 0 || length > 31) return "invalid_name";
+        for (uint8_t c = 0; c < length; c++) {
+          if (!isalnum(field[c]) && field[c] != '-') return "invalid_name";
+        }
+        memcpy(out->settings.deviceName, field, length);
+        out->settingsFields |= NETWORK_FIELD_DEVICE_NAME;
+        break;
+      default:
+        break; // Newer dashboard: ignore
+    }
+  }
+
+  if (out->ssid[0] == '\0') return "invalid_ssid";
+  // Credentials only travel with the host they are for, and a host never
+  // goes without them (the built-in ones are not sent to it)
+  bool hasHost = out->settingsFields & NETWORK_FIELD_MQTT_HOST;
+  if (hasHost != hasUser || (hasPass && !hasHost)) return "invalid_mqtt_credentials";
+  return nullptr;
+}
@@ -0,0 +1,400 @@
+/**
+ * @file pump_monitor.cpp
+ * @brief Pump current monitoring, protection and energy accounting implementation
+ */
+
+#include "pump_monitor.h"
+#include "power_kernel.h"
+#include "analog_sensors.h"
+#include "config.h"
+#include <Preferences.h>
+
+#define NVS_NAMESPACE       "pump"
+#define ADC_FULL_SCALE      3.3f        // Volts at 4095 counts (11 dB attenuation)
+#define SELFTEST_CYCLES     30
+#define SELFTEST_RATE       4000        // Sample rate of the self-test if the ADC is not running
+
+// ==================== State Variables ====================
+static PowerKernel kernel;
+static bool available = false;
+static float ampsPerCount = 0;            // Per Q3 count
+static float voltsPerCount = 0;
+
+// Window being accumulated by the kernel callback, and the last complete one
+static PowerSums window;
+static uint8_t windowCycles = 0;
+static PowerSums completed;
+static bool completedReady = false;
+
+static PumpPower power;
+static bool running = false;
+static uint32_t startedAt = 0;
+static PumpEvent alarm = PUMP_EVENT_NONE;
+static PumpEvent pendingEvent = PUMP_EVENT_NONE;
+static uint32_t pendingSince = 0;
+static uint32_t lastWindowAt = 0;
+static uint32_t lastEnergySave = 0;
+static uint32_t runMs = 0;                // Running time not yet added to runSeconds
+
+// CT presence check (raw current samples until PUMP_CT_DETECT_TIME)
+static bool ctConfirmed = false;
+static bool ctDetecting = false;
+static uint32_t ctDetectStart = 0;
+static uint16_t ctMin = 0;
+static uint16_t ctMax = 0;
+static uint64_t ctSum = 0;
+static uint32_t ctCount = 0;
+
+// Kernel statistics (PUMP_REPORT_INTERVAL)
+static uint32_t reportStart = 0;
+static uint32_t statSamples = 0;
+static uint32_t statCycles = 0;           // CPU cycles spent in the kernel
+static uint32_t statWindows = 0;
+
+// ==================== Waveform Handler ====================
+
+/**
+ * Waveform handler (loop task, inside serviceAnalogSensors())
+ */
+static void onWaveform(const uint16_t* current, const uint16_t* voltage, size_t count) {
+  if (ctDetecting) {
+    for (size_t n = 0; n < count; n++) {
+      if (ctCount == 0 || current[n] < ctMin) ctMin = current[n];
+      if (ctCount == 0 || current[n] > ctMax) ctMax = current[n];
+      ctSum += current[n];
+      ctCount++;
+    }
+  }
+
+  uint32_t startCycles = ESP.getCycleCount();
+  PowerSums cycle;
+  for (size_t n = 0; n < count; n++) {
+    if (!kernelSample(kernel, current[n], voltage ? voltage[n] : 0, cycle)) continue;
+    addSums(window, cycle);
+    if (++windowCycles < PUMP_WINDOW_CYCLES) continue;
+
+    completed = window;
+    completedReady = true;
+    memset(&window, 0, sizeof(window));
+    windowCycles = 0;
+  }
+  statCycles += ESP.getCycleCount() - startCycles;
+  statSamples += count;
+}
+
+// ==================== Self-Test ====================
+
+/**
+ * Run a synthetic waveform of known RMS and power factor through a kernel
+ * Current 1000 counts peak lagging by acos(pf), voltage 1200 counts peak,
+ * both around mid-scale and rounded to integer counts like the ADC. The
+ * first cycle (bias and crossing lock-in) is discarded.
+ * @param cyclesPerSample Receives the kernel cost in CPU cycles per sample
+ */
+static void selfTestCase(uint32_t rate, bool hasVoltage, float pf, float* currentError,
+                         float* voltageError, float* measuredPf, float* cyclesPerSample) {
+  const float currentPeak = 1000;
+  const float voltagePeak = 1200;
+  PowerKernel k;
+  kernelReset(k, rate, MAINS_FREQUENCY, hasVoltage);
+
+  PowerSums total = {0, 0, 0, 0};
+  PowerSums cycle;
+  uint8_t cycles = 0;
+  uint32_t samples = rate / MAINS_FREQUENCY * SELFTEST_CYCLES;
+  float lag = acosf(pf);
+  uint32_t kernelCycles = 0;
+  for (uint32_t n = 0; n < samples; n++) {
+    float phase = 2 * PI * MAINS_FREQUENCY * n / rate;
+    uint16_t rawV = (uint16_t)lroundf(2048 + voltagePeak * sinf(phase));
+    uint16_t rawI = (uint16_t)lroundf(2048 + currentPeak * sinf(phase - lag));
+
+    uint32_t start = ESP.getCycleCount();
+    bool closed = kernelSample(k, rawI, rawV, cycle);
+    kernelCycles += ESP.getCycleCount() - start;
+    if (closed && cycles++ > 0) addSums(total, cycle);
+  }
+
+  float scale = 1 << KERNEL_FRAC_BITS;
+  float expectedI = currentPeak / sqrtf(2);
+  float expectedV = voltagePeak / sqrtf(2);
+  float rmsI = rmsOf(total.sumI2, total.samples) / scale;
+  float rmsV = rmsOf(total.sumV2, total.samples) / scale;
+  *currentError = (rmsI - expectedI) / expectedI * 100;
+  *voltageError = hasVoltage ? (rmsV - expectedV) / expectedV * 100 : 0;
+  *measuredPf = hasVoltage && total.samples
+                    ? (float)total.sumVI / total.samples / (scale * scale) / (rmsI * rmsV)
+                    : NAN;
+  *cyclesPerSample = (float)kernelCycles / samples;
+}
+
+/**
+ * Validate the kernel against synthetic waveforms and log the errors
+ */
+static void selfTest(uint32_t rate) {
+  float currentError, voltageError, pf, cyclesPerSample;
+
+  selfTestCase(rate, true, 0.8f, &currentError, &voltageError, &pf, &cyclesPerSample);
+  Serial.print("[PUMP] Kernel self-test (V+I, ");
+  Serial.print(rate);
+  Serial.print(" Hz): current RMS error ");
+  Serial.print(currentError, 2);
+  Serial.print("%, voltage RMS error ");
+  Serial.print(voltageError, 2);
+  Serial.print("%, PF 0.800 -> ");
+  Serial.print(pf, 3);
+  Serial.print(", ");
+  Serial.print(cyclesPerSample, 1);
+  Serial.println(" cycles/sample");
+
+  selfTestCase(rate, false, 1.0f, &currentError, &voltageError, &pf, &cyclesPerSample);
+  Serial.print("[PUMP] Kernel self-test (I only): current RMS error ");
+  Serial.print(currentError, 2);
+  Serial.print("%, ");
+  Serial.print(cyclesPerSample, 1);
+  Serial.println(" cycles/sample");
+}
+
+// ==================== Energy Counter ====================
+
+/**
+ * Store the energy and running time counters in NVS
+ */
+static void saveEnergy() {
+  power.runSeconds += runMs / 1000;
+  runMs %= 1000;
+
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putDouble("wh", power.energyWh);
+  prefs.putUInt("runs", power.runSeconds);
+  prefs.end();
+  lastEnergySave = millis();
+}
+
+// ==================== Event Detection ====================
+
+/**
+ * Close the boot check of the CT input once PUMP_CT_DETECT_TIME passed
+ */
+static void finishCTDetection(uint32_t now) {
+  if (!ctDetecting || now - ctDetectStart < PUMP_CT_DETECT_TIME) return;
+  ctDetecting = false;
+
+  uint32_t bias = ctCount ? (uint32_t)(ctSum / ctCount) : 0;
+  uint16_t noise = ctCount ? ctMax - ctMin : 0;
+  if (bias >= PUMP_CT_BIAS_MIN && bias <= PUMP_CT_BIAS_MAX && noise >= PUMP_CT_MIN_NOISE) {
+    ctConfirmed = true;
+  }
+  Serial.print("[PUMP] CT input: bias ");
+  Serial.print(bias);
+  Serial.print(" counts, noise ");
+  Serial.print(noise);
+  Serial.println(ctConfirmed ? " counts - CT present" : " counts - CT not confirmed, events off until current is measured");
+}
+
+/**
+ * Fault condition of a window (not yet confirmed)
+ */
+static PumpEvent classify(uint32_t now) {
+  // Inrush, and a window that started before the relay closed
+  if (now - startedAt < PUMP_START_GRACE) return PUMP_EVENT_NONE;
+
+  // Without a confirmed CT, no current is no information (and no load would follow)
+  if (power.current < PUMP_NO_CURRENT) return ctConfirmed ? PUMP_EVENT_NO_CURRENT : PUMP_EVENT_NONE;
+  if (power.current > PUMP_RATED_CURRENT * PUMP_LOCKED_FACTOR) return PUMP_EVENT_LOCKED_ROTOR;
+  if (power.current > PUMP_RATED_CURRENT * PUMP_OVERLOAD_FACTOR) return PUMP_EVENT_OVERLOAD;
+
+  // A dry pump moves no water: real power drops more than current
+  float load = kernel.hasVoltage ? power.power / PUMP_RATED_POWER
+                                 : power.current / PUMP_RATED_CURRENT;
+  if (load < PUMP_NO_LOAD_FRACTION) return PUMP_EVENT_NO_LOAD;
+  return PUMP_EVENT_NONE;
+}
+
+/**
+ * Time a condition must persist before it is reported (ms)
+ */
+static uint32_t persistenceOf(PumpEvent event) {
+  switch (event) {
+    case PUMP_EVENT_NO_CURRENT:   return PUMP_NO_CURRENT_TIME;
+    case PUMP_EVENT_NO_LOAD:      return PUMP_NO_LOAD_TIME;
+    case PUMP_EVENT_OVERLOAD:     return PUMP_OVERLOAD_TIME;
+    case PUMP_EVENT_LOCKED_ROTOR: return PUMP_LOCKED_TIME;
+    default:                      return 0;
+  }
+}
+
+/**
+ * Log kernel cost and throughput once per PUMP_REPORT_INTERVAL
+ */
+static void logReport(uint32_t now) {
+  uint32_t elapsed = now - reportStart;
+  if (elapsed < PUMP_REPORT_INTERVAL) return;
+
+  Serial.print("[PUMP] Kernel: ");
+  Serial.print(statSamples ? (float)statCycles / statSamples : 0, 1);
+  Serial.print(" cycles/sample, ");
+  Serial.print((uint32_t)((uint64_t)statSamples * 1000 / elapsed));
+  Serial.print(" samples/s, ");
+  Serial.print(statWindows);
+  Serial.print(" windows, energy ");
+  Serial.print(power.energyWh, 0);
+  Serial.println(" Wh");
+
+  reportStart = now;
+  statSamples = 0;
+  statCycles = 0;
+  statWindows = 0;
+}
+
+// ==================== Public Functions ====================
+
+void initPumpMonitor() {
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, true);
+  power.energyWh = prefs.getDouble("wh", 0);
+  power.runSeconds = prefs.getUInt("runs", 0);
+  prefs.end();
+  power.current = NAN;
+  power.voltage = NAN;
+  power.power = NAN;
+  power.powerFactor = NAN;
+
+  uint32_t rate = getAnalogChannelRate();
+  selfTest(rate ? rate : SELFTEST_RATE);
+
+  if (!hasAnalogCurrent()) {
+    Serial.println("[PUMP] No current transformer - monitoring disabled");
+    return;
+  }
+
+  float volts = ADC_FULL_SCALE / 4095 / (1 << KERNEL_FRAC_BITS);
+  ampsPerCount = volts * PUMP_CT_AMPS_PER_VOLT;
+  voltsPerCount = volts * MAINS_VOLTS_PER_VOLT;
+  kernelReset(kernel, rate, MAINS_FREQUENCY, hasAnalogVoltage());
+  memset(&window, 0, sizeof(window));
+  setAnalogWaveformCallback(onWaveform);
+
+  available = true;
+  ctDetecting = true;
+  ctDetectStart = millis();
+  lastWindowAt = millis();
+  reportStart = millis();
+
+  Serial.print("[PUMP] ✓ Current monitoring (");
+  Serial.print(kernel.hasVoltage ? "current + voltage" : "current only, nominal voltage");
+  Serial.print("), energy ");
+  Serial.print(power.energyWh, 0);
+  Serial.println(" Wh");
+}
+
+void setPumpMonitorRunning(bool on) {
+  if (on == running) return;
+  running = on;
+  if (on) {
+    startedAt = millis();
+    alarm = PUMP_EVENT_NONE;  // New start: the previous trip was acknowledged
+    pendingEvent = PUMP_EVENT_NONE;
+  } else if (available) {
+    saveEnergy();
+  }
+}
+
+PumpEvent servicePumpMonitor() {
+  if (!available || !completedReady) return PUMP_EVENT_NONE;
+  completedReady = false;
+  statWindows++;
+
+  uint32_t now = millis();
+  uint32_t elapsed = now - lastWindowAt;
+  lastWindowAt = now;
+
+  float rmsI = rmsOf(completed.sumI2, completed.samples);
+  power.current = rmsI * ampsPerCount;
+  if (kernel.hasVoltage) {
+    float rmsV = rmsOf(completed.sumV2, completed.samples);
+    power.voltage = rmsV * voltsPerCount;
+    // A reversed CT reads negative power
+    float mean = completed.samples ? (float)completed.sumVI / completed.samples : 0;
+    power.power = fabsf(mean) * ampsPerCount * voltsPerCount;
+    float apparent = power.voltage * power.current;
+    power.powerFactor = apparent > 0 ? power.power / apparent : NAN;
+  } else {
+    power.voltage = MAINS_VOLTAGE;
+    power.power = MAINS_VOLTAGE * power.current * PUMP_NOMINAL_PF;
+    power.powerFactor = NAN;
+  }
+
+  finishCTDetection(now);
+
+  // Energy and running time count whenever the motor draws current
+  // (also a relay stuck closed)
+  if (power.current >= PUMP_NO_CURRENT) {
+    if (!ctConfirmed) Serial.println("[PUMP] CT confirmed by measured current");
+    ctConfirmed = true;
+    power.energyWh += power.power * elapsed / 3600000.0;
+    runMs += elapsed;
+    if (now - lastEnergySave >= PUMP_ENERGY_SAVE_INTERVAL) saveEnergy();
+  }
+  logReport(now);
+
+  if (!running) {
+    pendingEvent = PUMP_EVENT_NONE;
+    return PUMP_EVENT_NONE;
+  }
+
+  PumpEvent candidate = classify(now);
+  if (candidate != pendingEvent) {
+    pendingEvent = candidate;
+    pendingSince = now;
+  }
+  if (candidate == PUMP_EVENT_NONE || alarm != PUMP_EVENT_NONE) return PUMP_EVENT_NONE;
+  if (now - pendingSince < persistenceOf(candidate)) return PUMP_EVENT_NONE;
+
+  alarm = candidate;
+  Serial.print("[PUMP] ⚠ ");
+  Serial.print(getPumpEventName(alarm));
+  Serial.print(": ");
+  Serial.print(power.current, 2);
+  Serial.print(" A, ");
+  Serial.print(power.power, 0);
+  Serial.print(" W, PF ");
+  Serial.println(power.powerFactor, 2);
+  return alarm;
+}
+
+bool isPumpMonitorAvailable() {
+  return available;
+}
+
+PumpPower getPumpPower() {
+  return power;
+}
+
+PumpEvent getPumpAlarm() {
+  return alarm;
+}
+
+const char* getPumpEventName(PumpEvent event) {
+  switch (event) {
+    case PUMP_EVENT_NO_CURRENT:   return "no_current";
+    case PUMP_EVENT_NO_LOAD:      return "no_load";
+    case PUMP_EVENT_OVERLOAD:     return "overload";
+    case PUMP_EVENT_LOCKED_ROTOR: return "locked_rotor";
+    default:                      return "none";
+  }
+}
+
+String getPumpPowerJSON() {
+  String json = "{";
+  json += "\"current\":" + (isnan(power.current) ? String("null") : String(power.current, 2)) + ",";
+  json += "\"voltage\":" + (isnan(power.voltage) ? String("null") : String(power.voltage, 0)) + ",";
+  json += "\"power\":" + (isnan(power.power) ? String("null") : String(power.power, 0)) + ",";
+  json += "\"pf\":" + (isnan(power.powerFactor) ? String("null") : String(power.powerFactor, 2)) + ",";
+  json += "\"energy_wh\":" + String(power.energyWh, 0) + ",";
+  json += "\"run_hours\":" + String((power.runSeconds + runMs / 1000) / 3600.0, 1) + ",";
+  json += "\"alarm\":\"" + String(getPumpEventName(alarm)) + "\"";
+  json += "}";
+  return json;
+}
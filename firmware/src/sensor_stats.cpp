@@ -0,0 +1,114 @@
+/**
+ * @file sensor_stats.cpp
+ * @brief Windowed streaming statistics per sensor implementation
+ */
+
+#include "sensor_stats.h"
+#include <esp_timer.h>
+
+/**
+ * One registered sensor
+ */
+struct StatsSensor {
+  const char* name;
+  float deadband;
+  float lastValue;          // Reading the last change is measured from
+  uint32_t lastChangeAt;    // Uptime (s)
+  StatsSeries series;
+};
+
+// JSON keys, in StatsWindow order
+static const char* const windowNames[STATS_WINDOW_COUNT] = {"1m", "15m", "1h", "24h"};
+
+// ==================== State Variables ====================
+static StatsSensor sensors[STATS_MAX_SENSORS];
+static uint8_t sensorCount = 0;
+
+// ==================== Helpers ====================
+
+/**
+ * Seconds since boot (64-bit timer: no 49-day millis() wrap)
+ */
+static uint32_t uptimeSeconds() {
+  return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+/**
+ * Milliseconds since boot (64-bit timer: no 49-day millis() wrap)
+ */
+static uint64_t uptimeMs() {
+  return (uint64_t)(esp_timer_get_time() / 1000);
+}
+
+/**
+ * Format a value for JSON (null if NAN)
+ */
+static String jsonNumber(float value, unsigned int decimals) {
+  return isnan(value) ? String("null") : String(value, decimals);
+}
+
+// ==================== Public Functions ====================
+
+int8_t registerStatsSensor(const char* name, float deadband) {
+  if (sensorCount >= STATS_MAX_SENSORS) {
+    Serial.println("[STATS] Sensor table full");
+    return -1;
+  }
+  StatsSensor& sensor = sensors[sensorCount];
+  sensor.name = name;
+  sensor.deadband = deadband;
+  sensor.lastValue = NAN;
+  sensor.lastChangeAt = uptimeSeconds();
+  resetStatsSeries(&sensor.series);
+  return sensorCount++;
+}
+
+void addStatsSample(int8_t id, float value) {
+  if (id < 0 || id >= sensorCount || isnan(value)) return;
+  StatsSensor& sensor = sensors[id];
+  uint32_t now = uptimeSeconds();
+
+  if (isnan(sensor.lastValue) || fabsf(value - sensor.lastValue) >= sensor.deadband) {
+    sensor.lastValue = value;
+    sensor.lastChangeAt = now;
+  }
+  addStatsSeriesSample(&sensor.series, value, uptimeMs());
+}
+
+SensorStats getSensorStats(int8_t id, StatsWindow window) {
+  if (id < 0 || id >= sensorCount) return {0, NAN, NAN, NAN, NAN};
+  return queryStatsSeries(sensors[id].series, window, uptimeMs());
+}
+
+uint8_t getStatsSensorCount() {
+  return sensorCount;
+}
+
+int8_t findStatsSensor(const char* name) {
+  for (uint8_t i = 0; i < sensorCount; i++) {
+    if (strcasecmp(sensors[i].name, name) == 0) return i;
+  }
+  return -1;
+}
+
+String getSensorStatsJSON(int8_t id) {
+  if (id < 0 || id >= sensorCount) return "{}";
+  const StatsSensor& sensor = sensors[id];
+
+  String json = "{";
+  json += "\"sensor\":\"" + String(sensor.name) + "\",";
+  json += "\"last_change_s\":";
+  json += sensor.series.hasSample ? String(uptimeSeconds() - sensor.lastChangeAt) : String("null");
+  for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+    SensorStats stats = getSensorStats(id, (StatsWindow)w);
+    json += ",\"" + String(windowNames[w]) + "\":{";
+    json += "\"n\":" + String(stats.count) + ",";
+    json += "\"mean\":" + jsonNumber(stats.mean, 2) + ",";
+    json += "\"std\":" + jsonNumber(stats.stddev, 3) + ",";
+    json += "\"min\":" + jsonNumber(stats.min, 2) + ",";
+    json += "\"max\":" + jsonNumber(stats.max, 2);
+    json += "}";
+  }
+  json += "}";
+  return json;
+}
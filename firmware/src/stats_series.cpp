@@ -0,0 +1,133 @@
+/**
+ * @file stats_series.cpp
+ * @brief Sliding-window statistics of one sensor implementation
+ */
+
+#include "stats_series.h"
+#include <math.h>
+
+// Window lengths (s), in StatsWindow order
+static const uint32_t windowSeconds[STATS_WINDOW_COUNT] = {60, 900, 3600, 86400};
+
+/**
+ * Bucket span of a window (ms)
+ */
+static uint32_t bucketSpanMs(int window) {
+  return windowSeconds[window] * 1000 / STATS_BUCKETS;
+}
+
+/**
+ * Weight of a reading held from a time to another (s): at least 1 ms (two
+ * readings in the same millisecond), at most one bucket
+ */
+static float holdWeight(uint64_t fromMs, uint64_t toMs, uint32_t spanMs) {
+  uint64_t held = toMs - fromMs;
+  if (held < 1) held = 1;
+  if (held > spanMs) held = spanMs;
+  return held / 1000.0f;
+}
+
+uint32_t statsWindowSeconds(StatsWindow window) {
+  return window < STATS_WINDOW_COUNT ? windowSeconds[window] : 0;
+}
+
+void statsBucketReset(StatsBucket* bucket, uint32_t slot) {
+  bucket->slot = slot;
+  bucket->count = 0;
+  bucket->weight = 0;
+  bucket->mean = 0;
+  bucket->m2 = 0;
+  bucket->min = INFINITY;
+  bucket->max = -INFINITY;
+}
+
+void statsBucketAdd(StatsBucket* bucket, float value, float weight) {
+  bucket->count++;
+  bucket->weight += weight;
+  float delta = value - bucket->mean;
+  bucket->mean += delta * weight / bucket->weight;
+  bucket->m2 += weight * delta * (value - bucket->mean);
+  if (value < bucket->min) bucket->min = value;
+  if (value > bucket->max) bucket->max = value;
+}
+
+void statsBucketMerge(StatsBucket* total, const StatsBucket& bucket) {
+  if (bucket.count == 0) return;
+  if (total->count == 0) {
+    *total = bucket;
+    return;
+  }
+  float weight = total->weight + bucket.weight;
+  float delta = bucket.mean - total->mean;
+  total->mean += delta * bucket.weight / weight;
+  total->m2 += bucket.m2 + delta * delta * total->weight * bucket.weight / weight;
+  total->weight = weight;
+  total->count += bucket.count;
+  if (bucket.min < total->min) total->min = bucket.min;
+  if (bucket.max > total->max) total->max = bucket.max;
+}
+
+void resetStatsSeries(StatsSeries* series) {
+  series->offset = 0;
+  series->pending = NAN;
+  series->pendingAt = 0;
+  series->hasSample = false;
+  for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+      statsBucketReset(&series->buckets[w][b], UINT32_MAX);
+    }
+  }
+}
+
+void addStatsSeriesSample(StatsSeries* series, float value, uint64_t nowMs) {
+  if (!series->hasSample) {
+    series->offset = value;
+  } else {
+    // The previous reading stood until now: into the bucket of its own time
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+      uint32_t span = bucketSpanMs(w);
+      uint32_t slot = series->pendingAt / span;
+      if (nowMs / span - slot >= STATS_BUCKETS) continue;   // Already out of the window
+      StatsBucket& bucket = series->buckets[w][slot % STATS_BUCKETS];
+      if (bucket.slot != slot) statsBucketReset(&bucket, slot);
+      // Shifted data: float keeps its precision for the small deviations
+      // even when the level is large (ORP in mV, pump power in W)
+      statsBucketAdd(&bucket, series->pending - series->offset,
+                     holdWeight(series->pendingAt, nowMs, span));
+    }
+  }
+  series->pending = value;
+  series->pendingAt = nowMs;
+  series->hasSample = true;
+}
+
+SensorStats queryStatsSeries(const StatsSeries& series, StatsWindow window, uint64_t nowMs) {
+  SensorStats stats = {0, NAN, NAN, NAN, NAN};
+  if (window >= STATS_WINDOW_COUNT || !series.hasSample) return stats;
+
+  StatsBucket total;
+  statsBucketReset(&total, 0);
+  uint32_t span = bucketSpanMs(window);
+  uint32_t current = nowMs / span;
+  for (int b = 0; b < STATS_BUCKETS; b++) {
+    const StatsBucket& bucket = series.buckets[window][b];
+    // Only the STATS_BUCKETS most recent slots belong to the window
+    if (bucket.slot == UINT32_MAX || current - bucket.slot >= STATS_BUCKETS) continue;
+    statsBucketMerge(&total, bucket);
+  }
+  // The latest reading, for the time it has stood so far
+  if (current - (uint32_t)(series.pendingAt / span) < STATS_BUCKETS) {
+    StatsBucket latest;
+    statsBucketReset(&latest, current);
+    statsBucketAdd(&latest, series.pending - series.offset, holdWeight(series.pendingAt, nowMs, span));
+    statsBucketMerge(&total, latest);
+  }
+  if (total.count == 0) return stats;
+
+  stats.count = total.count;
+  stats.mean = total.mean + series.offset;
+  stats.stddev = total.weight > 0 ? sqrtf(fmaxf(total.m2, 0) / total.weight) : 0;
+  stats.min = total.min + series.offset;
+  stats.max = total.max + series.offset;
+  return stats;
+}
@@ -0,0 +1,577 @@
+/**
+ * @file temperature.cpp
+ * @brief Non-blocking multi-probe DS18B20 temperature bus implementation
+ */
+
+#include "temperature.h"
+#include "config.h"
+#include "irq_latency.h"
+#include "temperature_filter.h"
+#include "temperature_sampling.h"
+#include <OneWire.h>
+#include <DallasTemperature.h>
+#include <Preferences.h>
+
+#define NVS_NAMESPACE "temp"
+
+#if TEMP_MEDIAN_SIZE < 1 || TEMP_MEDIAN_SIZE > 7
+#error "TEMP_MEDIAN_SIZE must be 1..7"
+#endif
+
+/**
+ * One probe on the bus
+ */
+struct TemperatureProbe {
+  DeviceAddress address;
+  char label[TEMP_LABEL_MAX];
+  float temperature;        // Filtered; NAN until read / when the probe did not answer
+  float reference;          // Reading the drift / rate is measured from
+  float raw;                // Last reading before the filters
+  TemperatureFilter filter;
+};
+
+// ==================== Global Objects ====================
+// Setup OneWire on TEMP_SENSOR_PIN
+static OneWire oneWire(TEMP_SENSOR_PIN);
+static DallasTemperature tempSensor(&oneWire);
+
+// ==================== State Variables ====================
+static TemperatureProbe probes[TEMP_MAX_PROBES];
+static uint8_t probeCount = 0;
+
+static bool conversionRequested = false;
+static bool converting = false;
+static uint8_t collectIndex = 0;          // Next probe to read in the running cycle
+static uint32_t conversionStart = 0;      // millis() when CONVERT T was sent
+static uint32_t conversionWait = 0;       // Deadline relative to conversionStart (ms)
+static uint32_t cycleBusUs = 0;           // Bus time of the running cycle
+static uint32_t cycleMaxStepUs = 0;       // Longest single bus step of the cycle
+
+// Adaptive sampling
+static bool activeMode = false;
+static uint8_t resolution = TEMP_STABLE_RESOLUTION;
+static uint32_t lastCycleStart = 0;
+static uint32_t referenceTime = 0;        // millis() of the probes' reference readings
+static bool referencesPending = false;    // Mode changed: the next cycle (new resolution) takes them
+
+// Sampler statistics of the running report window
+static uint32_t reportStart = 0;
+static uint32_t reportCycles = 0;
+static uint32_t reportConversionMs = 0;   // Probe conversion time (datasheet, per cycle)
+static uint32_t reportBusUs = 0;
+static uint32_t reportActiveMs = 0;       // Time spent in the active mode
+static uint32_t modeSince = 0;
+static float reportErrorMax = 0;          // Estimated tracking error (°C)
+static float reportErrorSum = 0;
+static float reportJitterSum = 0;         // |raw - filtered| of every probe reading
+static uint32_t reportReadings = 0;
+static uint32_t reportSpikes = 0;         // Readings the median kept out
+
+// ==================== Helpers ====================
+
+/**
+ * ROM address as 16 upper case hex digits
+ */
+static void formatAddress(const uint8_t* address, char* text) {
+  for (int i = 0; i < 8; i++) {
+    sprintf(text + i * 2, "%02X", address[i]);
+  }
+}
+
+/**
+ * Find a probe by label or ROM address (case-insensitive)
+ * @return TEMP_MAX_PROBES if unknown
+ */
+static uint8_t findProbe(const char* probe) {
+  char rom[17];
+  for (uint8_t i = 0; i < probeCount; i++) {
+    formatAddress(probes[i].address, rom);
+    if (strcasecmp(probe, probes[i].label) == 0 || strcasecmp(probe, rom) == 0) return i;
+  }
+  return TEMP_MAX_PROBES;
+}
+
+/**
+ * Check a label: 1-15 characters [a-z0-9_-] once lower-cased
+ * Labels become JSON keys and topic-safe names, so nothing else is allowed.
+ */
+static bool validLabel(const char* label) {
+  size_t length = strlen(label);
+  if (length == 0 || length >= TEMP_LABEL_MAX) return false;
+  for (size_t i = 0; i < length; i++) {
+    char c = tolower(label[i]);
+    if (!isalnum(c) && c != '_' && c != '-') return false;
+  }
+  return true;
+}
+
+/**
+ * Check if a label is used by another probe
+ */
+static bool labelInUse(const char* label, uint8_t except) {
+  for (uint8_t i = 0; i < probeCount; i++) {
+    if (i != except && strcasecmp(label, probes[i].label) == 0) return true;
+  }
+  return false;
+}
+
+/**
+ * Load the probe table from NVS
+ */
+static void loadProbes() {
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, true);
+  uint8_t count = prefs.getUChar("count", 0);
+  probeCount = 0;
+  for (uint8_t i = 0; i < count && i < TEMP_MAX_PROBES; i++) {
+    char key[8];
+    TemperatureProbe& probe = probes[probeCount];
+    snprintf(key, sizeof(key), "rom%u", i);
+    if (prefs.getBytes(key, probe.address, sizeof(DeviceAddress)) != sizeof(DeviceAddress)) continue;
+    snprintf(key, sizeof(key), "label%u", i);
+    String label = prefs.getString(key, "");
+    strncpy(probe.label, label.c_str(), TEMP_LABEL_MAX - 1);
+    probe.label[TEMP_LABEL_MAX - 1] = '\0';
+    probe.temperature = NAN;
+    probeCount++;
+  }
+  prefs.end();
+}
+
+/**
+ * Store the probe table in NVS
+ */
+static void saveProbes() {
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putUChar("count", probeCount);
+  for (uint8_t i = 0; i < probeCount; i++) {
+    char key[8];
+    snprintf(key, sizeof(key), "rom%u", i);
+    prefs.putBytes(key, probes[i].address, sizeof(DeviceAddress));
+    snprintf(key, sizeof(key), "label%u", i);
+    prefs.putString(key, probes[i].label);
+  }
+  prefs.end();
+}
+
+/**
+ * Search the bus once and add probes that are not in the table yet
+ * @return true if the table changed
+ */
+static bool discoverProbes() {
+  bool changed = false;
+  uint8_t found = tempSensor.getDeviceCount();
+  for (uint8_t i = 0; i < found; i++) {
+    DeviceAddress address;
+    if (!tempSensor.getAddress(address, i)) continue;
+
+    bool known = false;
+    for (uint8_t p = 0; p < probeCount && !known; p++) {
+      known = memcmp(probes[p].address, address, sizeof(DeviceAddress)) == 0;
+    }
+    if (known) continue;
+
+    if (probeCount >= TEMP_MAX_PROBES) {
+      Serial.println("[SENSOR] Probe table full - extra probe ignored");
+      break;
+    }
+
+    TemperatureProbe& probe = probes[probeCount];
+    memcpy(probe.address, address, sizeof(DeviceAddress));
+    // First probe ever is the pool water probe (single-probe installations)
+    if (!labelInUse(TEMP_PRIMARY_LABEL, TEMP_MAX_PROBES)) {
+      strcpy(probe.label, TEMP_PRIMARY_LABEL);
+    } else {
+      snprintf(probe.label, TEMP_LABEL_MAX, "probe%u", probeCount + 1);
+    }
+    probe.temperature = NAN;
+    probeCount++;
+    changed = true;
+  }
+  return changed;
+}
+
+/**
+ * Write a resolution to every known probe (only on a mode change)
+ * Addressed writes skip the bus search of the global setResolution(). Only
+ * the scratchpad is written: auto-save is off (initTemperature()), so mode
+ * changes never wear the probes' EEPROM.
+ */
+static void applyResolution(uint8_t bits) {
+  for (uint8_t i = 0; i < probeCount; i++) {
+    tempSensor.setResolution(probes[i].address, bits, true /*skipGlobalBitResolutionCalculation*/);
+  }
+  resolution = bits;
+}
+
+/**
+ * Current readings become the references for drift and rate
+ */
+static void resetReferences() {
+  for (uint8_t i = 0; i < probeCount; i++) {
+    probes[i].reference = probes[i].temperature;
+  }
+  referenceTime = millis();
+}
+
+/**
+ * Switch between the stable and the active sampling mode
+ */
+static void setSamplingMode(bool active, float rate) {
+  uint32_t now = millis();
+  if (activeMode) reportActiveMs += now - modeSince;
+  modeSince = now;
+  activeMode = active;
+  applyResolution(samplingResolution(active));
+  // A reference read at the old resolution is off by up to half its step,
+  // which hides a slow ramp over the whole window
+  referencesPending = true;
+
+  Serial.print("[SENSOR] Sampling ");
+  Serial.print(active ? "active (" : "stable (");
+  Serial.print(resolution);
+  Serial.print(" bits every ");
+  Serial.print(samplingInterval(active) / 1000);
+  Serial.print(" s), rate ");
+  Serial.print(rate, 2);
+  Serial.println(" °C/h");
+}
+
+/**
+ * Apply the sampling rules (temperature_sampling.h) after a completed cycle
+ * @return Fastest change rate seen (°C/h)
+ */
+static float adaptSampling() {
+  if (referencesPending) {
+    referencesPending = false;
+    resetReferences();
+    return 0;
+  }
+
+  float maxDrift = 0;
+  for (uint8_t i = 0; i < probeCount; i++) {
+    TemperatureProbe& probe = probes[i];
+    if (isnan(probe.temperature)) continue;
+    if (isnan(probe.reference)) {
+      probe.reference = probe.temperature; // First reading (or probe back)
+      continue;
+    }
+    float drift = fabsf(probe.temperature - probe.reference);
+    if (drift > maxDrift) maxDrift = drift;
+  }
+
+  uint32_t elapsed = millis() - referenceTime;
+  float rate = samplingRate(maxDrift, elapsed);
+
+  switch (evaluateSampling(activeMode, maxDrift, elapsed)) {
+    case TEMP_SAMPLING_ACTIVATE:  setSamplingMode(true, rate); break;
+    case TEMP_SAMPLING_STABILIZE: setSamplingMode(false, rate); break;
+    case TEMP_SAMPLING_RESTART:   resetReferences(); break;
+    case TEMP_SAMPLING_KEEP:      break;
+  }
+  return rate;
+}
+
+/**
+ * Account one cycle and log the sampler statistics every TEMP_REPORT_INTERVAL
+ * Tracking error estimate: half a reading step plus how far the water moves
+ * (at the measured rate) during one sampling interval.
+ */
+static void accountCycle(uint8_t bits, float rate) {
+  float error = resolutionStep(bits) / 2 + rate * samplingInterval(activeMode) / 3600000.0f;
+  reportCycles++;
+  reportConversionMs += conversionTimeMs(bits);
+  reportBusUs += cycleBusUs;
+  reportErrorSum += error;
+  if (error > reportErrorMax) reportErrorMax = error;
+
+  uint32_t now = millis();
+  uint32_t window = now - reportStart;
+  if (window < TEMP_REPORT_INTERVAL) return;
+
+  if (activeMode) reportActiveMs += now - modeSince;
+  modeSince = now;
+
+  // Old schedule: 12-bit conversion every TEMP_BASELINE_INTERVAL
+  uint32_t baselineMs = (window / TEMP_BASELINE_INTERVAL) * conversionTimeMs(12);
+  Serial.print("[SENSOR] Sampler: ");
+  Serial.print(reportCycles);
+  Serial.print(" cycles, conversion ");
+  Serial.print(reportConversionMs);
+  Serial.print(" ms (fixed 12 bits/");
+  Serial.print(TEMP_BASELINE_INTERVAL / 1000);
+  Serial.print(" s: ");
+  Serial.print(baselineMs);
+  Serial.print(" ms), bus ");
+  Serial.print(reportBusUs);
+  Serial.print(" us, active ");
+  Serial.print(reportActiveMs * 100 / window);
+  Serial.print("%, tracking error avg ");
+  Serial.print(reportErrorSum / reportCycles, 3);
+  Serial.print(" max ");
+  Serial.print(reportErrorMax, 3);
+  Serial.print(" °C, filter jitter removed avg ");
+  Serial.print(reportReadings ? reportJitterSum / reportReadings : 0, 3);
+  Serial.print(" °C, spikes ");
+  Serial.print(reportSpikes);
+  Serial.print("/");
+  Serial.println(reportReadings);
+
+#if IRQ_LATENCY_PROBE
+  // Interrupt latency while the bus is busy vs the rest of the window
+  // (compare the esp32dev and esp32dev-bitbang builds)
+  IRQLatencyStats bus = getIRQLatencyStats(IRQ_TAG_ONEWIRE);
+  IRQLatencyStats idle = getIRQLatencyStats(IRQ_TAG_IDLE);
+  Serial.print("[SENSOR] IRQ latency: bus avg ");
+  Serial.print(bus.avgUs);
+  Serial.print(" max ");
+  Serial.print(bus.maxUs);
+  Serial.print(" us (");
+  Serial.print(bus.samples);
+  Serial.print(" samples), idle avg ");
+  Serial.print(idle.avgUs);
+  Serial.print(" max ");
+  Serial.print(idle.maxUs);
+  Serial.print(" us (");
+  Serial.print(idle.samples);
+  Serial.println(" samples)");
+  resetIRQLatencyStats();
+#endif
+
+  reportStart = now;
+  reportCycles = 0;
+  reportConversionMs = 0;
+  reportBusUs = 0;
+  reportActiveMs = 0;
+  reportErrorMax = 0;
+  reportErrorSum = 0;
+  reportJitterSum = 0;
+  reportReadings = 0;
+  reportSpikes = 0;
+}
+
+// ==================== Filter Chain ====================
+
+/**
+ * Forget a probe's filter history (probe missing, first reading)
+ */
+static void resetFilter(TemperatureProbe& probe) {
+  resetTemperatureFilter(&probe.filter);
+  probe.temperature = NAN;
+}
+
+/**
+ * Run one raw reading through median -> Kalman (temperature_filter.h)
+ * @param bits Resolution of the reading (its quantization adds noise)
+ */
+static void filterReading(TemperatureProbe& probe, float raw, uint8_t bits) {
+  probe.raw = raw;
+  probe.temperature = updateTemperatureFilter(&probe.filter, raw, bits, millis());
+  if (isnan(raw)) return;
+
+  reportReadings++;
+  reportJitterSum += fabsf(raw - probe.temperature);
+  if (fabsf(raw - temperatureMedian(probe.filter)) >= TEMP_DEADBAND) reportSpikes++;
+}
+
+/**
+ * Send one skip-ROM CONVERT T to every probe and take the deadline
+ */
+static void startConversion() {
+  setIRQLatencyTag(IRQ_TAG_ONEWIRE);
+  uint32_t startUs = micros();
+  tempSensor.requestTemperatures();  // Skip ROM; returns right away (setWaitForConversion(false))
+  uint32_t us = micros() - startUs;
+  setIRQLatencyTag(IRQ_TAG_IDLE);
+
+  cycleBusUs = us;
+  cycleMaxStepUs = us;
+  collectIndex = 0;
+  conversionStart = millis();
+  lastCycleStart = conversionStart;
+  conversionWait = conversionTimeMs(resolution) + TEMP_CONVERSION_MARGIN;
+  converting = true;
+}
+
+/**
+ * Read the next probe of the finished conversion by its address
+ */
+static void collectProbe() {
+  TemperatureProbe& probe = probes[collectIndex++];
+
+  setIRQLatencyTag(IRQ_TAG_ONEWIRE);
+  uint32_t startUs = micros();
+  float temp = tempSensor.getTempC(probe.address);
+  uint32_t us = micros() - startUs;
+  setIRQLatencyTag(IRQ_TAG_IDLE);
+  cycleBusUs += us;
+  if (us > cycleMaxStepUs) cycleMaxStepUs = us;
+
+  filterReading(probe, temp == DEVICE_DISCONNECTED_C ? NAN : temp, resolution);
+}
+
+/**
+ * Log the readings and bus time of a completed cycle
+ */
+static void logCycle() {
+  Serial.print("[SENSOR] Temperature:");
+  for (uint8_t i = 0; i < probeCount; i++) {
+    Serial.print(" ");
+    Serial.print(probes[i].label);
+    Serial.print("=");
+    if (isnan(probes[i].temperature)) {
+      Serial.print("ERROR");
+    } else {
+      Serial.print(probes[i].temperature);
+      Serial.print("(raw ");
+      Serial.print(probes[i].raw);
+      Serial.print(")");
+    }
+  }
+  Serial.print(" °C (");
+  Serial.print(resolution);
+  Serial.print(" bits, conversion ");
+  Serial.print(millis() - conversionStart);
+  Serial.print(" ms, bus ");
+  Serial.print(cycleBusUs);
+  Serial.print(" us, longest step ");
+  Serial.print(cycleMaxStepUs);
+  Serial.println(" us)");
+}
+
+// ==================== Public Functions ====================
+
+void initTemperature() {
+  Serial.println("[SENSOR] Initializing DS18B20...");
+  tempSensor.begin();
+  tempSensor.setWaitForConversion(false);
+  // setResolution() would otherwise copy the scratchpad to EEPROM on every
+  // mode change (limited write cycles); the probes boot at their stored
+  // resolution and get the stable one below
+  tempSensor.setAutoSaveScratchPad(false);
+
+  Serial.print("[SENSOR] DS18B20 devices found: ");
+  Serial.println(tempSensor.getDeviceCount());
+
+  loadProbes();
+  if (discoverProbes()) saveProbes();
+  for (uint8_t i = 0; i < probeCount; i++) {
+    resetFilter(probes[i]);
+    probes[i].raw = NAN;
+    probes[i].reference = NAN;
+  }
+
+  // Start stable; the first drift switches to the active mode
+  applyResolution(samplingResolution(false));
+  referenceTime = millis();
+  reportStart = millis();
+  modeSince = millis();
+
+  for (uint8_t i = 0; i < probeCount; i++) {
+    char rom[17];
+    formatAddress(probes[i].address, rom);
+    Serial.print("[SENSOR] Probe ");
+    Serial.print(rom);
+    Serial.print(" = ");
+    Serial.print(probes[i].label);
+    Serial.println(tempSensor.isConnected(probes[i].address) ? "" : " (not on the bus)");
+  }
+
+  requestTemperature();
+}
+
+void requestTemperature() {
+  if (!converting) conversionRequested = true;
+}
+
+TemperatureEvent serviceTemperature() {
+  if (converting) {
+    if (millis() - conversionStart < conversionWait) return TEMP_EVENT_IDLE;
+
+    // One probe per call keeps the bus time of a loop iteration constant
+    if (collectIndex < probeCount) collectProbe();
+    if (collectIndex < probeCount) return TEMP_EVENT_IDLE;
+
+    converting = false;
+    logCycle();
+    uint8_t bits = resolution;  // A mode change below applies to the next cycle
+    accountCycle(bits, adaptSampling());
+    return TEMP_EVENT_READY;
+  }
+
+  uint32_t interval = samplingInterval(activeMode);
+  if (conversionRequested || millis() - lastCycleStart >= interval) {
+    conversionRequested = false;
+    startConversion();
+  }
+  return TEMP_EVENT_IDLE;
+}
+
+float getTemperature() {
+  if (probeCount == 0) return NAN;
+  uint8_t primary = findProbe(TEMP_PRIMARY_LABEL);
+  return probes[primary < probeCount ? primary : 0].temperature;
+}
+
+bool isTemperatureConverting() {
+  return converting || conversionRequested;
+}
+
+bool isTemperatureActive() {
+  return activeMode;
+}
+
+// ==================== Probes ====================
+
+uint8_t getTemperatureProbeCount() {
+  return probeCount;
+}
+
+float getProbeTemperature(uint8_t index) {
+  if (index >= probeCount) return NAN;
+  return probes[index].temperature;
+}
+
+float getProbeRawTemperature(uint8_t index) {
+  if (index >= probeCount) return NAN;
+  return probes[index].raw;
+}
+
+const char* getProbeLabel(uint8_t index) {
+  if (index >= probeCount) return "";
+  return probes[index].label;
+}
+
+bool setProbeLabel(const char* probe, const char* label) {
+  uint8_t index = findProbe(probe);
+  if (index >= probeCount || !validLabel(label) || labelInUse(label, index)) return false;
+
+  for (size_t i = 0; i <= strlen(label); i++) {
+    probes[index].label[i] = tolower(label[i]);
+  }
+  saveProbes();
+
+  Serial.print("[SENSOR] Probe ");
+  Serial.print(probe);
+  Serial.print(" labelled ");
+  Serial.println(probes[index].label);
+  return true;
+}
+
+String getTemperatureJSON() {
+  String json = "{";
+  for (uint8_t i = 0; i < probeCount; i++) {
+    if (i > 0) json += ",";
+    json += "\"";
+    json += probes[i].label;
+    json += "\":";
+    if (isnan(probes[i].temperature)) {
+      json += "null";
+    } else {
+      json += String(probes[i].temperature, 1);
+    }
+  }
+  json += "}";
+  return json;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file temperature_filter.cpp
+ * @brief Per-probe temperature filter chain implementation
+ */
+
+#include "temperature_filter.h"
+#include "temperature_sampling.h"
+#include <math.h>
+
+void resetTemperatureFilter(TemperatureFilter* filter) {
+  filter->windowCount = 0;
+  filter->windowNext = 0;
+  filter->estimate = NAN;
+  filter->variance = 0;
+  filter->updatedAt = 0;
+}
+
+float temperatureMedian(const TemperatureFilter& filter) {
+  uint8_t count = filter.windowCount;
+  if (count == 0) return NAN;
+
+  // Insertion sort of at most 7 values
+  float sorted[TEMP_MEDIAN_SIZE];
+  for (uint8_t i = 0; i < count; i++) {
+    float value = filter.window[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = value;
+  }
+  return count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+}
+
+float updateTemperatureFilter(TemperatureFilter* filter, float raw, uint8_t bits, uint32_t nowMs) {
+  if (isnan(raw)) {
+    resetTemperatureFilter(filter);
+    return NAN;
+  }
+
+  filter->window[filter->windowNext] = raw;
+  filter->windowNext = (filter->windowNext + 1) % TEMP_MEDIAN_SIZE;
+  if (filter->windowCount < TEMP_MEDIAN_SIZE) filter->windowCount++;
+  float median = temperatureMedian(*filter);
+
+  float step = resolutionStep(bits);
+  float noise = TEMP_KALMAN_R + step * step / 12;   // Probe noise + quantization
+  if (isnan(filter->estimate)) {
+    filter->estimate = median;
+    filter->variance = noise;
+  } else {
+    // Predict: the water may have moved since the last reading
+    filter->variance += TEMP_KALMAN_Q * (uint32_t)(nowMs - filter->updatedAt) / 1000.0f;
+    // Update
+    float gain = filter->variance / (filter->variance + noise);
+    filter->estimate += gain * (median - filter->estimate);
+    filter->variance *= 1 - gain;
+  }
+  filter->updatedAt = nowMs;
+  return filter->estimate;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file temperature_sampling.cpp
+ * @brief Adaptive DS18B20 sampling rules implementation
+ */
+
+#include "temperature_sampling.h"
+#include "config.h"
+
+TempSamplingAction evaluateSampling(bool active, float maxDrift, uint32_t elapsedMs) {
+  if (!active) {
+    return maxDrift >= TEMP_ACTIVE_DELTA ? TEMP_SAMPLING_ACTIVATE : TEMP_SAMPLING_KEEP;
+  }
+  if (elapsedMs < TEMP_STABLE_WINDOW) return TEMP_SAMPLING_KEEP;
+  return samplingRate(maxDrift, elapsedMs) < TEMP_STABLE_RATE ? TEMP_SAMPLING_STABILIZE
+                                                               : TEMP_SAMPLING_RESTART;
+}
+
+float samplingRate(float maxDrift, uint32_t elapsedMs) {
+  return elapsedMs ? maxDrift * 3600000.0f / elapsedMs : 0;
+}
+
+uint32_t samplingInterval(bool active) {
+  return active ? TEMP_ACTIVE_INTERVAL : TEMP_STABLE_INTERVAL;
+}
+
+uint8_t samplingResolution(bool active) {
+  return active ? TEMP_ACTIVE_RESOLUTION : TEMP_STABLE_RESOLUTION;
+}
+
+uint32_t conversionTimeMs(uint8_t bits) {
+  // tCONV (DS18B20 datasheet), same values as DallasTemperature
+  switch (bits) {
+    case 9:  return 94;
+    case 10: return 188;
+    case 11: return 375;
+    default: return 750;
+  }
+}
+
+float resolutionStep(uint8_t bits) {
+  return 0.5f / (1 << (bits - 9));
+}
@@ -0,0 +1,256 @@
+/**
+ * @file vsd_pump.cpp
+ * @brief Variable-speed pump drive over Modbus RTU implementation
+ */
+
+#include "vsd_pump.h"
+#include "config.h"
+#include "modbus_uart.h"
+#include <Preferences.h>
+
+#define NVS_NAMESPACE   "vsd"
+
+// Readback block, consecutive registers from VSD_REG_READBACK
+enum VsdReadback {
+  VSD_RB_STATUS,        // Bit 0 = running
+  VSD_RB_SPEED,         // rpm
+  VSD_RB_POWER,         // W
+  VSD_RB_CURRENT,       // A / VSD_CURRENT_SCALE
+  VSD_RB_FAULT,         // 0 = none
+  VSD_RB_COUNT
+};
+
+// Transaction tags
+enum VsdTag {
+  VSD_TAG_POLL,
+  VSD_TAG_RUN,
+  VSD_TAG_SPEED,
+  VSD_TAG_COUNT
+};
+
+// ==================== State Variables ====================
+static bool available = false;
+static VsdPumpState state = {false, false, VSD_DEFAULT_RPM, 0, 0, 0, 0};
+static VsdPumpState published = {false, false, 0, 0, 0, NAN, 0};
+static bool runCommand = false;
+static bool runPending = false;
+static bool speedPending = false;
+static bool inFlight[VSD_TAG_COUNT] = {false};
+static uint8_t failedPolls = 0;
+static uint32_t lastPollAt = 0;
+static uint32_t lastReportAt = 0;
+
+// ==================== Bus Requests ====================
+
+/**
+ * Submit one transaction unless the same one is still on its way
+ */
+static void submit(VsdTag tag, uint8_t function, uint16_t address, uint16_t count, uint16_t value) {
+  if (inFlight[tag]) return;
+  ModbusRequest request = {};
+  request.slave = VSD_SLAVE_ID;
+  request.function = function;
+  request.address = address;
+  request.count = count;
+  request.values[0] = value;
+  request.tag = tag;
+  inFlight[tag] = modbusSubmit(request);
+}
+
+static void sendRun() {
+  submit(VSD_TAG_RUN, MODBUS_WRITE_SINGLE, VSD_REG_CONTROL, 1, runCommand ? VSD_CMD_RUN : VSD_CMD_STOP);
+}
+
+static void sendSpeed() {
+  submit(VSD_TAG_SPEED, MODBUS_WRITE_SINGLE, VSD_REG_SPEED, 1, state.setpoint);
+}
+
+/**
+ * Apply a completed transaction
+ * @return true if it was a poll
+ */
+static bool handleResult(const ModbusResult& result) {
+  if (result.tag >= VSD_TAG_COUNT) return false;
+  inFlight[result.tag] = false;
+  bool ok = result.status == MODBUS_OK;
+
+  if (!ok) {
+    Serial.print("[VSD] Transaction ");
+    Serial.print(result.tag);
+    Serial.print(" failed: status ");
+    Serial.print(result.status);
+    if (result.status == MODBUS_EXCEPTION) {
+      Serial.print(", exception ");
+      Serial.print(result.exception);
+    }
+    Serial.println();
+  }
+
+  // A write acknowledged with an older value leaves the new one pending
+  switch (result.tag) {
+    case VSD_TAG_RUN:
+      if (ok && result.values[0] == (runCommand ? VSD_CMD_RUN : VSD_CMD_STOP)) runPending = false;
+      return false;
+    case VSD_TAG_SPEED:
+      if (ok && result.values[0] == state.setpoint) speedPending = false;
+      return false;
+  }
+
+  if (ok) {
+    if (!state.online) Serial.println("[VSD] Drive online");
+    failedPolls = 0;
+    state.online = true;
+    state.running = result.values[VSD_RB_STATUS] & 0x0001;
+    state.speed = result.values[VSD_RB_SPEED];
+    state.power = result.values[VSD_RB_POWER];
+    state.current = result.values[VSD_RB_CURRENT] * VSD_CURRENT_SCALE;
+    state.fault = result.values[VSD_RB_FAULT];
+  } else if (failedPolls < VSD_OFFLINE_POLLS && ++failedPolls == VSD_OFFLINE_POLLS) {
+    Serial.println("[VSD] Drive offline");
+    state.online = false;
+    // Resend everything when it comes back (it may have lost power)
+    runPending = true;
+    speedPending = true;
+  }
+  return true;
+}
+
+/**
+ * Hourly bus throughput and error counters
+ */
+static void reportBusStats() {
+  static ModbusStats previous = {};
+  uint32_t dropped = 0;
+  ModbusStats stats = getModbusStats(&dropped);
+  uint32_t responses = stats.responses - previous.responses;
+  uint64_t latency = stats.latencyTotalUs - previous.latencyTotalUs;
+
+  Serial.print("[VSD] Bus: ");
+  Serial.print(stats.requests - previous.requests);
+  Serial.print(" requests, ");
+  Serial.print(responses);
+  Serial.print(" ok (avg ");
+  Serial.print(responses ? (uint32_t)(latency / responses) : 0);
+  Serial.print(" us, max ");
+  Serial.print(takeModbusLatencyPeak());
+  Serial.print(" us), ");
+  Serial.print(stats.timeouts - previous.timeouts);
+  Serial.print(" timeouts, ");
+  Serial.print(stats.crcErrors - previous.crcErrors);
+  Serial.print(" CRC errors, ");
+  Serial.print(stats.exceptions - previous.exceptions);
+  Serial.print(" exceptions, ");
+  Serial.print(stats.rejected - previous.rejected + dropped);
+  Serial.println(" dropped");
+  previous = stats;
+}
+
+// ==================== Public Functions ====================
+
+void initVsdPump() {
+#if VSD_PUMP
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, true);
+  state.setpoint = prefs.getUShort("rpm", VSD_DEFAULT_RPM);
+  prefs.end();
+
+  if (!initModbusUart()) return;
+  available = true;
+
+  // The drive may have kept running across our reboot: send stop and the setpoint
+  runPending = true;
+  speedPending = true;
+  lastPollAt = millis() - VSD_POLL_INTERVAL;
+  lastReportAt = millis();
+
+  Serial.print("[VSD] ✓ Drive at slave ");
+  Serial.print(VSD_SLAVE_ID);
+  Serial.print(", setpoint ");
+  Serial.print(state.setpoint);
+  Serial.println(" rpm");
+#else
+  Serial.println("[VSD] Variable-speed pump disabled");
+#endif
+}
+
+bool serviceVsdPump() {
+  if (!available) return false;
+
+  bool polled = false;
+  ModbusResult result;
+  while (modbusReceive(result)) {
+    polled |= handleResult(result);
+  }
+
+  if (millis() - lastPollAt >= VSD_POLL_INTERVAL) {
+    lastPollAt = millis();
+    // Queued together: the bus task sends them back to back
+    if (runPending) sendRun();
+    if (speedPending) sendSpeed();
+    submit(VSD_TAG_POLL, MODBUS_READ_HOLDING, VSD_REG_READBACK, VSD_RB_COUNT, 0);
+  }
+
+  if (millis() - lastReportAt >= VSD_REPORT_INTERVAL) {
+    lastReportAt = millis();
+    reportBusStats();
+  }
+  return polled;
+}
+
+bool isVsdPumpAvailable() {
+  return available;
+}
+
+void setVsdRunning(bool running) {
+  if (!available) return;
+  runCommand = running;
+  runPending = true;
+  sendRun();
+}
+
+bool setVsdSpeed(uint16_t rpm) {
+  if (!available || rpm < VSD_MIN_RPM || rpm > VSD_MAX_RPM) return false;
+
+  if (rpm != state.setpoint) {
+    Preferences prefs;
+    prefs.begin(NVS_NAMESPACE, false);
+    prefs.putUShort("rpm", rpm);
+    prefs.end();
+  }
+  state.setpoint = rpm;
+  speedPending = true;
+  // Skipped while a write is in flight (old value); the next poll resends
+  sendSpeed();
+
+  Serial.print("[VSD] Speed setpoint: ");
+  Serial.print(rpm);
+  Serial.println(" rpm");
+  return true;
+}
+
+VsdPumpState getVsdPumpState() {
+  return state;
+}
+
+bool vsdPumpMoved() {
+  return state.online != published.online || state.running != published.running ||
+         state.fault != published.fault || state.setpoint != published.setpoint ||
+         abs((int)state.speed - (int)published.speed) >= VSD_SPEED_DEADBAND;
+}
+
+void markVsdPumpPublished() {
+  published = state;
+}
+
+String getVsdPumpJSON() {
+  String json = "{";
+  json += "\"online\":" + String(state.online ? "true" : "false") + ",";
+  json += "\"running\":" + String(state.running ? "true" : "false") + ",";
+  json += "\"setpoint_rpm\":" + String(state.setpoint) + ",";
+  json += "\"speed_rpm\":" + String(state.speed) + ",";
+  json += "\"power\":" + String(state.power) + ",";
+  json += "\"current\":" + String(state.current, 1) + ",";
+  json += "\"fault\":" + String(state.fault);
+  json += "}";
+  return json;
+}
@@ -0,0 +1,304 @@
+/**
+ * @file wifi_scan.cpp
+ * @brief Asynchronous WiFi scanner with TTL cache implementation
+ */
+
+#include "wifi_scan.h"
+#include <WiFi.h>
+
+/**
+ * Networks of one scan pass, sorted strongest first
+ */
+struct ScanTable {
+  ScanNetwork entries[WIFI_SCAN_MAX_NETWORKS];
+  uint8_t count;
+};
+
+// ==================== State Variables ====================
+// The cache keeps answering while the next pass is built in the other table
+static ScanTable tables[2];
+static ScanTable* cache = &tables[0];     // Last completed pass
+static ScanTable* pass = &tables[1];      // Pass being built
+static bool passMerged = false;           // At least one channel of the pass completed
+static bool haveResults = false;
+static uint32_t resultsTime = 0;          // millis() of the last completed scan
+
+static volatile bool scanRequested = false; // Set from any task, consumed in loop
+static bool scanRunning = false;
+static uint32_t scanStartTime = 0;
+static uint8_t channelIndex = 0;          // Position in CHANNEL_ORDER of the running channel
+
+// Busiest channels first so the first results arrive within a few hundred ms
+static const uint8_t CHANNEL_ORDER[] = {1, 6, 11, 2, 3, 4, 5, 7, 8, 9, 10, 12, 13};
+#define CHANNEL_COUNT (sizeof(CHANNEL_ORDER) / sizeof(CHANNEL_ORDER[0]))
+
+// ==================== Helpers ====================
+
+/**
+ * Insert a network keeping the table sorted by RSSI (strongest first)
+ * Duplicate SSIDs (mesh / multiple APs) keep only the strongest entry.
+ * New or stronger entries become pending for every consumer.
+ */
+static void insertNetwork(ScanTable& table, const String& ssid, int rssi, uint8_t channel, bool open) {
+  for (uint8_t i = 0; i < table.count; i++) {
+    if (strcmp(table.entries[i].ssid, ssid.c_str()) == 0) {
+      if (rssi <= table.entries[i].rssi) return;
+      // Stronger duplicate: remove the old entry and re-insert below
+      memmove(&table.entries[i], &table.entries[i + 1], (table.count - i - 1) * sizeof(ScanNetwork));
+      table.count--;
+      break;
+    }
+  }
+
+  uint8_t pos = table.count;
+  while (pos > 0 && table.entries[pos - 1].rssi < rssi) pos--;
+  if (pos >= WIFI_SCAN_MAX_NETWORKS) return; // Weaker than everything kept
+
+  uint8_t moveCount = table.count - pos;
+  if (table.count == WIFI_SCAN_MAX_NETWORKS) moveCount--; // Drop the weakest
+  memmove(&table.entries[pos + 1], &table.entries[pos], moveCount * sizeof(ScanNetwork));
+
+  strncpy(table.entries[pos].ssid, ssid.c_str(), 32);
+  table.entries[pos].ssid[32] = '\0';
+  table.entries[pos].rssi = (int8_t)rssi;
+  table.entries[pos].channel = channel;
+  table.entries[pos].open = open;
+  table.entries[pos].pendingMask = 0xFF;
+  if (table.count < WIFI_SCAN_MAX_NETWORKS) table.count++;
+}
+
+/**
+ * Append a JSON string literal. SSIDs are arbitrary bytes: quotes,
+ * backslashes and control characters are escaped, so the entry parses and
+ * a newline in an SSID cannot split a line of the streamed list
+ */
+static void appendJsonString(String& json, const char* text) {
+  static const char hex[] = "0123456789abcdef";
+  json += '"';
+  for (const char* c = text; *c; c++) {
+    uint8_t byte = (uint8_t)*c;
+    if (byte == '"' || byte == '\\') {
+      json += '\\';
+      json += *c;
+    } else if (byte == '\n') {
+      json += "\\n";
+    } else if (byte == '\r') {
+      json += "\\r";
+    } else if (byte == '\t') {
+      json += "\\t";
+    } else if (byte < 0x20) {
+      json += "\\u00";
+      json += hex[byte >> 4];
+      json += hex[byte & 0x0F];
+    } else {
+      json += *c;
+    }
+  }
+  json += '"';
+}
+
+/**
+ * Build one JSON object for a network
+ */
+static String networkJSON(const ScanNetwork& net) {
+  String entry = "{\"ssid\":";
+  appendJsonString(entry, net.ssid);
+  entry += ",\"rssi\":";
+  entry += String(net.rssi);
+  entry += ",\"open\":";
+  entry += (net.open ? "true" : "false");
+  entry += "}";
+  return entry;
+}
+
+/**
+ * Merge the driver's results of one channel into the pass being built
+ */
+static void mergeResults(int16_t found) {
+  for (int i = 0; i < found; i++) {
+    String ssid = WiFi.SSID(i);
+    if (ssid.length() == 0) continue; // Skip hidden networks
+    insertNetwork(*pass, ssid, WiFi.RSSI(i), WiFi.channel(i), WiFi.encryptionType(i) == WIFI_AUTH_OPEN);
+  }
+  WiFi.scanDelete();
+  passMerged = true;
+}
+
+/**
+ * Table the incremental readers work on
+ * While a pass runs they stream its entries as channels complete; the
+ * pending flags move with the entries when the pass replaces the cache.
+ */
+static ScanTable& streamTable() {
+  return scanRunning ? *pass : *cache;
+}
+
+/**
+ * Start the asynchronous scan of one channel
+ * @return false if the driver refused to start
+ */
+static bool startChannelScan(uint8_t channel) {
+  return WiFi.scanNetworks(true /*async*/, false /*show_hidden*/, false /*passive*/,
+                           WIFI_SCAN_CHANNEL_TIME, channel) != WIFI_SCAN_FAILED;
+}
+
+// ==================== Public Functions ====================
+
+void requestWiFiScan() {
+  scanRequested = true;
+}
+
+WiFiScanEvent serviceWiFiScan() {
+  if (scanRunning) {
+    int16_t result = WiFi.scanComplete();
+    if (result == WIFI_SCAN_RUNNING) return WIFI_SCAN_IDLE;
+
+    if (result >= 0) {
+      mergeResults(result);
+    } else {
+      Serial.print("[SCAN] Channel ");
+      Serial.print(CHANNEL_ORDER[channelIndex]);
+      Serial.println(" failed");
+    }
+
+    // Next channel, or finish the pass
+    while (++channelIndex < CHANNEL_COUNT) {
+      if (startChannelScan(CHANNEL_ORDER[channelIndex])) return WIFI_SCAN_PROGRESS;
+    }
+
+    scanRunning = false;
+    if (!passMerged) {
+      // Every channel failed: keep serving the previous results
+      Serial.println("[SCAN] Pass failed, keeping cached results");
+      return WIFI_SCAN_DONE;
+    }
+
+    // Swap the completed pass in
+    ScanTable* completed = pass;
+    pass = cache;
+    cache = completed;
+    haveResults = true;
+    resultsTime = millis();
+    Serial.print("[SCAN] ✓ ");
+    Serial.print(cache->count);
+    Serial.print(" networks in ");
+    Serial.print(resultsTime - scanStartTime);
+    Serial.println(" ms");
+    return WIFI_SCAN_DONE;
+  }
+
+  if (!scanRequested) return WIFI_SCAN_IDLE;
+  scanRequested = false;
+
+  if (isWiFiScanFresh()) return WIFI_SCAN_IDLE; // Cache answers this request
+
+  // Station interface must be up; AP+STA (captive portal) already qualifies
+  if ((WiFi.getMode() & WIFI_MODE_STA) == 0) {
+    WiFi.mode(WIFI_STA);
+  }
+
+  // New pass: built channel by channel next to the cache
+  pass->count = 0;
+  passMerged = false;
+  channelIndex = 0;
+  if (!startChannelScan(CHANNEL_ORDER[0])) {
+    Serial.println("[SCAN] Could not start scan");
+    return WIFI_SCAN_IDLE;
+  }
+
+  scanRunning = true;
+  scanStartTime = millis();
+  Serial.println("[SCAN] Background scan started");
+  return WIFI_SCAN_IDLE;
+}
+
+bool isWiFiScanRunning() {
+  return scanRunning || scanRequested;
+}
+
+bool hasWiFiScanResults() {
+  return haveResults;
+}
+
+bool isWiFiScanFresh() {
+  return haveResults && !scanRunning && (millis() - resultsTime) < WIFI_SCAN_TTL;
+}
+
+uint8_t getWiFiScanCount() {
+  return cache->count;
+}
+
+const ScanNetwork* getWiFiScanNetwork(uint8_t index) {
+  if (index >= cache->count) return nullptr;
+  return &cache->entries[index];
+}
+
+String getWiFiScanJSON(size_t maxLength) {
+  String json = "[";
+  int count = 0;
+
+  for (uint8_t i = 0; i < cache->count; i++) {
+    String entry = networkJSON(cache->entries[i]);
+
+    // +1 for comma, +1 for closing bracket
+    if (maxLength > 0 && json.length() + entry.length() + (count > 0 ? 1 : 0) + 1 > maxLength) {
+      break;
+    }
+
+    if (count > 0) json += ",";
+    json += entry;
+    count++;
+  }
+
+  json += "]";
+  return json;
+}
+
+// ==================== Incremental Results ====================
+
+void markWiFiScanPending(uint8_t consumer) {
+  if (consumer >= WIFI_SCAN_CONSUMERS) return;
+  ScanTable& table = streamTable();
+  for (uint8_t i = 0; i < table.count; i++) {
+    table.entries[i].pendingMask |= (1 << consumer);
+  }
+}
+
+bool hasWiFiScanPending(uint8_t consumer) {
+  if (consumer >= WIFI_SCAN_CONSUMERS) return false;
+  ScanTable& table = streamTable();
+  for (uint8_t i = 0; i < table.count; i++) {
+    if (table.entries[i].pendingMask & (1 << consumer)) return true;
+  }
+  return false;
+}
+
+String takeWiFiScanPendingJSON(uint8_t consumer, size_t maxLength) {
+  String json = "[";
+  if (consumer >= WIFI_SCAN_CONSUMERS) return "[]";
+
+  int count = 0;
+  uint8_t bit = 1 << consumer;
+  ScanTable& table = streamTable();
+
+  // Table is sorted, so entries come out strongest first
+  for (uint8_t i = 0; i < table.count; i++) {
+    if (!(table.entries[i].pendingMask & bit)) continue;
+
+    String entry = networkJSON(table.entries[i]);
+    if (json.length() + entry.length() + (count > 0 ? 1 : 0) + 1 > maxLength) {
+      if (count > 0) break;
+      // Entry can never fit: drop it instead of stalling the stream
+      table.entries[i].pendingMask &= ~bit;
+      continue;
+    }
+
+    if (count > 0) json += ",";
+    json += entry;
+    table.entries[i].pendingMask &= ~bit;
+    count++;
+  }
+
+  json += "]";
+  return json;
+}
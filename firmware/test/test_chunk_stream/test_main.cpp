@@ -0,0 +1,298 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the BLE networks chunk framing (pio test -e native)
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "chunk_stream.h"
+
+/**
+ * Simulated notify path: the stack takes at most budget frames until the
+ * next connection event drains them
+ */
+struct FakeLink {
+  std::vector<std::vector<uint8_t> > frames;
+  int budget;
+};
+
+static bool fakeSend(void* context, const uint8_t* frame, size_t length) {
+  FakeLink* link = (FakeLink*)context;
+  if (link->budget <= 0) return false;
+  link->budget--;
+  link->frames.push_back(std::vector<uint8_t>(frame, frame + length));
+  return true;
+}
+
+static ChunkStream stream;
+static FakeLink link;
+
+void setUp(void) {
+  resetChunkStream(&stream);
+  link.frames.clear();
+  link.budget = 1 << 30;
+}
+
+void tearDown(void) {}
+
+/**
+ * JSON lines like the ones the scan produces
+ */
+static std::string networksText(int networks) {
+  std::string text;
+  char entry[80];
+  for (int i = 0; i < networks; i++) {
+    snprintf(entry, sizeof(entry), "[{\"ssid\":\"Network-%02d\",\"rssi\":%d,\"open\":%s}]\n",
+             i, -40 - i, i % 3 ? "false" : "true");
+    text += entry;
+  }
+  return text;
+}
+
+/**
+ * Send the whole text (list complete), dropping what each chunk consumed
+ * @return Status of the last call
+ */
+static ChunkStatus drain(std::string& text, uint16_t mtu) {
+  ChunkStatus status = CHUNK_IDLE;
+  for (int guard = 0; guard < 100000; guard++) {
+    size_t consumed = 0;
+    status = sendNextChunk(&stream, text.data(), text.size(), mtu, true, fakeSend, &link, &consumed);
+    text.erase(0, consumed);
+    if (status != CHUNK_SENT) break;
+  }
+  return status;
+}
+
+/**
+ * Check the frames of one list and put the payload back together
+ */
+static std::string reassemble(uint16_t mtu) {
+  std::string text;
+  for (size_t i = 0; i < link.frames.size(); i++) {
+    const std::vector<uint8_t>& frame = link.frames[i];
+    TEST_ASSERT_TRUE(frame.size() >= CHUNK_HEADER_SIZE);
+    TEST_ASSERT_TRUE(frame.size() <= (size_t)mtu - ATT_NOTIFY_OVERHEAD);
+    bool last = i + 1 == link.frames.size();
+    TEST_ASSERT_EQUAL_HEX8(CHUNK_FLAG_FRAMED | (last ? CHUNK_FLAG_FINAL : 0), frame[0]);
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)i, frame[1]);
+    text.append(frame.begin() + CHUNK_HEADER_SIZE, frame.end());
+  }
+  return text;
+}
+
+// ==================== Chunk Boundaries ====================
+
+static void checkMtu(uint16_t mtu) {
+  setUp();
+  std::string sent = networksText(30);
+  std::string text = sent;
+  TEST_ASSERT_EQUAL(CHUNK_FINAL, drain(text, mtu));
+  TEST_ASSERT_EQUAL_UINT(0, text.size());
+  TEST_ASSERT_TRUE(sent == reassemble(mtu));
+
+  // Every chunk but the last is full
+  size_t payloadMax = mtu - ATT_NOTIFY_OVERHEAD - CHUNK_HEADER_SIZE;
+  for (size_t i = 0; i + 1 < link.frames.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT(payloadMax + CHUNK_HEADER_SIZE, link.frames[i].size());
+  }
+  TEST_ASSERT_EQUAL_UINT32((sent.size() + payloadMax - 1) / payloadMax, stream.chunks);
+  TEST_ASSERT_EQUAL_UINT32(sent.size() + CHUNK_HEADER_SIZE * stream.chunks, stream.bytes);
+}
+
+void test_chunks_fit_mtu(void) {
+  checkMtu(23);
+  checkMtu(185);
+  checkMtu(247);
+}
+
+void test_payload_limits(void) {
+  TEST_ASSERT_EQUAL_UINT(18, chunkPayloadMax(23));
+  TEST_ASSERT_EQUAL_UINT(180, chunkPayloadMax(185));
+  TEST_ASSERT_EQUAL_UINT(242, chunkPayloadMax(247));
+  // Out-of-range MTUs are clamped to what the frame buffer holds
+  TEST_ASSERT_EQUAL_UINT(18, chunkPayloadMax(0));
+  TEST_ASSERT_EQUAL_UINT(CHUNK_MTU_MAX - 5, chunkPayloadMax(1000));
+  // Batches: at least one JSON entry, at most one chunk with its newline
+  TEST_ASSERT_EQUAL_UINT(CHUNK_BATCH_MIN, chunkBatchMax(23));
+  TEST_ASSERT_EQUAL_UINT(179, chunkBatchMax(185));
+}
+
+void test_exact_multiple_ends_with_full_final(void) {
+  // 36 bytes at MTU 23: two full chunks, the second one final
+  std::string text(36, 'x');
+  TEST_ASSERT_EQUAL(CHUNK_FINAL, drain(text, 23));
+  TEST_ASSERT_EQUAL_UINT(2, link.frames.size());
+  TEST_ASSERT_EQUAL_HEX8(CHUNK_FLAG_FRAMED | CHUNK_FLAG_FINAL, link.frames[1][0]);
+}
+
+// ==================== Final Flag ====================
+
+void test_incomplete_list_keeps_streaming(void) {
+  size_t consumed = 0;
+  // Nothing buffered and the scan still running: nothing to send
+  TEST_ASSERT_EQUAL(CHUNK_IDLE, sendNextChunk(&stream, "", 0, 23, false, fakeSend, &link, &consumed));
+  TEST_ASSERT_EQUAL_UINT(0, link.frames.size());
+
+  // A short batch while the scan runs is not final
+  const char* batch = "[{\"ssid\":\"a\"}]\n";
+  TEST_ASSERT_EQUAL(CHUNK_SENT, sendNextChunk(&stream, batch, strlen(batch), 247, false,
+                                              fakeSend, &link, &consumed));
+  TEST_ASSERT_EQUAL_UINT(strlen(batch), consumed);
+  TEST_ASSERT_EQUAL_HEX8(CHUNK_FLAG_FRAMED, link.frames[0][0]);
+
+  // Scan done with the buffer empty: an empty final chunk closes the list
+  TEST_ASSERT_EQUAL(CHUNK_FINAL, sendNextChunk(&stream, "", 0, 247, true, fakeSend, &link, &consumed));
+  TEST_ASSERT_EQUAL_UINT(2, link.frames.size());
+  TEST_ASSERT_EQUAL_UINT(CHUNK_HEADER_SIZE, link.frames[1].size());
+  TEST_ASSERT_EQUAL_HEX8(CHUNK_FLAG_FRAMED | CHUNK_FLAG_FINAL, link.frames[1][0]);
+  TEST_ASSERT_EQUAL_UINT8(1, link.frames[1][1]);
+}
+
+void test_empty_list(void) {
+  size_t consumed = 0;
+  TEST_ASSERT_EQUAL(CHUNK_FINAL, sendNextChunk(&stream, "", 0, 23, true, fakeSend, &link, &consumed));
+  TEST_ASSERT_EQUAL_UINT(1, link.frames.size());
+  TEST_ASSERT_EQUAL_UINT8(0, link.frames[0][1]);
+}
+
+// ==================== Sequence ====================
+
+void test_seq_wraps(void) {
+  // 300 chunks at MTU 23: seq goes ...254, 255, 0, 1...
+  std::string text(300 * 18, 'n');
+  TEST_ASSERT_EQUAL(CHUNK_FINAL, drain(text, 23));
+  TEST_ASSERT_EQUAL_UINT(300, link.frames.size());
+  TEST_ASSERT_EQUAL_UINT8(255, link.frames[255][1]);
+  TEST_ASSERT_EQUAL_UINT8(0, link.frames[256][1]);
+  TEST_ASSERT_EQUAL_UINT8(43, link.frames[299][1]);
+  TEST_ASSERT_EQUAL_UINT32(300, stream.chunks);
+}
+
+void test_new_list_restarts_seq(void) {
+  std::string text(50, 'a');
+  drain(text, 23);
+  resetChunkStream(&stream);
+  link.frames.clear();
+  text.assign(10, 'b');
+  drain(text, 23);
+  TEST_ASSERT_EQUAL_UINT8(0, link.frames[0][1]);
+  TEST_ASSERT_EQUAL_UINT32(1, stream.chunks);
+}
+
+// ==================== Refusal and Retry ====================
+
+void test_refused_chunk_is_retried_in_order(void) {
+  std::string text(100, 'r');
+  size_t consumed = 99;
+  link.budget = 0;
+  TEST_ASSERT_EQUAL(CHUNK_REFUSED, sendNextChunk(&stream, text.data(), text.size(), 23, true,
+                                                 fakeSend, &link, &consumed));
+  // Nothing taken from the text, seq not used
+  TEST_ASSERT_EQUAL_UINT(0, consumed);
+  TEST_ASSERT_EQUAL_UINT8(0, stream.seq);
+  TEST_ASSERT_EQUAL_UINT16(1, stream.stalls);
+
+  link.budget = 1;
+  TEST_ASSERT_EQUAL(CHUNK_SENT, sendNextChunk(&stream, text.data(), text.size(), 23, true,
+                                              fakeSend, &link, &consumed));
+  TEST_ASSERT_EQUAL_UINT8(0, link.frames[0][1]);
+  TEST_ASSERT_EQUAL_UINT(18, consumed);
+}
+
+/**
+ * Loop every 1 ms with a burst of NETWORKS_MAX_BURST chunks, text arriving
+ * in scan batches, and a connection event every 7.5 ms that drains up to
+ * 6 frames from a 6-frame notify queue
+ * @return Payload bytes per second on the simulated link
+ */
+static double simulateTransfer(uint16_t mtu, int networks, uint32_t* stallsOut) {
+  const int burst = 8;
+  const int queueFrames = 6;
+  const int loopUs = 1000;
+  const int eventUs = 7500;
+
+  setUp();
+  std::string pending = networksText(networks);
+  std::string sent = pending;
+  std::string buffer;
+  int queued = 0;
+  uint32_t nowUs = 0;
+  uint32_t nextEvent = eventUs;
+  bool done = false;
+
+  while (!done && nowUs < 60000000) {
+    // Connection event: the controller sends what was queued
+    if (nowUs >= nextEvent) {
+      queued = 0;
+      nextEvent += eventUs;
+    }
+    link.budget = queueFrames - queued;
+    int before = (int)link.frames.size();
+
+    for (int n = 0; n < burst; n++) {
+      if (buffer.size() < chunkPayloadMax(mtu) && !pending.empty()) {
+        // Whole lines up to one batch, as takeWiFiScanPendingJSON() hands them out
+        size_t take = pending.find('\n') + 1;
+        size_t next;
+        while (take < pending.size() &&
+               (next = pending.find('\n', take) + 1) <= chunkBatchMax(mtu) + 1) {
+          take = next;
+        }
+        buffer += pending.substr(0, take);
+        pending.erase(0, take);
+      }
+      size_t consumed = 0;
+      ChunkStatus status = sendNextChunk(&stream, buffer.data(), buffer.size(), mtu, pending.empty(),
+                                         fakeSend, &link, &consumed);
+      if (status == CHUNK_IDLE || status == CHUNK_REFUSED) break;
+      buffer.erase(0, consumed);
+      if (status == CHUNK_FINAL) {
+        done = true;
+        break;
+      }
+    }
+    queued += (int)link.frames.size() - before;
+    nowUs += loopUs;
+  }
+  TEST_ASSERT_TRUE(done);
+  TEST_ASSERT_TRUE(sent == reassemble(mtu));
+  // The last frames leave at the next connection event
+  double seconds = nextEvent / 1e6;
+  *stallsOut = stream.stalls;
+  return sent.size() / seconds;
+}
+
+void test_throughput_with_notify_budget(void) {
+  const uint16_t mtus[] = {23, 185, 247};
+  double previous = 0;
+  for (int i = 0; i < 3; i++) {
+    uint32_t stalls = 0;
+    double rate = simulateTransfer(mtus[i], 40, &stalls);
+    char message[120];
+    snprintf(message, sizeof(message), "MTU %u: %.0f B/s payload, %u chunks, %u stalls",
+             mtus[i], rate, (unsigned)stream.chunks, (unsigned)stalls);
+    TEST_MESSAGE(message);
+    // The queue limit was hit, and every refused chunk still arrived in order
+    TEST_ASSERT_GREATER_THAN(0, stalls);
+    TEST_ASSERT_TRUE(rate >= previous);
+    previous = rate;
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_chunks_fit_mtu);
+  RUN_TEST(test_payload_limits);
+  RUN_TEST(test_exact_multiple_ends_with_full_final);
+  RUN_TEST(test_incomplete_list_keeps_streaming);
+  RUN_TEST(test_empty_list);
+  RUN_TEST(test_seq_wraps);
+  RUN_TEST(test_new_list_restarts_seq);
+  RUN_TEST(test_refused_chunk_is_retried_in_order);
+  RUN_TEST(test_throughput_with_notify_budget);
+  return UNITY_END();
+}
@@ -0,0 +1,127 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests and benchmark of the CIC decimator (pio test -e native)
+ *
+ * The kernel is checked against a direct computation (cascaded boxcar sums
+ * in 64-bit) over long random input, long enough for every integrator to
+ * wrap. The benchmark reports ns/sample on the host; the device reports its
+ * own figure in the hourly [ANALOG] Acquisition log.
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "cic_decimator.h"
+
+#define BENCH_SAMPLES   20000000UL
+
+static CicDecimator cic;
+static uint32_t randomState;
+
+/**
+ * Deterministic 12-bit ADC sample
+ */
+static uint32_t randomSample() {
+  randomState = randomState * 1664525u + 1013904223u;
+  return randomState >> 20;
+}
+
+void setUp(void) {
+  resetCicDecimator(&cic);
+  randomState = 1;
+}
+
+void tearDown(void) {}
+
+// ==================== Exactness ====================
+
+void test_dc_gain(void) {
+  uint32_t output = 0;
+  uint32_t outputs = 0;
+  for (uint32_t i = 0; i < 20 * ANALOG_DECIMATION; i++) {
+    if (cicDecimate(&cic, 4095, &output)) {
+      outputs++;
+      TEST_ASSERT_EQUAL_UINT32((uint32_t)(4095 * cicGain()), output);
+    }
+  }
+  // Settling discards the first ANALOG_CIC_STAGES outputs
+  TEST_ASSERT_EQUAL_UINT32(20 - ANALOG_CIC_STAGES, outputs);
+}
+
+void test_matches_cascaded_boxcars(void) {
+  // Reference: a CIC of order N is N boxcars of ANALOG_DECIMATION samples,
+  // sampled every ANALOG_DECIMATION inputs
+  const uint32_t length = (ANALOG_CIC_STAGES + 1) * ANALOG_DECIMATION;
+  static uint32_t history[ANALOG_CIC_STAGES + 1][(ANALOG_CIC_STAGES + 1) * ANALOG_DECIMATION];
+  memset(history, 0, sizeof(history));
+  uint32_t head = 0;
+  uint32_t checked = 0;
+  uint32_t output;
+
+  // 2^32 / (4095 * 64^2) ~ 256 outputs until the last integrator first wraps
+  for (uint32_t n = 0; n < 4000 * ANALOG_DECIMATION; n++) {
+    uint32_t sample = randomSample();
+    // history[0] = input, history[s] = boxcar of history[s - 1]
+    history[0][head] = sample;
+    for (int s = 1; s <= ANALOG_CIC_STAGES; s++) {
+      uint64_t sum = 0;
+      for (uint32_t k = 0; k < ANALOG_DECIMATION; k++) {
+        sum += history[s - 1][(head + length - k) % length];
+      }
+      history[s][head] = (uint32_t)sum;
+    }
+    bool ready = cicDecimate(&cic, sample, &output);
+    if (ready) {
+      TEST_ASSERT_EQUAL_UINT32(history[ANALOG_CIC_STAGES][head], output);
+      checked++;
+    }
+    head = (head + 1) % length;
+  }
+  TEST_ASSERT_GREATER_THAN(3000, checked);
+}
+
+void test_reset_restarts_settling(void) {
+  uint32_t output;
+  for (uint32_t i = 0; i < 10 * ANALOG_DECIMATION; i++) cicDecimate(&cic, randomSample(), &output);
+  resetCicDecimator(&cic);
+  for (uint32_t i = 0; i < ANALOG_CIC_STAGES * ANALOG_DECIMATION; i++) {
+    TEST_ASSERT_FALSE(cicDecimate(&cic, 2048, &output));
+  }
+  uint32_t i = 0;
+  while (!cicDecimate(&cic, 2048, &output)) i++;
+  TEST_ASSERT_EQUAL_UINT32(ANALOG_DECIMATION - 1, i);
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)(2048 * cicGain()), output);
+}
+
+// ==================== Benchmark ====================
+
+void test_benchmark(void) {
+  static uint32_t samples[4096];
+  for (int i = 0; i < 4096; i++) samples[i] = randomSample();
+
+  uint64_t sum = 0;
+  uint32_t output;
+  clock_t start = clock();
+  for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+    if (cicDecimate(&cic, samples[i & 4095], &output)) sum += output;
+  }
+  double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  char line[160];
+  snprintf(line, sizeof(line),
+           "CIC %dx%d: %.2f ns/sample, %.0f Msamples/s on the host (checksum %llu)",
+           ANALOG_CIC_STAGES, ANALOG_DECIMATION, seconds * 1e9 / BENCH_SAMPLES,
+           BENCH_SAMPLES / seconds / 1e6, (unsigned long long)sum);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_GREATER_THAN(0, sum);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_dc_gain);
+  RUN_TEST(test_matches_cascaded_boxcars);
+  RUN_TEST(test_reset_restarts_settling);
+  RUN_TEST(test_benchmark);
+  return UNITY_END();
+}
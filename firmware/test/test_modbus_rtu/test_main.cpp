@@ -0,0 +1,364 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the Modbus RTU master (pio test -e native)
+ */
+
+#include <unity.h>
+#include <string.h>
+#include "modbus_rtu.h"
+
+#define TIMEOUT_US      100000
+#define TURNAROUND_US   5000
+
+// Frames written by the master and results handed back, in order
+static uint8_t sent[MODBUS_QUEUE_LEN + 2][MODBUS_MAX_FRAME];
+static size_t sentLength[MODBUS_QUEUE_LEN + 2];
+static int sentCount;
+static ModbusResult results[MODBUS_QUEUE_LEN + 2];
+static int resultCount;
+
+static void captureFrame(const uint8_t* frame, size_t length) {
+  if (sentCount < MODBUS_QUEUE_LEN + 2) {
+    memcpy(sent[sentCount], frame, length);
+    sentLength[sentCount] = length;
+  }
+  sentCount++;
+}
+
+static void captureResult(const ModbusResult& result) {
+  if (resultCount < MODBUS_QUEUE_LEN + 2) results[resultCount] = result;
+  resultCount++;
+}
+
+/**
+ * Append the CRC to a frame body
+ * @return Frame length
+ */
+static size_t withCRC(uint8_t* frame, size_t length) {
+  uint16_t crc = modbusCRC16(frame, length);
+  frame[length++] = crc & 0xFF;
+  frame[length++] = crc >> 8;
+  return length;
+}
+
+static ModbusRequest makeRequest(uint8_t slave, uint8_t function, uint16_t address, uint16_t count) {
+  ModbusRequest request;
+  memset(&request, 0, sizeof(request));
+  request.slave = slave;
+  request.function = function;
+  request.address = address;
+  request.count = count;
+  return request;
+}
+
+void setUp(void) {
+  sentCount = 0;
+  resultCount = 0;
+  modbusMasterBegin(captureFrame, captureResult, TIMEOUT_US, TURNAROUND_US);
+}
+
+void tearDown(void) {}
+
+// ==================== CRC ====================
+
+void test_crc_reference_vector(void) {
+  const uint8_t frame[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A};
+  TEST_ASSERT_EQUAL_HEX16(0xCDC5, modbusCRC16(frame, sizeof(frame)));
+  // Spec example (write single register): CRC 9A 9B on the wire
+  const uint8_t write[] = {0x11, 0x06, 0x00, 0x01, 0x00, 0x03};
+  TEST_ASSERT_EQUAL_HEX16(0x9B9A, modbusCRC16(write, sizeof(write)));
+}
+
+/**
+ * Bit-by-bit CRC-16/MODBUS, the reference for the table
+ */
+static uint16_t bitwiseCRC(const uint8_t* data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  while (length--) {
+    crc ^= *data++;
+    for (int bit = 0; bit < 8; bit++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+  }
+  return crc;
+}
+
+void test_crc_table_matches_bitwise(void) {
+  // Every table entry is reached by some byte value after the 0xFFFF init
+  uint8_t data[2];
+  for (int value = 0; value < 256; value++) {
+    data[0] = value;
+    data[1] = 255 - value;
+    TEST_ASSERT_EQUAL_HEX16(bitwiseCRC(data, 1), modbusCRC16(data, 1));
+    TEST_ASSERT_EQUAL_HEX16(bitwiseCRC(data, 2), modbusCRC16(data, 2));
+  }
+}
+
+// ==================== Encoding ====================
+
+void test_build_read_holding(void) {
+  const uint8_t expected[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+  uint8_t frame[MODBUS_MAX_FRAME];
+  size_t length = modbusBuildRequest(makeRequest(1, MODBUS_READ_HOLDING, 0, 10), frame);
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame, length);
+}
+
+void test_build_read_input(void) {
+  const uint8_t expected[] = {0x11, 0x04, 0x00, 0x08, 0x00, 0x01, 0xB2, 0x98};
+  uint8_t frame[MODBUS_MAX_FRAME];
+  size_t length = modbusBuildRequest(makeRequest(0x11, MODBUS_READ_INPUT, 8, 1), frame);
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame, length);
+}
+
+void test_build_write_single(void) {
+  const uint8_t expected[] = {0x11, 0x06, 0x00, 0x01, 0x00, 0x03, 0x9A, 0x9B};
+  ModbusRequest request = makeRequest(0x11, MODBUS_WRITE_SINGLE, 1, 1);
+  request.values[0] = 3;
+  uint8_t frame[MODBUS_MAX_FRAME];
+  size_t length = modbusBuildRequest(request, frame);
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame, length);
+}
+
+void test_build_write_multiple(void) {
+  const uint8_t expected[] = {0x11, 0x10, 0x00, 0x01, 0x00, 0x02, 0x04,
+                              0x00, 0x0A, 0x01, 0x02, 0xC6, 0xF0};
+  ModbusRequest request = makeRequest(0x11, MODBUS_WRITE_MULTIPLE, 1, 2);
+  request.values[0] = 0x000A;
+  request.values[1] = 0x0102;
+  uint8_t frame[MODBUS_MAX_FRAME];
+  size_t length = modbusBuildRequest(request, frame);
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame, length);
+}
+
+void test_build_rejects_invalid(void) {
+  uint8_t frame[MODBUS_MAX_FRAME];
+  TEST_ASSERT_EQUAL_UINT(0, modbusBuildRequest(makeRequest(1, MODBUS_READ_HOLDING, 0, 0), frame));
+  TEST_ASSERT_EQUAL_UINT(0, modbusBuildRequest(
+      makeRequest(1, MODBUS_READ_HOLDING, 0, MODBUS_MAX_REGISTERS + 1), frame));
+  TEST_ASSERT_EQUAL_UINT(0, modbusBuildRequest(makeRequest(1, MODBUS_WRITE_SINGLE, 0, 2), frame));
+  TEST_ASSERT_EQUAL_UINT(0, modbusBuildRequest(makeRequest(1, 0x05, 0, 1), frame));
+  // A broadcast read would never be answered
+  TEST_ASSERT_EQUAL_UINT(0, modbusBuildRequest(
+      makeRequest(MODBUS_BROADCAST, MODBUS_READ_HOLDING, 0, 1), frame));
+}
+
+// ==================== Decoding ====================
+
+void test_parse_read_holding(void) {
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x01, 0x03, 0x06, 0x00, 0x01, 0x09, 0x5E, 0x01, 0x9A};
+  size_t length = withCRC(frame, 9);
+  ModbusResult result;
+  TEST_ASSERT_EQUAL(MODBUS_OK, modbusParseResponse(makeRequest(1, MODBUS_READ_HOLDING, 0x3000, 3),
+                                                   frame, length, result));
+  TEST_ASSERT_EQUAL_UINT16(1, result.values[0]);
+  TEST_ASSERT_EQUAL_UINT16(2398, result.values[1]);
+  TEST_ASSERT_EQUAL_UINT16(410, result.values[2]);
+  TEST_ASSERT_EQUAL_UINT16(0x3000, result.address);
+}
+
+void test_parse_read_input(void) {
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x11, 0x04, 0x02, 0x00, 0x0A};
+  size_t length = withCRC(frame, 5);
+  ModbusResult result;
+  TEST_ASSERT_EQUAL(MODBUS_OK, modbusParseResponse(makeRequest(0x11, MODBUS_READ_INPUT, 8, 1),
+                                                   frame, length, result));
+  TEST_ASSERT_EQUAL_UINT16(10, result.values[0]);
+}
+
+void test_parse_wrong_byte_count(void) {
+  // Two registers asked, one answered
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x11, 0x03, 0x02, 0x00, 0x0A};
+  size_t length = withCRC(frame, 5);
+  ModbusResult result;
+  TEST_ASSERT_EQUAL(MODBUS_BAD_RESPONSE, modbusParseResponse(
+      makeRequest(0x11, MODBUS_READ_HOLDING, 8, 2), frame, length, result));
+}
+
+void test_parse_write_single_echo(void) {
+  ModbusRequest request = makeRequest(0x11, MODBUS_WRITE_SINGLE, 1, 1);
+  request.values[0] = 3;
+  uint8_t frame[MODBUS_MAX_FRAME];
+  size_t length = modbusBuildRequest(request, frame);
+  ModbusResult result;
+  TEST_ASSERT_EQUAL(MODBUS_OK, modbusParseResponse(request, frame, length, result));
+  TEST_ASSERT_EQUAL_UINT16(3, result.values[0]);
+
+  // Echo of another value
+  frame[5] = 4;
+  length = withCRC(frame, 6);
+  TEST_ASSERT_EQUAL(MODBUS_BAD_RESPONSE, modbusParseResponse(request, frame, length, result));
+}
+
+void test_parse_write_multiple_echo(void) {
+  ModbusRequest request = makeRequest(0x11, MODBUS_WRITE_MULTIPLE, 1, 2);
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x11, 0x10, 0x00, 0x01, 0x00, 0x02};
+  size_t length = withCRC(frame, 6);
+  ModbusResult result;
+  TEST_ASSERT_EQUAL(MODBUS_OK, modbusParseResponse(request, frame, length, result));
+
+  frame[5] = 1;   // One register written, not two
+  length = withCRC(frame, 6);
+  TEST_ASSERT_EQUAL(MODBUS_BAD_RESPONSE, modbusParseResponse(request, frame, length, result));
+}
+
+void test_parse_exception(void) {
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x01, 0x83, 0x02};
+  size_t length = withCRC(frame, 3);
+  ModbusResult result;
+  TEST_ASSERT_EQUAL(MODBUS_EXCEPTION, modbusParseResponse(
+      makeRequest(1, MODBUS_READ_HOLDING, 0x4000, 5), frame, length, result));
+  TEST_ASSERT_EQUAL_UINT8(2, result.exception);   // Illegal data address
+}
+
+void test_parse_crc_error(void) {
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x01, 0x03, 0x02, 0x00, 0x0A};
+  size_t length = withCRC(frame, 5);
+  frame[4] ^= 0x01;   // One bit flipped on the line
+  ModbusResult result;
+  TEST_ASSERT_EQUAL(MODBUS_CRC_ERROR, modbusParseResponse(
+      makeRequest(1, MODBUS_READ_HOLDING, 0, 1), frame, length, result));
+}
+
+void test_parse_other_slave(void) {
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x02, 0x03, 0x02, 0x00, 0x0A};
+  size_t length = withCRC(frame, 5);
+  ModbusResult result;
+  TEST_ASSERT_EQUAL(MODBUS_BAD_RESPONSE, modbusParseResponse(
+      makeRequest(1, MODBUS_READ_HOLDING, 0, 1), frame, length, result));
+}
+
+// ==================== Pipeline ====================
+
+void test_next_frame_sent_with_the_answer(void) {
+  ModbusRequest first = makeRequest(1, MODBUS_READ_HOLDING, 0, 1);
+  first.tag = 1;
+  ModbusRequest second = makeRequest(1, MODBUS_READ_HOLDING, 2, 1);
+  second.tag = 2;
+  TEST_ASSERT_TRUE(modbusMasterSubmit(first, 1000));
+  TEST_ASSERT_TRUE(modbusMasterSubmit(second, 1000));
+  // Idle bus: the first frame goes out at once, the second waits
+  TEST_ASSERT_EQUAL_INT(1, sentCount);
+  TEST_ASSERT_EQUAL_UINT8(2, modbusMasterPending());
+
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x01, 0x03, 0x02, 0x12, 0x34};
+  size_t length = withCRC(frame, 5);
+  modbusMasterOnFrame(frame, length, 4000);
+
+  // Answer in, next frame out in the same call
+  TEST_ASSERT_EQUAL_INT(2, sentCount);
+  TEST_ASSERT_EQUAL_UINT(8, sentLength[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x02, sent[1][3]);
+  TEST_ASSERT_EQUAL_INT(1, resultCount);
+  TEST_ASSERT_EQUAL_UINT32(1, results[0].tag);
+  TEST_ASSERT_EQUAL(MODBUS_OK, results[0].status);
+  TEST_ASSERT_EQUAL_HEX16(0x1234, results[0].values[0]);
+  TEST_ASSERT_EQUAL_UINT32(3000, results[0].latencyUs);
+
+  ModbusStats stats = modbusMasterStats();
+  TEST_ASSERT_EQUAL_UINT32(2, stats.requests);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.responses);
+  TEST_ASSERT_EQUAL_UINT32(3000, stats.latencyMaxUs);
+}
+
+void test_timeout(void) {
+  ModbusRequest request = makeRequest(2, MODBUS_READ_HOLDING, 0, 1);
+  modbusMasterSubmit(request, 0);
+  TEST_ASSERT_EQUAL_UINT32(TIMEOUT_US, modbusMasterTick(0));
+  TEST_ASSERT_EQUAL_UINT32(TIMEOUT_US - 40000, modbusMasterTick(40000));
+  TEST_ASSERT_EQUAL_INT(0, resultCount);
+
+  // Deadline reached: the bus is free again
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, modbusMasterTick(TIMEOUT_US));
+  TEST_ASSERT_EQUAL_INT(1, resultCount);
+  TEST_ASSERT_EQUAL(MODBUS_TIMEOUT, results[0].status);
+  TEST_ASSERT_EQUAL_UINT8(0, modbusMasterPending());
+  TEST_ASSERT_EQUAL_UINT32(1, modbusMasterStats().timeouts);
+
+  // The late answer is counted, not taken for another request
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x02, 0x03, 0x02, 0x00, 0x01};
+  size_t length = withCRC(frame, 5);
+  modbusMasterOnFrame(frame, length, TIMEOUT_US + 1000);
+  TEST_ASSERT_EQUAL_INT(1, resultCount);
+  TEST_ASSERT_EQUAL_UINT32(1, modbusMasterStats().unexpected);
+}
+
+void test_exception_and_crc_error_counted(void) {
+  modbusMasterSubmit(makeRequest(1, MODBUS_READ_HOLDING, 0x4000, 1), 0);
+  modbusMasterSubmit(makeRequest(1, MODBUS_READ_HOLDING, 0x5000, 1), 0);
+
+  uint8_t frame[MODBUS_MAX_FRAME] = {0x01, 0x83, 0x02};
+  size_t length = withCRC(frame, 3);
+  modbusMasterOnFrame(frame, length, 2000);
+  frame[length - 1] ^= 0xFF;
+  modbusMasterOnFrame(frame, length, 4000);
+
+  TEST_ASSERT_EQUAL_INT(2, resultCount);
+  TEST_ASSERT_EQUAL(MODBUS_EXCEPTION, results[0].status);
+  TEST_ASSERT_EQUAL(MODBUS_CRC_ERROR, results[1].status);
+  ModbusStats stats = modbusMasterStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.exceptions);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.crcErrors);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.responses);
+}
+
+void test_broadcast_turnaround(void) {
+  ModbusRequest broadcast = makeRequest(MODBUS_BROADCAST, MODBUS_WRITE_SINGLE, 0x2001, 1);
+  broadcast.values[0] = 2800;
+  modbusMasterSubmit(broadcast, 0);
+  modbusMasterSubmit(makeRequest(1, MODBUS_READ_HOLDING, 0, 1), 0);
+  TEST_ASSERT_EQUAL_INT(1, sentCount);
+
+  // Nobody answers: the next frame waits for the turnaround, not the timeout
+  TEST_ASSERT_EQUAL_UINT32(TURNAROUND_US - 1000, modbusMasterTick(1000));
+  TEST_ASSERT_EQUAL_INT(1, sentCount);
+  TEST_ASSERT_EQUAL_UINT32(TIMEOUT_US, modbusMasterTick(TURNAROUND_US));
+  TEST_ASSERT_EQUAL_INT(2, sentCount);
+  TEST_ASSERT_EQUAL_INT(1, resultCount);
+  TEST_ASSERT_EQUAL(MODBUS_OK, results[0].status);
+  TEST_ASSERT_EQUAL_UINT16(2800, results[0].values[0]);
+}
+
+void test_full_queue_rejected(void) {
+  ModbusRequest request = makeRequest(1, MODBUS_READ_HOLDING, 0, 1);
+  for (int i = 0; i < MODBUS_QUEUE_LEN; i++) {
+    TEST_ASSERT_TRUE(modbusMasterSubmit(request, 0));
+  }
+  TEST_ASSERT_FALSE(modbusMasterSubmit(request, 0));
+  TEST_ASSERT_EQUAL_UINT8(MODBUS_QUEUE_LEN, modbusMasterPending());
+  TEST_ASSERT_EQUAL_UINT32(1, modbusMasterStats().rejected);
+
+  // Invalid requests are refused the same way
+  TEST_ASSERT_FALSE(modbusMasterSubmit(makeRequest(1, MODBUS_READ_HOLDING, 0, 0), 0));
+  TEST_ASSERT_EQUAL_UINT32(2, modbusMasterStats().rejected);
+
+  // One completed: room again
+  modbusMasterTick(TIMEOUT_US);
+  TEST_ASSERT_TRUE(modbusMasterSubmit(request, TIMEOUT_US));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc_reference_vector);
+  RUN_TEST(test_crc_table_matches_bitwise);
+  RUN_TEST(test_build_read_holding);
+  RUN_TEST(test_build_read_input);
+  RUN_TEST(test_build_write_single);
+  RUN_TEST(test_build_write_multiple);
+  RUN_TEST(test_build_rejects_invalid);
+  RUN_TEST(test_parse_read_holding);
+  RUN_TEST(test_parse_read_input);
+  RUN_TEST(test_parse_wrong_byte_count);
+  RUN_TEST(test_parse_write_single_echo);
+  RUN_TEST(test_parse_write_multiple_echo);
+  RUN_TEST(test_parse_exception);
+  RUN_TEST(test_parse_crc_error);
+  RUN_TEST(test_parse_other_slave);
+  RUN_TEST(test_next_frame_sent_with_the_answer);
+  RUN_TEST(test_timeout);
+  RUN_TEST(test_exception_and_crc_error_counted);
+  RUN_TEST(test_broadcast_turnaround);
+  RUN_TEST(test_full_queue_rejected);
+  return UNITY_END();
+}
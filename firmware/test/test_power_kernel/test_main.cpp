@@ -0,0 +1,202 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the pump power kernel (pio test -e native)
+ *
+ * Synthetic mains waveforms of known RMS and power factor, rounded to
+ * integer counts like the ADC, go through the kernel as on the device: the
+ * same cases as the boot self-test plus the bias tracking and the cycle
+ * closing rules.
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "power_kernel.h"
+
+#define RATE            4000    // Samples/s per channel
+#define MAINS           50      // Hz
+#define NOMINAL         (RATE / MAINS)
+#define CURRENT_PEAK    1000.0f // Counts
+#define VOLTAGE_PEAK    1200.0f
+#define RMS_TOLERANCE   0.5f    // %
+#define PF_TOLERANCE    0.01f
+
+static PowerKernel kernel;
+static PowerSums total;
+static uint32_t closedCycles;
+
+/**
+ * Feed cycles of a sine pair; sums after the first discarded cycles go to total
+ * @param bias Mid-point of both channels (counts)
+ * @param discard Cycles closed before total starts (bias and crossing lock-in)
+ */
+static void feed(uint32_t cycles, float pf, float bias, uint32_t discard) {
+  float lag = acosf(pf);
+  PowerSums cycle;
+  for (uint32_t n = 0; n < cycles * NOMINAL; n++) {
+    float phase = 2 * (float)M_PI * MAINS * n / RATE;
+    uint16_t rawV = (uint16_t)lroundf(bias + VOLTAGE_PEAK * sinf(phase));
+    uint16_t rawI = (uint16_t)lroundf(bias + CURRENT_PEAK * sinf(phase - lag));
+    if (!kernelSample(kernel, rawI, rawV, cycle)) continue;
+    if (closedCycles++ >= discard) addSums(total, cycle);
+  }
+}
+
+static float errorPercent(float measured, float expected) {
+  return (measured - expected) / expected * 100;
+}
+
+static float currentRms() {
+  return rmsOf(total.sumI2, total.samples) / (1 << KERNEL_FRAC_BITS);
+}
+
+static float voltageRms() {
+  return rmsOf(total.sumV2, total.samples) / (1 << KERNEL_FRAC_BITS);
+}
+
+static float powerFactor() {
+  float scale = 1 << KERNEL_FRAC_BITS;
+  return (float)total.sumVI / total.samples / (scale * scale) / (currentRms() * voltageRms());
+}
+
+void setUp(void) {
+  memset(&total, 0, sizeof(total));
+  closedCycles = 0;
+}
+
+void tearDown(void) {}
+
+// ==================== RMS And Power Factor ====================
+
+static void checkPowerFactor(float pf) {
+  kernelReset(kernel, RATE, MAINS, true);
+  feed(30, pf, 2048, 1);
+  TEST_ASSERT_FLOAT_WITHIN(RMS_TOLERANCE, 0, errorPercent(currentRms(), CURRENT_PEAK / sqrtf(2)));
+  TEST_ASSERT_FLOAT_WITHIN(RMS_TOLERANCE, 0, errorPercent(voltageRms(), VOLTAGE_PEAK / sqrtf(2)));
+  TEST_ASSERT_FLOAT_WITHIN(PF_TOLERANCE, pf, powerFactor());
+}
+
+void test_unity_power_factor(void) {
+  checkPowerFactor(1.0f);
+}
+
+void test_power_factor_0_8(void) {
+  checkPowerFactor(0.8f);
+}
+
+void test_power_factor_0_5(void) {
+  checkPowerFactor(0.5f);
+}
+
+void test_cycles_follow_voltage_crossings(void) {
+  kernelReset(kernel, RATE, MAINS, true);
+  feed(30, 0.5f, 2048, 1);
+  // One closed cycle per mains period, all of nominal length
+  TEST_ASSERT_UINT32_WITHIN(1, 30, closedCycles);
+  TEST_ASSERT_UINT32_WITHIN(NOMINAL, (closedCycles - 1) * NOMINAL, total.samples);
+}
+
+void test_pump_off_closes_on_voltage(void) {
+  // Relay open: mains voltage but flat current still gives nominal cycles
+  kernelReset(kernel, RATE, MAINS, true);
+  PowerSums cycle;
+  uint32_t closes = 0;
+  for (uint32_t n = 0; n < 30 * NOMINAL; n++) {
+    float phase = 2 * (float)M_PI * MAINS * n / RATE;
+    uint16_t rawV = (uint16_t)lroundf(2048 + VOLTAGE_PEAK * sinf(phase));
+    if (!kernelSample(kernel, 2048, rawV, cycle)) continue;
+    if (closes++ > 0) TEST_ASSERT_UINT32_WITHIN(1, NOMINAL, cycle.samples);
+    TEST_ASSERT_EQUAL_UINT64(0, cycle.sumI2);
+  }
+  TEST_ASSERT_UINT32_WITHIN(1, 30, closes);
+}
+
+void test_current_only(void) {
+  kernelReset(kernel, RATE, MAINS, false);
+  feed(30, 0.5f, 2048, 1);
+  TEST_ASSERT_FLOAT_WITHIN(RMS_TOLERANCE, 0, errorPercent(currentRms(), CURRENT_PEAK / sqrtf(2)));
+  // Voltage ignored: cycles closed on the current crossings
+  TEST_ASSERT_EQUAL_UINT64(0, total.sumV2);
+  TEST_ASSERT_EQUAL_INT64(0, total.sumVI);
+  TEST_ASSERT_UINT32_WITHIN(1, 30, closedCycles);
+}
+
+// ==================== Bias Tracking ====================
+
+void test_offset_bias_converges(void) {
+  // CT divider off mid-scale by 250 counts: the kernel starts at 2048
+  const float bias = 1798;
+  kernelReset(kernel, RATE, MAINS, true);
+  // 8 s, about 8 time constants of the 2^12-sample bias IIR; the last 2 s count
+  feed(400, 0.8f, bias, 300);
+  // The IIR follows the sine a little: ripple of peak / (2^shift * 2*pi*f/rate)
+  float rippleI = CURRENT_PEAK / (1 << PUMP_OFFSET_SHIFT) / (2 * (float)M_PI * MAINS / RATE);
+  float rippleV = rippleI * VOLTAGE_PEAK / CURRENT_PEAK;
+  TEST_ASSERT_FLOAT_WITHIN(rippleI + 1, bias, kernel.offsetI / 65536.0f);
+  TEST_ASSERT_FLOAT_WITHIN(rippleV + 1, bias, kernel.offsetV / 65536.0f);
+  TEST_ASSERT_FLOAT_WITHIN(RMS_TOLERANCE, 0, errorPercent(currentRms(), CURRENT_PEAK / sqrtf(2)));
+  TEST_ASSERT_FLOAT_WITHIN(RMS_TOLERANCE, 0, errorPercent(voltageRms(), VOLTAGE_PEAK / sqrtf(2)));
+  TEST_ASSERT_FLOAT_WITHIN(PF_TOLERANCE, 0.8f, powerFactor());
+}
+
+void test_bias_error_shows_before_convergence(void) {
+  // The same input read in the first cycles, before the bias settled: the
+  // DC error inflates the RMS (guards the test above against a kernel that
+  // ignores the bias altogether)
+  kernelReset(kernel, RATE, MAINS, false);
+  feed(3, 1.0f, 1798, 0);
+  TEST_ASSERT_TRUE(errorPercent(currentRms(), CURRENT_PEAK / sqrtf(2)) > 2 * RMS_TOLERANCE);
+}
+
+// ==================== Cycle Closing ====================
+
+void test_flat_input_closes_at_max_samples(void) {
+  // Pump off: no crossings, a cycle is still closed every maxSamples
+  kernelReset(kernel, RATE, MAINS, false);
+  PowerSums cycle;
+  uint32_t closes = 0;
+  for (uint32_t n = 1; n <= 10 * kernel.maxSamples; n++) {
+    // ADC noise inside the hysteresis band never arms the detector
+    uint16_t noise = (uint16_t)(2048 + (n % 3) * (PUMP_ZC_HYSTERESIS / 2));
+    bool closed = kernelSample(kernel, noise, 0, cycle);
+    TEST_ASSERT_EQUAL(n % kernel.maxSamples == 0, closed);
+    if (!closed) continue;
+    closes++;
+    TEST_ASSERT_EQUAL_UINT32(kernel.maxSamples, cycle.samples);
+    TEST_ASSERT_EQUAL_UINT16(0, kernel.samples);
+  }
+  TEST_ASSERT_EQUAL_UINT32(10, closes);
+  TEST_ASSERT_EQUAL_UINT16(2 * NOMINAL, kernel.maxSamples);
+}
+
+void test_short_cycle_not_closed(void) {
+  // A crossing before minSamples (spike, harmonic) does not close the cycle
+  kernelReset(kernel, RATE, MAINS, false);
+  PowerSums cycle;
+  uint16_t low = 2048 - 4 * PUMP_ZC_HYSTERESIS;
+  TEST_ASSERT_FALSE(kernelSample(kernel, low, 0, cycle));
+  TEST_ASSERT_FALSE(kernelSample(kernel, 2048 + 100, 0, cycle));
+  TEST_ASSERT_FALSE(kernel.armed);
+  for (uint16_t n = kernel.samples; n < kernel.minSamples - 1; n++) {
+    TEST_ASSERT_FALSE(kernelSample(kernel, 2048, 0, cycle));
+  }
+  // Armed again and crossing once minSamples are in: closed
+  TEST_ASSERT_FALSE(kernelSample(kernel, low, 0, cycle));
+  TEST_ASSERT_TRUE(kernelSample(kernel, 2048 + 100, 0, cycle));
+  TEST_ASSERT_EQUAL_UINT32(kernel.minSamples + 1, cycle.samples);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unity_power_factor);
+  RUN_TEST(test_power_factor_0_8);
+  RUN_TEST(test_power_factor_0_5);
+  RUN_TEST(test_cycles_follow_voltage_crossings);
+  RUN_TEST(test_pump_off_closes_on_voltage);
+  RUN_TEST(test_current_only);
+  RUN_TEST(test_offset_bias_converges);
+  RUN_TEST(test_bias_error_shows_before_convergence);
+  RUN_TEST(test_flat_input_closes_at_max_samples);
+  RUN_TEST(test_short_cycle_not_closed);
+  return UNITY_END();
+}
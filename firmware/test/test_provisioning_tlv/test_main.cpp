@@ -0,0 +1,292 @@
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the provisioning TLV parser (pio test -e native)
+ */
+
+#include <unity.h>
+#include <string.h>
+#include "provisioning_tlv.h"
+
+static uint8_t buffer[512];
+static size_t length;
+static ProvisioningData data;
+
+/**
+ * Append one [type][length][value] record to the test buffer
+ */
+static void record(uint8_t type, const void* value, size_t size) {
+  buffer[length++] = type;
+  buffer[length++] = (uint8_t)size;
+  memcpy(buffer + length, value, size);
+  length += size;
+}
+
+static void recordString(uint8_t type, const char* value) {
+  record(type, value, strlen(value));
+}
+
+static const char* parse() {
+  return parseProvisioningTLV(buffer, length, &data);
+}
+
+void setUp(void) {
+  length = 0;
+  memset(&data, 0xA5, sizeof(data));
+}
+
+void tearDown(void) {}
+
+// ==================== Valid Writes ====================
+
+void test_ssid_and_password(void) {
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_PASSWORD, "secret123");
+  TEST_ASSERT_NULL(parse());
+  TEST_ASSERT_EQUAL_STRING("PoolNet", data.ssid);
+  TEST_ASSERT_EQUAL_STRING("secret123", data.password);
+  // Absent settings come back cleared (firmware defaults)
+  TEST_ASSERT_EQUAL_STRING("", data.settings.mqttHost);
+  TEST_ASSERT_EQUAL_UINT16(0, data.settings.mqttPort);
+  TEST_ASSERT_EQUAL_HEX8(0, data.settingsFields);
+}
+
+void test_open_network(void) {
+  recordString(TLV_SSID, "Guest");
+  record(TLV_PASSWORD, "", 0);
+  TEST_ASSERT_NULL(parse());
+  TEST_ASSERT_EQUAL_STRING("", data.password);
+}
+
+void test_all_settings(void) {
+  const uint8_t ip[16] = {192, 168, 1, 50, 192, 168, 1, 1, 255, 255, 255, 0, 1, 1, 1, 1};
+  const uint8_t port[2] = {0x22, 0xB3};  // 8883
+  recordString(TLV_SSID, "PoolNet");
+  record(TLV_STATIC_IP, ip, sizeof(ip));
+  recordString(TLV_MQTT_HOST, "broker.local");
+  recordString(TLV_MQTT_USER, "pool");
+  recordString(TLV_MQTT_PASS, "hunter2");
+  record(TLV_MQTT_PORT, port, sizeof(port));
+  recordString(TLV_DEVICE_NAME, "pool-2");
+  TEST_ASSERT_NULL(parse());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(ip, data.settings.ip, 4);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(ip + 4, data.settings.gateway, 4);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(ip + 8, data.settings.subnet, 4);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(ip + 12, data.settings.dns, 4);
+  TEST_ASSERT_EQUAL_STRING("broker.local", data.settings.mqttHost);
+  TEST_ASSERT_EQUAL_STRING("pool", data.settings.mqttUser);
+  TEST_ASSERT_EQUAL_STRING("hunter2", data.settings.mqttPass);
+  TEST_ASSERT_EQUAL_UINT16(8883, data.settings.mqttPort);
+  TEST_ASSERT_EQUAL_STRING("pool-2", data.settings.deviceName);
+  TEST_ASSERT_EQUAL_HEX8(NETWORK_FIELD_STATIC_IP | NETWORK_FIELD_MQTT_HOST |
+                         NETWORK_FIELD_MQTT_PORT | NETWORK_FIELD_DEVICE_NAME, data.settingsFields);
+}
+
+void test_partial_settings_flagged(void) {
+  const uint8_t port[2] = {0x07, 0x5B};  // 1883
+  recordString(TLV_SSID, "PoolNet");
+  record(TLV_MQTT_PORT, port, sizeof(port));
+  TEST_ASSERT_NULL(parse());
+  // Only the port was sent: the stored host, address and name must be kept
+  TEST_ASSERT_EQUAL_HEX8(NETWORK_FIELD_MQTT_PORT, data.settingsFields);
+  TEST_ASSERT_EQUAL_UINT16(1883, data.settings.mqttPort);
+}
+
+void test_anonymous_broker(void) {
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_MQTT_HOST, "broker.local");
+  record(TLV_MQTT_USER, "", 0);
+  TEST_ASSERT_NULL(parse());
+  TEST_ASSERT_EQUAL_STRING("", data.settings.mqttUser);
+  TEST_ASSERT_EQUAL_STRING("", data.settings.mqttPass);
+  TEST_ASSERT_EQUAL_HEX8(NETWORK_FIELD_MQTT_HOST, data.settingsFields);
+}
+
+void test_maximum_lengths(void) {
+  char ssid[33], password[64];
+  memset(ssid, 'S', 32);
+  ssid[32] = '\0';
+  memset(password, 'p', 63);
+  password[63] = '\0';
+  recordString(TLV_SSID, ssid);
+  recordString(TLV_PASSWORD, password);
+  TEST_ASSERT_NULL(parse());
+  TEST_ASSERT_EQUAL_STRING(ssid, data.ssid);
+  TEST_ASSERT_EQUAL_STRING(password, data.password);
+}
+
+void test_unknown_types_skipped(void) {
+  const uint8_t future[5] = {1, 2, 3, 4, 5};
+  record(0x7F, future, sizeof(future));
+  recordString(TLV_SSID, "PoolNet");
+  record(0x20, "", 0);
+  recordString(TLV_PASSWORD, "secret123");
+  TEST_ASSERT_NULL(parse());
+  TEST_ASSERT_EQUAL_STRING("PoolNet", data.ssid);
+  TEST_ASSERT_EQUAL_STRING("secret123", data.password);
+}
+
+// ==================== Truncated Writes ====================
+
+void test_truncated_header(void) {
+  recordString(TLV_SSID, "PoolNet");
+  buffer[length++] = TLV_PASSWORD;  // Type without length
+  TEST_ASSERT_EQUAL_STRING("invalid_tlv", parse());
+}
+
+void test_truncated_value(void) {
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_PASSWORD, "secret123");
+  length -= 3;  // Length byte promises more than was written
+  TEST_ASSERT_EQUAL_STRING("invalid_tlv", parse());
+}
+
+void test_length_past_end(void) {
+  buffer[0] = TLV_SSID;
+  buffer[1] = 0xFF;
+  memcpy(buffer + 2, "PoolNet", 7);
+  length = 9;
+  TEST_ASSERT_EQUAL_STRING("invalid_tlv", parse());
+}
+
+// ==================== Oversize And Malformed Fields ====================
+
+void test_oversize_ssid(void) {
+  char ssid[34];
+  memset(ssid, 'S', 33);
+  ssid[33] = '\0';
+  recordString(TLV_SSID, ssid);
+  TEST_ASSERT_EQUAL_STRING("invalid_ssid", parse());
+}
+
+void test_oversize_password(void) {
+  char password[65];
+  memset(password, 'p', 64);
+  password[64] = '\0';
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_PASSWORD, password);
+  TEST_ASSERT_EQUAL_STRING("invalid_password", parse());
+}
+
+void test_oversize_mqtt_host(void) {
+  char host[65];
+  memset(host, 'h', 64);
+  host[64] = '\0';
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_MQTT_HOST, host);
+  TEST_ASSERT_EQUAL_STRING("invalid_mqtt_host", parse());
+}
+
+void test_oversize_mqtt_credentials(void) {
+  char user[65];
+  memset(user, 'u', 64);
+  user[64] = '\0';
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_MQTT_HOST, "broker.local");
+  recordString(TLV_MQTT_USER, user);
+  TEST_ASSERT_EQUAL_STRING("invalid_mqtt_credentials", parse());
+
+  length = 0;
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_MQTT_HOST, "broker.local");
+  record(TLV_MQTT_USER, "", 0);
+  recordString(TLV_MQTT_PASS, user);
+  TEST_ASSERT_EQUAL_STRING("invalid_mqtt_credentials", parse());
+}
+
+void test_oversize_device_name(void) {
+  char name[33];
+  memset(name, 'n', 32);
+  name[32] = '\0';
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_DEVICE_NAME, name);
+  TEST_ASSERT_EQUAL_STRING("invalid_name", parse());
+}
+
+void test_wrong_fixed_lengths(void) {
+  const uint8_t ip[12] = {192, 168, 1, 50, 192, 168, 1, 1, 255, 255, 255, 0};
+  recordString(TLV_SSID, "PoolNet");
+  record(TLV_STATIC_IP, ip, sizeof(ip));
+  TEST_ASSERT_EQUAL_STRING("invalid_ip", parse());
+
+  length = 0;
+  recordString(TLV_SSID, "PoolNet");
+  record(TLV_MQTT_PORT, "\x07", 1);
+  TEST_ASSERT_EQUAL_STRING("invalid_mqtt_port", parse());
+}
+
+void test_device_name_characters(void) {
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_DEVICE_NAME, "pool_2");
+  TEST_ASSERT_EQUAL_STRING("invalid_name", parse());
+}
+
+// ==================== Broker Credentials ====================
+
+void test_host_without_credentials(void) {
+  // The built-in credentials are never sent to a provisioned host
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_MQTT_HOST, "broker.local");
+  TEST_ASSERT_EQUAL_STRING("invalid_mqtt_credentials", parse());
+
+  length = 0;
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_MQTT_HOST, "broker.local");
+  recordString(TLV_MQTT_PASS, "hunter2");
+  TEST_ASSERT_EQUAL_STRING("invalid_mqtt_credentials", parse());
+}
+
+void test_credentials_without_host(void) {
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_MQTT_USER, "pool");
+  recordString(TLV_MQTT_PASS, "hunter2");
+  TEST_ASSERT_EQUAL_STRING("invalid_mqtt_credentials", parse());
+
+  length = 0;
+  recordString(TLV_SSID, "PoolNet");
+  recordString(TLV_MQTT_PASS, "hunter2");
+  TEST_ASSERT_EQUAL_STRING("invalid_mqtt_credentials", parse());
+}
+
+// ==================== Missing SSID ====================
+
+void test_missing_ssid(void) {
+  recordString(TLV_PASSWORD, "secret123");
+  TEST_ASSERT_EQUAL_STRING("invalid_ssid", parse());
+}
+
+void test_empty_ssid(void) {
+  record(TLV_SSID, "", 0);
+  recordString(TLV_PASSWORD, "secret123");
+  TEST_ASSERT_EQUAL_STRING("invalid_ssid", parse());
+}
+
+void test_empty_write(void) {
+  TEST_ASSERT_EQUAL_STRING("invalid_ssid", parse());
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ssid_and_password);
+  RUN_TEST(test_open_network);
+  RUN_TEST(test_all_settings);
+  RUN_TEST(test_partial_settings_flagged);
+  RUN_TEST(test_anonymous_broker);
+  RUN_TEST(test_maximum_lengths);
+  RUN_TEST(test_unknown_types_skipped);
+  RUN_TEST(test_truncated_header);
+  RUN_TEST(test_truncated_value);
+  RUN_TEST(test_length_past_end);
+  RUN_TEST(test_oversize_ssid);
+  RUN_TEST(test_oversize_password);
+  RUN_TEST(test_oversize_mqtt_host);
+  RUN_TEST(test_oversize_mqtt_credentials);
+  RUN_TEST(test_oversize_device_name);
+  RUN_TEST(test_wrong_fixed_lengths);
+  RUN_TEST(test_device_name_characters);
+  RUN_TEST(test_host_without_credentials);
+  RUN_TEST(test_credentials_without_host);
+  RUN_TEST(test_missing_ssid);
+  RUN_TEST(test_empty_ssid);
+  RUN_TEST(test_empty_write);
+  return UNITY_END();
+}
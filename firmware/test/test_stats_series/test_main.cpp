@@ -0,0 +1,193 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the windowed sensor statistics (pio test -e native)
+ */
+
+#include <unity.h>
+#include <math.h>
+#include "stats_series.h"
+
+#define SECOND  1000ULL
+#define MINUTE  (60 * SECOND)
+
+static StatsSeries series;
+
+void setUp(void) {
+  resetStatsSeries(&series);
+}
+
+void tearDown(void) {}
+
+// ==================== Shifted Data ====================
+
+/**
+ * Large level, small swing: unshifted float Welford drifts by ~0.5% of the
+ * spread at 10000; the reference is computed in double from the same floats
+ */
+static void checkShifted(float level, float swing) {
+  static float readings[1000];
+  resetStatsSeries(&series);
+  double sum = 0;
+  for (int i = 0; i < 1000; i++) {
+    readings[i] = level + swing * sinf(i * 0.7f);
+    sum += readings[i];
+    addStatsSeriesSample(&series, readings[i], 10 * SECOND + i * SECOND);
+  }
+  double mean = sum / 1000;
+  double variance = 0;
+  for (int i = 0; i < 1000; i++) variance += (readings[i] - mean) * (readings[i] - mean);
+  double stddev = sqrt(variance / 1000);
+
+  // Every reading held 1 s, the last one queried 1 s later
+  SensorStats stats = queryStatsSeries(series, STATS_WINDOW_1H, 1010 * SECOND);
+  TEST_ASSERT_EQUAL_UINT32(1000, stats.count);
+  TEST_ASSERT_FLOAT_WITHIN(swing * 0.01f, mean, stats.mean);
+  TEST_ASSERT_FLOAT_WITHIN(stddev * 0.001, stddev, stats.stddev);
+}
+
+void test_shifted_data(void) {
+  checkShifted(10000.0f, 0.01f);
+  checkShifted(650.0f, 0.5f);     // ORP (mV)
+  checkShifted(812.0f, 3.0f);     // Pump power (W)
+}
+
+// ==================== Time Weighting ====================
+
+void test_value_weighted_by_its_own_hold(void) {
+  // 10 stands for 9 s, 20 for 1 s: mean 11, not the 19 a backward hold gives
+  // (15 min window: 75 s buckets, no cap)
+  addStatsSeriesSample(&series, 10, 0);
+  addStatsSeriesSample(&series, 20, 9 * SECOND);
+  SensorStats stats = queryStatsSeries(series, STATS_WINDOW_15MIN, 10 * SECOND);
+
+  TEST_ASSERT_EQUAL_UINT32(2, stats.count);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 11.0f, stats.mean);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 3.0f, stats.stddev);
+}
+
+void test_fast_schedule_does_not_bias_the_mean(void) {
+  // 25 °C for 10 min read every 2 min, then 27 °C for 10 min read every 10 s
+  uint64_t t = 0;
+  for (; t < 10 * MINUTE; t += 2 * MINUTE) addStatsSeriesSample(&series, 25, t);
+  for (; t < 20 * MINUTE; t += 10 * SECOND) addStatsSeriesSample(&series, 27, t);
+  SensorStats stats = queryStatsSeries(series, STATS_WINDOW_1H, t);
+
+  TEST_ASSERT_EQUAL_UINT32(5 + 60, stats.count);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 26.0f, stats.mean);
+}
+
+void test_latest_reading_counts_at_once(void) {
+  addStatsSeriesSample(&series, 7, 0);
+  SensorStats stats = queryStatsSeries(series, STATS_WINDOW_1MIN, 0);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.count);
+  TEST_ASSERT_EQUAL_FLOAT(7, stats.mean);
+  TEST_ASSERT_EQUAL_FLOAT(0, stats.stddev);
+}
+
+void test_same_millisecond_readings(void) {
+  addStatsSeriesSample(&series, 1, 5 * SECOND);
+  addStatsSeriesSample(&series, 3, 5 * SECOND);
+  SensorStats stats = queryStatsSeries(series, STATS_WINDOW_1MIN, 5 * SECOND);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.count);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 2.0f, stats.mean);
+  TEST_ASSERT_FALSE(isnan(stats.stddev));
+}
+
+void test_gap_weighs_one_bucket(void) {
+  // 24 h window: 2 h buckets. A reading followed by a 5 h gap (sensor
+  // missing) stands for one bucket, like the 2 h reading after it
+  addStatsSeriesSample(&series, 10, 0);
+  addStatsSeriesSample(&series, 20, 300 * MINUTE);
+  SensorStats stats = queryStatsSeries(series, STATS_WINDOW_24H, 420 * MINUTE);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 15.0f, stats.mean);
+}
+
+// ==================== Window Expiry ====================
+
+void test_bucket_expiry(void) {
+  // Readings every 5 s during the first minute, then nothing
+  for (int i = 0; i < 12; i++) addStatsSeriesSample(&series, 20 + i % 2, i * 5 * SECOND);
+
+  TEST_ASSERT_EQUAL_UINT32(12, queryStatsSeries(series, STATS_WINDOW_1MIN, 59 * SECOND).count);
+  // 1 min window, 5 s buckets: a bucket leaves 1 min after it began
+  TEST_ASSERT_EQUAL_UINT32(11, queryStatsSeries(series, STATS_WINDOW_1MIN, 60 * SECOND).count);
+  TEST_ASSERT_EQUAL_UINT32(10, queryStatsSeries(series, STATS_WINDOW_1MIN, 65 * SECOND).count);
+  // All gone from the minute, still in the longer windows
+  TEST_ASSERT_EQUAL_UINT32(0, queryStatsSeries(series, STATS_WINDOW_1MIN, 2 * MINUTE).count);
+  TEST_ASSERT_FLOAT_IS_NAN(queryStatsSeries(series, STATS_WINDOW_1MIN, 2 * MINUTE).mean);
+  TEST_ASSERT_EQUAL_UINT32(12, queryStatsSeries(series, STATS_WINDOW_15MIN, 2 * MINUTE).count);
+  TEST_ASSERT_EQUAL_UINT32(0, queryStatsSeries(series, STATS_WINDOW_15MIN, 16 * MINUTE).count);
+  TEST_ASSERT_EQUAL_UINT32(12, queryStatsSeries(series, STATS_WINDOW_24H, 16 * MINUTE).count);
+}
+
+void test_reused_bucket_drops_old_slot(void) {
+  // Same ring position one window later: the old slot is reset, not merged
+  addStatsSeriesSample(&series, 100, 0);
+  addStatsSeriesSample(&series, 5, 1 * SECOND);     // 100 into slot 0
+  addStatsSeriesSample(&series, 5, 61 * SECOND);    // 5 of 1 s: out of the window
+  addStatsSeriesSample(&series, 5, 62 * SECOND);    // 5 of 61 s into slot 12 (ring position 0)
+  SensorStats stats = queryStatsSeries(series, STATS_WINDOW_1MIN, 63 * SECOND);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.count);
+  TEST_ASSERT_EQUAL_FLOAT(5, stats.max);
+  TEST_ASSERT_EQUAL_FLOAT(5, stats.mean);
+}
+
+// ==================== Chan Merge ====================
+
+void test_chan_merge_matches_single_pass(void) {
+  // Random weighted data split across buckets vs one bucket of all of it
+  StatsBucket whole;
+  StatsBucket parts[5];
+  statsBucketReset(&whole, 0);
+  for (int p = 0; p < 5; p++) statsBucketReset(&parts[p], p);
+
+  uint32_t state = 7;
+  for (int i = 0; i < 500; i++) {
+    state = state * 1664525u + 1013904223u;
+    float value = (state >> 8) / 16777216.0f * 4 - 2;
+    float weight = 0.5f + (state & 0xFF) / 64.0f;
+    statsBucketAdd(&whole, value, weight);
+    statsBucketAdd(&parts[i * 5 / 500], value, weight);
+  }
+  StatsBucket merged;
+  statsBucketReset(&merged, 0);
+  for (int p = 0; p < 5; p++) statsBucketMerge(&merged, parts[p]);
+
+  TEST_ASSERT_EQUAL_UINT32(whole.count, merged.count);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, whole.weight, merged.weight);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, whole.mean, merged.mean);
+  TEST_ASSERT_FLOAT_WITHIN(whole.m2 * 1e-4f, whole.m2, merged.m2);
+  TEST_ASSERT_EQUAL_FLOAT(whole.min, merged.min);
+  TEST_ASSERT_EQUAL_FLOAT(whole.max, merged.max);
+}
+
+void test_merge_skips_empty_buckets(void) {
+  StatsBucket total;
+  StatsBucket empty;
+  StatsBucket one;
+  statsBucketReset(&total, 0);
+  statsBucketReset(&empty, 1);
+  statsBucketReset(&one, 2);
+  statsBucketAdd(&one, 4, 2);
+  statsBucketMerge(&total, empty);
+  statsBucketMerge(&total, one);
+  statsBucketMerge(&total, empty);
+  TEST_ASSERT_EQUAL_UINT32(1, total.count);
+  TEST_ASSERT_EQUAL_FLOAT(4, total.mean);
+  TEST_ASSERT_EQUAL_FLOAT(2, total.weight);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_shifted_data);
+  RUN_TEST(test_value_weighted_by_its_own_hold);
+  RUN_TEST(test_fast_schedule_does_not_bias_the_mean);
+  RUN_TEST(test_latest_reading_counts_at_once);
+  RUN_TEST(test_same_millisecond_readings);
+  RUN_TEST(test_gap_weighs_one_bucket);
+  RUN_TEST(test_bucket_expiry);
+  RUN_TEST(test_reused_bucket_drops_old_slot);
+  RUN_TEST(test_chan_merge_matches_single_pass);
+  RUN_TEST(test_merge_skips_empty_buckets);
+  return UNITY_END();
+}
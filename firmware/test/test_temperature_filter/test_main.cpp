@@ -0,0 +1,149 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the probe filter chain (pio test -e native)
+ */
+
+#include <unity.h>
+#include <math.h>
+#include "config.h"
+#include "temperature_filter.h"
+
+#define ACTIVE_BITS     TEMP_ACTIVE_RESOLUTION
+#define ACTIVE_MS       TEMP_ACTIVE_INTERVAL
+
+static TemperatureFilter filter;
+static uint32_t now;
+
+/**
+ * Feed one reading a sampling interval after the previous one
+ */
+static float feed(float raw, uint32_t intervalMs = ACTIVE_MS, uint8_t bits = ACTIVE_BITS) {
+  now += intervalMs;
+  return updateTemperatureFilter(&filter, raw, bits, now);
+}
+
+void setUp(void) {
+  resetTemperatureFilter(&filter);
+  now = 0;
+}
+
+void tearDown(void) {}
+
+// ==================== Median ====================
+
+void test_first_reading_passes_through(void) {
+  TEST_ASSERT_FLOAT_IS_NAN(filter.estimate);
+  TEST_ASSERT_EQUAL_FLOAT(25.5f, feed(25.5f));
+}
+
+void test_median_while_filling(void) {
+  feed(25.0f);
+  feed(26.0f);
+  // Even count: mean of the middle pair
+  TEST_ASSERT_EQUAL_FLOAT(25.5f, temperatureMedian(filter));
+  feed(30.0f);
+  TEST_ASSERT_EQUAL_FLOAT(26.0f, temperatureMedian(filter));
+}
+
+void test_spike_rejection(void) {
+  for (int i = 0; i < 6; i++) feed(25.0f);
+  // 85 °C is the DS18B20 power-on value: a brown-out on a long cable
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, feed(85.0f));
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, feed(25.0f));
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, feed(25.0f));
+  // Low spike as well
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, feed(0.0f));
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, feed(25.0f));
+}
+
+// ==================== Kalman ====================
+
+void test_step_response(void) {
+  for (int i = 0; i < 10; i++) feed(25.0f);
+
+  // The median holds the first reading of the step back
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, feed(27.0f));
+
+  float previous = 25.0f;
+  int readings = 1;
+  float value;
+  do {
+    value = feed(27.0f);
+    readings++;
+    // Monotonic, no overshoot
+    TEST_ASSERT_TRUE(value > previous);
+    TEST_ASSERT_TRUE(value <= 27.0f);
+    previous = value;
+  } while (27.0f - value > TEMP_DEADBAND && readings < 20);
+
+  // Within the report deadband in about a minute of active sampling
+  TEST_ASSERT_LESS_OR_EQUAL(7, readings);
+}
+
+void test_longer_interval_follows_faster(void) {
+  // After 2 min the water may have moved more than after 10 s: higher gain
+  for (int i = 0; i < 10; i++) feed(25.0f, TEMP_STABLE_INTERVAL, TEMP_STABLE_RESOLUTION);
+  feed(27.0f, TEMP_STABLE_INTERVAL, TEMP_STABLE_RESOLUTION);
+  float stable = feed(27.0f, TEMP_STABLE_INTERVAL, TEMP_STABLE_RESOLUTION);
+
+  setUp();
+  for (int i = 0; i < 10; i++) feed(25.0f);
+  feed(27.0f);
+  float active = feed(27.0f);
+
+  TEST_ASSERT_TRUE(stable > active);
+}
+
+void test_quantization_jitter_smoothed(void) {
+  // Readings toggling by one 12-bit step
+  float minOut = 100, maxOut = -100;
+  for (int i = 0; i < 60; i++) {
+    float out = feed(i % 4 < 2 ? 25.0f : 25.0625f);
+    if (i < 20) continue;
+    if (out < minOut) minOut = out;
+    if (out > maxOut) maxOut = out;
+  }
+  TEST_ASSERT_TRUE(maxOut - minOut < 0.0625f);
+}
+
+void test_clock_wrap(void) {
+  now = 0xFFFFFFFFu - ACTIVE_MS / 2;
+  feed(25.0f);
+  float variance = filter.variance;
+  feed(25.0f);
+  // One interval of process noise, not four billion ms of it
+  TEST_ASSERT_TRUE(filter.variance < variance + TEMP_KALMAN_Q * ACTIVE_MS / 1000.0f);
+}
+
+// ==================== Missing readings ====================
+
+void test_nan_resets_the_chain(void) {
+  for (int i = 0; i < 10; i++) feed(25.0f);
+
+  TEST_ASSERT_FLOAT_IS_NAN(feed(NAN));
+  TEST_ASSERT_FLOAT_IS_NAN(filter.estimate);
+  TEST_ASSERT_EQUAL_UINT8(0, filter.windowCount);
+
+  // Starts again from the next reading, no history of the old one
+  TEST_ASSERT_EQUAL_FLOAT(30.0f, feed(30.0f));
+  TEST_ASSERT_EQUAL_FLOAT(30.0f, temperatureMedian(filter));
+  TEST_ASSERT_EQUAL_FLOAT(30.0f, feed(30.0f));
+}
+
+void test_empty_median_is_nan(void) {
+  TEST_ASSERT_FLOAT_IS_NAN(temperatureMedian(filter));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_reading_passes_through);
+  RUN_TEST(test_median_while_filling);
+  RUN_TEST(test_spike_rejection);
+  RUN_TEST(test_step_response);
+  RUN_TEST(test_longer_interval_follows_faster);
+  RUN_TEST(test_quantization_jitter_smoothed);
+  RUN_TEST(test_clock_wrap);
+  RUN_TEST(test_nan_resets_the_chain);
+  RUN_TEST(test_empty_median_is_nan);
+  return UNITY_END();
+}
@@ -0,0 +1,221 @@
+/**
+ * @file test_main.cpp
+ * @brief Host simulation of the adaptive DS18B20 sampler (pio test -e native)
+ *
+ * Replays water temperature traces through the sampling rules the firmware
+ * uses (temperature_sampling.h) and through the old fixed schedule (12 bits
+ * every TEMP_BASELINE_INTERVAL), and reports conversion (bus) time and
+ * tracking error (|water - last reading|, sampled every second) for both.
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "config.h"
+#include "temperature_sampling.h"
+
+#define SIM_STEP_MS         1000
+#define BASELINE_INTERVAL   60000   // Old schedule (TEMP_BASELINE_INTERVAL in temperature.h)
+#define PROBE_NOISE         0.02f   // Peak probe noise (°C)
+
+typedef float (*WaterTrace)(uint32_t ms);
+
+struct SimResult {
+  uint32_t cycles;
+  uint32_t conversionMs;
+  uint32_t activeMs;
+  float errorMax;
+  float errorAvg;
+};
+
+static uint32_t noiseState;
+
+/**
+ * Deterministic probe noise in [-PROBE_NOISE, PROBE_NOISE]
+ */
+static float probeNoise() {
+  noiseState = noiseState * 1664525u + 1013904223u;
+  return ((noiseState >> 8) / 16777216.0f * 2 - 1) * PROBE_NOISE;
+}
+
+/**
+ * Probe reading: water plus noise, rounded to the resolution step
+ */
+static float probeReading(float water, uint8_t bits) {
+  float step = resolutionStep(bits);
+  return floorf((water + probeNoise()) / step + 0.5f) * step;
+}
+
+/**
+ * Run one trace for a duration
+ * @param adaptive false = fixed 12-bit schedule
+ */
+static SimResult simulate(WaterTrace trace, uint32_t durationMs, bool adaptive) {
+  SimResult result = {0, 0, 0, 0, 0};
+  noiseState = 12345;
+  bool active = false;
+  float reading = NAN;
+  float reference = NAN;
+  uint32_t referenceTime = 0;
+  uint32_t lastCycle = 0;
+  double errorSum = 0;
+  uint32_t samples = 0;
+
+  for (uint32_t t = 0; t < durationMs; t += SIM_STEP_MS) {
+    uint32_t interval = adaptive ? samplingInterval(active) : BASELINE_INTERVAL;
+    if (result.cycles == 0 || t - lastCycle >= interval) {
+      lastCycle = t;
+      uint8_t bits = adaptive ? samplingResolution(active) : 12;
+      result.cycles++;
+      result.conversionMs += conversionTimeMs(bits);
+      reading = probeReading(trace(t), bits);
+
+      if (adaptive) {
+        if (isnan(reference)) {
+          reference = reading;
+          referenceTime = t;
+        }
+        switch (evaluateSampling(active, fabsf(reading - reference), t - referenceTime)) {
+          case TEMP_SAMPLING_ACTIVATE:
+          case TEMP_SAMPLING_STABILIZE:
+            // Like temperature.cpp: the first reading at the new resolution is the reference
+            active = !active;
+            reference = NAN;
+            break;
+          case TEMP_SAMPLING_RESTART:
+            reference = reading;
+            referenceTime = t;
+            break;
+          case TEMP_SAMPLING_KEEP:
+            break;
+        }
+      }
+    }
+
+    if (active) result.activeMs += SIM_STEP_MS;
+    float error = fabsf(trace(t) - reading);
+    if (error > result.errorMax) result.errorMax = error;
+    errorSum += error;
+    samples++;
+  }
+  result.errorAvg = samples ? errorSum / samples : 0;
+  return result;
+}
+
+static void report(const char* name, const SimResult& adaptive, const SimResult& fixed,
+                   uint32_t durationMs) {
+  char line[200];
+  snprintf(line, sizeof(line),
+           "%s: adaptive %u cycles %u ms conversion (%.1f%% of fixed), %.0f%% active, "
+           "error avg %.3f max %.3f | fixed %u cycles %u ms, error avg %.3f max %.3f",
+           name, adaptive.cycles, adaptive.conversionMs,
+           100.0 * adaptive.conversionMs / fixed.conversionMs,
+           100.0 * adaptive.activeMs / durationMs, adaptive.errorAvg, adaptive.errorMax,
+           fixed.cycles, fixed.conversionMs, fixed.errorAvg, fixed.errorMax);
+  TEST_MESSAGE(line);
+}
+
+// ==================== Traces ====================
+
+#define HOUR_MS 3600000UL
+
+// Covered pool: slow day/night swing of +-0.4 °C
+static float stableDay(uint32_t ms) {
+  return 26.0f + 0.4f * sinf(2 * (float)M_PI * ms / (24 * HOUR_MS));
+}
+
+// Heat pump on at 2 h for 3 h (+1.5 °C/h), then steady
+static float heaterRun(uint32_t ms) {
+  float hours = ms / (float)HOUR_MS;
+  if (hours < 2) return 25.0f;
+  if (hours < 5) return 25.0f + 1.5f * (hours - 2);
+  return 29.5f;
+}
+
+// Fresh water at 3 h: -2 °C over 10 minutes
+static float freshWater(uint32_t ms) {
+  float hours = ms / (float)HOUR_MS;
+  if (hours < 3) return 27.0f;
+  if (hours < 3 + 10 / 60.0f) return 27.0f - 2.0f * (hours - 3) * 6;
+  return 25.0f;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// ==================== Rules ====================
+
+void test_stable_mode_activates_on_drift(void) {
+  TEST_ASSERT_EQUAL(TEMP_SAMPLING_KEEP, evaluateSampling(false, TEMP_ACTIVE_DELTA * 0.9f, 60000));
+  TEST_ASSERT_EQUAL(TEMP_SAMPLING_ACTIVATE, evaluateSampling(false, TEMP_ACTIVE_DELTA, 60000));
+}
+
+void test_active_mode_waits_for_a_whole_window(void) {
+  TEST_ASSERT_EQUAL(TEMP_SAMPLING_KEEP, evaluateSampling(true, 0, TEMP_STABLE_WINDOW - 1));
+  TEST_ASSERT_EQUAL(TEMP_SAMPLING_STABILIZE, evaluateSampling(true, 0, TEMP_STABLE_WINDOW));
+  // Still moving at the end of the window: restart it
+  float fast = TEMP_STABLE_RATE * 2 * TEMP_STABLE_WINDOW / 3600000.0f;
+  TEST_ASSERT_EQUAL(TEMP_SAMPLING_RESTART, evaluateSampling(true, fast, TEMP_STABLE_WINDOW));
+}
+
+void test_datasheet_figures(void) {
+  TEST_ASSERT_EQUAL_UINT32(94, conversionTimeMs(9));
+  TEST_ASSERT_EQUAL_UINT32(750, conversionTimeMs(12));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.5f, resolutionStep(9));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0625f, resolutionStep(12));
+}
+
+// ==================== Simulation ====================
+
+void test_stable_day(void) {
+  uint32_t duration = 24 * HOUR_MS;
+  SimResult adaptive = simulate(stableDay, duration, true);
+  SimResult fixed = simulate(stableDay, duration, false);
+  report("stable day", adaptive, fixed, duration);
+
+  // 10 bits every 2 min instead of 12 bits every minute (~1/8 of the bus time),
+  // plus an active window each time the day swing drifts TEMP_ACTIVE_DELTA
+  TEST_ASSERT_LESS_THAN(fixed.conversionMs / 3, adaptive.conversionMs);
+  // Error bounded by half a 10-bit step plus noise
+  TEST_ASSERT_LESS_THAN(resolutionStep(TEMP_STABLE_RESOLUTION) / 2 + 2 * PROBE_NOISE, adaptive.errorMax);
+}
+
+void test_heater_run(void) {
+  uint32_t duration = 8 * HOUR_MS;
+  SimResult adaptive = simulate(heaterRun, duration, true);
+  SimResult fixed = simulate(heaterRun, duration, false);
+  report("heater run", adaptive, fixed, duration);
+
+  // 12 bits every 10 s during the ramp: more bus time than the fixed schedule
+  TEST_ASSERT_LESS_THAN(fixed.conversionMs * 3, adaptive.conversionMs);
+  // Active for most of the 3 h ramp, stable again afterwards
+  TEST_ASSERT_GREATER_THAN(2 * HOUR_MS, adaptive.activeMs);
+  TEST_ASSERT_LESS_THAN(4 * HOUR_MS, adaptive.activeMs);
+  // The 10 s active interval follows the ramp closer than the 1 min schedule
+  TEST_ASSERT_LESS_THAN(fixed.errorAvg * 1.5f, adaptive.errorAvg);
+  TEST_ASSERT_LESS_THAN(0.25f, adaptive.errorMax);
+}
+
+void test_fresh_water(void) {
+  uint32_t duration = 6 * HOUR_MS;
+  SimResult adaptive = simulate(freshWater, duration, true);
+  SimResult fixed = simulate(freshWater, duration, false);
+  report("fresh water", adaptive, fixed, duration);
+
+  TEST_ASSERT_LESS_THAN(fixed.conversionMs / 2, adaptive.conversionMs);
+  // A fast drop is caught within one stable interval, then followed closely
+  TEST_ASSERT_LESS_THAN(1.0f, adaptive.errorMax);
+  TEST_ASSERT_GREATER_THAN(0, adaptive.activeMs);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_stable_mode_activates_on_drift);
+  RUN_TEST(test_active_mode_waits_for_a_whole_window);
+  RUN_TEST(test_datasheet_figures);
+  RUN_TEST(test_stable_day);
+  RUN_TEST(test_heater_run);
+  RUN_TEST(test_fresh_water);
+  return UNITY_END();
+}
@@ -0,0 +1,213 @@
+/**
+ * @file bench.cpp
+ * @brief Modbus RTU master against the simulated slave on a pty (Linux)
+ *
+ * Runs modbus_rtu.cpp as on the ESP32, with a pty in place of the UART and
+ * slave.py on the other side: one pass of every transaction type and fault
+ * (OK, exception, CRC error, timeout, broadcast, full queue), then 3 s with
+ * the queue kept full of 5-register polls to measure throughput.
+ *
+ * Build and run from firmware/:
+ *   g++ -std=gnu++11 -O2 -Iinclude tools/modbus_sim/bench.cpp src/modbus_rtu.cpp \
+ *       -o /tmp/modbus_bench -lutil && /tmp/modbus_bench tools/modbus_sim/slave.py
+ *
+ * Frames are delimited by 2 ms of line silence on both sides (a pty has no
+ * baud timing; the ESP32 uses the UART RX timeout), so throughput here is
+ * bounded by those two waits, not by the master.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "modbus_rtu.h"
+
+#define RESPONSE_TIMEOUT_US 100000
+#define TURNAROUND_US       5000
+#define SILENCE_US          2000
+#define THROUGHPUT_US       3000000
+
+// ==================== State Variables ====================
+static int busFd = -1;
+static int resultCount = 0;
+static int okCount = 0;
+static ModbusResult results[16];
+
+static uint64_t nowUs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+static void sendFrame(const uint8_t* frame, size_t length) {
+  if (write(busFd, frame, length) != (ssize_t)length) perror("write");
+}
+
+static void onResult(const ModbusResult& result) {
+  if (resultCount < 16) results[resultCount] = result;
+  resultCount++;
+  if (result.status == MODBUS_OK) okCount++;
+}
+
+/**
+ * Serve the bus until a number of results are in or time is up
+ */
+static void runBus(uint64_t untilUs, int wanted) {
+  static uint8_t frame[MODBUS_MAX_FRAME];
+  static size_t length = 0;
+  static uint64_t lastByteAt = 0;
+
+  while (nowUs() < untilUs && resultCount < wanted) {
+    uint32_t waitUs = modbusMasterTick(nowUs());
+    int waitMs = length ? SILENCE_US / 1000 : waitUs == UINT32_MAX ? 5 : waitUs / 1000 + 1;
+    pollfd event = {busFd, POLLIN, 0};
+    if (poll(&event, 1, waitMs) > 0) {
+      ssize_t received = read(busFd, frame + length, sizeof(frame) - length);
+      if (received > 0) {
+        length += received;
+        lastByteAt = nowUs();
+      }
+    }
+    if (length && nowUs() - lastByteAt >= SILENCE_US) {
+      modbusMasterOnFrame(frame, length, nowUs());
+      length = 0;
+    }
+  }
+}
+
+static ModbusRequest makeRequest(uint8_t slave, uint8_t function, uint16_t address, uint16_t count,
+                                 uint32_t tag) {
+  ModbusRequest request;
+  memset(&request, 0, sizeof(request));
+  request.slave = slave;
+  request.function = function;
+  request.address = address;
+  request.count = count;
+  request.tag = tag;
+  return request;
+}
+
+/**
+ * Every transaction type once
+ * @return Number of failed checks
+ */
+static int checkTransactions() {
+  int failures = 0;
+  ModbusRequest readback = makeRequest(1, MODBUS_READ_HOLDING, 0x3000, 5, 1);
+  ModbusRequest writeSingle = makeRequest(1, MODBUS_WRITE_SINGLE, 0x2001, 1, 2);
+  writeSingle.values[0] = 2800;
+  ModbusRequest writeMultiple = makeRequest(1, MODBUS_WRITE_MULTIPLE, 0x2000, 2, 3);
+  writeMultiple.values[0] = 1;
+  writeMultiple.values[1] = 1500;
+
+  modbusMasterSubmit(readback, nowUs());
+  modbusMasterSubmit(writeSingle, nowUs());
+  modbusMasterSubmit(writeMultiple, nowUs());
+  modbusMasterSubmit(makeRequest(1, MODBUS_READ_HOLDING, 0x2000, 2, 4), nowUs());
+  modbusMasterSubmit(makeRequest(1, MODBUS_READ_HOLDING, 0x4000, 1, 5), nowUs());
+  modbusMasterSubmit(makeRequest(1, MODBUS_READ_HOLDING, 0x5000, 1, 6), nowUs());
+  modbusMasterSubmit(makeRequest(2, MODBUS_READ_HOLDING, 0x3000, 5, 7), nowUs());
+  writeSingle.slave = MODBUS_BROADCAST;
+  writeSingle.tag = 8;
+  modbusMasterSubmit(writeSingle, nowUs());
+  if (modbusMasterSubmit(readback, nowUs())) {
+    printf("full queue: 9th request accepted\n");
+    failures++;
+  }
+
+  runBus(nowUs() + 3000000, 8);
+  if (resultCount < 8) {
+    printf("only %d results\n", resultCount);
+    return failures + 1;
+  }
+  const ModbusStatus expected[] = {MODBUS_OK, MODBUS_OK, MODBUS_OK, MODBUS_OK,
+                                   MODBUS_EXCEPTION, MODBUS_CRC_ERROR, MODBUS_TIMEOUT, MODBUS_OK};
+  for (int i = 0; i < 8; i++) {
+    if (results[i].status != expected[i]) {
+      printf("tag %u: status %d, expected %d\n", results[i].tag, results[i].status, expected[i]);
+      failures++;
+    }
+  }
+  if (results[0].values[1] != 2398 || results[0].values[4] != 0) {
+    printf("read holding: wrong values\n");
+    failures++;
+  }
+  if (results[3].values[0] != 1 || results[3].values[1] != 1500) {
+    printf("write multiple: not read back\n");
+    failures++;
+  }
+  if (results[4].exception != 2) {
+    printf("exception code %u, expected 2\n", results[4].exception);
+    failures++;
+  }
+  return failures;
+}
+
+/**
+ * Queue kept full of polls for THROUGHPUT_US
+ */
+static void measureThroughput() {
+  modbusMasterBegin(sendFrame, onResult, RESPONSE_TIMEOUT_US, TURNAROUND_US);
+  ModbusRequest readback = makeRequest(1, MODBUS_READ_HOLDING, 0x3000, 5, 100);
+  resultCount = 0;
+  okCount = 0;
+
+  uint64_t startedAt = nowUs();
+  while (nowUs() - startedAt < THROUGHPUT_US) {
+    while (modbusMasterPending() < MODBUS_QUEUE_LEN) modbusMasterSubmit(readback, nowUs());
+    runBus(nowUs() + 5000, resultCount + 1);
+  }
+  double seconds = (nowUs() - startedAt) / 1e6;
+
+  ModbusStats stats = modbusMasterStats();
+  printf("Throughput: %.0f polls/s (%d ok in %.2f s), latency avg %.0f us, max %u us\n",
+         okCount / seconds, okCount, seconds,
+         stats.responses ? (double)stats.latencyTotalUs / stats.responses : 0.0, stats.latencyMaxUs);
+  printf("Requests %u, timeouts %u, CRC errors %u, bad responses %u, unexpected %u\n",
+         stats.requests, stats.timeouts, stats.crcErrors, stats.badResponses, stats.unexpected);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <path to slave.py>\n", argv[0]);
+    return 2;
+  }
+
+  int master;
+  int slave;
+  if (openpty(&master, &slave, nullptr, nullptr, nullptr) != 0) {
+    perror("openpty");
+    return 1;
+  }
+  termios raw;
+  tcgetattr(slave, &raw);
+  cfmakeraw(&raw);
+  tcsetattr(slave, TCSANOW, &raw);
+  tcsetattr(master, TCSANOW, &raw);
+
+  pid_t simulator = fork();
+  if (simulator == 0) {
+    close(master);
+    char fd[16];
+    snprintf(fd, sizeof(fd), "%d", slave);
+    execlp("python3", "python3", argv[1], fd, (char*)nullptr);
+    perror("python3");
+    _exit(1);
+  }
+  close(slave);
+  busFd = master;
+  usleep(300000);   // Simulator start-up
+
+  modbusMasterBegin(sendFrame, onResult, RESPONSE_TIMEOUT_US, TURNAROUND_US);
+  int failures = checkTransactions();
+  printf("Transactions: %s\n", failures ? "FAIL" : "OK");
+  measureThroughput();
+
+  kill(simulator, SIGTERM);
+  return failures ? 1 : 0;
+}
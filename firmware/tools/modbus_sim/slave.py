@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""
+Simulated Modbus RTU slave on a pseudo-terminal, for bench.cpp
+
+Usage: slave.py <fd>   (the slave side of a pty, inherited from the bench)
+
+Answers slave 1 and the broadcast address (no reply) with a register map in
+memory: 03 reads, 06 and 16 write. Fault cases by address, so the bench can
+reach every master status:
+  0x4000  read -> exception 02 (illegal data address)
+  0x5000  read -> answer with a corrupted CRC
+  other slaves   -> silence (timeout)
+Frames are delimited by 2 ms of line silence: a pty has no baud timing.
+"""
+
+import os
+import select
+import struct
+import sys
+
+SLAVE = 1
+SILENCE_S = 0.002
+EXCEPTION_ADDRESS = 0x4000
+BAD_CRC_ADDRESS = 0x5000
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def answer(frame, registers):
+    """Response PDU with address, or None (broadcast, other slave, bad frame)"""
+    if len(frame) < 8 or crc16(frame[:-2]) != struct.unpack('<H', frame[-2:])[0]:
+        return None
+    slave, function = frame[0], frame[1]
+    if slave not in (0, SLAVE):
+        return None
+    address, value = struct.unpack('>HH', frame[2:6])
+
+    if function in (0x03, 0x04):
+        if address == EXCEPTION_ADDRESS:
+            out = bytes([slave, function | 0x80, 0x02])
+        else:
+            out = bytes([slave, function, 2 * value])
+            out += b''.join(struct.pack('>H', registers.get(address + i, 0)) for i in range(value))
+    elif function == 0x06:
+        registers[address] = value
+        out = frame[:6]
+    elif function == 0x10:
+        for i in range(value):
+            registers[address + i] = struct.unpack('>H', frame[7 + 2 * i:9 + 2 * i])[0]
+        out = frame[:6]
+    else:
+        out = bytes([slave, function | 0x80, 0x01])   # Illegal function
+
+    if slave == 0:
+        return None
+    crc = crc16(out)
+    if address == BAD_CRC_ADDRESS:
+        crc ^= 0x5A5A
+    return out + struct.pack('<H', crc)
+
+
+def main():
+    fd = int(sys.argv[1])
+    # Readback block of a drive: status, speed, power, current, fault
+    registers = {0x3000 + i: value for i, value in enumerate([1, 2398, 410, 21, 0])}
+    buffer = b''
+    while True:
+        ready, _, _ = select.select([fd], [], [], SILENCE_S)
+        if ready:
+            data = os.read(fd, 256)
+            if not data:
+                break
+            buffer += data
+            continue
+        if not buffer:
+            continue
+        response = answer(buffer, registers)
+        buffer = b''
+        if response:
+            os.write(fd, response)
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except (OSError, KeyboardInterrupt):
+        pass
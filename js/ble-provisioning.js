@@ -16,6 +16,29 @@ const ESP32BLEProvisioning = {
   STATUS_CHAR_UUID: '8d8218b6-97bc-4527-a8db-13094ac06b1d',
   NETWORKS_CHAR_UUID: 'fa87c0d0-afac-11de-8a39-0800200c9a66',
   COMMAND_CHAR_UUID: '8b9d68c4-57b8-4b02-bf19-6fd94b62f709',
+  PROVISION_CHAR_UUID: '4fafc202-1fb5-459e-8fcc-c5c9c331914b',
+
+  // TLV record types of the single-write provisioning characteristic
+  TLV: {
+    SSID: 0x01,
+    PASSWORD: 0x02,
+    STATIC_IP: 0x03,    // ip, gateway, subnet, dns (4 bytes each)
+    MQTT_HOST: 0x04,
+    MQTT_PORT: 0x05,    // big endian
+    DEVICE_NAME: 0x06,
+    MQTT_USER: 0x07,    // Required with MQTT_HOST (empty = anonymous)
+    MQTT_PASS: 0x08
+  },
+
+  // Local control service (pump/valve/timer without cloud, optional in firmware)
+  CONTROL_SERVICE_UUID: '6e0f0001-8d2f-4a8e-9b3c-5f1c2a7d9e10',
+  CONTROL_CHAR_UUIDS: {
+    pump: '6e0f0002-8d2f-4a8e-9b3c-5f1c2a7d9e10',
+    valve: '6e0f0003-8d2f-4a8e-9b3c-5f1c2a7d9e10',
+    timer: '6e0f0004-8d2f-4a8e-9b3c-5f1c2a7d9e10',
+    temperature: '6e0f0005-8d2f-4a8e-9b3c-5f1c2a7d9e10',
+    stats: '6e0f0006-8d2f-4a8e-9b3c-5f1c2a7d9e10'
+  },
 
   // State
   device: null,
@@ -26,6 +49,13 @@ const ESP32BLEProvisioning = {
   statusCharacteristic: null,
   networksCharacteristic: null,
   commandCharacteristic: null,
+  provisionCharacteristic: null, // Single TLV write (null on old firmware)
+  statusListener: null,     // Receives status notifications (provisioning ack)
+  networksListener: null,   // Receives networks notifications (scan results)
+  controlCharacteristics: null, // { pump, valve, timer, temperature, stats } when supported
+  controlListeners: [],     // Callbacks for local control state notifications
+  controlWriteConfirmed: false, // A control write succeeded on this link (bonded, passkey authenticated)
+  lastConnectMs: null,      // GATT connect -> characteristics ready (repeat connections skip discovery)
 
   /**
    * Check if Web Bluetooth is supported
@@ -57,13 +87,14 @@ const ESP32BLEProvisioning = {
         filters: [
           { namePrefix: 'Controlador Smart Pool' }
         ],
-        optionalServices: [this.SERVICE_UUID]
+        optionalServices: [this.SERVICE_UUID, this.CONTROL_SERVICE_UUID]
       });
 
       console.log(`[BLE] Found device: ${this.device.name}`);
 
       // Connect to GATT server
       console.log('[BLE] Connecting to GATT server...');
+      const connectStart = performance.now();
       this.server = await this.device.gatt.connect();
       console.log('[BLE] ✓ Connected to GATT server');
 
@@ -85,16 +116,42 @@ const ESP32BLEProvisioning = {
         console.warn('[BLE] Command characteristic not available (old firmware or cached GATT)');
         this.commandCharacteristic = null;
       }
+
+      // Single-write provisioning is optional as well (older firmware: SSID + password writes)
+      try {
+        this.provisionCharacteristic = await this.service.getCharacteristic(this.PROVISION_CHAR_UUID);
+        console.log('[BLE] ✓ Got provisioning characteristic (single TLV write)');
+      } catch (e) {
+        this.provisionCharacteristic = null;
+      }
       
       console.log('[BLE] ✓ Got all characteristics');
 
+      // Subscribe to networks notifications (cached answer + background refresh)
+      try {
+        await this.networksCharacteristic.startNotifications();
+        this.networksCharacteristic.addEventListener('characteristicvaluechanged', (event) => {
+          if (this.networksListener) this.networksListener(event.target.value);
+        });
+      } catch (e) {
+        console.warn('[BLE] Networks notifications not available, falling back to read');
+      }
+
+      // Local control service is optional (disabled in firmware or old firmware)
+      await this.connectControl();
+
       // Subscribe to status notifications
       await this.statusCharacteristic.startNotifications();
       this.statusCharacteristic.addEventListener('characteristicvaluechanged', (event) => {
         const value = new TextDecoder().decode(event.target.value);
         console.log(`[BLE] Status update: ${value}`);
+        if (this.statusListener) this.statusListener(value);
       });
 
+      // A bonded phone with a cached GATT table skips service discovery
+      this.lastConnectMs = Math.round(performance.now() - connectStart);
+      console.log(`[BLE] ✓ Usable ${this.lastConnectMs} ms after connect`);
+
       return true;
     } catch (error) {
       console.error('[BLE] Connection error:', error);
@@ -103,12 +160,129 @@ const ESP32BLEProvisioning = {
     }
   },
 
+  /**
+   * Get the local control characteristics and subscribe to state notifications
+   * Leaves controlCharacteristics null when the firmware has no control service
+   */
+  async connectControl() {
+    try {
+      const service = await this.server.getPrimaryService(this.CONTROL_SERVICE_UUID);
+      const characteristics = {};
+      for (const [name, uuid] of Object.entries(this.CONTROL_CHAR_UUIDS)) {
+        characteristics[name] = await service.getCharacteristic(uuid);
+        if (name === 'stats') continue;
+        await characteristics[name].startNotifications();
+        characteristics[name].addEventListener('characteristicvaluechanged', (event) => {
+          const value = new TextDecoder().decode(event.target.value);
+          this.controlListeners.forEach((listener) => listener(name, value));
+        });
+      }
+      this.controlCharacteristics = characteristics;
+      this.controlWriteConfirmed = false;
+      console.log('[BLE] ✓ Local control service available');
+    } catch (e) {
+      console.warn('[BLE] Local control service not available');
+      this.controlCharacteristics = null;
+    }
+  },
+
+  /**
+   * Register a callback for local control state notifications
+   * @param {Function} listener - (resource, value) with resource pump/valve/timer/temperature
+   */
+  onControlState(listener) {
+    this.controlListeners.push(listener);
+  },
+
+  /**
+   * Send a local control command (same payloads as the MQTT command topics)
+   * Resolves when the resulting state notification arrives, so the returned
+   * time is the full round trip: write -> relay switched -> state notified.
+   * @param {string} resource - 'pump' (ON/OFF/TOGGLE), 'valve' (1/2/TOGGLE) or 'timer' (JSON)
+   * @param {string} value - Command payload
+   * @returns {Promise<{value: string, latencyMs: number}>} New state and round trip time
+   */
+  async sendControl(resource, value) {
+    if (!this.controlCharacteristics || !this.controlCharacteristics[resource]) {
+      throw new Error('Local control not supported by this firmware.');
+    }
+
+    const characteristic = this.controlCharacteristics[resource];
+    const startTime = performance.now();
+
+    const stateNotified = new Promise((resolve, reject) => {
+      const timeout = setTimeout(() => {
+        this.controlListeners = this.controlListeners.filter(l => l !== listener);
+        reject(new Error('No state notification from controller'));
+      }, 2000);
+      const listener = (name, state) => {
+        if (name !== resource) return;
+        clearTimeout(timeout);
+        this.controlListeners = this.controlListeners.filter(l => l !== listener);
+        resolve(state);
+      };
+      this.controlListeners.push(listener);
+    });
+
+    const payload = new TextEncoder().encode(value);
+    if (!this.controlWriteConfirmed) {
+      // Control writes need a bonded link paired with the passkey. A write
+      // command on a weaker link is dropped silently; a write request gets
+      // "insufficient authentication" and the browser pairs (passkey prompt)
+      await characteristic.writeValueWithResponse(payload);
+      this.controlWriteConfirmed = true;
+    } else {
+      // Write without response: no extra ATT round trip before the command runs
+      await characteristic.writeValueWithoutResponse(payload);
+    }
+    const state = await stateNotified;
+    const latencyMs = Math.round(performance.now() - startTime);
+    console.log(`[BLE] Local ${resource} command -> ${state} in ${latencyMs} ms`);
+    return { value: state, latencyMs };
+  },
+
+  /**
+   * Read the controller-side latency statistics of local commands
+   * @returns {Promise<Object>} {commands, dropped, rejected, avg_us, max_us}
+   */
+  async getControlStats() {
+    if (!this.controlCharacteristics) {
+      throw new Error('Local control not supported by this firmware.');
+    }
+    const value = await this.controlCharacteristics.stats.readValue();
+    return JSON.parse(new TextDecoder().decode(value));
+  },
+
+  /**
+   * Parse a networks payload into a list sorted by signal strength
+   * @param {DataView} value - Characteristic value
+   * @returns {Array} [{ssid, rssi, open}, ...]
+   */
+  parseNetworks(value) {
+    let json = new TextDecoder().decode(value).trim();
+
+    // Find the end of valid JSON (last closing bracket)
+    const lastBracket = json.lastIndexOf(']');
+    if (lastBracket !== -1) {
+      json = json.substring(0, lastBracket + 1);
+    }
+
+    const networks = JSON.parse(json);
+    return networks.sort((a, b) => b.rssi - a.rssi); // Sort by signal strength
+  },
+
   /**
    * Scan for available WiFi networks
-   * Request scan from ESP32 and get results via networks characteristic
-   * @returns {Promise<Array>} Array of networks: [{ssid, rssi, open}, ...]
+   * The ESP32 streams the list strongest networks first: the cached table
+   * right away and then every channel of a background refresh as it
+   * completes. The stream is a series of JSON arrays (one per line) cut into
+   * MTU-sized chunks, each notification being [flags][seq][payload]; the last
+   * chunk carries the final flag. A gap in seq means a notification was lost,
+   * in which case the list is requested again once.
+   * @param {Function} onUpdate - Optional callback with the merged list after each array
+   * @returns {Promise<Array>} Complete list: [{ssid, rssi, open}, ...]
    */
-  async scanNetworks() {
+  async scanNetworks(onUpdate) {
     if (!this.server || !this.server.connected) {
       throw new Error('Not connected to device. Call connect() first.');
     }
@@ -117,56 +291,199 @@ const ESP32BLEProvisioning = {
       throw new Error('Networks characteristic not found.');
     }
 
+    const CHUNK_FLAG_FRAMED = 0x80;
+    const CHUNK_FLAG_FINAL = 0x01;
+
+    const encoder = new TextEncoder();
+    const decoder = new TextDecoder();
+    const startTime = performance.now();
+    const found = new Map(); // ssid -> strongest entry
+    let pending = '';        // Text of an incomplete line
+    let expectedSeq = 0;
+    let chunkLost = false;
+    let retried = false;
+    let received = 0;        // Bytes received in this transfer
+    let framed = false;      // Firmware speaks the chunk protocol
+    let done = false;
+
+    const mergedList = () => Array.from(found.values()).sort((a, b) => b.rssi - a.rssi);
+
+    const mergeLine = (line) => {
+      if (line.trim().length === 0) return;
+      let networks;
+      try {
+        networks = JSON.parse(line);
+      } catch (e) {
+        console.warn('[BLE] Skipping incomplete networks line');
+        return;
+      }
+      if (networks.length === 0) return;
+      if (found.size === 0) {
+        console.log(`[BLE] First networks after ${Math.round(performance.now() - startTime)} ms`);
+      }
+      networks.forEach((network) => {
+        const known = found.get(network.ssid);
+        if (!known || network.rssi > known.rssi) found.set(network.ssid, network);
+      });
+      if (onUpdate) onUpdate(mergedList());
+    };
+
     try {
+      const complete = new Promise((resolve) => {
+        this.networksListener = (value) => {
+          if (done) return;
+          const flags = value.byteLength > 0 ? value.getUint8(0) : 0;
+
+          // Firmware without chunk framing notifies whole JSON arrays
+          if (!(flags & CHUNK_FLAG_FRAMED)) {
+            mergeLine(decoder.decode(value));
+            return;
+          }
+
+          framed = true;
+          const seq = value.getUint8(1);
+          if (seq !== expectedSeq) {
+            console.warn(`[BLE] Networks chunk lost (expected ${expectedSeq}, got ${seq})`);
+            chunkLost = true;
+            pending = '';
+          }
+          expectedSeq = (seq + 1) & 0xFF;
+          received += value.byteLength;
+
+          // Complete lines are merged right away; the rest waits for the next chunk
+          const lines = (pending + decoder.decode(new Uint8Array(value.buffer, value.byteOffset + 2, value.byteLength - 2))).split('\n');
+          pending = lines.pop();
+          lines.forEach(mergeLine);
+
+          if (!(flags & CHUNK_FLAG_FINAL)) return;
+
+          mergeLine(pending);
+          pending = '';
+          const elapsed = Math.round(performance.now() - startTime);
+
+          if (chunkLost && !retried) {
+            // Ask again: the cache is fresh now, so the whole list is resent at once
+            console.warn('[BLE] Requesting networks list again after lost chunk');
+            retried = true;
+            chunkLost = false;
+            expectedSeq = 0;
+            received = 0;
+            this.networksCharacteristic.writeValue(encoder.encode('scan')).catch(() => {});
+            return;
+          }
+
+          done = true;
+          console.log(`[BLE] Network list complete: ${found.size} networks, ${received} bytes after ${elapsed} ms`);
+          resolve(mergedList());
+        };
+      });
+
       console.log('[BLE] Triggering network scan...');
-      
-      // Write "scan" to trigger the ESP32 to perform a WiFi scan
-      const encoder = new TextEncoder();
+
+      // Write "scan" to request results from the ESP32
       await this.networksCharacteristic.writeValue(encoder.encode('scan'));
-      
-      console.log('[BLE] Scan request sent, waiting for results...');
-      
-      // Wait for ESP32 to complete scan (2-3 seconds for WiFi scan)
-      await new Promise(resolve => setTimeout(resolve, 3000));
-      
-      // Read the networks characteristic to get scan results
-      const value = await this.networksCharacteristic.readValue();
-      let json = new TextDecoder().decode(value);
-      
-      console.log('[BLE] Raw data length:', value.byteLength);
-      console.log('[BLE] Raw data:', json);
-      
-      // Clean the JSON string - trim whitespace and remove any trailing garbage
-      json = json.trim();
-      
-      // Find the end of valid JSON (last closing bracket)
-      const lastBracket = json.lastIndexOf(']');
-      if (lastBracket !== -1) {
-        json = json.substring(0, lastBracket + 1);
-      }
-      
-      console.log('[BLE] Cleaned JSON:', json);
-      
-      const networks = JSON.parse(json);
-      console.log('[BLE] Parsed networks:', networks);
-      return networks.sort((a, b) => b.rssi - a.rssi); // Sort by signal strength
+
+      // Old firmware never sends a final chunk: settle after a full scan time
+      const fallback = new Promise(resolve => setTimeout(resolve, 5000)).then(async () => {
+        if (done) return null;
+        if (framed) return complete; // Still streaming: the final chunk settles it
+        done = true;
+        if (found.size > 0) return mergedList();
+        console.warn('[BLE] No scan notification, reading characteristic');
+        return this.parseNetworks(await this.networksCharacteristic.readValue());
+      });
+
+      return await Promise.race([complete, fallback]);
     } catch (error) {
       console.error('[BLE] Scan error:', error);
       throw error;
     }
   },
 
+  /**
+   * Encode credentials and optional settings as provisioning TLV records
+   * @param {string} ssid - WiFi network name
+   * @param {string} password - WiFi password
+   * @param {Object} options - Optional { staticIP: {ip, gateway, subnet, dns}, mqttHost, mqttUser,
+   *                           mqttPass, mqttPort, deviceName }. A broker host goes with its own
+   *                           credentials: the firmware never sends its built-in ones to it
+   * @returns {Uint8Array} TLV payload
+   */
+  encodeProvisioningTLV(ssid, password, options = {}) {
+    const encoder = new TextEncoder();
+    const records = [];
+    const add = (type, bytes) => {
+      if (bytes.length > 255) throw new Error('Valor demasiado largo');
+      records.push(type, bytes.length, ...bytes);
+    };
+    const ipv4 = (text) => {
+      const parts = String(text).split('.').map(Number);
+      if (parts.length !== 4 || parts.some(p => !Number.isInteger(p) || p < 0 || p > 255)) {
+        throw new Error(`Dirección IP inválida: ${text}`);
+      }
+      return parts;
+    };
+
+    add(this.TLV.SSID, encoder.encode(ssid));
+    add(this.TLV.PASSWORD, encoder.encode(password));
+    if (options.staticIP) {
+      const { ip, gateway, subnet, dns } = options.staticIP;
+      add(this.TLV.STATIC_IP, [...ipv4(ip), ...ipv4(gateway), ...ipv4(subnet || '255.255.255.0'), ...ipv4(dns || gateway)]);
+    }
+    if (options.mqttHost) {
+      add(this.TLV.MQTT_HOST, encoder.encode(options.mqttHost));
+      add(this.TLV.MQTT_USER, encoder.encode(options.mqttUser || ''));
+      add(this.TLV.MQTT_PASS, encoder.encode(options.mqttPass || ''));
+    }
+    if (options.mqttPort) add(this.TLV.MQTT_PORT, [(options.mqttPort >> 8) & 0xff, options.mqttPort & 0xff]);
+    if (options.deviceName) add(this.TLV.DEVICE_NAME, encoder.encode(options.deviceName));
+    return new Uint8Array(records);
+  },
+
   /**
    * Send WiFi credentials to ESP32
+   * Uses one TLV write acknowledged by one status notify when the firmware
+   * supports it, otherwise the legacy SSID + password writes.
    * @param {string} ssid - WiFi network name
    * @param {string} password - WiFi password
-   * @returns {Promise<boolean>} true if sent successfully
+   * @param {Object} options - Optional network settings (see encodeProvisioningTLV)
+   * @returns {Promise<{roundTrips: number, ms: number, acked: boolean}>}
    */
-  async sendCredentials(ssid, password) {
+  async sendCredentials(ssid, password, options = {}) {
     if (!this.server || !this.server.connected) {
       throw new Error('Not connected to device. Call connect() first.');
     }
 
+    const start = performance.now();
+    if (this.provisionCharacteristic) {
+      const payload = this.encodeProvisioningTLV(ssid, password, options);
+      const ack = new Promise((resolve, reject) => {
+        const timeout = setTimeout(() => {
+          this.statusListener = null;
+          resolve(null);   // No ack (notifications unavailable): the write itself succeeded
+        }, 3000);
+        this.statusListener = (status) => {
+          if (status === 'credentials_ready' || status.startsWith('invalid') || status === 'busy') {
+            clearTimeout(timeout);
+            this.statusListener = null;
+            if (status === 'credentials_ready') resolve(status);
+            else reject(new Error(`El dispositivo rechazó la configuración: ${status}`));
+          }
+        };
+      });
+
+      console.log(`[BLE] Sending provisioning TLV (${payload.length} bytes)`);
+      await this.provisionCharacteristic.writeValue(payload);
+      const status = await ack;
+      const ms = Math.round(performance.now() - start);
+      console.log(`[BLE] ✓ Provisioning ${status ? 'acknowledged' : 'sent'} in ${ms} ms (1 round trip)`);
+      return { roundTrips: 1, ms, acked: status !== null };
+    }
+
+    if (Object.keys(options).length > 0) {
+      console.warn('[BLE] Firmware without TLV provisioning: optional settings ignored');
+    }
+
     try {
       console.log(`[BLE] Sending SSID: ${ssid}`);
       const ssidEncoder = new TextEncoder();
@@ -179,9 +496,10 @@ const ESP32BLEProvisioning = {
       console.log('[BLE] Sending password...');
       const passwordEncoder = new TextEncoder();
       await this.passwordCharacteristic.writeValue(passwordEncoder.encode(password));
-      console.log('[BLE] ✓ Password sent');
+      const ms = Math.round(performance.now() - start);
+      console.log(`[BLE] ✓ Password sent (legacy, 2 round trips, ${ms} ms)`);
 
-      return true;
+      return { roundTrips: 2, ms, acked: false };
     } catch (error) {
       console.error('[BLE] Error sending credentials:', error);
       throw error;
@@ -209,7 +527,13 @@ const ESP32BLEProvisioning = {
     this.ssidCharacteristic = null;
     this.passwordCharacteristic = null;
     this.statusCharacteristic = null;
+    this.networksCharacteristic = null;
     this.commandCharacteristic = null;
+    this.provisionCharacteristic = null;
+    this.statusListener = null;
+    this.networksListener = null;
+    this.controlCharacteristics = null;
+    this.controlWriteConfirmed = false;
   },
 
   /**
@@ -241,9 +565,10 @@ const ESP32BLEProvisioning = {
    * @param {string} ssid - WiFi network name
    * @param {string} password - WiFi password
    * @param {Object} callbacks - Optional callbacks { onProgress, onSuccess, onError }
+   * @param {Object} options - Optional network settings (see encodeProvisioningTLV)
    * @returns {Promise<void>}
    */
-  async provision(ssid, password, callbacks = {}) {
+  async provision(ssid, password, callbacks = {}, options = {}) {
     const { onProgress, onSuccess, onError } = callbacks;
 
     try {
@@ -257,14 +582,16 @@ const ESP32BLEProvisioning = {
 
       // Step 2: Send credentials
       if (onProgress) onProgress('Enviando credenciales WiFi...');
-      await this.sendCredentials(ssid, password);
+      const result = await this.sendCredentials(ssid, password, options);
 
       // Step 3: ESP32 will disconnect BLE after receiving credentials
       // We consider this a success - the ESP32 is now connecting to WiFi
       if (onProgress) onProgress('¡Credenciales enviadas! ESP32 conectando a WiFi...');
 
-      // Give ESP32 a moment to start WiFi connection, then disconnect our side
-      await new Promise(resolve => setTimeout(resolve, 1000));
+      // Without an ack, give ESP32 a moment to take the credentials before disconnecting
+      if (!result.acked) {
+        await new Promise(resolve => setTimeout(resolve, 1000));
+      }
 
       // Disconnect (ESP32 might have already disconnected)
       try {